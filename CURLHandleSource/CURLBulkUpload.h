@@ -0,0 +1,165 @@
+//
+//  CURLBulkUpload.h
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLFTPSession.h"
+
+
+@class CURLBulkUploadItem;
+@class CURLBulkUploadSummary;
+@protocol CURLBulkUploadDelegate;
+
+/**
+ Uploads a whole tree's worth of files to one or more FTP or SFTP servers, e.g. to publish a site.
+
+ Each server gets a small pool of CURLFTPSessions, so files go over a handful of connections which stay logged
+ in, rather than each file opening its own or everything going at once. Files are handed out largest first to
+ whichever session comes free, which keeps the sessions busy until the end rather than leaving one grinding
+ through a big file after the others are done.
+
+ The directories files are going into are created up front, once each, before the files bound for them
+ start. A file which fails is retried on its own, up to maximumAttempts, without holding up the others.
+ */
+
+@interface CURLBulkUpload : NSObject <CURLFTPSessionDelegate>
+{
+  @private
+    NSDictionary                *_manifest;
+    NSURLCredential             *_credential;
+    id <CURLBulkUploadDelegate> _delegate;
+    NSOperationQueue            *_delegateQueue;
+
+    NSUInteger  _maximumSessionsPerHost;
+    NSUInteger  _maximumAttempts;
+
+    // Only accessed on _workQueue, which is also where the hosts' session pools report
+    NSOperationQueue    *_workQueue;
+    NSMutableDictionary *_hosts;
+    BOOL                _started;
+    BOOL                _cancelled;
+    BOOL                _finished;
+    CFAbsoluteTime      _startTime;
+
+    NSUInteger          _succeededCount;
+    NSUInteger          _failedCount;
+    NSUInteger          _retryCount;
+    unsigned long long  _totalBytesSent;
+}
+
+/**
+ @param manifest Maps the file URL of each local file to the ftp, ftps or sftp URL it should be uploaded to.
+ @param credential Used to log in to every server. If `nil`, any credentials in the remote URLs are used.
+ @param delegate Retained until the upload completes or is cancelled.
+ @param queue The queue to deliver delegate messages on. If `nil`, a serial queue is created.
+ */
+- (id)initWithManifest:(NSDictionary *)manifest
+            credential:(NSURLCredential *)credential
+              delegate:(id <CURLBulkUploadDelegate>)delegate
+         delegateQueue:(NSOperationQueue *)queue __attribute((nonnull(1)));
+
+@property (readonly, copy) NSDictionary *manifest;
+@property (readonly, strong) id <CURLBulkUploadDelegate> delegate;
+
+/**
+ The most sessions, and so connections, to open to any one server. Default is 4.
+
+ Must be set before calling -start.
+ */
+@property (assign) NSUInteger maximumSessionsPerHost;
+
+/**
+ How many times to try each file before giving up on it. Default is 3.
+
+ Must be set before calling -start.
+ */
+@property (assign) NSUInteger maximumAttempts;
+
+/**
+ Starts uploading. Only call this once.
+ */
+- (void)start;
+
+/**
+ Stops as quickly as possible. Files not yet uploaded are reported with NSURLErrorCancelled, and then the
+ summary is delivered as usual.
+ */
+- (void)cancel;
+
+@end
+
+
+#pragma mark - Results
+
+/**
+ The outcome of one file.
+ */
+
+@interface CURLBulkUploadItem : NSObject
+{
+  @private
+    NSURL               *_localURL;
+    NSURL               *_remoteURL;
+    NSString            *_path;
+    unsigned long long  _size;
+    NSUInteger          _attemptCount;
+    NSError             *_error;
+}
+
+@property (readonly, copy) NSURL *localURL;
+@property (readonly, copy) NSURL *remoteURL;
+@property (readonly) unsigned long long size;
+@property (readonly) NSUInteger attemptCount;
+@property (readonly, copy) NSError *error;      // from the last attempt; nil if the file was uploaded
+
+@end
+
+
+/**
+ Aggregate figures for a completed bulk upload.
+ */
+
+@interface CURLBulkUploadSummary : NSObject
+{
+  @private
+    NSUInteger          _succeededCount;
+    NSUInteger          _failedCount;
+    NSUInteger          _retryCount;
+    NSUInteger          _sessionCount;
+    unsigned long long  _totalBytesSent;
+    NSTimeInterval      _elapsedTime;
+}
+
+@property (readonly) NSUInteger succeededCount;
+@property (readonly) NSUInteger failedCount;            // includes cancelled files
+@property (readonly) NSUInteger retryCount;             // attempts beyond each file's first
+@property (readonly) NSUInteger sessionCount;           // across all servers
+@property (readonly) unsigned long long totalBytesSent;
+@property (readonly) NSTimeInterval elapsedTime;        // from -start to the last file finishing
+
+/**
+ Bytes sent per second of elapsed time, over all sessions together. 0 if nothing was sent.
+ */
+@property (readonly) double throughput;
+
+@end
+
+
+#pragma mark - Delegate
+
+@protocol CURLBulkUploadDelegate <NSObject>
+
+/**
+ Called once for each file, when it's been uploaded or given up on.
+ */
+- (void)bulkUpload:(CURLBulkUpload *)upload didFinishItem:(CURLBulkUploadItem *)item;
+
+/**
+ Sent as the last message related to the upload, once every file has been reported.
+ */
+- (void)bulkUpload:(CURLBulkUpload *)upload didCompleteWithSummary:(CURLBulkUploadSummary *)summary;
+
+@end
@@ -0,0 +1,445 @@
+//
+//  CURLBulkUpload.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLBulkUpload.h"
+
+#import "CURLFTPSessionPool.h"
+
+
+@interface CURLBulkUploadItem ()
+- (id)initWithLocalURL:(NSURL *)localURL remoteURL:(NSURL *)remoteURL;
+@property (readonly, copy) NSString *path;      // relative to the server's base URL
+@property (readwrite) NSUInteger attemptCount;
+@property (readwrite, copy) NSError *error;
+@end
+
+
+@interface CURLBulkUploadSummary ()
+- (id)initWithSucceededCount:(NSUInteger)succeeded failedCount:(NSUInteger)failed retryCount:(NSUInteger)retries sessionCount:(NSUInteger)sessions totalBytesSent:(unsigned long long)bytes elapsedTime:(NSTimeInterval)elapsed;
+@end
+
+
+#pragma mark Hosts
+
+/*  Everything going to one server: the sessions logged in to it, and the work waiting for them.
+ */
+
+@interface CURLBulkUploadHost : NSObject
+{
+  @public
+    CURLFTPSessionPool  *_pool;
+    NSMutableArray  *_pendingDirectories;   // paths, in the order the largest files need them
+    NSMutableSet    *_readyDirectories;     // created, or tried and failed, so files can go ahead
+    NSMutableArray  *_pendingItems;         // largest first
+}
+@end
+
+@implementation CURLBulkUploadHost
+
+- (id)init
+{
+    if (self = [super init])
+    {
+        _pendingDirectories = [[NSMutableArray alloc] init];
+        _readyDirectories = [[NSMutableSet alloc] initWithObjects:@"", @"~", nil];
+        _pendingItems = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [_pool release];
+    [_pendingDirectories release];
+    [_readyDirectories release];
+    [_pendingItems release];
+
+    [super dealloc];
+}
+
+@end
+
+
+static NSComparator CompareItemsLargestFirst = ^NSComparisonResult(CURLBulkUploadItem *item1, CURLBulkUploadItem *item2) {
+    if (item1.size > item2.size) return NSOrderedAscending;
+    if (item1.size < item2.size) return NSOrderedDescending;
+    return NSOrderedSame;
+};
+
+
+#pragma mark -
+
+@implementation CURLBulkUpload
+
+@synthesize manifest = _manifest;
+@synthesize delegate = _delegate;
+@synthesize maximumSessionsPerHost = _maximumSessionsPerHost;
+@synthesize maximumAttempts = _maximumAttempts;
+
+#pragma mark Lifecycle
+
+- (id)initWithManifest:(NSDictionary *)manifest credential:(NSURLCredential *)credential delegate:(id <CURLBulkUploadDelegate>)delegate delegateQueue:(NSOperationQueue *)queue;
+{
+    NSParameterAssert(manifest);
+
+    if (self = [self init])
+    {
+        _manifest = [manifest copy];
+        _credential = [credential retain];
+        _delegate = [delegate retain];
+
+        if (queue)
+        {
+            _delegateQueue = [queue retain];
+        }
+        else
+        {
+            _delegateQueue = [[NSOperationQueue alloc] init];
+            _delegateQueue.maxConcurrentOperationCount = 1;
+        }
+
+        _workQueue = [[NSOperationQueue alloc] init];
+        _workQueue.maxConcurrentOperationCount = 1;
+
+        _hosts = [[NSMutableDictionary alloc] init];
+        _maximumSessionsPerHost = 4;
+        _maximumAttempts = 3;
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_manifest release];
+    [_credential release];
+    [_delegate release];
+    [_delegateQueue release];
+    [_workQueue release];
+    [_hosts release];
+
+    [super dealloc];
+}
+
+#pragma mark Running
+
+- (void)start;
+{
+    [_workQueue addOperationWithBlock:^{
+
+        NSAssert(!_started, @"CURLBulkUpload can only be started once");
+        _started = YES;
+        if (_cancelled) return;     // and the summary's already gone
+        _startTime = CFAbsoluteTimeGetCurrent();
+
+        // Sort out which server each file is going to
+        for (NSURL *aLocalURL in _manifest)
+        {
+            NSURL *remoteURL = [_manifest objectForKey:aLocalURL];
+            CURLBulkUploadItem *item = [[CURLBulkUploadItem alloc] initWithLocalURL:aLocalURL remoteURL:remoteURL];
+
+            NSURL *baseURL = [[NSURL URLWithString:@"/" relativeToURL:remoteURL] absoluteURL];
+            CURLBulkUploadHost *host = [_hosts objectForKey:[baseURL absoluteString]];
+            if (!host)
+            {
+                host = [[CURLBulkUploadHost alloc] init];
+                host->_pool = [[CURLFTPSessionPool alloc] initWithBaseURL:baseURL credential:_credential maximumSessions:_maximumSessionsPerHost delegate:self delegateQueue:_workQueue];
+                host->_pool.createsIntermediateDirectories = YES;   // in case a directory couldn't be made up front
+                [_hosts setObject:host forKey:[baseURL absoluteString]];
+                [host release];
+            }
+
+            [host->_pendingItems addObject:item];
+            [item release];
+        }
+
+        for (CURLBulkUploadHost *aHost in [_hosts objectEnumerator])
+        {
+            [aHost->_pendingItems sortUsingComparator:CompareItemsLargestFirst];
+
+            // Each directory is created just the once, ahead of the first (and so largest) file to need it
+            for (CURLBulkUploadItem *anItem in aHost->_pendingItems)
+            {
+                NSString *directory = [anItem.path stringByDeletingLastPathComponent];
+                if (![aHost->_readyDirectories containsObject:directory] && ![aHost->_pendingDirectories containsObject:directory])
+                {
+                    [aHost->_pendingDirectories addObject:directory];
+                }
+            }
+
+            [self startWorkForHost:aHost];
+        }
+
+        [self finishIfDone];    // might be an empty manifest
+    }];
+}
+
+- (void)cancel;
+{
+    [_workQueue addOperationWithBlock:^{
+
+        if (_cancelled || _finished) return;
+        _cancelled = YES;
+
+        NSError *error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil];
+
+        for (CURLBulkUploadHost *aHost in [_hosts objectEnumerator])
+        {
+            for (CURLBulkUploadItem *anItem in aHost->_pendingItems)
+            {
+                anItem.error = error;
+                [self finishItem:anItem];
+            }
+            [aHost->_pendingItems removeAllObjects];
+            [aHost->_pendingDirectories removeAllObjects];
+            [aHost->_pool invalidateAndCancel];
+        }
+
+        [self finishIfDone];
+    }];
+}
+
+/*  Keeps every session that can be busy, busy. The host's pool only opens another session while there's work
+ *  waiting which none of the existing ones are free to take.
+ */
+- (void)startWorkForHost:(CURLBulkUploadHost *)host;
+{
+    while (!_cancelled)
+    {
+        // Directories come first, as files can't go until theirs is there
+        NSString *directory = ([host->_pendingDirectories count] ? [host->_pendingDirectories objectAtIndex:0] : nil);
+
+        CURLBulkUploadItem *item = nil;
+        if (!directory)
+        {
+            for (CURLBulkUploadItem *anItem in host->_pendingItems)
+            {
+                if ([host->_readyDirectories containsObject:[anItem.path stringByDeletingLastPathComponent]])
+                {
+                    item = anItem;
+                    break;
+                }
+            }
+        }
+
+        if (!directory && !item) break;
+
+        CURLFTPSession *session = [host->_pool dequeueSession];
+        if (!session) break;
+
+        if (directory)
+        {
+            [host->_pendingDirectories removeObjectAtIndex:0];
+            [session createDirectoryAtPath:directory withIntermediateDirectories:YES];
+        }
+        else
+        {
+            [item retain];
+            [host->_pendingItems removeObject:item];
+            item.attemptCount = item.attemptCount + 1;
+
+            CURLFTPOperation *operation = [session uploadFileAtURL:item.localURL toPath:item.path];
+            operation.userInfo = item;
+            [item release];
+        }
+    }
+}
+
+- (void)finishItem:(CURLBulkUploadItem *)item;
+{
+    if (item.error)
+    {
+        _failedCount++;
+    }
+    else
+    {
+        _succeededCount++;
+    }
+
+    [_delegateQueue addOperationWithBlock:^{
+        [self.delegate bulkUpload:self didFinishItem:item];
+    }];
+}
+
+- (void)finishIfDone;
+{
+    if (_finished) return;
+
+    for (CURLBulkUploadHost *aHost in [_hosts objectEnumerator])
+    {
+        if (aHost->_pool.activeCount || [aHost->_pendingItems count] || [aHost->_pendingDirectories count]) return;
+    }
+
+    _finished = YES;
+
+    NSUInteger sessionCount = 0;
+    for (CURLBulkUploadHost *aHost in [_hosts objectEnumerator])
+    {
+        [aHost->_pool finishOperationsAndInvalidate];
+        sessionCount += aHost->_pool.sessionCount;
+    }
+
+    CURLBulkUploadSummary *summary = [[CURLBulkUploadSummary alloc] initWithSucceededCount:_succeededCount
+                                                                               failedCount:_failedCount
+                                                                                retryCount:_retryCount
+                                                                              sessionCount:sessionCount
+                                                                            totalBytesSent:_totalBytesSent
+                                                                               elapsedTime:CFAbsoluteTimeGetCurrent() - _startTime];
+
+    [_delegateQueue addOperationWithBlock:^{
+        [self.delegate bulkUpload:self didCompleteWithSummary:summary];
+
+        // Break the retain cycle, like CURLTransfer
+        [_delegate release]; _delegate = nil;
+    }];
+    [summary release];
+}
+
+#pragma mark CURLFTPSessionDelegate
+
+// Passed on by the hosts' pools, on _workQueue. By then the session is back in its pool, ready for more work
+
+- (void)FTPSession:(CURLFTPSession *)session didCompleteOperation:(CURLFTPOperation *)operation;
+{
+    CURLBulkUploadHost *host = [_hosts objectForKey:[session.baseURL absoluteString]];
+    NSAssert(host, @"operation %@ from a session that isn't ours", operation);
+
+    if (operation.type == CURLFTPOperationTypeCreateDirectory)
+    {
+        // If it failed, uploads get to try creating it themselves
+        if (operation.error) CURLHandleLog(@"couldn't create directory %@: %@", operation.path, operation.error);
+
+        NSString *directory = operation.path;
+        while ([directory length])
+        {
+            [host->_readyDirectories addObject:directory];
+            directory = [directory stringByDeletingLastPathComponent];
+        }
+    }
+    else
+    {
+        CURLBulkUploadItem *item = operation.userInfo;
+        item.error = operation.error;
+
+        if (!item.error)
+        {
+            _totalBytesSent += operation.bytesSent;
+            [self finishItem:item];
+        }
+        else if (!_cancelled && item.attemptCount < _maximumAttempts)
+        {
+            // Back in the queue, in size order like everything else
+            CURLHandleLog(@"retrying %@ after %@", item.remoteURL, item.error);
+            _retryCount++;
+
+            NSUInteger index = [host->_pendingItems indexOfObject:item
+                                                    inSortedRange:NSMakeRange(0, [host->_pendingItems count])
+                                                          options:NSBinarySearchingInsertionIndex
+                                                  usingComparator:CompareItemsLargestFirst];
+            [host->_pendingItems insertObject:item atIndex:index];
+        }
+        else
+        {
+            [self finishItem:item];
+        }
+    }
+
+    [self startWorkForHost:host];
+    [self finishIfDone];
+}
+
+@end
+
+
+#pragma mark -
+
+
+@implementation CURLBulkUploadItem
+
+- (id)initWithLocalURL:(NSURL *)localURL remoteURL:(NSURL *)remoteURL;
+{
+    if (self = [self init])
+    {
+        _localURL = [localURL copy];
+        _remoteURL = [remoteURL copy];
+
+        NSString *path = [remoteURL path];
+        _path = [([path hasPrefix:@"/"] ? [path substringFromIndex:1] : path) copy];
+
+        NSNumber *size = [[[NSFileManager defaultManager] attributesOfItemAtPath:[localURL path] error:NULL] objectForKey:NSFileSize];
+        _size = [size unsignedLongLongValue];
+    }
+    return self;
+}
+
+@synthesize localURL = _localURL;
+@synthesize remoteURL = _remoteURL;
+@synthesize path = _path;
+@synthesize size = _size;
+@synthesize attemptCount = _attemptCount;
+@synthesize error = _error;
+
+- (void)dealloc
+{
+    [_localURL release];
+    [_remoteURL release];
+    [_path release];
+    [_error release];
+
+    [super dealloc];
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %p %@ -> %@ %llu bytes, %lu attempts %@>", [self class], self, [_localURL path], _remoteURL, _size, (unsigned long)_attemptCount, (_error ? _error : @"OK")];
+}
+
+@end
+
+
+#pragma mark -
+
+
+@implementation CURLBulkUploadSummary
+
+@synthesize succeededCount = _succeededCount;
+@synthesize failedCount = _failedCount;
+@synthesize retryCount = _retryCount;
+@synthesize sessionCount = _sessionCount;
+@synthesize totalBytesSent = _totalBytesSent;
+@synthesize elapsedTime = _elapsedTime;
+
+- (id)initWithSucceededCount:(NSUInteger)succeeded failedCount:(NSUInteger)failed retryCount:(NSUInteger)retries sessionCount:(NSUInteger)sessions totalBytesSent:(unsigned long long)bytes elapsedTime:(NSTimeInterval)elapsed;
+{
+    if (self = [self init])
+    {
+        _succeededCount = succeeded;
+        _failedCount = failed;
+        _retryCount = retries;
+        _sessionCount = sessions;
+        _totalBytesSent = bytes;
+        _elapsedTime = elapsed;
+    }
+
+    return self;
+}
+
+- (double)throughput;
+{
+    return (_elapsedTime > 0.0 ? _totalBytesSent / _elapsedTime : 0.0);
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %p succeeded:%lu failed:%lu retries:%lu sessions:%lu bytes:%llu in %.2fs (%.1fKB/s)>",
+            [self class], self,
+            (unsigned long)_succeededCount, (unsigned long)_failedCount, (unsigned long)_retryCount, (unsigned long)_sessionCount,
+            _totalBytesSent, _elapsedTime, self.throughput / 1024.0];
+}
+
+@end
@@ -0,0 +1,74 @@
+//
+//  CURLConnectionPool.h
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <curl/curl.h>
+
+#import "CURLConnectionStatistics.h"
+
+
+typedef struct {
+    NSUInteger      transfers;
+    NSUInteger      newConnections;
+    NSUInteger      reusedConnections;
+    NSUInteger      openConnections;
+    NSUInteger      idleConnections;
+    NSUInteger      closedConnections;
+    NSUInteger      evictions;
+    NSTimeInterval  totalLifetime;
+    NSTimeInterval  longestLifetime;
+} CURLConnectionCounts;
+
+
+/**
+ Internal bookkeeping behind CURLMultiHandle's connection statistics. Not intended for public consumption.
+
+ Watches every socket the multi's easy handles open and close, using CURLOPT_OPENSOCKETFUNCTION and
+ CURLOPT_CLOSESOCKETFUNCTION. libcurl hangs on to the close callback for as long as the connection is pooled,
+ which can be longer than the multi itself lives, so each open socket keeps the receiver alive until it's closed.
+
+ Thread-safe, although CURLMultiHandle only calls it on its queue, apart from taking snapshots.
+ */
+
+@interface CURLConnectionPool : NSObject
+{
+  @private
+    NSMutableDictionary     *_sockets;          // NSNumber of the socket -> CURLPooledSocket
+    NSMutableDictionary     *_origins;          // origin -> NSMutableData holding CURLConnectionCounts
+    CURLConnectionCounts    _totals;
+    NSCountedSet            *_runningOrigins;
+}
+
+/**
+ Sets the socket callbacks on `handle`. Must come after anything that resets the handle.
+ */
+- (CURLcode)installOnHandle:(CURL *)handle __attribute((nonnull));
+
+- (void)noteTransferStartedForOrigin:(NSString *)origin __attribute((nonnull));
+
+/**
+ Must be called while `handle` is still part of the multi, so libcurl can still say which connection it used.
+ */
+- (void)noteTransferFinishedForOrigin:(NSString *)origin handle:(CURL *)handle __attribute((nonnull));
+
+- (CURLConnectionStatistics *)statistics;
+- (NSDictionary *)statisticsByOrigin;
+
+/**
+ Zeroes the counts. Connections which are still open carry on being tracked.
+ */
+- (void)reset;
+
+@end
+
+
+@interface CURLConnectionStatistics (CURLConnectionPool)
+
+- (id)initWithCounts:(const CURLConnectionCounts *)counts __attribute((nonnull));
+
+@end
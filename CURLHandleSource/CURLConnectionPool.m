@@ -0,0 +1,263 @@
+//
+//  CURLConnectionPool.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLConnectionPool.h"
+
+#import "CURLRequest.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+#pragma mark Pooled Socket
+
+@interface CURLPooledSocket : NSObject
+{
+  @public
+    CFAbsoluteTime  _openTime;
+    NSString        *_origin;       // nil until a transfer has finished with it
+}
+@end
+
+@implementation CURLPooledSocket
+
+- (void)dealloc
+{
+    [_origin release];
+    [super dealloc];
+}
+
+@end
+
+
+#pragma mark - Callbacks
+
+static curl_socket_t CURLConnectionPoolOpenSocket(CURLConnectionPool *pool, curlsocktype purpose, struct curl_sockaddr *address);
+static int CURLConnectionPoolCloseSocket(CURLConnectionPool *pool, curl_socket_t socket);
+
+@interface CURLConnectionPool ()
+- (void)noteSocketOpened:(curl_socket_t)socket;
+- (void)noteSocketClosed:(curl_socket_t)socket;
+@end
+
+
+#pragma mark - Pool
+
+@implementation CURLConnectionPool
+
+- (id)init;
+{
+    if (self = [super init])
+    {
+        _sockets = [[NSMutableDictionary alloc] init];
+        _origins = [[NSMutableDictionary alloc] init];
+        _runningOrigins = [[NSCountedSet alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [_sockets release];
+    [_origins release];
+    [_runningOrigins release];
+
+    [super dealloc];
+}
+
+- (CURLcode)installOnHandle:(CURL *)handle;
+{
+    CURLcode code = curl_easy_setopt(handle, CURLOPT_OPENSOCKETFUNCTION, CURLConnectionPoolOpenSocket);
+    if (code == CURLE_OK) code = curl_easy_setopt(handle, CURLOPT_OPENSOCKETDATA, self);
+    if (code == CURLE_OK) code = curl_easy_setopt(handle, CURLOPT_CLOSESOCKETFUNCTION, CURLConnectionPoolCloseSocket);
+    if (code == CURLE_OK) code = curl_easy_setopt(handle, CURLOPT_CLOSESOCKETDATA, self);
+    return code;
+}
+
+- (CURLConnectionCounts *)countsForOrigin:(NSString *)origin;
+{
+    NSMutableData *counts = [_origins objectForKey:origin];
+    if (!counts)
+    {
+        counts = [NSMutableData dataWithLength:sizeof(CURLConnectionCounts)];
+        [_origins setObject:counts forKey:origin];
+    }
+    return [counts mutableBytes];
+}
+
+#pragma mark Transfers
+
+- (void)noteTransferStartedForOrigin:(NSString *)origin;
+{
+    @synchronized(self)
+    {
+        [_runningOrigins addObject:origin];
+    }
+}
+
+- (void)noteTransferFinishedForOrigin:(NSString *)origin handle:(CURL *)handle;
+{
+    long connections = 0;
+    if (curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &connections) != CURLE_OK) connections = 0;
+
+    // The connection the transfer was left on, if it was kept, which is attributed to wherever the transfer
+    // ended up after any redirects
+    long socket = -1;
+    if (curl_easy_getinfo(handle, CURLINFO_LASTSOCKET, &socket) != CURLE_OK) socket = -1;
+
+    char *primaryIP = NULL;
+    curl_easy_getinfo(handle, CURLINFO_PRIMARY_IP, &primaryIP);
+    BOOL connected = (primaryIP && *primaryIP);
+
+    char *effectiveURL = NULL;
+    curl_easy_getinfo(handle, CURLINFO_EFFECTIVE_URL, &effectiveURL);
+    NSString *connectionOrigin = (effectiveURL ? [[NSURL URLWithString:[NSString stringWithUTF8String:effectiveURL]] curl_originString] : nil);
+    if (!connectionOrigin) connectionOrigin = origin;
+
+    @synchronized(self)
+    {
+        [_runningOrigins removeObject:origin];
+
+        CURLConnectionCounts *counts = [self countsForOrigin:origin];
+        counts->transfers++; _totals.transfers++;
+        counts->newConnections += connections; _totals.newConnections += connections;
+        if (connections == 0 && connected)
+        {
+            counts->reusedConnections++; _totals.reusedConnections++;
+        }
+
+        CURLPooledSocket *pooled = (socket != -1 ? [_sockets objectForKey:[NSNumber numberWithLong:socket]] : nil);
+        if (pooled && !pooled->_origin) pooled->_origin = [connectionOrigin copy];
+    }
+}
+
+#pragma mark Sockets
+
+- (void)noteSocketOpened:(curl_socket_t)socket;
+{
+    CURLPooledSocket *pooled = [[CURLPooledSocket alloc] init];
+    pooled->_openTime = CFAbsoluteTimeGetCurrent();
+
+    @synchronized(self)
+    {
+        [_sockets setObject:pooled forKey:[NSNumber numberWithInt:socket]];
+    }
+    [pooled release];
+
+    [self retain];  // balanced when the socket closes
+}
+
+- (void)noteSocketClosed:(curl_socket_t)socket;
+{
+    NSNumber *key = [NSNumber numberWithInt:socket];
+
+    @synchronized(self)
+    {
+        CURLPooledSocket *pooled = [_sockets objectForKey:key];
+        if (!pooled) return;    // e.g. an FTP listening socket, which libcurl made itself
+
+        // Sockets no transfer finished with were failed connection attempts, or FTP data connections, so
+        // aren't worth counting
+        NSString *origin = pooled->_origin;
+        if (origin)
+        {
+            NSTimeInterval lifetime = CFAbsoluteTimeGetCurrent() - pooled->_openTime;
+            BOOL evicted = ([_runningOrigins countForObject:origin] == 0);
+
+            CURLConnectionCounts *counts = [self countsForOrigin:origin];
+            counts->closedConnections++; _totals.closedConnections++;
+            counts->totalLifetime += lifetime; _totals.totalLifetime += lifetime;
+            counts->longestLifetime = MAX(counts->longestLifetime, lifetime);
+            _totals.longestLifetime = MAX(_totals.longestLifetime, lifetime);
+            if (evicted)
+            {
+                counts->evictions++; _totals.evictions++;
+            }
+        }
+
+        [_sockets removeObjectForKey:key];
+    }
+
+    [self release];
+}
+
+#pragma mark Statistics
+
+- (CURLConnectionStatistics *)statistics;
+{
+    @synchronized(self)
+    {
+        CURLConnectionCounts counts = _totals;
+        counts.openConnections = [_sockets count];
+
+        NSUInteger running = 0;
+        for (NSString *anOrigin in _runningOrigins)
+        {
+            running += [_runningOrigins countForObject:anOrigin];
+        }
+        counts.idleConnections = (counts.openConnections > running ? counts.openConnections - running : 0);
+
+        return [[[CURLConnectionStatistics alloc] initWithCounts:&counts] autorelease];
+    }
+}
+
+- (NSDictionary *)statisticsByOrigin;
+{
+    @synchronized(self)
+    {
+        // Tally open connections for each origin
+        NSCountedSet *open = [NSCountedSet set];
+        for (CURLPooledSocket *aSocket in [_sockets objectEnumerator])
+        {
+            if (aSocket->_origin) [open addObject:aSocket->_origin];
+        }
+
+        NSMutableDictionary *result = [NSMutableDictionary dictionaryWithCapacity:[_origins count]];
+        for (NSString *anOrigin in [open setByAddingObjectsFromArray:[_origins allKeys]])
+        {
+            CURLConnectionCounts counts = *[self countsForOrigin:anOrigin];
+            counts.openConnections = [open countForObject:anOrigin];
+
+            NSUInteger running = [_runningOrigins countForObject:anOrigin];
+            counts.idleConnections = (counts.openConnections > running ? counts.openConnections - running : 0);
+
+            CURLConnectionStatistics *statistics = [[CURLConnectionStatistics alloc] initWithCounts:&counts];
+            [result setObject:statistics forKey:anOrigin];
+            [statistics release];
+        }
+
+        return result;
+    }
+}
+
+- (void)reset;
+{
+    @synchronized(self)
+    {
+        [_origins removeAllObjects];
+        memset(&_totals, 0, sizeof(_totals));
+    }
+}
+
+@end
+
+
+#pragma mark - Callback Functions
+
+static curl_socket_t CURLConnectionPoolOpenSocket(CURLConnectionPool *pool, curlsocktype purpose, struct curl_sockaddr *address)
+{
+    curl_socket_t result = socket(address->family, address->socktype, address->protocol);
+    if (result != CURL_SOCKET_BAD) [pool noteSocketOpened:result];
+    return result;
+}
+
+static int CURLConnectionPoolCloseSocket(CURLConnectionPool *pool, curl_socket_t socket)
+{
+    [pool noteSocketClosed:socket];
+    return close(socket);
+}
@@ -0,0 +1,81 @@
+//
+//  CURLConnectionStatistics.h
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+
+/**
+ A snapshot of how a CURLMultiHandle's connections have been used, overall or for a single origin.
+
+ Get one from -[CURLMultiHandle connectionStatistics] or -connectionStatisticsByOrigin; for CURLProtocol loads,
+ ask [CURLMultiHandle sharedInstance]. Counts accumulate from when the multi was created, or last reset.
+
+ Connections are attributed to an origin once a transfer has finished with them; until then, they only show up
+ in the overall figures. Synchronous transfers, which don't go through a multi, aren't counted.
+ */
+
+@interface CURLConnectionStatistics : NSObject
+{
+  @private
+    NSUInteger      _transferCount;
+    NSUInteger      _newConnectionCount;
+    NSUInteger      _reusedConnectionCount;
+    NSUInteger      _openConnectionCount;
+    NSUInteger      _idleConnectionCount;
+    NSUInteger      _closedConnectionCount;
+    NSUInteger      _evictionCount;
+    NSTimeInterval  _totalConnectionLifetime;
+    NSTimeInterval  _longestConnectionLifetime;
+}
+
+/** @name Transfers */
+
+@property (readonly) NSUInteger transferCount;
+
+/**
+ Connections transfers had to open for themselves (CURLINFO_NUM_CONNECTS).
+ */
+@property (readonly) NSUInteger newConnectionCount;
+
+/**
+ Transfers which ran entirely over a connection left in the pool.
+ */
+@property (readonly) NSUInteger reusedConnectionCount;
+
+/**
+ The fraction of transfers which reused a connection, from 0 to 1.
+ */
+@property (readonly) double reuseRatio;
+
+/** @name The Pool */
+
+@property (readonly) NSUInteger openConnectionCount;
+
+/**
+ Open connections not carrying a transfer. Exact when the multi is quiet; while transfers are running, it's
+ an estimate, since libcurl doesn't say which pooled connection a transfer has picked up until it finishes.
+ */
+@property (readonly) NSUInteger idleConnectionCount;
+
+@property (readonly) NSUInteger closedConnectionCount;
+
+/**
+ Connections closed by the pool rather than by a transfer using them: to make room under its limit, because
+ the server had dropped them, or as the multi shut down.
+ */
+@property (readonly) NSUInteger evictionCount;
+
+/** @name Lifetimes */
+
+/**
+ From opening to closing, over the connections which have closed. 0 if none have.
+ */
+@property (readonly) NSTimeInterval averageConnectionLifetime;
+@property (readonly) NSTimeInterval longestConnectionLifetime;
+
+@end
@@ -0,0 +1,68 @@
+//
+//  CURLConnectionStatistics.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLConnectionStatistics.h"
+
+#import "CURLConnectionPool.h"
+
+
+@implementation CURLConnectionStatistics
+
+- (id)initWithCounts:(const CURLConnectionCounts *)counts;
+{
+    if (self = [self init])
+    {
+        _transferCount = counts->transfers;
+        _newConnectionCount = counts->newConnections;
+        _reusedConnectionCount = counts->reusedConnections;
+        _openConnectionCount = counts->openConnections;
+        _idleConnectionCount = counts->idleConnections;
+        _closedConnectionCount = counts->closedConnections;
+        _evictionCount = counts->evictions;
+        _totalConnectionLifetime = counts->totalLifetime;
+        _longestConnectionLifetime = counts->longestLifetime;
+    }
+    return self;
+}
+
+@synthesize transferCount = _transferCount;
+@synthesize newConnectionCount = _newConnectionCount;
+@synthesize reusedConnectionCount = _reusedConnectionCount;
+@synthesize openConnectionCount = _openConnectionCount;
+@synthesize idleConnectionCount = _idleConnectionCount;
+@synthesize closedConnectionCount = _closedConnectionCount;
+@synthesize evictionCount = _evictionCount;
+@synthesize longestConnectionLifetime = _longestConnectionLifetime;
+
+- (double)reuseRatio;
+{
+    return (_transferCount ? (double)_reusedConnectionCount / _transferCount : 0.0);
+}
+
+- (NSTimeInterval)averageConnectionLifetime;
+{
+    return (_closedConnectionCount ? _totalConnectionLifetime / _closedConnectionCount : 0.0);
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"%@ %lu transfers, %lu new connections, %lu reused (%.0f%%); %lu open, %lu idle; %lu closed, %lu evicted; lifetime average %.1fs longest %.1fs",
+            [super description],
+            (unsigned long)_transferCount,
+            (unsigned long)_newConnectionCount,
+            (unsigned long)_reusedConnectionCount,
+            [self reuseRatio] * 100.0,
+            (unsigned long)_openConnectionCount,
+            (unsigned long)_idleConnectionCount,
+            (unsigned long)_closedConnectionCount,
+            (unsigned long)_evictionCount,
+            [self averageConnectionLifetime],
+            _longestConnectionLifetime];
+}
+
+@end
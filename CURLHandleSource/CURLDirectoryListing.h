@@ -0,0 +1,122 @@
+//
+//  CURLDirectoryListing.h
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+
+@class CURLDirectoryEntry;
+
+/**
+ The listing formats CURLDirectoryListingParser understands.
+ */
+typedef NS_ENUM(NSInteger, CURLDirectoryListingFormat) {
+    CURLDirectoryListingFormatAutomatic = 0,    // worked out line by line
+    CURLDirectoryListingFormatUnix,             // "ls -l" style, as from most FTP servers' LIST, and always for SFTP
+    CURLDirectoryListingFormatMLSD,             // RFC 3659 machine-readable facts
+    CURLDirectoryListingFormatWindows,          // IIS/DOS style, e.g. "01-02-13  03:04PM  <DIR>  name"
+};
+
+typedef NS_ENUM(NSInteger, CURLDirectoryEntryType) {
+    CURLDirectoryEntryTypeUnknown = 0,
+    CURLDirectoryEntryTypeFile,
+    CURLDirectoryEntryTypeDirectory,
+    CURLDirectoryEntryTypeSymbolicLink,
+};
+
+/**
+ Called with the entries parsed from each chunk of data. The array is the parser's to reuse once the block
+ returns, so copy it if you want to keep it (the entries themselves can be retained as usual).
+ */
+typedef void (^CURLDirectoryListingHandler)(NSArray *entries);
+
+
+/**
+ Turns a directory listing into CURLDirectoryEntry objects as it downloads.
+
+ Feed it each chunk of body data from -transfer:didReceiveData: (or anywhere else), then call -finish once the
+ transfer completes. Lines are parsed as soon as they're complete; only a partial line is ever held over
+ between chunks, so a listing of millions of entries never has to sit in memory as text. What happens to the
+ entries is up to the handler -- keep them, or just count, filter or write them out as they go by.
+
+ Lines which can't be parsed (e.g. "total 123" headers) are skipped and counted, as are the "." and ".."
+ entries some servers include. Not thread-safe; feed it from one queue at a time, such as the transfer's
+ delegate queue.
+ */
+
+@interface CURLDirectoryListingParser : NSObject
+{
+  @private
+    CURLDirectoryListingFormat  _format;
+    CURLDirectoryListingHandler _handler;
+    NSMutableData               *_partialLine;
+    BOOL                        _discardingLine;        // the partial line got too long to be an entry
+    NSMutableArray              *_batch;
+    NSUInteger                  _entryCount;
+    NSUInteger                  _skippedLineCount;
+    CFAbsoluteTime              _referenceTime;         // for Unix dates which leave the year out
+}
+
+/**
+ @param format The format to expect, or CURLDirectoryListingFormatAutomatic if unknown.
+ @param handler Called synchronously from -appendData: and -finish whenever there are new entries.
+ */
+- (id)initWithFormat:(CURLDirectoryListingFormat)format handler:(CURLDirectoryListingHandler)handler __attribute((nonnull(2)));
+
+- (void)appendData:(NSData *)data;
+- (void)appendBytes:(const void *)bytes length:(NSUInteger)length;
+
+/**
+ Parses anything left over which wasn't followed by a newline. Call once there's no more data.
+ */
+- (void)finish;
+
+@property (readonly) CURLDirectoryListingFormat format;
+@property (readonly) NSUInteger entryCount;
+@property (readonly) NSUInteger skippedLineCount;
+
+/**
+ Parses a single line, without the line ending.
+
+ @return `nil` if the line isn't an entry in the given format.
+ */
++ (CURLDirectoryEntry *)entryWithLine:(NSString *)line format:(CURLDirectoryListingFormat)format;
+
+@end
+
+
+/**
+ One item in a directory listing. Anything the listing doesn't say is left as 0/`nil`.
+ */
+
+@interface CURLDirectoryEntry : NSObject
+{
+  @private
+    NSString                *_name;
+    NSString                *_symbolicLinkTarget;
+    unsigned long long      _size;
+    CFAbsoluteTime          _modificationTime;      // NAN if unknown
+    CURLDirectoryEntryType  _type;
+    unsigned short          _permissions;
+    CURLDirectoryListingFormat  _format;
+}
+
+@property (readonly, copy) NSString *name;
+@property (readonly, copy) NSString *symbolicLinkTarget;    // for Unix listings of symbolic links
+@property (readonly) unsigned long long size;
+@property (readonly) CURLDirectoryEntryType type;
+@property (readonly) unsigned short permissions;            // POSIX mode bits, e.g. 0755
+@property (readonly) CURLDirectoryListingFormat format;     // what the line was parsed as; never Automatic
+
+/**
+ In UTC. Unix listings give the server's local time, which is taken to be UTC, and leave out the seconds; recent
+ entries leave out the year too.
+ */
+@property (readonly, copy) NSDate *modificationDate;
+@property (readonly) CFAbsoluteTime modificationTime;       // NAN if unknown; saves creating an NSDate
+
+@end
@@ -0,0 +1,591 @@
+//
+//  CURLDirectoryListing.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLDirectoryListing.h"
+
+#include <sys/stat.h>
+#include <time.h>
+
+
+// Anything longer is taken to be garbage rather than an entry, so a listing without newlines can't eat memory
+static const NSUInteger kMaximumLineLength = 64 * 1024;
+
+// What a line parses to, before any objects are made
+typedef struct {
+    const char              *name;
+    size_t                  nameLength;
+    const char              *target;
+    size_t                  targetLength;
+    unsigned long long      size;
+    CFAbsoluteTime          time;
+    CURLDirectoryEntryType  type;
+    unsigned short          permissions;
+    CURLDirectoryListingFormat  format;
+} CURLParsedEntry;
+
+typedef struct {
+    const char  *start;
+    const char  *end;
+} CURLToken;
+
+
+@interface CURLDirectoryEntry ()
+- (id)initWithParsedEntry:(const CURLParsedEntry *)parsed;
+@end
+
+
+#pragma mark - Parsing Helpers
+
+static CFAbsoluteTime CURLTimeFromComponents(int year, int month, int day, int hour, int minute, int second)
+{
+    struct tm components = {0};
+    components.tm_year = year - 1900;
+    components.tm_mon = month - 1;
+    components.tm_mday = day;
+    components.tm_hour = hour;
+    components.tm_min = minute;
+    components.tm_sec = second;
+
+    return (CFAbsoluteTime)timegm(&components) - kCFAbsoluteTimeIntervalSince1970;
+}
+
+static BOOL CURLTokenIsDigits(CURLToken token)
+{
+    if (token.start == token.end) return NO;
+    for (const char *p = token.start; p < token.end; ++p)
+    {
+        if (!isdigit(*p)) return NO;
+    }
+    return YES;
+}
+
+static int CURLParseDigits(const char *p, size_t length)
+{
+    int result = 0;
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (!isdigit(p[i])) return -1;
+        result = result * 10 + (p[i] - '0');
+    }
+    return result;
+}
+
+static int CURLMonthFromToken(CURLToken token)
+{
+    static const char *months[] = { "jan", "feb", "mar", "apr", "may", "jun", "jul", "aug", "sep", "oct", "nov", "dec" };
+
+    if (token.end - token.start != 3) return 0;
+    for (int i = 0; i < 12; ++i)
+    {
+        if (strncasecmp(token.start, months[i], 3) == 0) return i + 1;
+    }
+    return 0;
+}
+
+/*  Permission characters come in threes. Execute doubles up with setuid/setgid/sticky: lowercase if execute is
+ *  set too, uppercase if not
+ */
+static BOOL CURLParseUnixPermissions(const char *mode, unsigned short *permissions)
+{
+    static const unsigned short specialBits[] = { S_ISUID, S_ISGID, S_ISVTX };
+    static const char specialChars[] = { 's', 's', 't' };
+
+    unsigned short result = 0;
+    for (int i = 0; i < 3; ++i)
+    {
+        const char *triple = mode + (i * 3);
+        unsigned short shift = (unsigned short)(6 - (i * 3));
+
+        if (triple[0] == 'r') result |= (4 << shift);
+        else if (triple[0] != '-') return NO;
+
+        if (triple[1] == 'w') result |= (2 << shift);
+        else if (triple[1] != '-') return NO;
+
+        char execute = triple[2];
+        if (execute == 'x') result |= (1 << shift);
+        else if (execute == specialChars[i]) result |= (1 << shift) | specialBits[i];
+        else if (execute == toupper(specialChars[i])) result |= specialBits[i];
+        else if (execute != '-') return NO;
+    }
+
+    *permissions = result;
+    return YES;
+}
+
+/*  e.g. "drwxr-xr-x   2 owner group      4096 Mar  7 12:34 name" or "... Mar  7  2011 name". Some servers leave
+ *  out the group, or add more columns, so the date is found by its shape, and the size is whatever precedes it
+ */
+static BOOL CURLParseUnixLine(const char *line, const char *end, CFAbsoluteTime referenceTime, CURLParsedEntry *entry)
+{
+    if (end - line < 11) return NO;
+
+    switch (line[0])
+    {
+        case '-': entry->type = CURLDirectoryEntryTypeFile; break;
+        case 'd': entry->type = CURLDirectoryEntryTypeDirectory; break;
+        case 'l': entry->type = CURLDirectoryEntryTypeSymbolicLink; break;
+        case 'b': case 'c': case 'p': case 's': entry->type = CURLDirectoryEntryTypeUnknown; break;
+        default: return NO;
+    }
+    if (!CURLParseUnixPermissions(line + 1, &entry->permissions)) return NO;
+
+    // Only the columns up to the date matter, so there's no need to split the whole line
+    CURLToken tokens[10];
+    NSUInteger count = 0;
+    const char *p = line + 10;
+    while (count < 10)
+    {
+        while (p < end && *p == ' ') ++p;
+        if (p == end) break;
+
+        tokens[count].start = p;
+        while (p < end && *p != ' ') ++p;
+        tokens[count].end = p;
+        ++count;
+    }
+
+    for (NSUInteger i = 1; i + 2 < count; ++i)
+    {
+        int month = CURLMonthFromToken(tokens[i]);
+        if (!month || !CURLTokenIsDigits(tokens[i - 1])) continue;
+
+        CURLToken dayToken = tokens[i + 1];
+        int day = CURLParseDigits(dayToken.start, dayToken.end - dayToken.start);
+        if (day < 1 || day > 31) continue;
+
+        CURLToken timeToken = tokens[i + 2];
+        size_t timeLength = timeToken.end - timeToken.start;
+        if (timeLength == 4 && CURLTokenIsDigits(timeToken))
+        {
+            int year = CURLParseDigits(timeToken.start, 4);
+            entry->time = CURLTimeFromComponents(year, month, day, 0, 0, 0);
+        }
+        else if ((timeLength == 5 || timeLength == 4) && timeToken.start[timeLength - 3] == ':')
+        {
+            int hour = CURLParseDigits(timeToken.start, timeLength - 3);
+            int minute = CURLParseDigits(timeToken.end - 2, 2);
+            if (hour < 0 || minute < 0) continue;
+
+            // The year is left out for entries from the last six months or so. A date much beyond now must be from last year
+            struct tm now;
+            time_t reference = (time_t)(referenceTime + kCFAbsoluteTimeIntervalSince1970);
+            gmtime_r(&reference, &now);
+
+            entry->time = CURLTimeFromComponents(now.tm_year + 1900, month, day, hour, minute, 0);
+            if (entry->time > referenceTime + 86400.0)
+            {
+                entry->time = CURLTimeFromComponents(now.tm_year + 1900 - 1, month, day, hour, minute, 0);
+            }
+        }
+        else
+        {
+            continue;
+        }
+
+        entry->size = strtoull(tokens[i - 1].start, NULL, 10);
+
+        // The name is separated from the date by a single space; any more belong to the name
+        const char *name = timeToken.end + 1;
+        if (name >= end) return NO;
+        entry->name = name;
+        entry->nameLength = end - name;
+
+        if (entry->type == CURLDirectoryEntryTypeSymbolicLink)
+        {
+            for (const char *arrow = name; arrow + 4 <= end; ++arrow)
+            {
+                if (memcmp(arrow, " -> ", 4) == 0)
+                {
+                    entry->nameLength = arrow - name;
+                    entry->target = arrow + 4;
+                    entry->targetLength = end - entry->target;
+                    break;
+                }
+            }
+        }
+
+        return YES;
+    }
+
+    return NO;
+}
+
+/*  e.g. "type=file;size=1234;modify=20130307123456;UNIX.mode=0644; name". The facts come first, each ending in a
+ *  semicolon, then a single space, then the name. The listed directory itself (cdir) and its parent (pdir) aren't
+ *  entries as such
+ */
+static BOOL CURLParseMLSDLine(const char *line, const char *end, CURLParsedEntry *entry)
+{
+    const char *space = memchr(line, ' ', end - line);
+    if (!space || space + 1 >= end || space == line || space[-1] != ';') return NO;
+
+    BOOL sawFact = NO;
+    for (const char *fact = line; fact < space; )
+    {
+        const char *semicolon = memchr(fact, ';', space - fact);
+        if (!semicolon) return NO;
+        const char *equals = memchr(fact, '=', semicolon - fact);
+        if (!equals) return NO;
+        sawFact = YES;
+
+        size_t keyLength = equals - fact;
+        const char *value = equals + 1;
+        size_t valueLength = semicolon - value;
+
+        if (keyLength == 4 && strncasecmp(fact, "type", 4) == 0)
+        {
+            if (valueLength == 4 && strncasecmp(value, "file", 4) == 0) entry->type = CURLDirectoryEntryTypeFile;
+            else if (valueLength == 3 && strncasecmp(value, "dir", 3) == 0) entry->type = CURLDirectoryEntryTypeDirectory;
+            else if (valueLength == 4 && (strncasecmp(value, "cdir", 4) == 0 || strncasecmp(value, "pdir", 4) == 0)) return NO;
+            else if (valueLength >= 13 && strncasecmp(value, "OS.unix=slink", 13) == 0) entry->type = CURLDirectoryEntryTypeSymbolicLink;
+            else if (valueLength >= 15 && strncasecmp(value, "OS.unix=symlink", 15) == 0) entry->type = CURLDirectoryEntryTypeSymbolicLink;
+        }
+        else if ((keyLength == 4 && strncasecmp(fact, "size", 4) == 0) || (keyLength == 4 && strncasecmp(fact, "sizd", 4) == 0))
+        {
+            entry->size = strtoull(value, NULL, 10);
+        }
+        else if (keyLength == 6 && strncasecmp(fact, "modify", 6) == 0 && valueLength >= 14)
+        {
+            int year = CURLParseDigits(value, 4);
+            int month = CURLParseDigits(value + 4, 2);
+            int day = CURLParseDigits(value + 6, 2);
+            int hour = CURLParseDigits(value + 8, 2);
+            int minute = CURLParseDigits(value + 10, 2);
+            int second = CURLParseDigits(value + 12, 2);
+            if (year >= 0 && month >= 0 && day >= 0 && hour >= 0 && minute >= 0 && second >= 0)
+            {
+                entry->time = CURLTimeFromComponents(year, month, day, hour, minute, second);
+            }
+        }
+        else if (keyLength == 9 && strncasecmp(fact, "UNIX.mode", 9) == 0)
+        {
+            entry->permissions = (unsigned short)(strtoul(value, NULL, 8) & 07777);
+        }
+
+        fact = semicolon + 1;
+    }
+    if (!sawFact) return NO;
+
+    entry->name = space + 1;
+    entry->nameLength = end - entry->name;
+    return YES;
+}
+
+/*  e.g. "03-07-13  12:34PM       <DIR>          name" or "03-07-2013  12:34  1234 name"
+ */
+static BOOL CURLParseWindowsLine(const char *line, const char *end, CURLParsedEntry *entry)
+{
+    const char *p = line;
+    const char *dateEnd = memchr(p, ' ', end - p);
+    if (!dateEnd) return NO;
+
+    size_t dateLength = dateEnd - p;
+    if ((dateLength != 8 && dateLength != 10) || p[2] != '-' || p[5] != '-') return NO;
+
+    int month = CURLParseDigits(p, 2);
+    int day = CURLParseDigits(p + 3, 2);
+    int year = CURLParseDigits(p + 6, dateLength - 6);
+    if (month < 1 || month > 12 || day < 1 || day > 31 || year < 0) return NO;
+    if (dateLength == 8) year += (year < 70 ? 2000 : 1900);
+
+    p = dateEnd;
+    while (p < end && *p == ' ') ++p;
+
+    const char *colon = memchr(p, ':', end - p);
+    if (!colon || colon - p < 1 || colon - p > 2 || end - colon < 3) return NO;
+
+    int hour = CURLParseDigits(p, colon - p);
+    int minute = CURLParseDigits(colon + 1, 2);
+    if (hour < 0 || minute < 0) return NO;
+
+    p = colon + 3;
+    if (end - p >= 2 && (p[1] == 'M' || p[1] == 'm'))
+    {
+        BOOL pm = (p[0] == 'P' || p[0] == 'p');
+        if (hour == 12) hour = 0;
+        if (pm) hour += 12;
+        p += 2;
+    }
+    entry->time = CURLTimeFromComponents(year, month, day, hour, minute, 0);
+
+    while (p < end && *p == ' ') ++p;
+    if (end - p >= 5 && memcmp(p, "<DIR>", 5) == 0)
+    {
+        entry->type = CURLDirectoryEntryTypeDirectory;
+        p += 5;
+    }
+    else
+    {
+        const char *sizeStart = p;
+        while (p < end && isdigit(*p)) ++p;
+        if (p == sizeStart) return NO;
+
+        entry->type = CURLDirectoryEntryTypeFile;
+        entry->size = strtoull(sizeStart, NULL, 10);
+    }
+
+    while (p < end && *p == ' ') ++p;
+    if (p == end) return NO;
+
+    entry->name = p;
+    entry->nameLength = end - p;
+    return YES;
+}
+
+static CURLDirectoryListingFormat CURLGuessFormat(const char *line, const char *end)
+{
+    if (end - line >= 8 && isdigit(line[0]) && isdigit(line[1]) && line[2] == '-') return CURLDirectoryListingFormatWindows;
+
+    const char *space = memchr(line, ' ', end - line);
+    if (space && space > line && space[-1] == ';' && memchr(line, '=', space - line)) return CURLDirectoryListingFormatMLSD;
+
+    return CURLDirectoryListingFormatUnix;
+}
+
+static BOOL CURLParseLine(const char *line, const char *end, CURLDirectoryListingFormat format, CFAbsoluteTime referenceTime, CURLParsedEntry *entry)
+{
+    memset(entry, 0, sizeof(*entry));
+    entry->time = NAN;
+
+    if (format == CURLDirectoryListingFormatAutomatic) format = CURLGuessFormat(line, end);
+    entry->format = (format == CURLDirectoryListingFormatMLSD || format == CURLDirectoryListingFormatWindows ? format : CURLDirectoryListingFormatUnix);
+
+    BOOL result;
+    switch (format)
+    {
+        case CURLDirectoryListingFormatMLSD:
+            result = CURLParseMLSDLine(line, end, entry);
+            break;
+        case CURLDirectoryListingFormatWindows:
+            result = CURLParseWindowsLine(line, end, entry);
+            break;
+        default:
+            result = CURLParseUnixLine(line, end, referenceTime, entry);
+            break;
+    }
+
+    if (result)
+    {
+        if ((entry->nameLength == 1 && entry->name[0] == '.') ||
+            (entry->nameLength == 2 && entry->name[0] == '.' && entry->name[1] == '.'))
+        {
+            result = NO;
+        }
+    }
+
+    return result;
+}
+
+static NSString *CURLNewStringFromBytes(const char *bytes, size_t length)
+{
+    NSString *result = [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding];
+    if (!result)
+    {
+        // FTP servers are fairly free to use whatever encoding they like. As for debug info, ISO Latin 2 is the best compromise
+        result = [[NSString alloc] initWithBytes:bytes length:length encoding:NSISOLatin2StringEncoding];
+    }
+    return result;
+}
+
+
+#pragma mark -
+
+@implementation CURLDirectoryListingParser
+
+- (id)initWithFormat:(CURLDirectoryListingFormat)format handler:(CURLDirectoryListingHandler)handler;
+{
+    NSParameterAssert(handler);
+
+    if (self = [self init])
+    {
+        _format = format;
+        _handler = [handler copy];
+        _partialLine = [[NSMutableData alloc] init];
+        _batch = [[NSMutableArray alloc] init];
+        _referenceTime = CFAbsoluteTimeGetCurrent();
+    }
+
+    return self;
+}
+
+- (void)dealloc;
+{
+    [_handler release];
+    [_partialLine release];
+    [_batch release];
+
+    [super dealloc];
+}
+
+@synthesize format = _format;
+@synthesize entryCount = _entryCount;
+@synthesize skippedLineCount = _skippedLineCount;
+
+- (void)parseLine:(const char *)line end:(const char *)end;
+{
+    if (end > line && end[-1] == '\r') --end;
+    if (end == line) return;
+
+    CURLParsedEntry parsed;
+    if (CURLParseLine(line, end, _format, _referenceTime, &parsed))
+    {
+        CURLDirectoryEntry *entry = [[CURLDirectoryEntry alloc] initWithParsedEntry:&parsed];
+        if (entry)
+        {
+            [_batch addObject:entry];
+            [entry release];
+            ++_entryCount;
+            return;
+        }
+    }
+
+    ++_skippedLineCount;
+}
+
+- (void)deliverBatch;
+{
+    if ([_batch count])
+    {
+        _handler(_batch);
+        [_batch removeAllObjects];
+    }
+}
+
+- (void)appendData:(NSData *)data;
+{
+    [self appendBytes:[data bytes] length:[data length]];
+}
+
+- (void)appendBytes:(const void *)bytes length:(NSUInteger)length;
+{
+    const char *p = bytes;
+    const char *end = p + length;
+
+    while (p < end)
+    {
+        const char *newline = memchr(p, '\n', end - p);
+        if (!newline)
+        {
+            // Hold on to the start of the line until the rest arrives
+            if (!_discardingLine)
+            {
+                [_partialLine appendBytes:p length:end - p];
+                if ([_partialLine length] > kMaximumLineLength)
+                {
+                    [_partialLine setLength:0];
+                    _discardingLine = YES;
+                    ++_skippedLineCount;
+                }
+            }
+            break;
+        }
+
+        if (_discardingLine)
+        {
+            _discardingLine = NO;
+        }
+        else if ([_partialLine length])
+        {
+            [_partialLine appendBytes:p length:newline - p];
+            const char *line = [_partialLine bytes];
+            [self parseLine:line end:line + [_partialLine length]];
+            [_partialLine setLength:0];
+        }
+        else
+        {
+            [self parseLine:p end:newline];
+        }
+
+        p = newline + 1;
+    }
+
+    [self deliverBatch];
+}
+
+- (void)finish;
+{
+    if ([_partialLine length])
+    {
+        const char *line = [_partialLine bytes];
+        [self parseLine:line end:line + [_partialLine length]];
+        [_partialLine setLength:0];
+    }
+    _discardingLine = NO;
+
+    [self deliverBatch];
+}
+
++ (CURLDirectoryEntry *)entryWithLine:(NSString *)line format:(CURLDirectoryListingFormat)format;
+{
+    const char *bytes = [line UTF8String];
+    if (!bytes) return nil;
+
+    CURLParsedEntry parsed;
+    if (!CURLParseLine(bytes, bytes + strlen(bytes), format, CFAbsoluteTimeGetCurrent(), &parsed)) return nil;
+
+    return [[[CURLDirectoryEntry alloc] initWithParsedEntry:&parsed] autorelease];
+}
+
+@end
+
+
+#pragma mark -
+
+@implementation CURLDirectoryEntry
+
+- (id)initWithParsedEntry:(const CURLParsedEntry *)parsed;
+{
+    if (self = [self init])
+    {
+        _name = CURLNewStringFromBytes(parsed->name, parsed->nameLength);
+        if (!_name)
+        {
+            [self release]; return nil;
+        }
+
+        if (parsed->target) _symbolicLinkTarget = CURLNewStringFromBytes(parsed->target, parsed->targetLength);
+        _size = parsed->size;
+        _modificationTime = parsed->time;
+        _type = parsed->type;
+        _permissions = parsed->permissions;
+        _format = parsed->format;
+    }
+
+    return self;
+}
+
+- (void)dealloc;
+{
+    [_name release];
+    [_symbolicLinkTarget release];
+
+    [super dealloc];
+}
+
+@synthesize name = _name;
+@synthesize symbolicLinkTarget = _symbolicLinkTarget;
+@synthesize size = _size;
+@synthesize type = _type;
+@synthesize permissions = _permissions;
+@synthesize format = _format;
+@synthesize modificationTime = _modificationTime;
+
+- (NSDate *)modificationDate;
+{
+    if (isnan(_modificationTime)) return nil;
+    return [NSDate dateWithTimeIntervalSinceReferenceDate:_modificationTime];
+}
+
+- (NSString *)description;
+{
+    return [NSString stringWithFormat:@"%@ %@ %llu bytes %lo %@",
+            [super description], _name, _size, (unsigned long)_permissions, [self modificationDate]];
+}
+
+@end
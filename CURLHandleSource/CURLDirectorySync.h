@@ -0,0 +1,221 @@
+//
+//  CURLDirectorySync.h
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLFTPSession.h"
+
+
+@class CURLFTPSessionPool;
+@class CURLDirectorySyncAction;
+@class CURLDirectorySyncSummary;
+@protocol CURLDirectorySyncDelegate;
+
+/**
+ What a CURLDirectorySyncAction does to the server.
+ */
+typedef NS_ENUM(NSInteger, CURLDirectorySyncActionType) {
+    CURLDirectorySyncActionTypeList,
+    CURLDirectorySyncActionTypeCreateDirectory,
+    CURLDirectorySyncActionTypeUpload,
+    CURLDirectorySyncActionTypeRemoveFile,
+    CURLDirectorySyncActionTypeRemoveDirectory,
+};
+
+/**
+ Makes a directory on an FTP or SFTP server match a local one, doing only what's needed to get it there.
+
+ Each remote directory is listed, and its contents compared with the local directory's: files are uploaded if
+ they're missing or differ in size, or are newer locally; missing directories are created, and their contents
+ uploaded without further listing. Anything on the server that isn't there locally is removed, unless
+ `removesExtraneousItems` is turned off.
+
+ Only MLSD listings give a modification date reliable enough to compare. On servers without MLSD, a file the
+ manifest has no record of is uploaded even if it looks the same.
+
+ Listings, uploads and removals all run through a small pool of CURLFTPSessions, so several directories are
+ worked on at once over connections which stay logged in.
+
+ Given a `manifestURL`, what was found and done is saved at the end, and used by the next sync to go faster:
+
+ - A directory whose contents (all the way down) haven't changed locally since it was last synced without
+   error isn't listed at all, nor is anything inside it. For a large site with a few edits, that's most of the
+   listings gone.
+ - A file whose size and modification date are as they were when it was last uploaded is left alone, even
+   though the server's modification date will be the time of the upload.
+ - With `comparesContents`, a file which has been touched but has the same contents as when it was uploaded
+   isn't sent again.
+
+ Skipping unchanged directories assumes nothing else changes the server in between. Sync without the
+ manifest, or delete it, to check everything.
+ */
+
+@interface CURLDirectorySync : NSObject <CURLFTPSessionDelegate>
+{
+  @private
+    NSURL                           *_localURL;
+    NSURL                           *_remoteURL;
+    NSURLCredential                 *_credential;
+    id <CURLDirectorySyncDelegate>  _delegate;
+    NSOperationQueue                *_delegateQueue;
+
+    NSURL       *_manifestURL;
+    NSUInteger  _maximumSessions;
+    BOOL        _removesExtraneousItems;
+    BOOL        _comparesContents;
+
+    // Only accessed on _workQueue, which is also where the session pool reports
+    NSOperationQueue    *_workQueue;
+    CURLFTPSessionPool  *_pool;
+    NSMutableArray      *_pendingDirectoryActions;  // listings and creations, which lead to more work
+    NSMutableArray      *_pendingActions;
+    NSMutableDictionary *_manifestFiles;            // path -> attributes of the local file as last synced
+    NSMutableDictionary *_manifestDirectories;      // path -> signature of the local subtree as last synced
+    NSMutableSet        *_localPaths;
+    BOOL                _started;
+    BOOL                _cancelled;
+    BOOL                _finished;
+    CFAbsoluteTime      _startTime;
+
+    NSUInteger          _listedDirectoryCount;
+    NSUInteger          _skippedDirectoryCount;
+    NSUInteger          _unchangedFileCount;
+    NSUInteger          _uploadedFileCount;
+    NSUInteger          _createdDirectoryCount;
+    NSUInteger          _removedItemCount;
+    NSUInteger          _failedCount;
+    unsigned long long  _totalBytesSent;
+}
+
+/**
+ @param localURL The file URL of the directory to copy from.
+ @param remoteURL An ftp, ftps or sftp URL for the directory to copy to. Over FTP it's created if need be; over SFTP it must already exist.
+ @param credential Used to log in. If `nil`, any credentials in the remote URL are used.
+ @param delegate Retained until the sync completes.
+ @param queue The queue to deliver delegate messages on. If `nil`, a serial queue is created.
+ */
+- (id)initWithLocalURL:(NSURL *)localURL
+             remoteURL:(NSURL *)remoteURL
+            credential:(NSURLCredential *)credential
+              delegate:(id <CURLDirectorySyncDelegate>)delegate
+         delegateQueue:(NSOperationQueue *)queue __attribute((nonnull(1,2)));
+
+@property (readonly, copy) NSURL *localURL;
+@property (readonly, copy) NSURL *remoteURL;
+@property (readonly, strong) id <CURLDirectorySyncDelegate> delegate;
+
+/*
+ Settings must be made before calling -start.
+ */
+
+/**
+ Where to read the last sync's record from, and save this one's to. A manifest for a different remote URL is
+ ignored. Default is `nil`, for no manifest.
+ */
+@property (copy) NSURL *manifestURL;
+
+/**
+ The most sessions, and so connections, to use at once. Default is 4.
+ */
+@property (assign) NSUInteger maximumSessions;
+
+/**
+ If `YES`, files and directories on the server which aren't in the local directory are removed. Default is `YES`.
+ */
+@property (assign) BOOL removesExtraneousItems;
+
+/**
+ If `YES`, the manifest records a SHA-1 digest of each file uploaded, so a file whose modification date has
+ changed can be checked for real changes before uploading it again. This means reading such files an extra
+ time. Default is `NO`.
+ */
+@property (assign) BOOL comparesContents;
+
+/**
+ Starts syncing. Only call this once.
+ */
+- (void)start;
+
+/**
+ Stops as quickly as possible. Whatever was completed is still saved to the manifest, and the summary
+ delivered as usual.
+ */
+- (void)cancel;
+
+@end
+
+
+#pragma mark - Results
+
+/**
+ One thing done to the server.
+ */
+
+@interface CURLDirectorySyncAction : NSObject
+{
+  @private
+    CURLDirectorySyncActionType _type;
+    NSString                    *_path;
+    NSError                     *_error;
+    unsigned long long          _bytesSent;
+}
+
+@property (readonly) CURLDirectorySyncActionType type;
+@property (readonly, copy) NSString *path;              // relative to the remote URL; "" for the remote directory itself
+@property (readonly, copy) NSError *error;              // nil if it succeeded
+@property (readonly) unsigned long long bytesSent;      // for uploads
+
+@end
+
+
+/**
+ Aggregate figures for a completed sync.
+ */
+
+@interface CURLDirectorySyncSummary : NSObject
+{
+  @private
+    NSUInteger          _listedDirectoryCount;
+    NSUInteger          _skippedDirectoryCount;
+    NSUInteger          _unchangedFileCount;
+    NSUInteger          _uploadedFileCount;
+    NSUInteger          _createdDirectoryCount;
+    NSUInteger          _removedItemCount;
+    NSUInteger          _failedCount;
+    unsigned long long  _totalBytesSent;
+    NSTimeInterval      _elapsedTime;
+}
+
+@property (readonly) NSUInteger listedDirectoryCount;
+@property (readonly) NSUInteger skippedDirectoryCount;      // not listed, as the manifest showed them to be unchanged
+@property (readonly) NSUInteger unchangedFileCount;         // compared, and left alone
+@property (readonly) NSUInteger uploadedFileCount;
+@property (readonly) NSUInteger createdDirectoryCount;
+@property (readonly) NSUInteger removedItemCount;
+@property (readonly) NSUInteger failedCount;                // actions of any kind, including cancelled ones
+@property (readonly) unsigned long long totalBytesSent;
+@property (readonly) NSTimeInterval elapsedTime;
+
+@end
+
+
+#pragma mark - Delegate
+
+@protocol CURLDirectorySyncDelegate <NSObject>
+
+/**
+ Sent as the last message related to the sync, once everything's been done or given up on.
+ */
+- (void)directorySync:(CURLDirectorySync *)sync didCompleteWithSummary:(CURLDirectorySyncSummary *)summary;
+
+@optional
+
+/**
+ Called as each action finishes, successfully or not.
+ */
+- (void)directorySync:(CURLDirectorySync *)sync didFinishAction:(CURLDirectorySyncAction *)action;
+
+@end
@@ -0,0 +1,923 @@
+//
+//  CURLDirectorySync.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLDirectorySync.h"
+
+#import "CURLDirectoryListing.h"
+#import "CURLFTPSessionPool.h"
+
+#import <CommonCrypto/CommonDigest.h>
+
+
+// Manifest keys
+static NSString * const kVersionKey = @"version";
+static NSString * const kRemoteURLKey = @"remoteURL";
+static NSString * const kFilesKey = @"files";
+static NSString * const kDirectoriesKey = @"directories";
+static NSString * const kSizeKey = @"size";
+static NSString * const kModificationTimeKey = @"modificationTime";
+static NSString * const kDigestKey = @"SHA1";
+
+static const NSInteger kManifestVersion = 1;
+
+
+#pragma mark Local Items
+
+/*  A snapshot of one file or directory in the local tree, taken before anything goes to the server.
+ */
+
+@interface CURLDirectorySyncLocalItem : NSObject
+{
+  @public
+    NSString            *_name;
+    NSString            *_path;             // relative to the local URL
+    NSURL               *_fileURL;
+    BOOL                _isDirectory;
+    unsigned long long  _size;
+    CFAbsoluteTime      _modificationTime;
+    NSArray             *_children;         // sorted by name
+    NSSet               *_ignoredNames;     // children which aren't plain files or directories, or couldn't be read
+    NSData              *_signature;        // digest of everything below, for spotting unchanged subtrees
+    BOOL                _incomplete;        // something below couldn't be read, so the signature can't be trusted
+}
+@end
+
+@implementation CURLDirectorySyncLocalItem
+
+- (void)dealloc
+{
+    [_name release];
+    [_path release];
+    [_fileURL release];
+    [_children release];
+    [_ignoredNames release];
+    [_signature release];
+
+    [super dealloc];
+}
+
+@end
+
+
+#pragma mark Nodes
+
+/*  A remote directory being worked on. It's finished once all the actions and child nodes counted against it
+ *  are; for a directory being removed, that's when it's empty and can go itself.
+ */
+
+@interface CURLDirectorySyncNode : NSObject
+{
+  @public
+    NSString                    *_path;
+    CURLDirectorySyncNode       *_parent;
+    CURLDirectorySyncLocalItem  *_localItem;    // nil if being removed
+    NSUInteger                  _pendingCount;
+    BOOL                        _failed;
+    BOOL                        _removing;      // the final rmdir has been queued
+    CURLDirectorySyncAction     *_followUp;     // queued under the parent once this finishes without error
+}
+@end
+
+@implementation CURLDirectorySyncNode
+
+- (void)dealloc
+{
+    [_path release];
+    [_parent release];
+    [_localItem release];
+    [_followUp release];
+
+    [super dealloc];
+}
+
+@end
+
+
+@interface CURLDirectorySyncAction ()
+- (id)initWithType:(CURLDirectorySyncActionType)type path:(NSString *)path;
+@property (readwrite, copy) NSError *error;
+@property (readwrite) unsigned long long bytesSent;
+@property (nonatomic, retain) CURLDirectorySyncNode *node;                  // whose work it counts towards
+@property (nonatomic, retain) CURLDirectorySyncLocalItem *localItem;        // the file to upload, or directory to fill once created
+@property (nonatomic, retain) CURLDirectorySyncAction *followUp;            // queued once this succeeds
+@end
+
+
+@interface CURLDirectorySyncSummary ()
+@property (readwrite) NSUInteger listedDirectoryCount;
+@property (readwrite) NSUInteger skippedDirectoryCount;
+@property (readwrite) NSUInteger unchangedFileCount;
+@property (readwrite) NSUInteger uploadedFileCount;
+@property (readwrite) NSUInteger createdDirectoryCount;
+@property (readwrite) NSUInteger removedItemCount;
+@property (readwrite) NSUInteger failedCount;
+@property (readwrite) unsigned long long totalBytesSent;
+@property (readwrite) NSTimeInterval elapsedTime;
+@end
+
+
+#pragma mark Helpers
+
+static NSString *CURLDirectorySyncPath(NSString *directory, NSString *name)
+{
+    return ([directory length] ? [NSString stringWithFormat:@"%@/%@", directory, name] : name);
+}
+
+static NSData *CURLDirectorySyncDigestOfFile(NSURL *fileURL)
+{
+    FILE *file = fopen([[fileURL path] fileSystemRepresentation], "rb");
+    if (!file) return nil;
+
+    CC_SHA1_CTX context;
+    CC_SHA1_Init(&context);
+
+    char buffer[64 * 1024];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        CC_SHA1_Update(&context, buffer, (CC_LONG)length);
+    }
+
+    BOOL failed = ferror(file);
+    fclose(file);
+    if (failed) return nil;
+
+    unsigned char digest[CC_SHA1_DIGEST_LENGTH];
+    CC_SHA1_Final(digest, &context);
+    return [NSData dataWithBytes:digest length:sizeof(digest)];
+}
+
+
+#pragma mark -
+
+@implementation CURLDirectorySync
+
+@synthesize localURL = _localURL;
+@synthesize remoteURL = _remoteURL;
+@synthesize delegate = _delegate;
+@synthesize manifestURL = _manifestURL;
+@synthesize maximumSessions = _maximumSessions;
+@synthesize removesExtraneousItems = _removesExtraneousItems;
+@synthesize comparesContents = _comparesContents;
+
+#pragma mark Lifecycle
+
+- (id)initWithLocalURL:(NSURL *)localURL remoteURL:(NSURL *)remoteURL credential:(NSURLCredential *)credential delegate:(id <CURLDirectorySyncDelegate>)delegate delegateQueue:(NSOperationQueue *)queue;
+{
+    NSParameterAssert(localURL);
+    NSParameterAssert(remoteURL);
+
+    if (self = [self init])
+    {
+        _localURL = [localURL copy];
+
+        NSString *remote = [remoteURL absoluteString];
+        if (![remote hasSuffix:@"/"]) remoteURL = [NSURL URLWithString:[remote stringByAppendingString:@"/"]];
+        _remoteURL = [remoteURL copy];
+
+        _credential = [credential retain];
+        _delegate = [delegate retain];
+
+        if (queue)
+        {
+            _delegateQueue = [queue retain];
+        }
+        else
+        {
+            _delegateQueue = [[NSOperationQueue alloc] init];
+            _delegateQueue.maxConcurrentOperationCount = 1;
+        }
+
+        _workQueue = [[NSOperationQueue alloc] init];
+        _workQueue.maxConcurrentOperationCount = 1;
+
+        _pendingDirectoryActions = [[NSMutableArray alloc] init];
+        _pendingActions = [[NSMutableArray alloc] init];
+        _localPaths = [[NSMutableSet alloc] init];
+
+        _maximumSessions = 4;
+        _removesExtraneousItems = YES;
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_localURL release];
+    [_remoteURL release];
+    [_credential release];
+    [_delegate release];
+    [_delegateQueue release];
+    [_manifestURL release];
+    [_workQueue release];
+    [_pool release];
+    [_pendingDirectoryActions release];
+    [_pendingActions release];
+    [_manifestFiles release];
+    [_manifestDirectories release];
+    [_localPaths release];
+
+    [super dealloc];
+}
+
+#pragma mark Local Tree
+
+- (CURLDirectorySyncLocalItem *)newLocalItemForDirectoryAtURL:(NSURL *)directoryURL name:(NSString *)name path:(NSString *)path;
+{
+    NSArray *keys = [NSArray arrayWithObjects:NSURLIsDirectoryKey, NSURLIsRegularFileKey, NSURLFileSizeKey, NSURLContentModificationDateKey, nil];
+
+    NSError *error;
+    NSArray *contents = [[NSFileManager defaultManager] contentsOfDirectoryAtURL:directoryURL includingPropertiesForKeys:keys options:0 error:&error];
+    if (!contents)
+    {
+        CURLHandleLog(@"couldn't read %@: %@", directoryURL, error);
+        return nil;
+    }
+
+    CURLDirectorySyncLocalItem *result = [[CURLDirectorySyncLocalItem alloc] init];
+    result->_name = [name copy];
+    result->_path = [path copy];
+    result->_fileURL = [directoryURL copy];
+    result->_isDirectory = YES;
+
+    NSMutableArray *children = [[NSMutableArray alloc] initWithCapacity:[contents count]];
+    NSMutableSet *ignored = [[NSMutableSet alloc] init];
+
+    for (NSURL *aURL in contents)
+    {
+        NSDictionary *values = [aURL resourceValuesForKeys:keys error:NULL];
+        NSString *aName = [aURL lastPathComponent];
+        NSString *aPath = CURLDirectorySyncPath(path, aName);
+
+        CURLDirectorySyncLocalItem *child = nil;
+        if ([[values objectForKey:NSURLIsDirectoryKey] boolValue])
+        {
+            child = [self newLocalItemForDirectoryAtURL:aURL name:aName path:aPath];
+            if (!child) result->_incomplete = YES;
+        }
+        else if ([[values objectForKey:NSURLIsRegularFileKey] boolValue])
+        {
+            child = [[CURLDirectorySyncLocalItem alloc] init];
+            child->_name = [aName copy];
+            child->_path = [aPath copy];
+            child->_fileURL = [aURL copy];
+            child->_size = [[values objectForKey:NSURLFileSizeKey] unsignedLongLongValue];
+            child->_modificationTime = [[values objectForKey:NSURLContentModificationDateKey] timeIntervalSinceReferenceDate];
+        }
+
+        if (child)
+        {
+            if (child->_incomplete) result->_incomplete = YES;
+            [children addObject:child];
+            [_localPaths addObject:aPath];
+            [child release];
+        }
+        else
+        {
+            // Symlinks and the like are left alone, on both sides
+            [ignored addObject:aName];
+        }
+    }
+
+    [children sortUsingComparator:^NSComparisonResult(CURLDirectorySyncLocalItem *item1, CURLDirectorySyncLocalItem *item2) {
+        return [item1->_name compare:item2->_name options:NSLiteralSearch];
+    }];
+    result->_children = children;
+    result->_ignoredNames = ignored;
+
+    // The signature covers what a listing would be compared against, all the way down
+    CC_SHA1_CTX context;
+    CC_SHA1_Init(&context);
+    for (CURLDirectorySyncLocalItem *aChild in children)
+    {
+        const char *childName = [aChild->_name UTF8String];
+        CC_SHA1_Update(&context, childName, (CC_LONG)strlen(childName) + 1);
+        CC_SHA1_Update(&context, &aChild->_isDirectory, sizeof(aChild->_isDirectory));
+        CC_SHA1_Update(&context, &aChild->_size, sizeof(aChild->_size));
+        CC_SHA1_Update(&context, &aChild->_modificationTime, sizeof(aChild->_modificationTime));
+        if (aChild->_signature) CC_SHA1_Update(&context, [aChild->_signature bytes], (CC_LONG)[aChild->_signature length]);
+    }
+    for (NSString *aName in ignored)
+    {
+        const char *ignoredName = [aName UTF8String];
+        CC_SHA1_Update(&context, ignoredName, (CC_LONG)strlen(ignoredName) + 1);
+    }
+
+    unsigned char digest[CC_SHA1_DIGEST_LENGTH];
+    CC_SHA1_Final(digest, &context);
+    result->_signature = [[NSData alloc] initWithBytes:digest length:sizeof(digest)];
+
+    return result;
+}
+
+#pragma mark Manifest
+
+- (void)loadManifest;
+{
+    NSData *data = (_manifestURL ? [NSData dataWithContentsOfURL:_manifestURL] : nil);
+    NSDictionary *manifest = (data ? [NSPropertyListSerialization propertyListWithData:data options:0 format:NULL error:NULL] : nil);
+
+    // Only trust a manifest for the same server and directory
+    if ([manifest isKindOfClass:[NSDictionary class]] &&
+        [[manifest objectForKey:kVersionKey] integerValue] == kManifestVersion &&
+        [[manifest objectForKey:kRemoteURLKey] isEqualToString:[_remoteURL absoluteString]])
+    {
+        _manifestFiles = [[manifest objectForKey:kFilesKey] mutableCopy];
+        _manifestDirectories = [[manifest objectForKey:kDirectoriesKey] mutableCopy];
+    }
+
+    if (![_manifestFiles isKindOfClass:[NSMutableDictionary class]] || ![_manifestDirectories isKindOfClass:[NSMutableDictionary class]])
+    {
+        [_manifestFiles release]; _manifestFiles = [[NSMutableDictionary alloc] init];
+        [_manifestDirectories release]; _manifestDirectories = [[NSMutableDictionary alloc] init];
+    }
+}
+
+- (void)saveManifest;
+{
+    if (!_manifestURL) return;
+
+    // Forget anything that's gone locally
+    for (NSString *aPath in [_manifestFiles allKeys])
+    {
+        if (![_localPaths containsObject:aPath]) [_manifestFiles removeObjectForKey:aPath];
+    }
+    for (NSString *aPath in [_manifestDirectories allKeys])
+    {
+        if ([aPath length] && ![_localPaths containsObject:aPath]) [_manifestDirectories removeObjectForKey:aPath];
+    }
+
+    NSDictionary *manifest = [NSDictionary dictionaryWithObjectsAndKeys:
+                              [NSNumber numberWithInteger:kManifestVersion], kVersionKey,
+                              [_remoteURL absoluteString], kRemoteURLKey,
+                              _manifestFiles, kFilesKey,
+                              _manifestDirectories, kDirectoriesKey,
+                              nil];
+
+    NSError *error;
+    NSData *data = [NSPropertyListSerialization dataWithPropertyList:manifest format:NSPropertyListBinaryFormat_v1_0 options:0 error:&error];
+    if (!data || ![data writeToURL:_manifestURL options:NSDataWritingAtomic error:&error])
+    {
+        NSLog(@"Failed to write sync manifest: %@", error);
+    }
+}
+
+- (void)recordFile:(CURLDirectorySyncLocalItem *)item digest:(NSData *)digest;
+{
+    NSMutableDictionary *record = [[NSMutableDictionary alloc] initWithObjectsAndKeys:
+                                   [NSNumber numberWithUnsignedLongLong:item->_size], kSizeKey,
+                                   [NSNumber numberWithDouble:item->_modificationTime], kModificationTimeKey,
+                                   nil];
+    if (digest) [record setObject:digest forKey:kDigestKey];
+
+    [_manifestFiles setObject:record forKey:item->_path];
+    [record release];
+}
+
+/*  Whether a file on the server can be left as it is. The server's modification date is when the file was
+ *  uploaded, so it's only any use when there's no record of doing that, and only then from an MLSD listing:
+ *  LIST gives the server's local time in an unknown zone, often without the seconds or year
+ */
+- (BOOL)isLocalFile:(CURLDirectorySyncLocalItem *)item unchangedFromRemote:(CURLDirectoryEntry *)entry;
+{
+    if (entry.size != item->_size) return NO;
+
+    NSDictionary *record = [_manifestFiles objectForKey:item->_path];
+    if (record)
+    {
+        if ([[record objectForKey:kSizeKey] unsignedLongLongValue] != item->_size) return NO;
+        if ([[record objectForKey:kModificationTimeKey] doubleValue] == item->_modificationTime) return YES;
+
+        NSData *digest = [record objectForKey:kDigestKey];
+        if (_comparesContents && digest && [digest isEqualToData:CURLDirectorySyncDigestOfFile(item->_fileURL)])
+        {
+            [self recordFile:item digest:digest];   // so it's not read again next time
+            return YES;
+        }
+
+        return NO;
+    }
+
+    if (entry.format == CURLDirectoryListingFormatMLSD && !isnan(entry.modificationTime) && entry.modificationTime >= item->_modificationTime)
+    {
+        [self recordFile:item digest:nil];
+        return YES;
+    }
+
+    return NO;
+}
+
+#pragma mark Nodes & Actions
+
+- (CURLDirectorySyncNode *)newNodeWithPath:(NSString *)path parent:(CURLDirectorySyncNode *)parent localItem:(CURLDirectorySyncLocalItem *)item;
+{
+    CURLDirectorySyncNode *result = [[CURLDirectorySyncNode alloc] init];
+    result->_path = [path copy];
+    result->_parent = [parent retain];
+    result->_localItem = [item retain];
+    if (parent) parent->_pendingCount++;
+
+    // Whatever was recorded no longer holds once work starts on the directory
+    [_manifestDirectories removeObjectForKey:path];
+
+    return result;
+}
+
+- (CURLDirectorySyncAction *)newActionWithType:(CURLDirectorySyncActionType)type path:(NSString *)path node:(CURLDirectorySyncNode *)node localItem:(CURLDirectorySyncLocalItem *)item;
+{
+    CURLDirectorySyncAction *result = [[CURLDirectorySyncAction alloc] initWithType:type path:path];
+    result.node = node;
+    result.localItem = item;
+    return result;
+}
+
+- (void)enqueueAction:(CURLDirectorySyncAction *)action;
+{
+    action.node->_pendingCount++;
+
+    // Listings and new directories lead to more work, so they go first
+    if (action.type == CURLDirectorySyncActionTypeList || action.type == CURLDirectorySyncActionTypeCreateDirectory)
+    {
+        [_pendingDirectoryActions addObject:action];
+    }
+    else
+    {
+        [_pendingActions addObject:action];
+    }
+}
+
+- (void)enqueueActionWithType:(CURLDirectorySyncActionType)type path:(NSString *)path node:(CURLDirectorySyncNode *)node localItem:(CURLDirectorySyncLocalItem *)item;
+{
+    CURLDirectorySyncAction *action = [self newActionWithType:type path:path node:node localItem:item];
+    [self enqueueAction:action];
+    [action release];
+}
+
+/*  Removing a directory means listing it, removing everything inside, and then the directory itself
+ */
+- (CURLDirectorySyncNode *)removeDirectoryAtPath:(NSString *)path parent:(CURLDirectorySyncNode *)parent;
+{
+    CURLDirectorySyncNode *node = [self newNodeWithPath:path parent:parent localItem:nil];
+    [self enqueueActionWithType:CURLDirectorySyncActionTypeList path:path node:node localItem:nil];
+    return [node autorelease];
+}
+
+/*  A directory that's just been created is known to be empty, so everything in it can be sent without listing
+ */
+- (void)populateDirectory:(CURLDirectorySyncLocalItem *)directory parent:(CURLDirectorySyncNode *)parent;
+{
+    CURLDirectorySyncNode *node = [self newNodeWithPath:directory->_path parent:parent localItem:directory];
+
+    for (CURLDirectorySyncLocalItem *aChild in directory->_children)
+    {
+        CURLDirectorySyncActionType type = (aChild->_isDirectory ? CURLDirectorySyncActionTypeCreateDirectory : CURLDirectorySyncActionTypeUpload);
+        [self enqueueActionWithType:type path:aChild->_path node:node localItem:aChild];
+    }
+
+    [self checkNode:node];  // might have been empty
+    [node release];
+}
+
+- (void)syncDirectory:(CURLDirectorySyncLocalItem *)directory parent:(CURLDirectorySyncNode *)parent;
+{
+    NSData *recorded = [_manifestDirectories objectForKey:directory->_path];
+    if (!directory->_incomplete && [recorded isEqualToData:directory->_signature])
+    {
+        _skippedDirectoryCount++;
+        return;
+    }
+
+    CURLDirectorySyncNode *node = [self newNodeWithPath:directory->_path parent:parent localItem:directory];
+    [self enqueueActionWithType:CURLDirectorySyncActionTypeList path:directory->_path node:node localItem:directory];
+    [node release];
+}
+
+- (void)node:(CURLDirectorySyncNode *)node didListEntries:(NSArray *)entries;
+{
+    NSMutableDictionary *remote = [[NSMutableDictionary alloc] initWithCapacity:[entries count]];
+    for (CURLDirectoryEntry *anEntry in entries)
+    {
+        [remote setObject:anEntry forKey:anEntry.name];
+    }
+
+    CURLDirectorySyncLocalItem *directory = node->_localItem;
+    if (!directory)
+    {
+        // Clearing out a directory that's to be removed
+        for (CURLDirectoryEntry *anEntry in entries)
+        {
+            NSString *path = CURLDirectorySyncPath(node->_path, anEntry.name);
+            if (anEntry.type == CURLDirectoryEntryTypeDirectory)
+            {
+                [self removeDirectoryAtPath:path parent:node];
+            }
+            else
+            {
+                [self enqueueActionWithType:CURLDirectorySyncActionTypeRemoveFile path:path node:node localItem:nil];
+            }
+        }
+
+        [remote release];
+        return;
+    }
+
+    for (CURLDirectorySyncLocalItem *aChild in directory->_children)
+    {
+        CURLDirectoryEntry *entry = [remote objectForKey:aChild->_name];
+        BOOL remoteIsDirectory = (entry.type == CURLDirectoryEntryTypeDirectory || entry.type == CURLDirectoryEntryTypeSymbolicLink);
+
+        if (aChild->_isDirectory)
+        {
+            if (!entry)
+            {
+                [self enqueueActionWithType:CURLDirectorySyncActionTypeCreateDirectory path:aChild->_path node:node localItem:aChild];
+            }
+            else if (remoteIsDirectory)
+            {
+                [self syncDirectory:aChild parent:node];
+            }
+            else
+            {
+                // A file's in the way
+                CURLDirectorySyncAction *remove = [self newActionWithType:CURLDirectorySyncActionTypeRemoveFile path:aChild->_path node:node localItem:nil];
+                CURLDirectorySyncAction *create = [self newActionWithType:CURLDirectorySyncActionTypeCreateDirectory path:aChild->_path node:node localItem:aChild];
+                remove.followUp = create;
+                [self enqueueAction:remove];
+                [remove release];
+                [create release];
+            }
+        }
+        else
+        {
+            if (!entry)
+            {
+                [self enqueueActionWithType:CURLDirectorySyncActionTypeUpload path:aChild->_path node:node localItem:aChild];
+            }
+            else if (entry.type == CURLDirectoryEntryTypeDirectory)
+            {
+                // A directory's in the way
+                CURLDirectorySyncNode *removal = [self removeDirectoryAtPath:aChild->_path parent:node];
+                removal->_followUp = [self newActionWithType:CURLDirectorySyncActionTypeUpload path:aChild->_path node:node localItem:aChild];
+            }
+            else if ([self isLocalFile:aChild unchangedFromRemote:entry])
+            {
+                _unchangedFileCount++;
+            }
+            else
+            {
+                [self enqueueActionWithType:CURLDirectorySyncActionTypeUpload path:aChild->_path node:node localItem:aChild];
+            }
+        }
+
+        [remote removeObjectForKey:aChild->_name];
+    }
+
+    // Whatever's left isn't wanted
+    if (_removesExtraneousItems)
+    {
+        for (NSString *aName in remote)
+        {
+            if ([directory->_ignoredNames containsObject:aName]) continue;
+
+            CURLDirectoryEntry *entry = [remote objectForKey:aName];
+            NSString *path = CURLDirectorySyncPath(node->_path, aName);
+
+            if (entry.type == CURLDirectoryEntryTypeDirectory)
+            {
+                [self removeDirectoryAtPath:path parent:node];
+            }
+            else
+            {
+                [self enqueueActionWithType:CURLDirectorySyncActionTypeRemoveFile path:path node:node localItem:nil];
+            }
+        }
+    }
+
+    [remote release];
+}
+
+/*  Called whenever something counted against a node finishes. Once nothing is left, the node finishes in turn
+ */
+- (void)checkNode:(CURLDirectorySyncNode *)node;
+{
+    if (node->_pendingCount || _cancelled) return;
+
+    if (!node->_localItem && !node->_failed && !node->_removing)
+    {
+        // Emptied, so it can go now
+        node->_removing = YES;
+        [self enqueueActionWithType:CURLDirectorySyncActionTypeRemoveDirectory path:node->_path node:node localItem:nil];
+        return;
+    }
+
+    CURLDirectorySyncLocalItem *item = node->_localItem;
+    if (item && !node->_failed && !item->_incomplete)
+    {
+        [_manifestDirectories setObject:item->_signature forKey:node->_path];
+    }
+
+    CURLDirectorySyncNode *parent = node->_parent;
+    if (parent)
+    {
+        if (node->_failed)
+        {
+            parent->_failed = YES;
+        }
+        else if (node->_followUp)
+        {
+            [self enqueueAction:node->_followUp];
+        }
+
+        parent->_pendingCount--;
+        [self checkNode:parent];
+    }
+}
+
+#pragma mark Running
+
+- (void)start;
+{
+    [_workQueue addOperationWithBlock:^{
+
+        NSAssert(!_started, @"CURLDirectorySync can only be started once");
+        _started = YES;
+        if (_cancelled) return;     // and the summary's already gone
+        _startTime = CFAbsoluteTimeGetCurrent();
+
+        _pool = [[CURLFTPSessionPool alloc] initWithBaseURL:_remoteURL credential:_credential maximumSessions:_maximumSessions delegate:self delegateQueue:_workQueue];
+
+        [self loadManifest];
+
+        CURLDirectorySyncLocalItem *root = [self newLocalItemForDirectoryAtURL:_localURL name:@"" path:@""];
+        if (!root)
+        {
+            _failedCount++;
+        }
+        else if (!root->_incomplete && [[_manifestDirectories objectForKey:@""] isEqualToData:root->_signature])
+        {
+            _skippedDirectoryCount++;
+        }
+        else
+        {
+            // Make sure the remote directory's there, then see what's in it
+            CURLDirectorySyncNode *node = [self newNodeWithPath:@"" parent:nil localItem:root];
+            CURLDirectorySyncAction *create = [self newActionWithType:CURLDirectorySyncActionTypeCreateDirectory path:@"" node:node localItem:nil];
+            CURLDirectorySyncAction *list = [self newActionWithType:CURLDirectorySyncActionTypeList path:@"" node:node localItem:root];
+            create.followUp = list;
+            [self enqueueAction:create];
+            [create release];
+            [list release];
+            [node release];
+        }
+        [root release];
+
+        [self startWork];
+        [self finishIfDone];
+    }];
+}
+
+- (void)cancel;
+{
+    [_workQueue addOperationWithBlock:^{
+
+        if (_cancelled || _finished) return;
+        _cancelled = YES;
+
+        NSError *error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil];
+
+        for (NSArray *aQueue in [NSArray arrayWithObjects:_pendingDirectoryActions, _pendingActions, nil])
+        {
+            for (CURLDirectorySyncAction *anAction in aQueue)
+            {
+                anAction.error = error;
+                [self reportAction:anAction];
+            }
+        }
+        [_pendingDirectoryActions removeAllObjects];
+        [_pendingActions removeAllObjects];
+        [_pool invalidateAndCancel];
+
+        [self finishIfDone];
+    }];
+}
+
+- (void)startWork;
+{
+    while (!_cancelled)
+    {
+        NSMutableArray *queue = ([_pendingDirectoryActions count] ? _pendingDirectoryActions : _pendingActions);
+        if (![queue count]) break;
+
+        CURLFTPSession *session = [_pool dequeueSession];
+        if (!session) break;
+
+        CURLDirectorySyncAction *action = [[queue objectAtIndex:0] retain];
+        [queue removeObjectAtIndex:0];
+
+        CURLFTPOperation *operation = nil;
+        switch (action.type)
+        {
+            case CURLDirectorySyncActionTypeList:
+                operation = [session listDirectoryAtPath:action.path];
+                break;
+            case CURLDirectorySyncActionTypeCreateDirectory:
+                // The remote directory itself may well exist already
+                operation = [session createDirectoryAtPath:action.path withIntermediateDirectories:![action.path length]];
+                break;
+            case CURLDirectorySyncActionTypeUpload:
+                operation = [session uploadFileAtURL:action.localItem->_fileURL toPath:action.path];
+                break;
+            case CURLDirectorySyncActionTypeRemoveFile:
+                operation = [session removeFileAtPath:action.path];
+                break;
+            case CURLDirectorySyncActionTypeRemoveDirectory:
+                operation = [session removeDirectoryAtPath:action.path];
+                break;
+        }
+        operation.userInfo = action;
+        [action release];
+    }
+}
+
+- (void)reportAction:(CURLDirectorySyncAction *)action;
+{
+    if (action.error) _failedCount++;
+
+    [_delegateQueue addOperationWithBlock:^{
+        id <CURLDirectorySyncDelegate> delegate = self.delegate;
+        if ([delegate respondsToSelector:@selector(directorySync:didFinishAction:)])
+        {
+            [delegate directorySync:self didFinishAction:action];
+        }
+    }];
+}
+
+- (void)finishAction:(CURLDirectorySyncAction *)action operation:(CURLFTPOperation *)operation;
+{
+    action.error = operation.error;
+    action.bytesSent = operation.bytesSent;
+    [self reportAction:action];
+
+    CURLDirectorySyncNode *node = action.node;
+    CURLDirectorySyncLocalItem *item = action.localItem;
+
+    if (action.error)
+    {
+        node->_failed = YES;
+        if (action.type == CURLDirectorySyncActionTypeUpload) [_manifestFiles removeObjectForKey:action.path];
+    }
+    else
+    {
+        switch (action.type)
+        {
+            case CURLDirectorySyncActionTypeList:
+                _listedDirectoryCount++;
+                if (!_cancelled) [self node:node didListEntries:operation.entries];
+                break;
+
+            case CURLDirectorySyncActionTypeCreateDirectory:
+                if ([action.path length])
+                {
+                    _createdDirectoryCount++;
+                    if (!_cancelled) [self populateDirectory:item parent:node];
+                }
+                break;
+
+            case CURLDirectorySyncActionTypeUpload:
+                _uploadedFileCount++;
+                _totalBytesSent += action.bytesSent;
+                [self recordFile:item digest:(_comparesContents ? CURLDirectorySyncDigestOfFile(item->_fileURL) : nil)];
+                break;
+
+            case CURLDirectorySyncActionTypeRemoveFile:
+            case CURLDirectorySyncActionTypeRemoveDirectory:
+                _removedItemCount++;
+                break;
+        }
+
+        if (action.followUp && !_cancelled) [self enqueueAction:action.followUp];
+    }
+
+    node->_pendingCount--;
+    [self checkNode:node];
+}
+
+- (void)finishIfDone;
+{
+    if (_finished || _pool.activeCount || [_pendingDirectoryActions count] || [_pendingActions count]) return;
+    _finished = YES;
+
+    [_pool finishOperationsAndInvalidate];
+
+    [self saveManifest];
+
+    CURLDirectorySyncSummary *summary = [[CURLDirectorySyncSummary alloc] init];
+    summary.listedDirectoryCount = _listedDirectoryCount;
+    summary.skippedDirectoryCount = _skippedDirectoryCount;
+    summary.unchangedFileCount = _unchangedFileCount;
+    summary.uploadedFileCount = _uploadedFileCount;
+    summary.createdDirectoryCount = _createdDirectoryCount;
+    summary.removedItemCount = _removedItemCount;
+    summary.failedCount = _failedCount;
+    summary.totalBytesSent = _totalBytesSent;
+    summary.elapsedTime = CFAbsoluteTimeGetCurrent() - _startTime;
+
+    [_delegateQueue addOperationWithBlock:^{
+        [self.delegate directorySync:self didCompleteWithSummary:summary];
+
+        // Break the retain cycle, like CURLTransfer
+        [_delegate release]; _delegate = nil;
+    }];
+    [summary release];
+}
+
+#pragma mark CURLFTPSessionDelegate
+
+- (void)FTPSession:(CURLFTPSession *)session didCompleteOperation:(CURLFTPOperation *)operation;
+{
+    CURLDirectorySyncAction *action = operation.userInfo;
+    if (action)
+    {
+        [self finishAction:action operation:operation];
+    }
+
+    [self startWork];
+    [self finishIfDone];
+}
+
+@end
+
+
+#pragma mark -
+
+
+@implementation CURLDirectorySyncAction
+
+- (id)initWithType:(CURLDirectorySyncActionType)type path:(NSString *)path;
+{
+    if (self = [self init])
+    {
+        _type = type;
+        _path = [path copy];
+    }
+    return self;
+}
+
+@synthesize type = _type;
+@synthesize path = _path;
+@synthesize error = _error;
+@synthesize bytesSent = _bytesSent;
+@synthesize node = _node;
+@synthesize localItem = _localItem;
+@synthesize followUp = _followUp;
+
+- (void)dealloc
+{
+    [_path release];
+    [_error release];
+    [_node release];
+    [_localItem release];
+    [_followUp release];
+
+    [super dealloc];
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %p %ld %@ %@>", [self class], self, (long)_type, _path, (_error ? _error : @"OK")];
+}
+
+@end
+
+
+#pragma mark -
+
+
+@implementation CURLDirectorySyncSummary
+
+@synthesize listedDirectoryCount = _listedDirectoryCount;
+@synthesize skippedDirectoryCount = _skippedDirectoryCount;
+@synthesize unchangedFileCount = _unchangedFileCount;
+@synthesize uploadedFileCount = _uploadedFileCount;
+@synthesize createdDirectoryCount = _createdDirectoryCount;
+@synthesize removedItemCount = _removedItemCount;
+@synthesize failedCount = _failedCount;
+@synthesize totalBytesSent = _totalBytesSent;
+@synthesize elapsedTime = _elapsedTime;
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %p listed:%lu skipped:%lu unchanged:%lu uploaded:%lu created:%lu removed:%lu failed:%lu bytes:%llu in %.2fs>",
+            [self class], self,
+            (unsigned long)_listedDirectoryCount, (unsigned long)_skippedDirectoryCount, (unsigned long)_unchangedFileCount,
+            (unsigned long)_uploadedFileCount, (unsigned long)_createdDirectoryCount, (unsigned long)_removedItemCount,
+            (unsigned long)_failedCount, _totalBytesSent, _elapsedTime];
+}
+
+@end
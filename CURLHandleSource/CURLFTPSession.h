@@ -0,0 +1,202 @@
+//
+//  CURLFTPSession.h
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLTransfer.h"
+
+
+@class CURLFTPOperation;
+@class CURLConnectionStatistics;
+@class CURLDirectoryListingParser;
+@protocol CURLFTPSessionDelegate;
+
+/**
+ What a CURLFTPOperation does.
+ */
+typedef NS_ENUM(NSInteger, CURLFTPOperationType) {
+    CURLFTPOperationTypeUpload,
+    CURLFTPOperationTypeRemoveFile,
+    CURLFTPOperationTypeCreateDirectory,
+    CURLFTPOperationTypeRemoveDirectory,
+    CURLFTPOperationTypeSetPermissions,
+    CURLFTPOperationTypeList,
+};
+
+/**
+ Runs a series of uploads and file management commands against one FTP or SFTP server, over a single
+ control connection which is kept open between them.
+
+ Doing the same thing with individual CURLTransfers means each one may log in afresh, and has to navigate to
+ its directory, unless it happens to pick up a suitable connection from the shared multi. A session has a
+ multi of its own, and runs one operation at a time on it, so every operation after the first goes straight
+ to work over the connection the last one left behind. Operations in the same directory as the previous one
+ don't even need a CWD.
+
+ Operations can be added at any time, from any thread, and run in the order they were added. The delegate
+ hears about each as it completes; a failure doesn't stop the rest.
+ */
+
+@interface CURLFTPSession : NSObject <CURLTransferDelegate>
+{
+  @private
+    NSURL                           *_baseURL;
+    NSURLCredential                 *_credential;
+    CURLMultiHandle                 *_multi;
+    dispatch_queue_t                _queue;
+    CURLConnectionStatistics        *_finalStatistics;
+    id <CURLFTPSessionDelegate>     _delegate;
+    NSOperationQueue                *_delegateQueue;
+    BOOL                            _createsIntermediateDirectories;
+
+    // Only accessed on the multi's queue
+    NSMutableArray      *_pendingOperations;
+    CURLFTPOperation    *_currentOperation;
+    CURLTransfer        *_currentTransfer;
+    CURLDirectoryListingParser  *_currentParser;
+    BOOL                _invalidating;
+    BOOL                _invalidated;
+}
+
+/**
+ @param baseURL An ftp, ftps or sftp URL for the directory operation paths are relative to. Credentials in the URL are used if `credential` is `nil`.
+ @param credential Used to log in. May be `nil`.
+ @param delegate Retained until the session is invalidated, much like CURLTransfer.
+ @param queue The queue to deliver delegate messages on. If `nil`, a serial queue is created.
+ */
+- (id)initWithBaseURL:(NSURL *)baseURL
+           credential:(NSURLCredential *)credential
+             delegate:(id <CURLFTPSessionDelegate>)delegate
+        delegateQueue:(NSOperationQueue *)queue __attribute((nonnull(1)));
+
+@property (readonly, copy) NSURL *baseURL;
+@property (readonly, strong) id <CURLFTPSessionDelegate> delegate;
+
+/**
+ If `YES`, uploads create any missing directories along their path (as CURLOPT_FTP_CREATE_MISSING_DIRS). Default is `NO`.
+
+ Applies to operations added after it's changed.
+ */
+@property (assign) BOOL createsIntermediateDirectories;
+
+/** @name Operations */
+
+/*
+ Paths are relative to the base URL, and use "/" as the separator whatever the server does; a trailing "/" is
+ ignored. Each method queues its operation and returns straight away; the operation object is handed back to
+ the delegate once it's run. Operations on an item fail with NSURLErrorBadURL if the path doesn't name one,
+ e.g. removing "/".
+ */
+
+- (CURLFTPOperation *)uploadData:(NSData *)data toPath:(NSString *)path __attribute((nonnull));
+
+/**
+ Streams the file from disk, rather than reading it all into memory first.
+ */
+- (CURLFTPOperation *)uploadFileAtURL:(NSURL *)fileURL toPath:(NSString *)path __attribute((nonnull));
+
+- (CURLFTPOperation *)removeFileAtPath:(NSString *)path __attribute((nonnull));
+
+/**
+ @param intermediates If `YES`, creates any missing parents too, and doesn't treat the directory already existing as a failure.
+ */
+- (CURLFTPOperation *)createDirectoryAtPath:(NSString *)path withIntermediateDirectories:(BOOL)intermediates __attribute((nonnull));
+
+- (CURLFTPOperation *)removeDirectoryAtPath:(NSString *)path __attribute((nonnull));
+
+/**
+ Uses SITE CHMOD for FTP, which not every server supports.
+ */
+- (CURLFTPOperation *)setPermissions:(unsigned long)permissions ofItemAtPath:(NSString *)path __attribute((nonnull));
+
+/**
+ Fetches the directory's contents, parsing the listing as it arrives. The entries are available from the
+ operation once it's complete.
+ */
+- (CURLFTPOperation *)listDirectoryAtPath:(NSString *)path __attribute((nonnull));
+
+/** @name Finishing Up */
+
+/**
+ Lets operations already added run, then closes the connection and sends -FTPSessionDidInvalidate:.
+ Any operations added afterwards fail with NSURLErrorCancelled.
+ */
+- (void)finishOperationsAndInvalidate;
+
+/**
+ Stops as quickly as possible. The current operation and any still waiting are reported with
+ NSURLErrorCancelled, then the session is invalidated.
+ */
+- (void)invalidateAndCancel;
+
+/**
+ How the session's connection has been used, e.g. to confirm operations are sharing it. Once the session
+ has been invalidated, the figures as they stood just before the connection closed.
+ */
+- (CURLConnectionStatistics *)connectionStatistics;
+
+@end
+
+
+#pragma mark - Operations
+
+/**
+ One upload or command run by a CURLFTPSession.
+ */
+
+@interface CURLFTPOperation : NSObject
+{
+  @private
+    CURLFTPOperationType    _type;
+    NSString                *_path;
+    NSData                  *_data;
+    NSURL                   *_fileURL;
+    unsigned long           _permissions;
+    BOOL                    _intermediates;
+    NSError                 *_error;
+    NSMutableArray          *_entries;
+    unsigned long long      _bytesSent;
+    NSTimeInterval          _totalTime;
+    id                      _userInfo;
+}
+
+@property (readonly) CURLFTPOperationType type;
+@property (readonly, copy) NSString *path;
+
+@property (readonly, copy) NSError *error;              // nil if the operation succeeded; only meaningful once complete
+@property (readonly) unsigned long long bytesSent;      // for uploads
+@property (readonly) NSTimeInterval totalTime;          // CURLINFO_TOTAL_TIME
+
+/**
+ For listings, the CURLDirectoryEntry for each item in the directory, "." and ".." excepted. `nil` if there were none.
+ */
+@property (readonly, copy) NSArray *entries;
+
+/**
+ For the client's use, to tie operations back to its own records.
+ */
+@property (strong) id userInfo;
+
+@end
+
+
+#pragma mark - Delegate
+
+@protocol CURLFTPSessionDelegate <NSObject>
+
+/**
+ Called as each operation finishes, in the order they were added.
+ */
+- (void)FTPSession:(CURLFTPSession *)session didCompleteOperation:(CURLFTPOperation *)operation;
+
+@optional
+
+/**
+ Sent as the last message related to the session, once it's been invalidated and all operations reported.
+ */
+- (void)FTPSessionDidInvalidate:(CURLFTPSession *)session;
+
+@end
@@ -0,0 +1,554 @@
+//
+//  CURLFTPSession.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLFTPSession.h"
+
+#import "CURLDirectoryListing.h"
+#import "CURLTransferMetrics.h"
+#import "CURLTransfer+MultiSupport.h"
+
+#import "CURLMultiHandle.h"
+#import "CURLRequest.h"
+
+
+@interface CURLFTPOperation ()
+- (id)initWithType:(CURLFTPOperationType)type path:(NSString *)path;
+@property (readwrite, copy) NSError *error;
+@property (readwrite) unsigned long long bytesSent;
+@property (readwrite) NSTimeInterval totalTime;
+@property (nonatomic, copy) NSData *data;
+@property (nonatomic, copy) NSURL *fileURL;
+@property (nonatomic) unsigned long permissions;
+@property (nonatomic) BOOL intermediates;     // create parent directories as needed
+- (void)addEntries:(NSArray *)entries;
+@end
+
+
+@implementation CURLFTPSession
+
+@synthesize baseURL = _baseURL;
+@synthesize delegate = _delegate;
+@synthesize createsIntermediateDirectories = _createsIntermediateDirectories;
+
+#pragma mark Lifecycle
+
+- (id)initWithBaseURL:(NSURL *)baseURL credential:(NSURLCredential *)credential delegate:(id <CURLFTPSessionDelegate>)delegate delegateQueue:(NSOperationQueue *)queue;
+{
+    NSParameterAssert(baseURL);
+
+    if (self = [self init])
+    {
+        // Paths get resolved against the base URL, so it needs to be a directory
+        NSString *base = [baseURL absoluteString];
+        if (![base hasSuffix:@"/"]) baseURL = [NSURL URLWithString:[base stringByAppendingString:@"/"]];
+        _baseURL = [baseURL copy];
+
+        _credential = [credential retain];
+        _delegate = [delegate retain];
+
+        // A multi of our own means nothing else can borrow the connection between operations
+        _multi = [[CURLMultiHandle alloc] init];
+        _queue = _multi.queue;
+        dispatch_retain(_queue);
+
+        if (queue)
+        {
+            _delegateQueue = [queue retain];
+        }
+        else
+        {
+            _delegateQueue = [[NSOperationQueue alloc] init];
+            _delegateQueue.maxConcurrentOperationCount = 1;
+        }
+
+        _pendingOperations = [[NSMutableArray alloc] init];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_baseURL release];
+    [_credential release];
+    [_multi release];
+    dispatch_release(_queue);
+    [_finalStatistics release];
+    [_delegate release];
+    [_delegateQueue release];
+    [_pendingOperations release];
+    [_currentOperation release];
+    [_currentTransfer release];
+    [_currentParser release];
+
+    [super dealloc];
+}
+
+#pragma mark Operations
+
+- (CURLFTPOperation *)addOperation:(CURLFTPOperation *)operation;
+{
+    dispatch_async(_queue, ^{
+
+        if (_invalidating)
+        {
+            operation.error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil];
+            [self reportOperation:operation];
+            return;
+        }
+
+        [_pendingOperations addObject:operation];
+        [self startNextOperation];
+    });
+
+    return operation;
+}
+
+- (CURLFTPOperation *)uploadData:(NSData *)data toPath:(NSString *)path;
+{
+    CURLFTPOperation *operation = [[CURLFTPOperation alloc] initWithType:CURLFTPOperationTypeUpload path:path];
+    operation.data = data;
+    operation.intermediates = self.createsIntermediateDirectories;
+    return [self addOperation:[operation autorelease]];
+}
+
+- (CURLFTPOperation *)uploadFileAtURL:(NSURL *)fileURL toPath:(NSString *)path;
+{
+    CURLFTPOperation *operation = [[CURLFTPOperation alloc] initWithType:CURLFTPOperationTypeUpload path:path];
+    operation.fileURL = fileURL;
+    operation.intermediates = self.createsIntermediateDirectories;
+    return [self addOperation:[operation autorelease]];
+}
+
+- (CURLFTPOperation *)removeFileAtPath:(NSString *)path;
+{
+    CURLFTPOperation *operation = [[CURLFTPOperation alloc] initWithType:CURLFTPOperationTypeRemoveFile path:path];
+    return [self addOperation:[operation autorelease]];
+}
+
+- (CURLFTPOperation *)createDirectoryAtPath:(NSString *)path withIntermediateDirectories:(BOOL)intermediates;
+{
+    CURLFTPOperation *operation = [[CURLFTPOperation alloc] initWithType:CURLFTPOperationTypeCreateDirectory path:path];
+    operation.intermediates = intermediates;
+    return [self addOperation:[operation autorelease]];
+}
+
+- (CURLFTPOperation *)removeDirectoryAtPath:(NSString *)path;
+{
+    CURLFTPOperation *operation = [[CURLFTPOperation alloc] initWithType:CURLFTPOperationTypeRemoveDirectory path:path];
+    return [self addOperation:[operation autorelease]];
+}
+
+- (CURLFTPOperation *)setPermissions:(unsigned long)permissions ofItemAtPath:(NSString *)path;
+{
+    CURLFTPOperation *operation = [[CURLFTPOperation alloc] initWithType:CURLFTPOperationTypeSetPermissions path:path];
+    operation.permissions = permissions;
+    return [self addOperation:[operation autorelease]];
+}
+
+- (CURLFTPOperation *)listDirectoryAtPath:(NSString *)path;
+{
+    CURLFTPOperation *operation = [[CURLFTPOperation alloc] initWithType:CURLFTPOperationTypeList path:path];
+    return [self addOperation:[operation autorelease]];
+}
+
+#pragma mark Running
+
+// Everything from here on happens on the multi's queue
+
+- (void)startNextOperation;
+{
+    if (_currentOperation) return;
+
+    if (![_pendingOperations count])
+    {
+        if (_invalidating) [self invalidate];
+        return;
+    }
+
+    _currentOperation = [[_pendingOperations objectAtIndex:0] retain];
+    [_pendingOperations removeObjectAtIndex:0];
+
+    if (_currentOperation.type == CURLFTPOperationTypeList)
+    {
+        CURLFTPOperation *operation = _currentOperation;
+        _currentParser = [[CURLDirectoryListingParser alloc] initWithFormat:CURLDirectoryListingFormatAutomatic handler:^(NSArray *entries) {
+            [operation addEntries:entries];
+        }];
+    }
+
+    NSURLRequest *request = [self newRequestForOperation:_currentOperation];
+    if (!request)
+    {
+        [self finishCurrentOperationWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorBadURL userInfo:nil]];
+        return;
+    }
+
+    // If setup fails, the transfer reports so before init returns
+    CURLTransfer *transfer = [[CURLTransfer alloc] initWithRequest:request credential:_credential delegate:self multi:_multi];
+    [request release];
+
+    if (!transfer)
+    {
+        if (_currentOperation) [self finishCurrentOperationWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorUnknown userInfo:nil]];
+    }
+    else if (transfer.state != CURLTransferStateCompleted)
+    {
+        _currentTransfer = transfer;
+        [_multi beginTransfer:transfer];
+    }
+    else
+    {
+        [transfer release];
+    }
+}
+
+- (void)finishCurrentOperationWithError:(NSError *)error;
+{
+    CURLFTPOperation *operation = _currentOperation;
+    _currentOperation = nil;
+    [_currentTransfer autorelease]; _currentTransfer = nil;     // we may be inside one of its methods
+
+    [_currentParser finish];
+    [_currentParser release]; _currentParser = nil;
+
+    operation.error = error;
+    [self reportOperation:operation];
+    [operation release];
+
+    // Start the next one afresh, rather than from within the transfer that just finished
+    dispatch_async(_queue, ^{
+        [self startNextOperation];
+    });
+}
+
+- (void)reportOperation:(CURLFTPOperation *)operation;
+{
+    [_delegateQueue addOperationWithBlock:^{
+        [self.delegate FTPSession:self didCompleteOperation:operation];
+    }];
+}
+
+#pragma mark Finishing Up
+
+- (void)finishOperationsAndInvalidate;
+{
+    dispatch_async(_queue, ^{
+        _invalidating = YES;
+        [self startNextOperation];  // if there's nothing left to do, this invalidates straight away
+    });
+}
+
+- (void)invalidateAndCancel;
+{
+    // -[CURLTransfer cancel] would report the running operation only after the pending ones, so we do its work directly
+    dispatch_async(_queue, ^{
+
+        if (_invalidated) return;
+        _invalidating = YES;
+
+        NSError *error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil];
+
+        // Report the running operation first, to keep everything in order
+        if (_currentTransfer)
+        {
+            CURLTransfer *transfer = _currentTransfer;  // our completion method lets go of it
+            [_multi suspendTransfer:transfer];
+            [transfer completeWithError:error];
+        }
+
+        for (CURLFTPOperation *anOperation in _pendingOperations)
+        {
+            anOperation.error = error;
+            [self reportOperation:anOperation];
+        }
+        [_pendingOperations removeAllObjects];
+
+        [self startNextOperation];  // with nothing left, this invalidates
+    });
+}
+
+- (void)invalidate;
+{
+    if (_invalidated) return;
+    _invalidated = YES;
+
+    // Cleaning up the multi closes the connection
+    @synchronized(self)
+    {
+        _finalStatistics = [[_multi connectionStatistics] retain];
+        [_multi release]; _multi = nil;
+    }
+
+    [_delegateQueue addOperationWithBlock:^{
+
+        id <CURLFTPSessionDelegate> delegate = self.delegate;
+        if ([delegate respondsToSelector:@selector(FTPSessionDidInvalidate:)])
+        {
+            [delegate FTPSessionDidInvalidate:self];
+        }
+
+        // Break the retain cycle, like CURLTransfer
+        [_delegate release]; _delegate = nil;
+    }];
+}
+
+- (CURLConnectionStatistics *)connectionStatistics;
+{
+    @synchronized(self)
+    {
+        return (_multi ? [_multi connectionStatistics] : [[_finalStatistics retain] autorelease]);
+    }
+}
+
+#pragma mark Requests
+
+- (BOOL)isSFTP;
+{
+    return ([[_baseURL scheme] caseInsensitiveCompare:@"sftp"] == NSOrderedSame);
+}
+
+- (NSURL *)URLForPath:(NSString *)path isDirectory:(BOOL)isDirectory;
+{
+    NSArray *components = [[path componentsSeparatedByString:@"/"] filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"length > 0"]];
+
+    NSURL *result = _baseURL;
+    for (NSUInteger i = 0; i < [components count]; i++)
+    {
+        BOOL last = (i == [components count] - 1);
+        result = [result URLByAppendingPathComponent:[components objectAtIndex:i] isDirectory:(last ? isDirectory : YES)];
+    }
+
+    return result;
+}
+
+/*  SFTP commands take paths from the server's idea of the working directory, which is the user's home, not
+ *  the URL. libcurl's "/~/" convention translates back to a relative path; anything else is absolute.
+ */
+- (NSString *)SFTPArgumentForPath:(NSString *)path;
+{
+    NSString *result = [[self URLForPath:path isDirectory:NO] path];
+    if ([result hasPrefix:@"/~/"])
+    {
+        result = [result substringFromIndex:3];
+    }
+
+    // libcurl splits arguments on whitespace unless they're quoted
+    result = [result stringByReplacingOccurrencesOfString:@"\\" withString:@"\\\\"];
+    result = [result stringByReplacingOccurrencesOfString:@"\"" withString:@"\\\""];
+    return [NSString stringWithFormat:@"\"%@\"", result];
+}
+
+/*  Returns nil if the operation needs to name an item, but its path doesn't, e.g. removing "/"
+ */
+- (NSURLRequest *)newRequestForOperation:(CURLFTPOperation *)operation;
+{
+    NSString *path = operation.path;
+    while ([path hasSuffix:@"/"]) path = [path substringToIndex:[path length] - 1];
+
+    NSString *name = [[path componentsSeparatedByString:@"/"] lastObject];
+    NSString *parent = [path substringToIndex:[path length] - [name length]];
+
+    NSMutableURLRequest *request;
+    NSString *command = nil;
+
+    if (![name length] &&
+        (operation.type == CURLFTPOperationTypeRemoveFile ||
+         operation.type == CURLFTPOperationTypeRemoveDirectory ||
+         operation.type == CURLFTPOperationTypeSetPermissions ||
+         (operation.type == CURLFTPOperationTypeCreateDirectory && !operation.intermediates)))
+    {
+        return nil;
+    }
+
+    if (operation.type == CURLFTPOperationTypeList)
+    {
+        // A directory URL has libcurl list it; LIST for FTP, or a long listing for SFTP
+        return [[NSMutableURLRequest alloc] initWithURL:[self URLForPath:path isDirectory:YES]];
+    }
+
+    if (operation.type == CURLFTPOperationTypeUpload)
+    {
+        request = [[NSMutableURLRequest alloc] initWithURL:[self URLForPath:path isDirectory:NO]];
+        [request curl_setCreateIntermediateDirectories:operation.intermediates];
+
+        if (operation.fileURL)
+        {
+            [request setHTTPBodyStream:[NSInputStream inputStreamWithURL:operation.fileURL]];
+
+            NSNumber *size = [[[NSFileManager defaultManager] attributesOfItemAtPath:[operation.fileURL path] error:NULL] objectForKey:NSFileSize];
+            [request curl_setUploadLength:size];
+        }
+        else
+        {
+            [request setHTTPBody:operation.data];
+        }
+
+        return request;
+    }
+
+    if ([self isSFTP])
+    {
+        // Commands name the item in full, so can go from wherever the connection is
+        request = [[NSMutableURLRequest alloc] initWithURL:_baseURL];
+        NSString *argument = [self SFTPArgumentForPath:path];
+
+        switch (operation.type)
+        {
+            case CURLFTPOperationTypeRemoveFile:
+                command = [@"rm " stringByAppendingString:argument];
+                break;
+
+            case CURLFTPOperationTypeCreateDirectory:
+                if (operation.intermediates)
+                {
+                    // Commands starting with an asterisk are allowed to fail, which covers directories that already exist
+                    NSMutableArray *commands = [NSMutableArray array];
+                    NSString *partial = @"";
+                    for (NSString *aComponent in [path componentsSeparatedByString:@"/"])
+                    {
+                        if (![aComponent length]) continue;
+                        partial = [partial stringByAppendingFormat:@"%@/", aComponent];
+                        [commands addObject:[@"*mkdir " stringByAppendingString:[self SFTPArgumentForPath:partial]]];
+                    }
+                    [request curl_setPreTransferCommands:commands];
+                }
+                else
+                {
+                    command = [@"mkdir " stringByAppendingString:argument];
+                }
+                break;
+
+            case CURLFTPOperationTypeRemoveDirectory:
+                command = [@"rmdir " stringByAppendingString:argument];
+                break;
+
+            case CURLFTPOperationTypeSetPermissions:
+                command = [NSString stringWithFormat:@"chmod %lo %@", operation.permissions, argument];
+                break;
+
+            default:
+                break;
+        }
+    }
+    else if (operation.type == CURLFTPOperationTypeCreateDirectory && operation.intermediates)
+    {
+        // Navigating to the directory has libcurl make whatever's missing on the way
+        request = [[NSMutableURLRequest alloc] initWithURL:[self URLForPath:path isDirectory:YES]];
+        [request curl_setCreateIntermediateDirectories:YES];
+    }
+    else
+    {
+        // Navigate to the item's directory, which libcurl skips if the connection is there already
+        request = [[NSMutableURLRequest alloc] initWithURL:[self URLForPath:parent isDirectory:YES]];
+
+        switch (operation.type)
+        {
+            case CURLFTPOperationTypeRemoveFile:
+                command = [@"DELE " stringByAppendingString:name];
+                break;
+
+            case CURLFTPOperationTypeCreateDirectory:
+                command = [@"MKD " stringByAppendingString:name];
+                break;
+
+            case CURLFTPOperationTypeRemoveDirectory:
+                command = [@"RMD " stringByAppendingString:name];
+                break;
+
+            case CURLFTPOperationTypeSetPermissions:
+                command = [NSString stringWithFormat:@"SITE CHMOD %lo %@", operation.permissions, name];
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    // @"HEAD" => CURLOPT_NOBODY, which stops libcurl from trying to list the directory's contents
+    [request setHTTPMethod:@"HEAD"];
+    if (command) [request curl_setPreTransferCommands:[NSArray arrayWithObject:command]];
+
+    return request;
+}
+
+#pragma mark CURLTransferDelegate
+
+// All of these arrive on the multi's queue
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveData:(NSData *)data;
+{
+    // Only listings produce any
+    [_currentParser appendData:data];
+}
+
+- (void)transfer:(CURLTransfer *)transfer didCompleteWithError:(NSError *)error;
+{
+    NSAssert(_currentOperation, @"completion for a transfer %@ with no operation running", transfer);
+
+    CURLTransferMetrics *metrics = transfer.metrics;
+    _currentOperation.bytesSent = (unsigned long long)metrics.bytesSent;
+    _currentOperation.totalTime = metrics.totalTime;
+
+    [self finishCurrentOperationWithError:error];
+}
+
+@end
+
+
+#pragma mark -
+
+
+@implementation CURLFTPOperation
+
+- (id)initWithType:(CURLFTPOperationType)type path:(NSString *)path;
+{
+    if (self = [self init])
+    {
+        _type = type;
+        _path = [path copy];
+    }
+    return self;
+}
+
+@synthesize type = _type;
+@synthesize path = _path;
+@synthesize data = _data;
+@synthesize fileURL = _fileURL;
+@synthesize permissions = _permissions;
+@synthesize intermediates = _intermediates;
+@synthesize error = _error;
+@synthesize entries = _entries;
+@synthesize bytesSent = _bytesSent;
+@synthesize totalTime = _totalTime;
+@synthesize userInfo = _userInfo;
+
+- (void)dealloc
+{
+    [_path release];
+    [_data release];
+    [_fileURL release];
+    [_error release];
+    [_entries release];
+    [_userInfo release];
+
+    [super dealloc];
+}
+
+- (void)addEntries:(NSArray *)entries;
+{
+    if (!_entries) _entries = [[NSMutableArray alloc] init];
+    [_entries addObjectsFromArray:entries];
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %p %ld %@ %@>", [self class], self, (long)_type, _path, (_error ? _error : @"OK")];
+}
+
+@end
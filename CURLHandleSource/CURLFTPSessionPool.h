@@ -0,0 +1,87 @@
+//
+//  CURLFTPSessionPool.h
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLFTPSession.h"
+
+
+/**
+ A bounded set of CURLFTPSessions logged in to the same server, behind CURLBulkUpload and CURLDirectorySync.
+ Not intended for public consumption.
+
+ Ask it for a session whenever there's an operation to run: an idle one is handed back if there is one, and
+ otherwise a new one is opened, up to `maximumSessions`. Give each session exactly one operation; when that
+ completes, the session goes back to being idle, and the pool's delegate gets the usual
+ -FTPSession:didCompleteOperation: message.
+
+ Not thread-safe. Only use it on the delegate queue, which must be serial, and is where its sessions report.
+ */
+
+@interface CURLFTPSessionPool : NSObject <CURLFTPSessionDelegate>
+{
+  @private
+    NSURL                       *_baseURL;
+    NSURLCredential             *_credential;
+    NSUInteger                  _maximumSessions;
+    id <CURLFTPSessionDelegate> _delegate;
+    NSOperationQueue            *_delegateQueue;
+    BOOL                        _createsIntermediateDirectories;
+
+    NSMutableArray  *_sessions;
+    NSMutableArray  *_idleSessions;
+    NSUInteger      _activeCount;
+    NSUInteger      _sessionCount;
+    BOOL            _invalidated;
+}
+
+/**
+ @param baseURL Passed on to each session.
+ @param credential Passed on to each session. May be `nil`.
+ @param maximumSessions The most sessions to have open at once. 0 is treated as 1.
+ @param delegate Retained until the pool has been invalidated and all its sessions have reported.
+ @param queue Where the sessions, and so the pool, report. Must be serial.
+ */
+- (id)initWithBaseURL:(NSURL *)baseURL
+           credential:(NSURLCredential *)credential
+      maximumSessions:(NSUInteger)maximumSessions
+             delegate:(id <CURLFTPSessionDelegate>)delegate
+        delegateQueue:(NSOperationQueue *)queue __attribute((nonnull(1,4,5)));
+
+@property (readonly, copy) NSURL *baseURL;
+@property (readonly) NSUInteger maximumSessions;
+
+/**
+ Applied to sessions opened after it's changed. Default is `NO`.
+ */
+@property (assign) BOOL createsIntermediateDirectories;
+
+/**
+ Sessions handed out whose operation hasn't completed yet.
+ */
+@property (readonly) NSUInteger activeCount;
+
+/**
+ How many sessions have been opened, over the pool's whole life.
+ */
+@property (readonly) NSUInteger sessionCount;
+
+/**
+ @return A session to run one operation on, or `nil` if they're all busy or the pool has been invalidated.
+ */
+- (CURLFTPSession *)dequeueSession;
+
+/**
+ Lets running operations finish, then logs out. No more sessions are handed out.
+ */
+- (void)finishOperationsAndInvalidate;
+
+/**
+ Cancels running operations, which still complete, with NSURLErrorCancelled. No more sessions are handed out.
+ */
+- (void)invalidateAndCancel;
+
+@end
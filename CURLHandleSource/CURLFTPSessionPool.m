@@ -0,0 +1,131 @@
+//
+//  CURLFTPSessionPool.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLFTPSessionPool.h"
+
+
+@implementation CURLFTPSessionPool
+
+@synthesize baseURL = _baseURL;
+@synthesize maximumSessions = _maximumSessions;
+@synthesize createsIntermediateDirectories = _createsIntermediateDirectories;
+@synthesize activeCount = _activeCount;
+@synthesize sessionCount = _sessionCount;
+
+#pragma mark Lifecycle
+
+- (id)initWithBaseURL:(NSURL *)baseURL credential:(NSURLCredential *)credential maximumSessions:(NSUInteger)maximumSessions delegate:(id <CURLFTPSessionDelegate>)delegate delegateQueue:(NSOperationQueue *)queue;
+{
+    NSParameterAssert(baseURL);
+    NSParameterAssert(delegate);
+    NSParameterAssert(queue);
+
+    if (self = [self init])
+    {
+        _baseURL = [baseURL copy];
+        _credential = [credential retain];
+        _maximumSessions = MAX(maximumSessions, 1U);
+        _delegate = [delegate retain];
+        _delegateQueue = [queue retain];
+
+        _sessions = [[NSMutableArray alloc] init];
+        _idleSessions = [[NSMutableArray alloc] init];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_baseURL release];
+    [_credential release];
+    [_delegate release];
+    [_delegateQueue release];
+    [_sessions release];
+    [_idleSessions release];
+
+    [super dealloc];
+}
+
+#pragma mark Sessions
+
+- (CURLFTPSession *)dequeueSession;
+{
+    if (_invalidated) return nil;
+
+    CURLFTPSession *result = [[[_idleSessions lastObject] retain] autorelease];
+    if (result)
+    {
+        [_idleSessions removeLastObject];
+    }
+    else if ([_sessions count] < _maximumSessions)
+    {
+        result = [[CURLFTPSession alloc] initWithBaseURL:_baseURL credential:_credential delegate:self delegateQueue:_delegateQueue];
+        result.createsIntermediateDirectories = _createsIntermediateDirectories;
+        [_sessions addObject:result];
+        [result autorelease];
+        _sessionCount++;
+    }
+    else
+    {
+        return nil;
+    }
+
+    _activeCount++;
+    return result;
+}
+
+#pragma mark Invalidating
+
+- (void)invalidateWithSelector:(SEL)selector;
+{
+    if (_invalidated) return;
+    _invalidated = YES;
+
+    [_idleSessions removeAllObjects];
+    [_sessions makeObjectsPerformSelector:selector];
+
+    // Otherwise the last session to go lets the delegate go
+    if (![_sessions count])
+    {
+        [_delegate release]; _delegate = nil;
+    }
+}
+
+- (void)finishOperationsAndInvalidate;
+{
+    [self invalidateWithSelector:_cmd];
+}
+
+- (void)invalidateAndCancel;
+{
+    [self invalidateWithSelector:_cmd];
+}
+
+#pragma mark CURLFTPSessionDelegate
+
+- (void)FTPSession:(CURLFTPSession *)session didCompleteOperation:(CURLFTPOperation *)operation;
+{
+    NSAssert(_activeCount, @"operation %@ completed on a session that wasn't handed out", operation);
+    _activeCount--;
+    if (!_invalidated) [_idleSessions addObject:session];
+
+    [_delegate FTPSession:session didCompleteOperation:operation];
+}
+
+- (void)FTPSessionDidInvalidate:(CURLFTPSession *)session;
+{
+    [_sessions removeObjectIdenticalTo:session];
+
+    if (_invalidated && ![_sessions count])
+    {
+        [_delegate release]; _delegate = nil;
+    }
+}
+
+@end
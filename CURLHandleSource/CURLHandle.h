@@ -10,4 +10,18 @@
 #import <CURLHandle/CURLTransfer.h>
 #import <CURLHandle/CURLRequest.h>
 #import <CURLHandle/CURLProtocol.h>
+#import <CURLHandle/CURLMultiHandle.h>
+#import <CURLHandle/CURLTransferBatch.h>
+#import <CURLHandle/CURLProxyResolver.h>
+#import <CURLHandle/CURLTransferMetrics.h>
+#import <CURLHandle/CURLSegmentedDownload.h>
+#import <CURLHandle/CURLResumableDownload.h>
+#import <CURLHandle/CURLResponseCache.h>
+#import <CURLHandle/CURLMultipartFormData.h>
+#import <CURLHandle/CURLSocketOptions.h>
+#import <CURLHandle/CURLConnectionStatistics.h>
+#import <CURLHandle/CURLFTPSession.h>
+#import <CURLHandle/CURLBulkUpload.h>
+#import <CURLHandle/CURLDirectoryListing.h>
+#import <CURLHandle/CURLDirectorySync.h>
 #import <CURLHandle/CK2SSHCredential.h>
@@ -10,6 +10,8 @@
 
 #import <curl/curl.h>
 
+#import "CURLRequest.h"
+
 #ifndef CURLMultiLog
 #define CURLMultiLog(...) // no logging by default - to enable it, add something like this to the prefix: #define CURLMultiLog NSLog
 #endif
@@ -24,6 +26,9 @@
 
 @class CURLTransfer;
 @class CURLSocketRegistration;
+@class CURLSocketOptions;
+@class CURLConnectionPool;
+@class CURLConnectionStatistics;
 
 /**
  * Wrapper for a curl_multi handle.
@@ -34,7 +39,8 @@
  * integration.
  *
  * There's nothing to stop you making other instances if you want to - it's just not really necessary, particularly
- * as we don't expose the curl multi externally.
+ * as we don't expose the curl multi externally. To tune or inspect the connections CURLProtocol makes, use the
+ * properties and statistics of the sharedInstance.
  *
  * This class works by setting up a serial GCD queue to process all events associated with the multi. We add
  * gcd dispatch sources for each socket that the multi makes, and use them to notify curl when something
@@ -45,12 +51,34 @@
 {
     CURLM *_multi;
     NSMutableArray* _transfers;
+    NSMutableArray* _transfersWithCoalescedData;    // only accessed on the queue
     BOOL            _isRunningProcessingLoop;
     NSMutableArray* _sockets;
     dispatch_queue_t _queue;
     
     dispatch_source_t   _timer;
     BOOL                _timerIsSuspended;
+
+    CURLExpectContinuePolicy    _expectContinuePolicy;
+    unsigned long long          _expectContinueThreshold;
+    NSMutableDictionary         *_expectContinueOrigins;    // origin -> whether it answers 100-continue. Guarded by @synchronized
+
+    CURLSocketOptions           *_socketOptions;
+
+    CURLAddressFamilyPreference _addressFamilyPreference;
+    NSTimeInterval              _happyEyeballsDelay;
+    NSMutableDictionary         *_addressFamilies;          // origin -> AF_INET or AF_INET6 that last connected. Guarded by @synchronized
+
+    BOOL                        _requiresAsynchronousResolver;
+    NSArray                     *_DNSServers;
+    NSTimeInterval              _DNSCacheTimeout;
+    NSTimeInterval              _resolveTimeout;
+
+    BOOL                        _adaptsFTPPassiveMode;
+    NSTimeInterval              _FTPPassiveModeProbeTimeout;
+    NSMutableDictionary         *_FTPPassiveModes;          // origin -> CURLFTPPassiveModeTraits. Guarded by @synchronized
+
+    CURLConnectionPool          *_connectionPool;
 }
 
 /**
@@ -82,6 +110,16 @@
 
 - (void)beginTransfer:(CURLTransfer*)transfer __attribute((nonnull));
 
+/**
+ * Assign several CURLTransfers to the multi at once.
+ * Equivalent to calling beginTransfer: for each, but the handles are all added in a single pass on the
+ * receiver's queue, and processing is kicked off just the once.
+ *
+ * @param transfers The transfers to manage. Each will be retained by the multi until removed.
+ */
+
+- (void)beginTransfers:(NSArray*)transfers __attribute((nonnull));
+
 /** 
  * This removes the transfer from the multi. *
  * It is safe to call this method for a transfer that has already been cancelled, or has completed,
@@ -98,23 +136,116 @@
 - (void)suspendTransfer:(CURLTransfer*)transfer __attribute((nonnull));
 
 /**
- Update the dispatch source for a given socket and type.
- 
- @warning The routine is used internally by <CURLMulti> / <CURLSocket>, and shouldn't be called from your code.
+ The serial queue the instance schedules sources on
+ */
+@property (readonly, assign, nonatomic) dispatch_queue_t queue;
 
- @param source The current dispatch source for the given type
- @param type Is this the source for reading or writing?
- @param socket The raw system socket that the dispatch source should be monitoring.
- @param registration The <CURLSocketRegistration> object that owns the source.
- @param required Is the source required? If not, an existing source will be cancelled. If required and the source parameter is nil, and new one will be created.
- @return The new/updated dispatch source.
-*/
+/**
+ Whether the caller is running on the receiver's queue, where a dispatch_sync onto it would deadlock.
 
-- (dispatch_source_t)updateSource:(dispatch_source_t)source type:(dispatch_source_type_t)type socket:(int)socket registration:(CURLSocketRegistration *)registration required:(BOOL)required;
+ @return YES if called from a block running on the receiver's queue.
+ */
+- (BOOL)isCurrentQueue;
 
 /**
- The serial queue the instance schedules sources on
+ When HTTP uploads should wait for a 100 Continue, unless the request says otherwise. Default is
+ CURLExpectContinuePolicyDefault, leaving it to libcurl.
  */
-@property (readonly, assign, nonatomic) dispatch_queue_t queue;
+@property (assign) CURLExpectContinuePolicy expectContinuePolicy;
+
+/**
+ Body size from which the threshold and adaptive policies ask for a 100 Continue. Default is 1MB.
+ */
+@property (assign) unsigned long long expectContinueThreshold;
+
+/**
+ TCP tuning applied to every connection the receiver's transfers open, unless a request has its own
+ curl_socketOptions. Default is `nil`, leaving the system defaults.
+ */
+@property (copy) CURLSocketOptions *socketOptions;
+
+/**
+ Which IP versions transfers may connect over, unless the request says otherwise. Default is
+ CURLAddressFamilyPreferenceDefault, which leaves libcurl to try both.
+ */
+@property (assign) CURLAddressFamilyPreference addressFamilyPreference;
+
+/**
+ How long libcurl waits on the first address family before also trying the other
+ (CURLOPT_HAPPY_EYEBALLS_TIMEOUT_MS). Default is 0, for libcurl's own. Has no effect before libcurl 7.59.0,
+ which always waits 200ms.
+ */
+@property (assign) NSTimeInterval happyEyeballsDelay;
+
+/** @name Name Resolution */
+
+/**
+ Describes the asynchronous resolver libcurl was built with, e.g. "c-ares 1.10.0" for CURLHandle's own build
+ (see Scripts/curl-config.sh), or "threaded".
+
+ @return `nil` if libcurl resolves names synchronously, which stalls every transfer on a multi while any one
+ of them is looking up a host.
+ */
++ (NSString *)asynchronousResolver;
+
+/**
+ If `YES`, transfers fail with CURLE_NOT_BUILT_IN rather than risk blocking the receiver's queue on a
+ synchronous lookup. Default is `NO`.
+ */
+@property (assign) BOOL requiresAsynchronousResolver;
+
+/**
+ Name servers to use in place of the system's, as "address[:port]" strings (CURLOPT_DNS_SERVERS). Needs the
+ c-ares resolver; ports need c-ares 1.11 or later. Default is `nil`, for the system's configuration. A request can
+ choose its own with -curl_setDNSServers:.
+ */
+@property (copy) NSArray *DNSServers;
+
+/**
+ How long resolved addresses are cached by the receiver (CURLOPT_DNS_CACHE_TIMEOUT). The cache is shared
+ by all of the receiver's transfers. Negative for forever; 0 disables caching. Default is 60 seconds.
+ */
+@property (assign) NSTimeInterval DNSCacheTimeout;
+
+/**
+ Longest a transfer may spend looking up and then connecting to its host (CURLOPT_CONNECTTIMEOUT_MS; libcurl
+ doesn't time the two separately). Default is 0, for libcurl's own 300 seconds. A request can choose its own with
+ -curl_setResolveTimeout:.
+ */
+@property (assign) NSTimeInterval resolveTimeout;
+
+/** @name FTP Passive Mode */
+
+/**
+ If `YES`, FTP transfers try EPSV the first time they reach a server, and remember per server whether it
+ worked, and whether the address in PASV replies can be reached. Later transfers to the server go straight to
+ whatever worked. Synchronous transfers don't try EPSV themselves, but do use it once it's been seen to work. If
+ `NO`, EPSV is never used over IPv4 and PASV addresses are always trusted. Default is `YES`.
+ */
+@property (assign) BOOL adaptsFTPPassiveMode;
+
+/**
+ While a server's EPSV support is unknown, the longest to wait for it to reply to EPSV. A server which doesn't
+ answer in time has its transfer quietly started over using PASV, so only costs the wait. Replies to other
+ commands are waited on as long as usual. Default is 15 seconds.
+ */
+@property (assign) NSTimeInterval FTPPassiveModeProbeTimeout;
+
+/** @name Connection Statistics */
+
+/**
+ How the receiver's connections have been opened, reused and closed, across all servers.
+ */
+- (CURLConnectionStatistics *)connectionStatistics;
+
+/**
+ @return CURLConnectionStatistics for each origin (as from -[NSURL curl_originString]) the receiver has connected to.
+ */
+- (NSDictionary *)connectionStatisticsByOrigin;
+
+/**
+ Zeroes the counts, e.g. before measuring a particular workload. Open connections are unaffected.
+ */
+- (void)resetConnectionStatistics;
 
 @end
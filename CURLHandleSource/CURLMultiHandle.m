@@ -49,6 +49,9 @@
 
 #import "CURLTransfer+MultiSupport.h"
 #import "CURLSocketRegistration.h"
+#import "CURLConnectionPool.h"
+
+#include <sys/socket.h>
 
 
 @interface CURLMultiHandle()
@@ -70,6 +73,9 @@
 static NSInteger gInstanceCount = 0;
 #endif
 
+// Tags each multi's queue with itself, so -isCurrentQueue can tell when it's being run on
+static const void *kCURLMultiQueueKey = &kCURLMultiQueueKey;
+
 NSString *const kActionNames[] =
 {
     @"CURL_SOCKET_TIMEOUT",
@@ -91,6 +97,17 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
 
 @synthesize sockets = _sockets;
 @synthesize queue = _queue;
+@synthesize expectContinuePolicy = _expectContinuePolicy;
+@synthesize expectContinueThreshold = _expectContinueThreshold;
+@synthesize socketOptions = _socketOptions;
+@synthesize addressFamilyPreference = _addressFamilyPreference;
+@synthesize happyEyeballsDelay = _happyEyeballsDelay;
+@synthesize requiresAsynchronousResolver = _requiresAsynchronousResolver;
+@synthesize DNSServers = _DNSServers;
+@synthesize DNSCacheTimeout = _DNSCacheTimeout;
+@synthesize resolveTimeout = _resolveTimeout;
+@synthesize adaptsFTPPassiveMode = _adaptsFTPPassiveMode;
+@synthesize FTPPassiveModeProbeTimeout = _FTPPassiveModeProbeTimeout;
 
 #pragma mark - Object Lifecycle
 
@@ -161,7 +178,16 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
         
         // Setup other ivars
         _transfers = [[NSMutableArray alloc] init];
+        _transfersWithCoalescedData = [[NSMutableArray alloc] init];
         self.sockets = [NSMutableArray array];
+        _expectContinueThreshold = 1024 * 1024;
+        _expectContinueOrigins = [[NSMutableDictionary alloc] init];
+        _addressFamilies = [[NSMutableDictionary alloc] init];
+        _DNSCacheTimeout = 60.0;
+        _adaptsFTPPassiveMode = YES;
+        _FTPPassiveModeProbeTimeout = 15.0;
+        _FTPPassiveModes = [[NSMutableDictionary alloc] init];
+        _connectionPool = [[CURLConnectionPool alloc] init];
 #if COUNT_INSTANCES
         ++gInstanceCount;
 #endif
@@ -185,7 +211,14 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
     NSAssert((_multi == NULL) && (_timer == NULL) && (_queue == NULL), @"should have been shut down by the time we're dealloced");
 
     [_transfers release];
+    [_transfersWithCoalescedData release];
     [_sockets release];
+    [_expectContinueOrigins release];
+    [_socketOptions release];
+    [_addressFamilies release];
+    [_DNSServers release];
+    [_FTPPassiveModes release];
+    [_connectionPool release];  // any sockets libcurl still has open keep it alive until they close
 
 #if COUNT_INSTANCES
     --gInstanceCount;
@@ -227,44 +260,126 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
     
     dispatch_async(self.queue, ^{
         
-        NSAssert(![self.transfers containsObject:transfer], @"shouldn't add a transfer twice");
-        
-        CURLMultiLog(@"adding transfer %@", transfer);
+        if ([self addTransfer:transfer])
+        {
+            [self startProcessingTransfers];
+        }
+    });
+}
+
+- (void)beginTransfers:(NSArray *)transfers;
+{
+    NSAssert(self.queue, @"need queue");
+    
+    transfers = [[transfers copy] autorelease];
+    dispatch_async(self.queue, ^{
         
-        CURLMcode result = curl_multi_add_handle(_multi, [transfer curlHandle]);
-        if (result == CURLM_OK)
+        BOOL added = NO;
+        for (CURLTransfer *aTransfer in transfers)
         {
-            [_transfers addObject:transfer];
-            
-#if USE_MULTI_SOCKET
-            // http://curl.haxx.se/libcurl/c/curl_multi_socket_action.html suggests you typically fire a timeout to get it started
-            [self processMulti:_multi action:CURL_SOCKET_TIMEOUT forSocket:0];
-#else
-            // Start up the queue again if needed
-            if (!_isRunningProcessingLoop)
-            {
-                _isRunningProcessingLoop = [self runProcessingLoop];
-            }
-#endif
+            if ([self addTransfer:aTransfer]) added = YES;
         }
-        else
+        
+        if (added)
         {
-            CURLMultiLogError(@"failed to add transfer %@", transfer);
-            NSAssert(result != CURLM_CALL_MULTI_SOCKET, @"CURLM_CALL_MULTI_SOCKET doesn't make sense as a transfer failure code");
-            [transfer completeWithError:[NSError errorWithDomain:CURLMcodeErrorDomain code:result userInfo:nil]];
+            [self startProcessingTransfers];
         }
     });
 }
 
+- (BOOL)addTransfer:(CURLTransfer *)transfer;
+{
+    NSAssert(![_transfers containsObject:transfer], @"shouldn't add a transfer twice");
+    
+    // Transfers created in bulk can be cancelled before they've made it to us
+    if ([transfer hasCompleted]) return NO;
+    
+    CURLMultiLog(@"adding transfer %@", transfer);
+    
+    // Statistics aren't worth failing the transfer over
+    if ([_connectionPool installOnHandle:[transfer curlHandle]] != CURLE_OK)
+    {
+        CURLMultiLogError(@"unable to track connections for transfer %@", transfer);
+    }
+    
+    CURLMcode result = curl_multi_add_handle(_multi, [transfer curlHandle]);
+    if (result == CURLM_OK)
+    {
+        [_transfers addObject:transfer];
+        [_connectionPool noteTransferStartedForOrigin:[[[transfer originalRequest] URL] curl_originString]];
+        return YES;
+    }
+    else
+    {
+        CURLMultiLogError(@"failed to add transfer %@", transfer);
+        NSAssert(result != CURLM_CALL_MULTI_SOCKET, @"CURLM_CALL_MULTI_SOCKET doesn't make sense as a transfer failure code");
+        [transfer completeWithError:[NSError errorWithDomain:CURLMcodeErrorDomain code:result userInfo:nil]];
+        return NO;
+    }
+}
+
+- (void)startProcessingTransfers;
+{
+#if USE_MULTI_SOCKET
+    // http://curl.haxx.se/libcurl/c/curl_multi_socket_action.html suggests you typically fire a timeout to get it started
+    [self processMulti:_multi action:CURL_SOCKET_TIMEOUT forSocket:0];
+#else
+    // Start up the queue again if needed
+    if (!_isRunningProcessingLoop)
+    {
+        _isRunningProcessingLoop = [self runProcessingLoop];
+    }
+#endif
+}
+
 - (void)suspendTransfer:(CURLTransfer *)transfer;
 {
-    NSAssert([_transfers containsObject:transfer], @"we should be managing this transfer");
+    // As documented, quietly ignore transfers we're not managing (e.g. cancelled before they were begun)
+    if (![_transfers containsObject:transfer]) return;
     
     CURLMultiLog(@"removed transfer %@", transfer);
+    
+    // Once removed, libcurl no longer says which pooled connection the transfer was using
+    [_connectionPool noteTransferFinishedForOrigin:[[[transfer originalRequest] URL] curl_originString] handle:[transfer curlHandle]];
+    
     CURLMcode result = curl_multi_remove_handle(_multi, [transfer curlHandle]);
     
     NSAssert(result == CURLM_OK, @"failed to remove curl easy from curl multi - something odd going on here");
     [_transfers removeObject:transfer];
+
+    // Anything it still has gets delivered as it completes
+    [_transfersWithCoalescedData removeObjectIdenticalTo:transfer];
+}
+
+- (void)noteTransferHasCoalescedData:(CURLTransfer *)transfer;
+{
+    [_transfersWithCoalescedData addObject:transfer];
+}
+
+- (void)noteTransferWasUnpaused:(CURLTransfer *)transfer;
+{
+#if USE_MULTI_SOCKET
+    // libcurl sets no timeout and doesn't ask after the socket when a send is unpaused, so without this nothing
+    // would prompt it to carry on
+    [self processMulti:_multi action:0 forSocket:CURL_SOCKET_TIMEOUT];
+#else
+    // Each time round, the processing loop calls curl_multi_perform() before waiting, which picks the transfer up
+    [self startProcessingTransfers];
+#endif
+}
+
+/*  libcurl hands over body data one read at a time; transfers which asked for it to be coalesced get all of
+ *  this pass's reads in one go
+ */
+- (void)deliverCoalescedData;
+{
+    if (![_transfersWithCoalescedData count]) return;
+
+    NSArray *transfers = [_transfersWithCoalescedData copy];
+    [_transfersWithCoalescedData removeAllObjects];
+
+    [transfers makeObjectsPerformSelector:@selector(deliverCoalescedData)];
+    [transfers release];
 }
 
 - (CURLTransfer*)transferForHandle:(CURL*)easy
@@ -286,6 +401,92 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
     return result;
 }
 
+#pragma mark - Expect: 100-continue
+
+- (void)noteOrigin:(NSString *)origin answersExpectContinue:(BOOL)answers;
+{
+    @synchronized(_expectContinueOrigins)
+    {
+        [_expectContinueOrigins setObject:[NSNumber numberWithBool:answers] forKey:origin];
+    }
+}
+
+- (BOOL)originAnswersExpectContinue:(NSString *)origin;
+{
+    @synchronized(_expectContinueOrigins)
+    {
+        NSNumber *answers = [_expectContinueOrigins objectForKey:origin];
+        return (answers ? [answers boolValue] : YES);   // worth trying until we know otherwise
+    }
+}
+
+#pragma mark - Connection Statistics
+
+- (CURLConnectionStatistics *)connectionStatistics; { return [_connectionPool statistics]; }
+- (NSDictionary *)connectionStatisticsByOrigin; { return [_connectionPool statisticsByOrigin]; }
+- (void)resetConnectionStatistics; { [_connectionPool reset]; }
+
+#pragma mark - Name Resolution
+
++ (NSString *)asynchronousResolver;
+{
+    curl_version_info_data *info = curl_version_info(CURLVERSION_NOW);
+    if (!(info->features & CURL_VERSION_ASYNCHDNS)) return nil;
+
+    return (info->ares ? [NSString stringWithFormat:@"c-ares %s", info->ares] : @"threaded");
+}
+
+#pragma mark - Address Families
+
+- (void)noteOrigin:(NSString *)origin connectedUsingAddressFamily:(int)family;
+{
+    @synchronized(_addressFamilies)
+    {
+        if (family == AF_UNSPEC)
+        {
+            [_addressFamilies removeObjectForKey:origin];
+        }
+        else
+        {
+            [_addressFamilies setObject:[NSNumber numberWithInt:family] forKey:origin];
+        }
+    }
+}
+
+- (int)addressFamilyForOrigin:(NSString *)origin;
+{
+    @synchronized(_addressFamilies)
+    {
+        NSNumber *family = [_addressFamilies objectForKey:origin];
+        return (family ? [family intValue] : AF_UNSPEC);
+    }
+}
+
+#pragma mark - FTP Passive Mode
+
+- (void)noteOrigin:(NSString *)origin FTPPassiveModeTraits:(CURLFTPPassiveModeTraits)traits;
+{
+    @synchronized(_FTPPassiveModes)
+    {
+        if (traits == 0)
+        {
+            [_FTPPassiveModes removeObjectForKey:origin];
+        }
+        else
+        {
+            [_FTPPassiveModes setObject:[NSNumber numberWithUnsignedInteger:traits] forKey:origin];
+        }
+    }
+}
+
+- (CURLFTPPassiveModeTraits)FTPPassiveModeTraitsForOrigin:(NSString *)origin;
+{
+    @synchronized(_FTPPassiveModes)
+    {
+        return [[_FTPPassiveModes objectForKey:origin] unsignedIntegerValue];
+    }
+}
+
 #pragma mark - Multi Handle Management
 
 - (void)multiCreate;
@@ -339,6 +540,7 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
 #endif
 
     [_transfers release]; _transfers = nil;
+    [_transfersWithCoalescedData removeAllObjects];
     self.sockets = nil;
 
     if (!_multi) return;
@@ -368,6 +570,8 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
         }
         while (result == CURLM_CALL_MULTI_SOCKET);
         
+        [self deliverCoalescedData];
+
         if (result == CURLM_OK)
         {
             CURLMultiLogDetail(@"%d handles reported as running", running);
@@ -394,6 +598,9 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
     }
     while (result == CURLM_CALL_MULTI_PERFORM);
     
+    // Body data goes out ahead of any completion it led up to
+    [self deliverCoalescedData];
+    
     if (result != CURLM_OK)
     {
         // If something went wrong, I guess there's not a lot we can do about it. After all, this is
@@ -545,6 +752,7 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
     static dispatch_once_t sGlobalQueueToken;
     dispatch_once(&sGlobalQueueToken, ^{
         sGlobalQueue = dispatch_queue_create("com.karelia.CURLMulti", NULL);
+        dispatch_queue_set_specific(sGlobalQueue, kCURLMultiQueueKey, sGlobalQueue, NULL);
     });
 
     queue = sGlobalQueue;
@@ -554,6 +762,7 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
     // make a new queue for each CURLMulti instance
     NSString* name = [NSString stringWithFormat:@"com.karelia.CURLMulti.%p", self];
     queue = dispatch_queue_create([name UTF8String], NULL);
+    dispatch_queue_set_specific(queue, kCURLMultiQueueKey, queue, NULL);
 
 #endif
 
@@ -561,6 +770,11 @@ static int socket_callback(CURL *easy, curl_socket_t s, int what, void *userp, v
     return queue;
 }
 
+- (BOOL)isCurrentQueue;
+{
+    return (_queue && dispatch_get_specific(kCURLMultiQueueKey) == _queue);
+}
+
 
 #pragma mark - Timer Management
 
@@ -0,0 +1,78 @@
+//
+//  CURLMultipartFormData.h
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+
+/**
+ Builds a multipart/form-data body (RFC 2388) from strings, data and files, for uploading with CURLTransfer.
+
+ Nothing is assembled in memory. Adding a file only records its URL and current length; its contents are
+ read a chunk at a time, as libcurl asks for them, by the stream from -newInputStream. Since every part's
+ length is known up front, so is the exact Content-Length of the whole body.
+
+ Files must not change length between being added and uploaded; if one does, the stream fails rather
+ than sending a body that doesn't match its Content-Length.
+ */
+
+@interface CURLMultipartFormData : NSObject <NSCopying>
+{
+  @private
+    NSString            *_boundary;
+    NSMutableArray      *_segments;     // NSData, or CURLMultipartFileSegment
+    unsigned long long  _partsLength;
+}
+
+/**
+ Uses a randomly generated boundary.
+ */
+- (id)init;
+
+@property (readonly, copy) NSString *boundary;
+
+/**
+ "multipart/form-data; boundary=…"
+ */
+@property (readonly) NSString *contentType;
+
+/**
+ The exact length of the body, including the closing boundary.
+ */
+@property (readonly) unsigned long long contentLength;
+
+/**
+ Adds a plain form field, encoded as UTF-8.
+ */
+- (void)addValue:(NSString *)value forName:(NSString *)name __attribute((nonnull(1,2)));
+
+/**
+ @param filename If not `nil`, the part is presented as a file upload.
+ @param contentType If `nil`, none is specified, which the server should take as text/plain.
+ */
+- (void)addData:(NSData *)data forName:(NSString *)name filename:(NSString *)filename contentType:(NSString *)contentType __attribute((nonnull(1,2)));
+
+/**
+ Adds a file, to be read lazily during the upload.
+
+ @param filename If `nil`, the file's own name is used.
+ @param contentType If `nil`, application/octet-stream is used.
+ @return `NO` if the file's length can't be determined.
+ */
+- (BOOL)addFileAtURL:(NSURL *)fileURL forName:(NSString *)name filename:(NSString *)filename contentType:(NSString *)contentType error:(NSError **)error __attribute((nonnull(1,2)));
+
+/**
+ @return A new, unopened stream which produces the whole body. Each stream reads independently.
+ */
+- (NSInputStream *)newInputStream;
+
+/**
+ Configures `request` to POST the form: sets the method, Content-Type, HTTPBodyStream and curl_uploadLength.
+ */
+- (void)applyToRequest:(NSMutableURLRequest *)request __attribute((nonnull(1)));
+
+@end
@@ -0,0 +1,341 @@
+//
+//  CURLMultipartFormData.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLMultipartFormData.h"
+
+#import "CURLRequest.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+#pragma mark File Segment
+
+@interface CURLMultipartFileSegment : NSObject
+{
+  @public
+    NSURL               *_fileURL;
+    unsigned long long  _length;
+}
+@end
+
+@implementation CURLMultipartFileSegment
+
+- (void)dealloc
+{
+    [_fileURL release];
+    [super dealloc];
+}
+
+@end
+
+
+#pragma mark - Stream
+
+/*  Walks the segments in order, copying from NSData segments and reading file segments with plain read(2)
+ *  into curl's buffer. Only the current file is ever open.
+ */
+@interface CURLMultipartFormDataStream : NSInputStream
+{
+  @private
+    NSArray             *_segments;
+    NSUInteger          _segmentIndex;
+    unsigned long long  _segmentOffset;
+    int                 _fileDescriptor;
+    NSStreamStatus      _status;
+    NSError             *_error;
+    id <NSStreamDelegate> _delegate;
+}
+
+- (id)initWithSegments:(NSArray *)segments;
+
+@end
+
+
+@implementation CURLMultipartFormDataStream
+
+- (id)initWithSegments:(NSArray *)segments;
+{
+    if (self = [super init])
+    {
+        _segments = [segments copy];
+        _fileDescriptor = -1;
+        _status = NSStreamStatusNotOpen;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_fileDescriptor >= 0) close(_fileDescriptor);
+    [_segments release];
+    [_error release];
+
+    [super dealloc];
+}
+
+- (void)open;
+{
+    if (_status == NSStreamStatusNotOpen) _status = NSStreamStatusOpen;
+}
+
+- (void)close;
+{
+    if (_fileDescriptor >= 0)
+    {
+        close(_fileDescriptor);
+        _fileDescriptor = -1;
+    }
+    _status = NSStreamStatusClosed;
+}
+
+- (NSStreamStatus)streamStatus; { return _status; }
+- (NSError *)streamError; { return _error; }
+
+- (id <NSStreamDelegate>)delegate; { return _delegate; }
+- (void)setDelegate:(id <NSStreamDelegate>)delegate; { _delegate = delegate; }
+
+- (void)scheduleInRunLoop:(NSRunLoop *)aRunLoop forMode:(NSString *)mode; { }
+- (void)removeFromRunLoop:(NSRunLoop *)aRunLoop forMode:(NSString *)mode; { }
+
+- (id)propertyForKey:(NSString *)key; { return nil; }
+- (BOOL)setProperty:(id)property forKey:(NSString *)key; { return NO; }
+
+- (BOOL)getBuffer:(uint8_t **)buffer length:(NSUInteger *)len; { return NO; }
+
+- (BOOL)hasBytesAvailable;
+{
+    return (_status == NSStreamStatusOpen || _status == NSStreamStatusReading);
+}
+
+- (void)failWithErrno:(int)code path:(NSString *)path;
+{
+    [_error release];
+    _error = [[NSError alloc] initWithDomain:NSPOSIXErrorDomain
+                                        code:code
+                                    userInfo:(path ? [NSDictionary dictionaryWithObject:path forKey:NSFilePathErrorKey] : nil)];
+    _status = NSStreamStatusError;
+}
+
+- (NSInteger)read:(uint8_t *)buffer maxLength:(NSUInteger)maxLength;
+{
+    if (_status == NSStreamStatusError) return -1;
+    if (_status != NSStreamStatusOpen && _status != NSStreamStatusReading) return 0;
+    _status = NSStreamStatusReading;
+
+    NSUInteger result = 0;
+    while (result < maxLength && _segmentIndex < [_segments count])
+    {
+        id segment = [_segments objectAtIndex:_segmentIndex];
+
+        if ([segment isKindOfClass:[NSData class]])
+        {
+            NSUInteger length = MIN([segment length] - (NSUInteger)_segmentOffset, maxLength - result);
+            [segment getBytes:buffer + result range:NSMakeRange((NSUInteger)_segmentOffset, length)];
+            result += length;
+            _segmentOffset += length;
+
+            if (_segmentOffset == [segment length])
+            {
+                _segmentIndex++;
+                _segmentOffset = 0;
+            }
+        }
+        else
+        {
+            CURLMultipartFileSegment *file = segment;
+
+            if (_fileDescriptor < 0)
+            {
+                _fileDescriptor = open([[file->_fileURL path] fileSystemRepresentation], O_RDONLY);
+                if (_fileDescriptor < 0)
+                {
+                    [self failWithErrno:errno path:[file->_fileURL path]];
+                    return -1;
+                }
+            }
+
+            size_t wanted = (size_t)MIN(file->_length - _segmentOffset, (unsigned long long)(maxLength - result));
+            ssize_t got = (wanted ? read(_fileDescriptor, buffer + result, wanted) : 0);
+            if (got < 0)
+            {
+                if (errno == EINTR) continue;
+                [self failWithErrno:errno path:[file->_fileURL path]];
+                return -1;
+            }
+            if (got == 0 && wanted > 0)
+            {
+                // The file has shrunk since being added, so the body can't match its Content-Length
+                [self failWithErrno:EIO path:[file->_fileURL path]];
+                return -1;
+            }
+
+            result += got;
+            _segmentOffset += got;
+
+            if (_segmentOffset == file->_length)
+            {
+                close(_fileDescriptor);
+                _fileDescriptor = -1;
+                _segmentIndex++;
+                _segmentOffset = 0;
+            }
+        }
+    }
+
+    if (_segmentIndex == [_segments count]) _status = NSStreamStatusAtEnd;
+    return result;
+}
+
+@end
+
+
+#pragma mark - Form Data
+
+@implementation CURLMultipartFormData
+
+@synthesize boundary = _boundary;
+
+- (id)init;
+{
+    if (self = [super init])
+    {
+        NSString *unique = [[[NSProcessInfo processInfo] globallyUniqueString] stringByReplacingOccurrencesOfString:@"-" withString:@""];
+        _boundary = [[@"CURLHandleFormBoundary" stringByAppendingString:unique] copy];
+        _segments = [[NSMutableArray alloc] init];
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [_boundary release];
+    [_segments release];
+
+    [super dealloc];
+}
+
+- (id)copyWithZone:(NSZone *)zone;
+{
+    CURLMultipartFormData *result = [[[self class] allocWithZone:zone] init];
+    [result->_boundary release];
+    result->_boundary = [_boundary copy];
+    [result->_segments setArray:_segments];
+    result->_partsLength = _partsLength;
+    return result;
+}
+
+- (NSString *)contentType;
+{
+    return [@"multipart/form-data; boundary=" stringByAppendingString:_boundary];
+}
+
+- (NSData *)closingBoundary;
+{
+    return [[NSString stringWithFormat:@"--%@--\r\n", _boundary] dataUsingEncoding:NSUTF8StringEncoding];
+}
+
+- (unsigned long long)contentLength;
+{
+    return _partsLength + [[self closingBoundary] length];
+}
+
+#pragma mark Adding Parts
+
+// Per the HTML spec, quotes and line breaks in names are percent-escaped; nothing else is
+static NSString *CURLFormQuotedString(NSString *string)
+{
+    string = [string stringByReplacingOccurrencesOfString:@"\"" withString:@"%22"];
+    string = [string stringByReplacingOccurrencesOfString:@"\r" withString:@"%0D"];
+    string = [string stringByReplacingOccurrencesOfString:@"\n" withString:@"%0A"];
+    return [NSString stringWithFormat:@"\"%@\"", string];
+}
+
+- (void)addPartWithName:(NSString *)name filename:(NSString *)filename contentType:(NSString *)contentType body:(id)body length:(unsigned long long)length;
+{
+    NSMutableString *header = [NSMutableString stringWithFormat:@"--%@\r\nContent-Disposition: form-data; name=%@", _boundary, CURLFormQuotedString(name)];
+    if (filename) [header appendFormat:@"; filename=%@", CURLFormQuotedString(filename)];
+    [header appendString:@"\r\n"];
+    if (contentType) [header appendFormat:@"Content-Type: %@\r\n", contentType];
+    [header appendString:@"\r\n"];
+
+    NSData *headerData = [header dataUsingEncoding:NSUTF8StringEncoding];
+    [_segments addObject:headerData];
+    if (length) [_segments addObject:body];
+
+    NSData *lineBreak = [NSData dataWithBytes:"\r\n" length:2];
+    [_segments addObject:lineBreak];
+
+    _partsLength += [headerData length] + length + [lineBreak length];
+}
+
+- (void)addValue:(NSString *)value forName:(NSString *)name;
+{
+    NSData *data = [value dataUsingEncoding:NSUTF8StringEncoding];
+    [self addPartWithName:name filename:nil contentType:nil body:data length:[data length]];
+}
+
+- (void)addData:(NSData *)data forName:(NSString *)name filename:(NSString *)filename contentType:(NSString *)contentType;
+{
+    data = [[data copy] autorelease];
+    [self addPartWithName:name filename:filename contentType:contentType body:data length:[data length]];
+}
+
+- (BOOL)addFileAtURL:(NSURL *)fileURL forName:(NSString *)name filename:(NSString *)filename contentType:(NSString *)contentType error:(NSError **)error;
+{
+    NSParameterAssert([fileURL isFileURL]);
+
+    struct stat info;
+    if (stat([[fileURL path] fileSystemRepresentation], &info) != 0)
+    {
+        if (error) *error = [NSError errorWithDomain:NSPOSIXErrorDomain
+                                                code:errno
+                                            userInfo:[NSDictionary dictionaryWithObject:[fileURL path] forKey:NSFilePathErrorKey]];
+        return NO;
+    }
+
+    CURLMultipartFileSegment *segment = [[CURLMultipartFileSegment alloc] init];
+    segment->_fileURL = [fileURL copy];
+    segment->_length = info.st_size;
+
+    [self addPartWithName:name
+                 filename:(filename ? filename : [fileURL lastPathComponent])
+              contentType:(contentType ? contentType : @"application/octet-stream")
+                     body:segment
+                   length:segment->_length];
+
+    [segment release];
+    return YES;
+}
+
+#pragma mark Uploading
+
+- (NSInputStream *)newInputStream;
+{
+    NSMutableArray *segments = [_segments mutableCopy];
+    [segments addObject:[self closingBoundary]];
+
+    NSInputStream *result = [[CURLMultipartFormDataStream alloc] initWithSegments:segments];
+    [segments release];
+    return result;
+}
+
+- (void)applyToRequest:(NSMutableURLRequest *)request;
+{
+    [request setHTTPMethod:@"POST"];
+    [request setValue:[self contentType] forHTTPHeaderField:@"Content-Type"];
+
+    NSInputStream *stream = [self newInputStream];
+    [request setHTTPBodyStream:stream];
+    [stream release];
+
+    [request curl_setUploadLength:[NSNumber numberWithUnsignedLongLong:[self contentLength]]];
+}
+
+@end
@@ -8,6 +8,8 @@
 
 #import "CURLTransfer.h"
 
+@class CURLResponseCache, CURLCachedResponse;
+
 #ifndef CURLProtocolLog
 #define CURLProtocolLog(...) // no logging by default - to enable it, add something like this to the prefix: #define CURLHandleLog NSLog
 #endif
@@ -17,6 +19,12 @@
  
  This allows you to use the Cocoa URL Loading System's APIs, but have it work
  using CURLHandle behind the scenes.
+
+ FTP requests ask the client for a credential before connecting. Once a credential has worked for a server
+ (and user, if the URL names one), later requests there use it straight away instead, until the server
+ rejects it; a request turned away with a remembered credential falls back to asking the client again.
+ Credentials with NSURLCredentialPersistenceNone aren't remembered, and any change to the shared
+ NSURLCredentialStorage forgets them all, so removing a password there takes effect.
  */
 
 @interface CURLProtocol : NSURLProtocol <CURLTransferDelegate, NSURLAuthenticationChallengeSender>
@@ -24,8 +32,35 @@
     BOOL _gotResponse;
     CURLTransfer* _transfer;
     BOOL _uploaded;
+    NSURLCredential* _credential;
+    BOOL _usedCachedCredential;
+
+    CURLCachedResponse* _staleResponse;
+    BOOL _notModified;
+    dispatch_queue_t _cacheQueue;   // file I/O for the cache happens here, so it can't hold up the multi
+    int _cacheFileDescriptor;       // only accessed on _cacheQueue
+    NSURL* _cacheFileURL;
+    NSHTTPURLResponse* _responseToCache;
 }
 
+/**
+ The cache consulted for HTTP GET requests. Default is `nil`, leaving caching up to the URL Loading System.
+
+ When set, fresh responses are served straight from the cache without touching the network. Stale ones
+ are revalidated with If-None-Match or If-Modified-Since, and new responses stored if suitable. The
+ request's cachePolicy is honoured.
+ 
+ Set it up before loading any requests.
+ */
++ (CURLResponseCache *)responseCache;
++ (void)setResponseCache:(CURLResponseCache *)cache;
+
+/**
+ Forgets every FTP credential that's worked, so the next request to each server asks the client again.
+ Call it when the user logs out, for example.
+ */
++ (void)clearFTPCredentialCache;
+
 @end
 
 
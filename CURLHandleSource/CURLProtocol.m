@@ -10,12 +10,18 @@
 #import "CURLMultiHandle.h"
 #import "CURLTransfer+MultiSupport.h"
 #import "CURLRequest.h"
+#import "CURLResponseCache.h"
+
+#include <fcntl.h>
+#include <unistd.h>
 
 @interface CURLProtocol()
 
 @property (assign, nonatomic) BOOL gotResponse;
 @property (strong, nonatomic) CURLTransfer* transfer;
 @property (assign, nonatomic) BOOL uploaded;
+@property (strong, nonatomic) CURLCachedResponse* staleResponse;
+@property (assign, nonatomic) BOOL notModified;
 
 @end
 
@@ -24,14 +30,31 @@
 @synthesize gotResponse = _gotResponse;
 @synthesize transfer = _transfer;
 @synthesize uploaded = _uploaded;
+@synthesize staleResponse = _staleResponse;
+@synthesize notModified = _notModified;
 
 #pragma mark - Object Lifecycle
 
+- (id)initWithRequest:(NSURLRequest *)request cachedResponse:(NSCachedURLResponse *)cachedResponse client:(id <NSURLProtocolClient>)client;
+{
+    if (self = [super initWithRequest:request cachedResponse:cachedResponse client:client])
+    {
+        _cacheFileDescriptor = -1;
+    }
+    return self;
+}
+
 - (void)dealloc
 {
     NSAssert((_transfer == nil) || [_transfer hasCompleted], @"transfer should be done by the time we are destroyed");
 
+    // Blocks queued for the cache retain us, so there's nothing left pending on _cacheQueue by now
+    [self closeCacheFileStoringResponse:NO];
+    if (_cacheQueue) dispatch_release(_cacheQueue);
+
     [_transfer release];
+    [_credential release];
+    [_staleResponse release];
 
     CURLProtocolLog(@"dealloced");
 
@@ -55,44 +78,85 @@
 {
     CURLProtocolLog(@"starting");
 
+    if ([self loadFromResponseCache]) return;
+
     // Request auth before trying FTP connection
-    NSURL *url = [[self request] URL];
-    NSString *scheme = [url scheme];
-    
+    NSString *scheme = [[[self request] URL] scheme];
     if ([@"ftp" caseInsensitiveCompare:scheme] == NSOrderedSame || [@"ftps" caseInsensitiveCompare:scheme] == NSOrderedSame)
     {
-        NSString *protocol = ([@"ftps" caseInsensitiveCompare:scheme] == NSOrderedSame ? @"ftps" : NSURLProtectionSpaceFTP);
-        
-        NSURLProtectionSpace *space = [[NSURLProtectionSpace alloc] initWithHost:[url host]
-                                                                            port:[[url port] integerValue]
-                                                                        protocol:protocol
-                                                                           realm:nil
-                                                            authenticationMethod:NSURLAuthenticationMethodDefault];
-        
-        NSURLCredential *credential = [[NSURLCredentialStorage sharedCredentialStorage] defaultCredentialForProtectionSpace:space];
-        
-        NSURLAuthenticationChallenge *challenge = [[NSURLAuthenticationChallenge alloc] initWithProtectionSpace:space
-                                                                                             proposedCredential:credential
-                                                                                           previousFailureCount:0
-                                                                                                failureResponse:nil
-                                                                                                          error:nil
-                                                                                                         sender:self];
-        
-        [space release];
-        
-        [[self client] URLProtocol:self didReceiveAuthenticationChallenge:challenge];
-        [challenge release];
-        
+        // Unless a credential has already worked for the server
+        NSURLCredential *credential = [self cachedFTPCredential];
+        if (credential)
+        {
+            _usedCachedCredential = YES;
+            [self startLoadingWithCredential:credential];
+        }
+        else
+        {
+            [self requestFTPCredentialWithPreviousFailureCount:0];
+        }
+
         return;
     }
     
     [self startLoadingWithCredential:nil];
 }
 
+- (void)requestFTPCredentialWithPreviousFailureCount:(NSInteger)failureCount;
+{
+    NSURL *url = [[self request] URL];
+    NSString *protocol = ([@"ftps" caseInsensitiveCompare:[url scheme]] == NSOrderedSame ? @"ftps" : NSURLProtectionSpaceFTP);
+
+    NSURLProtectionSpace *space = [[NSURLProtectionSpace alloc] initWithHost:[url host]
+                                                                        port:[[url port] integerValue]
+                                                                    protocol:protocol
+                                                                       realm:nil
+                                                        authenticationMethod:NSURLAuthenticationMethodDefault];
+
+    NSURLCredential *credential = [[NSURLCredentialStorage sharedCredentialStorage] defaultCredentialForProtectionSpace:space];
+
+    NSURLAuthenticationChallenge *challenge = [[NSURLAuthenticationChallenge alloc] initWithProtectionSpace:space
+                                                                                         proposedCredential:credential
+                                                                                       previousFailureCount:failureCount
+                                                                                            failureResponse:nil
+                                                                                                      error:nil
+                                                                                                     sender:self];
+
+    [space release];
+
+    [self messageClient:^(id <NSURLProtocolClient> client) {
+        [client URLProtocol:self didReceiveAuthenticationChallenge:challenge];
+    }];
+    [challenge release];
+}
+
 - (void)startLoadingWithCredential:(NSURLCredential *)credential;
 {
-    CURLTransfer *transfer = [[CURLTransfer alloc] initWithRequest:[self request] credential:credential delegate:self delegateQueue:nil];
+    NSURLRequest *request = [self request];
+
+    if (credential != _credential)
+    {
+        [_credential release];
+        _credential = [credential retain];
+    }
+
+    // Ask the server whether our stale copy is still good
+    CURLCachedResponse *stale = self.staleResponse;
+    if (stale)
+    {
+        NSMutableURLRequest *conditional = [[request mutableCopy] autorelease];
+        if ([stale entityTag]) [conditional setValue:[stale entityTag] forHTTPHeaderField:@"If-None-Match"];
+        if ([stale lastModified]) [conditional setValue:[stale lastModified] forHTTPHeaderField:@"If-Modified-Since"];
+        request = conditional;
+    }
+
+    // Messages come straight from the multi's queue, with body data gathered into larger chunks. There's
+    // little to do with each besides passing it on to the client, so no need for a delegate queue
+    CURLMultiHandle *multi = [CURLMultiHandle sharedInstance];
+    CURLTransfer *transfer = [[CURLTransfer alloc] initWithRequest:request credential:credential delegate:self multi:multi];
+    transfer.coalescesReceivedData = YES;
     self.transfer = transfer;
+    [multi beginTransfer:transfer];
     [transfer release];
 }
 
@@ -105,6 +169,284 @@
     // it from trying to send us delegate messages after we've been disposed
     [self.transfer cancel];
     self.transfer = nil;
+
+    [self discardCacheFile];
+}
+
+#pragma mark - Response Cache
+
+static CURLResponseCache *sResponseCache;
+
++ (CURLResponseCache *)responseCache;
+{
+    @synchronized(self)
+    {
+        return [[sResponseCache retain] autorelease];
+    }
+}
+
++ (void)setResponseCache:(CURLResponseCache *)cache;
+{
+    @synchronized(self)
+    {
+        if (cache != sResponseCache)
+        {
+            [sResponseCache release];
+            sResponseCache = [cache retain];
+        }
+    }
+}
+
+- (BOOL)canUseResponseCache;
+{
+    NSURLRequest *request = [self request];
+
+    NSString *scheme = [[request URL] scheme];
+    if ([@"http" caseInsensitiveCompare:scheme] != NSOrderedSame && [@"https" caseInsensitiveCompare:scheme] != NSOrderedSame) return NO;
+
+    NSString *method = [request HTTPMethod];
+    if (method && ![method isEqualToString:@"GET"]) return NO;
+
+    // Leave requests which are already conditional or partial to the client
+    return (![request valueForHTTPHeaderField:@"If-None-Match"] &&
+            ![request valueForHTTPHeaderField:@"If-Modified-Since"] &&
+            ![request valueForHTTPHeaderField:@"Range"]);
+}
+
+- (BOOL)requestDemandsRevalidation;
+{
+    NSURLRequest *request = [self request];
+    NSString *cacheControl = [request valueForHTTPHeaderField:@"Cache-Control"];
+    NSString *pragma = [request valueForHTTPHeaderField:@"Pragma"];
+
+    return (([cacheControl rangeOfString:@"no-cache" options:NSCaseInsensitiveSearch].location != NSNotFound) ||
+            ([cacheControl rangeOfString:@"max-age=0" options:NSCaseInsensitiveSearch].location != NSNotFound) ||
+            ([pragma rangeOfString:@"no-cache" options:NSCaseInsensitiveSearch].location != NSNotFound));
+}
+
+/*  Sends the cached response and its body to the client, but doesn't finish loading
+ */
+- (BOOL)deliverCachedResponse:(CURLCachedResponse *)cached response:(NSHTTPURLResponse *)response;
+{
+    NSData *body = [NSData dataWithContentsOfURL:[cached bodyFileURL] options:NSDataReadingMappedIfSafe error:NULL];
+    if (!body) return NO;
+
+    [self messageClient:^(id <NSURLProtocolClient> client) {
+        [client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+        if ([body length]) [client URLProtocol:self didLoadData:body];
+    }];
+    self.gotResponse = YES;
+
+    return YES;
+}
+
+/*  Returns YES if the request has been dealt with entirely from the cache. Otherwise, notes any stale entry
+ *  for revalidation
+ */
+- (BOOL)loadFromResponseCache;
+{
+    CURLResponseCache *cache = [[self class] responseCache];
+    if (!cache || ![self canUseResponseCache]) return NO;
+
+    NSURLRequest *request = [self request];
+    NSURLRequestCachePolicy policy = [request cachePolicy];
+    if (policy == NSURLRequestReloadIgnoringLocalCacheData || policy == NSURLRequestReloadIgnoringLocalAndRemoteCacheData) return NO;
+
+    CURLCachedResponse *cached = [cache cachedResponseForRequest:request];
+    BOOL acceptStale = (policy == NSURLRequestReturnCacheDataElseLoad || policy == NSURLRequestReturnCacheDataDontLoad);
+
+    if (cached && (acceptStale || ([cached isFresh] && ![self requestDemandsRevalidation])))
+    {
+        if ([self deliverCachedResponse:cached response:[cached response]])
+        {
+            CURLProtocolLog(@"served from cache");
+            [self messageClient:^(id <NSURLProtocolClient> client) {
+                [client URLProtocolDidFinishLoading:self];
+            }];
+            return YES;
+        }
+
+        // Body's gone missing
+        [cache removeCachedResponseForRequest:request];
+        cached = nil;
+    }
+
+    if (policy == NSURLRequestReturnCacheDataDontLoad)
+    {
+        [self messageClient:^(id <NSURLProtocolClient> client) {
+            [client URLProtocol:self didFailWithError:[NSError errorWithDomain:NSURLErrorDomain
+                                                                          code:NSURLErrorResourceUnavailable
+                                                                      userInfo:nil]];
+        }];
+        return YES;
+    }
+
+    if (cached && ([cached entityTag] || [cached lastModified])) self.staleResponse = cached;
+    return NO;
+}
+
+/*  The body is written out on _cacheQueue, since the multi's queue is shared by every transfer and
+ *  mustn't wait on the disk
+ */
+- (void)beginCachingResponse:(NSURLResponse *)response;
+{
+    CURLResponseCache *cache = [[self class] responseCache];
+    if (![cache shouldStoreResponse:response forRequest:[self request]]) return;
+
+    if (!_cacheQueue)
+    {
+        NSString *name = [NSString stringWithFormat:@"com.karelia.CURLProtocol.cache.%p", self];
+        _cacheQueue = dispatch_queue_create([name UTF8String], NULL);
+    }
+
+    NSURL *url = [cache temporaryBodyFileURL];
+    dispatch_async(_cacheQueue, ^{
+
+        int fd = open([[url path] fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return;
+
+        _cacheFileDescriptor = fd;
+        _cacheFileURL = [url copy];
+        _responseToCache = [(NSHTTPURLResponse *)response retain];
+    });
+}
+
+- (void)cacheData:(NSData *)data;
+{
+    if (!_cacheQueue) return;
+
+    dispatch_async(_cacheQueue, ^{
+
+        if (_cacheFileDescriptor < 0) return;
+
+        const char *bytes = [data bytes];
+        size_t length = [data length];
+        while (length > 0)
+        {
+            ssize_t written = write(_cacheFileDescriptor, bytes, length);
+            if (written < 0)
+            {
+                if (errno == EINTR) continue;
+
+                // Not worth failing the load over
+                [self closeCacheFileStoringResponse:NO];
+                return;
+            }
+            bytes += written;
+            length -= written;
+        }
+    });
+}
+
+/*  The handler is called once the response is in the cache, so a client finding out the load has finished can
+ *  count on it being there. It may be called on _cacheQueue
+ */
+- (void)finishCachingWithCompletionHandler:(void (^)(void))handler;
+{
+    if (!_cacheQueue)
+    {
+        handler();
+        return;
+    }
+
+    dispatch_async(_cacheQueue, ^{
+        [self closeCacheFileStoringResponse:YES];
+        handler();
+    });
+}
+
+- (void)discardCacheFile;
+{
+    if (!_cacheQueue) return;
+    dispatch_async(_cacheQueue, ^{ [self closeCacheFileStoringResponse:NO]; });
+}
+
+/*  Called on _cacheQueue
+ */
+- (void)closeCacheFileStoringResponse:(BOOL)store;
+{
+    if (_cacheFileDescriptor < 0) return;
+
+    BOOL closed = (close(_cacheFileDescriptor) == 0);
+    _cacheFileDescriptor = -1;
+
+    if (closed && store)
+    {
+        [[[self class] responseCache] storeResponse:_responseToCache bodyFileURL:_cacheFileURL forRequest:[self request]];
+    }
+    else
+    {
+        [[NSFileManager defaultManager] removeItemAtURL:_cacheFileURL error:NULL];
+    }
+
+    [_cacheFileURL release]; _cacheFileURL = nil;
+    [_responseToCache release]; _responseToCache = nil;
+}
+
+#pragma mark - FTP Credentials
+
+static NSMutableDictionary *sFTPCredentials;
+
++ (void)clearFTPCredentialCache;
+{
+    @synchronized([CURLProtocol class])
+    {
+        [sFTPCredentials removeAllObjects];
+    }
+}
+
+/*  Protection spaces for FTP are just the server, but a URL naming a user wants that user's credential
+ */
+- (NSString *)FTPCredentialKey;
+{
+    NSURL *url = [[self request] URL];
+    NSString *user = [url user];
+    return (user ? [NSString stringWithFormat:@"%@ %@", [url curl_originString], user] : [url curl_originString]);
+}
+
+- (NSURLCredential *)cachedFTPCredential;
+{
+    NSString *key = [self FTPCredentialKey];
+
+    @synchronized([CURLProtocol class])
+    {
+        return [[[sFTPCredentials objectForKey:key] retain] autorelease];
+    }
+}
+
+- (void)cacheFTPCredential:(NSURLCredential *)credential;
+{
+    if ([credential persistence] == NSURLCredentialPersistenceNone) return;
+
+    NSString *key = [self FTPCredentialKey];
+
+    @synchronized([CURLProtocol class])
+    {
+        if (!sFTPCredentials)
+        {
+            sFTPCredentials = [[NSMutableDictionary alloc] init];
+
+            // Whatever changed, a remembered credential may no longer be what the user wants
+            [[NSNotificationCenter defaultCenter] addObserverForName:NSURLCredentialStorageChangedNotification
+                                                              object:nil
+                                                               queue:nil
+                                                          usingBlock:^(NSNotification *note) {
+                                                              [CURLProtocol clearFTPCredentialCache];
+                                                          }];
+        }
+        [sFTPCredentials setObject:credential forKey:key];
+    }
+}
+
+- (void)forgetFTPCredential:(NSURLCredential *)credential;
+{
+    NSString *key = [self FTPCredentialKey];
+
+    @synchronized([CURLProtocol class])
+    {
+        // Another request may have found a better one meanwhile
+        if ([sFTPCredentials objectForKey:key] == credential) [sFTPCredentials removeObjectForKey:key];
+    }
 }
 
 #pragma mark - Utilities
@@ -114,38 +456,120 @@
     return [NSString stringWithFormat:@"<CURLProtocol %p %@>", self, self.request.URL];
 }
 
+/*  Every message to the client goes out from the multi's queue, so none can overtake another, whichever queue
+ *  it came about on. Called from anywhere else, the block is run there asynchronously
+ */
+- (void)messageClient:(void (^)(id <NSURLProtocolClient> client))block;
+{
+    CURLMultiHandle *multi = [CURLMultiHandle sharedInstance];
+    if ([multi isCurrentQueue])
+    {
+        block([self client]);
+    }
+    else
+    {
+        dispatch_async([multi queue], ^{
+            block([self client]);
+        });
+    }
+}
+
 #pragma mark - CURLTransferDelegate
 
 - (void)transfer:(CURLTransfer *)transfer didReceiveResponse:(NSURLResponse *)response;
 {
     if (!self.gotResponse)
     {
-        id <NSURLProtocolClient> client = [self client];
-        CURLProtocolLog(@"got didReceiveResponse %ld from %@ for %@", (long)[(NSHTTPURLResponse*)response statusCode], transfer, client);
-        [client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageAllowed];
+        CURLProtocolLog(@"got didReceiveResponse %ld from %@ for %@", (long)[(NSHTTPURLResponse*)response statusCode], transfer, [self client]);
+
+        CURLCachedResponse *stale = self.staleResponse;
+        if (stale && [response isKindOfClass:[NSHTTPURLResponse class]] && [(NSHTTPURLResponse *)response statusCode] == 304)
+        {
+            // Our copy is still good; the transfer itself carries nothing more of interest
+            self.notModified = YES;
+
+            NSHTTPURLResponse *updated = [[[self class] responseCache] updateCachedResponse:stale withNotModifiedResponse:(NSHTTPURLResponse *)response];
+            if (![self deliverCachedResponse:stale response:updated])
+            {
+                // Body's gone missing. Fail once the transfer's done
+                [[[self class] responseCache] removeCachedResponseForRequest:[self request]];
+            }
+            return;
+        }
+
+        // When we're doing the caching, the URL Loading System shouldn't as well
+        CURLResponseCache *cache = [[self class] responseCache];
+        if (cache && [self canUseResponseCache]) [self beginCachingResponse:response];
+
+        [self messageClient:^(id <NSURLProtocolClient> client) {
+            [client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:(cache ? NSURLCacheStorageNotAllowed : NSURLCacheStorageAllowed)];
+        }];
         self.gotResponse = YES;
     }
 }
 
 - (void)transfer:(CURLTransfer *)transfer didReceiveData:(NSData *)data;
 {
-    id <NSURLProtocolClient> client = [self client];
-    CURLProtocolLog(@"got didReceiveData from %@ for %@", transfer, client);
-    [client URLProtocol:self didLoadData:data];
+    if (self.notModified) return;
+    [self cacheData:data];
+
+    CURLProtocolLog(@"got didReceiveData from %@ for %@", transfer, [self client]);
+    [self messageClient:^(id <NSURLProtocolClient> client) {
+        [client URLProtocol:self didLoadData:data];
+    }];
 }
 
 - (void)transfer:(CURLTransfer*)transfer didCompleteWithError:(NSError *)error
 {
-    id <NSURLProtocolClient> client = [self client];
+    if (_credential)
+    {
+        if ([error code] == NSURLErrorUserAuthenticationRequired && [[error domain] isEqualToString:NSURLErrorDomain])
+        {
+            [self forgetFTPCredential:_credential];
+
+            // The server's stopped accepting what worked before, so see what the client wants to do now
+            if (_usedCachedCredential && !self.gotResponse)
+            {
+                _usedCachedCredential = NO;
+                self.transfer = nil;
+
+                // Ask once the transfer's done winding up; the client answers asynchronously, through the
+                // NSURLAuthenticationChallengeSender methods
+                dispatch_async([[CURLMultiHandle sharedInstance] queue], ^{
+                    [self requestFTPCredentialWithPreviousFailureCount:1];
+                });
+                return;
+            }
+        }
+        else if (!error)
+        {
+            [self cacheFTPCredential:_credential];
+        }
+    }
+
+    if (self.notModified && !self.gotResponse && !error)
+    {
+        error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorResourceUnavailable userInfo:nil];
+    }
+
     if (error)
     {
-        CURLProtocolLog(@"got didFailWithError %@ from %@ for %@", error, transfer, client);
-        [client URLProtocol:self didFailWithError:error];
+        [self discardCacheFile];
+
+        CURLProtocolLog(@"got didFailWithError %@ from %@ for %@", error, transfer, [self client]);
+        [self messageClient:^(id <NSURLProtocolClient> client) {
+            [client URLProtocol:self didFailWithError:error];
+        }];
     }
     else
     {
-        CURLProtocolLog(@"got didFinish from %@ for %@", transfer, client);
-        [client URLProtocolDidFinishLoading:self];
+        // Caching finishes on _cacheQueue; -messageClient: brings the news back to the multi's
+        [self finishCachingWithCompletionHandler:^{
+            CURLProtocolLog(@"got didFinish from %@ for %@", transfer, [self client]);
+            [self messageClient:^(id <NSURLProtocolClient> client) {
+                [client URLProtocolDidFinishLoading:self];
+            }];
+        }];
     }
 }
 
@@ -177,9 +601,11 @@
 
 - (void)cancelAuthenticationChallenge:(NSURLAuthenticationChallenge *)challenge;
 {
-    [[self client] URLProtocol:self didFailWithError:[NSError errorWithDomain:NSURLErrorDomain
-                                                                         code:NSURLErrorUserAuthenticationRequired
-                                                                     userInfo:nil]];
+    [self messageClient:^(id <NSURLProtocolClient> client) {
+        [client URLProtocol:self didFailWithError:[NSError errorWithDomain:NSURLErrorDomain
+                                                                      code:NSURLErrorUserAuthenticationRequired
+                                                                  userInfo:nil]];
+    }];
 }
 
 @end
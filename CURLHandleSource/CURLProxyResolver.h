@@ -0,0 +1,64 @@
+//
+//  CURLProxyResolver.h
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+
+/**
+ Decides which proxy, if any, a request should go through.
+
+ Proxy settings are parsed once into a compiled form: per-scheme proxy strings, a set of excluded
+ domains, and a list of excluded address ranges. Lookups then cost a few hash probes, and the decision
+ for each host is cached on top of that. The settings are only re-read when they change.
+
+ Only http and https requests are proxied at present. FTP proxying was disabled long ago as it seemed
+ to be messing up for at least one Karelia customer.
+ */
+
+@interface CURLProxyResolver : NSObject
+{
+  @private
+    id                  _matcher;
+    NSMutableDictionary *_decisions;
+}
+
+/**
+ The resolver CURLTransfer consults for each request.
+
+ By default on OS X this follows the System Configuration proxy settings; elsewhere it follows the
+ environment.
+ */
++ (CURLProxyResolver *)sharedResolver;
++ (void)setSharedResolver:(CURLProxyResolver *)resolver;
+
+/**
+ A resolver that follows the `http_proxy`, `https_proxy` and `no_proxy` environment variables, and the
+ uppercase `HTTPS_PROXY` and `NO_PROXY`. Like curl, it ignores `HTTP_PROXY`, which CGI programs can find set
+ from a request's `Proxy:` header.
+
+ `no_proxy` is a comma separated list. Entries may be `*`, domain names (which match themselves and
+ any subdomains, with or without a leading `.` or `*.`), IP addresses, or CIDR ranges such as
+ `10.0.0.0/8` or `fe80::/10`. A range whose prefix length isn't a plain decimal number that fits the
+ address family is ignored.
+ */
++ (CURLProxyResolver *)environmentResolver;
+
+#if defined(__APPLE__)
+/**
+ A resolver that follows the System Configuration proxy settings, including the exceptions list.
+ */
++ (CURLProxyResolver *)systemResolver;
+#endif
+
+/**
+ @param url The URL about to be loaded.
+ @return The proxy to hand to CURLOPT_PROXY, or `nil` to connect directly.
+ */
+- (NSString *)proxyForURL:(NSURL *)url;
+
+@end
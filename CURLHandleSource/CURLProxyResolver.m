@@ -0,0 +1,580 @@
+//
+//  CURLProxyResolver.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLProxyResolver.h"
+
+#include <arpa/inet.h>
+
+#if defined(__APPLE__)
+#include <libkern/OSAtomic.h>
+#include <SystemConfiguration/SystemConfiguration.h>
+#endif
+
+
+#define MAX_CACHED_DECISIONS 1024   // per-host decisions are simply thrown away once there are this many
+
+
+#pragma mark - Compiled Settings
+
+typedef struct
+{
+    int             family;         // AF_INET or AF_INET6
+    unsigned char   address[16];
+    unsigned int    prefixLength;
+} CURLAddressRange;
+
+/*  An immutable, parsed form of one set of proxy settings. Resolvers build a new one whenever
+ *  the underlying settings change.
+ */
+@interface CURLProxyMatcher : NSObject
+{
+  @public
+    NSString        *_HTTPProxy;
+    NSString        *_HTTPSProxy;
+
+  @private
+    BOOL            _excludesAllHosts;
+    BOOL            _excludesSimpleHostnames;
+    NSMutableSet    *_excludedDomains;
+    NSMutableData   *_excludedRanges;
+}
+
+- (id)initWithHTTPProxy:(NSString *)http HTTPSProxy:(NSString *)https;
+- (void)addException:(NSString *)exception;
+- (void)addExceptionsFromList:(NSString *)list;     // comma separated
+- (void)setExcludesSimpleHostnames:(BOOL)exclude;
+
+- (BOOL)excludesHost:(NSString *)host;              // host must be lowercase
+
+@end
+
+
+#pragma mark - Subclass Hooks
+
+@interface CURLProxyResolver ()
+
+// Subclasses must override to read the current settings. Returns a retained object
+- (CURLProxyMatcher *)newMatcher;
+
+// Called before every lookup, so must be cheap. Returning YES causes -newMatcher to be called again
+- (BOOL)configurationHasChanged;
+
+@end
+
+
+@interface CURLEnvironmentProxyResolver : CURLProxyResolver
+{
+  @private
+    char    *_values[5];    // the raw variables as last read, to spot changes
+}
+@end
+
+
+#if defined(__APPLE__)
+@interface CURLSystemProxyResolver : CURLProxyResolver
+{
+  @private
+    SCDynamicStoreRef   _store;
+    dispatch_queue_t    _queue;
+    volatile int32_t    _changed;
+}
+@end
+#endif
+
+
+#pragma mark -
+
+
+@implementation CURLProxyResolver
+
+static CURLProxyResolver *sSharedResolver = nil;
+
++ (CURLProxyResolver *)sharedResolver;
+{
+    @synchronized([CURLProxyResolver class])
+    {
+        if (!sSharedResolver)
+        {
+#if defined(__APPLE__)
+            sSharedResolver = [[self systemResolver] retain];
+#else
+            sSharedResolver = [[self environmentResolver] retain];
+#endif
+        }
+
+        return [[sSharedResolver retain] autorelease];
+    }
+}
+
++ (void)setSharedResolver:(CURLProxyResolver *)resolver;
+{
+    @synchronized([CURLProxyResolver class])
+    {
+        [resolver retain];
+        [sSharedResolver release];
+        sSharedResolver = resolver;
+    }
+}
+
++ (CURLProxyResolver *)environmentResolver;
+{
+    return [[[CURLEnvironmentProxyResolver alloc] init] autorelease];
+}
+
+#if defined(__APPLE__)
++ (CURLProxyResolver *)systemResolver;
+{
+    return [[[CURLSystemProxyResolver alloc] init] autorelease];
+}
+#endif
+
+- (id)init
+{
+    if (self = [super init])
+    {
+        _decisions = [[NSMutableDictionary alloc] init];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_matcher release];
+    [_decisions release];
+
+    [super dealloc];
+}
+
+- (CURLProxyMatcher *)newMatcher;
+{
+    return [[CURLProxyMatcher alloc] initWithHTTPProxy:nil HTTPSProxy:nil];
+}
+
+- (BOOL)configurationHasChanged; { return NO; }
+
+- (NSString *)proxyForURL:(NSURL *)url;
+{
+    NSString *scheme = [url scheme];
+    BOOL secure;
+    if ([scheme caseInsensitiveCompare:@"http"] == NSOrderedSame)
+    {
+        secure = NO;
+    }
+    else if ([scheme caseInsensitiveCompare:@"https"] == NSOrderedSame)
+    {
+        secure = YES;
+    }
+    else
+    {
+        return nil;
+    }
+
+    NSString *host = [url host];
+    if (!host) return nil;
+
+    @synchronized(self)
+    {
+        if (!_matcher || [self configurationHasChanged])
+        {
+            [_matcher release];
+            _matcher = [self newMatcher];
+            [_decisions removeAllObjects];
+        }
+
+        CURLProxyMatcher *matcher = _matcher;
+        NSString *proxy = (secure ? matcher->_HTTPSProxy : matcher->_HTTPProxy);
+        if (!proxy) return nil;
+
+        NSNumber *excluded = [_decisions objectForKey:host];
+        if (!excluded)
+        {
+            excluded = [NSNumber numberWithBool:[matcher excludesHost:[host lowercaseString]]];
+
+            if ([_decisions count] >= MAX_CACHED_DECISIONS) [_decisions removeAllObjects];
+            [_decisions setObject:excluded forKey:host];
+        }
+
+        return ([excluded boolValue] ? nil : [[proxy retain] autorelease]);
+    }
+}
+
+@end
+
+
+#pragma mark -
+
+
+@implementation CURLProxyMatcher
+
+- (id)initWithHTTPProxy:(NSString *)http HTTPSProxy:(NSString *)https;
+{
+    if (self = [self init])
+    {
+        _HTTPProxy = [http copy];
+        _HTTPSProxy = [https copy];
+        _excludedDomains = [[NSMutableSet alloc] init];
+        _excludedRanges = [[NSMutableData alloc] init];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_HTTPProxy release];
+    [_HTTPSProxy release];
+    [_excludedDomains release];
+    [_excludedRanges release];
+
+    [super dealloc];
+}
+
+- (void)setExcludesSimpleHostnames:(BOOL)exclude; { _excludesSimpleHostnames = exclude; }
+
+/*  Parses an IPv4 or IPv6 address, tolerating brackets, and the abbreviated IPv4 forms (e.g. 169.254)
+ *  that System Configuration uses for ranges.
+ */
+static BOOL CURLParseAddress(NSString *string, CURLAddressRange *range)
+{
+    if ([string hasPrefix:@"["] && [string hasSuffix:@"]"])
+    {
+        string = [string substringWithRange:NSMakeRange(1, [string length] - 2)];
+    }
+
+    const char *chars = [string UTF8String];
+    if (!chars) return NO;
+
+    if (inet_pton(AF_INET6, chars, range->address) == 1)
+    {
+        range->family = AF_INET6;
+        range->prefixLength = 128;
+        return YES;
+    }
+
+    NSArray *octets = [string componentsSeparatedByString:@"."];
+    if ([octets count] < 1 || [octets count] > 4) return NO;
+    if ([string rangeOfCharacterFromSet:[[NSCharacterSet characterSetWithCharactersInString:@"0123456789."] invertedSet]].location != NSNotFound) return NO;
+
+    while ([octets count] < 4)
+    {
+        octets = [octets arrayByAddingObject:@"0"];
+    }
+
+    if (inet_pton(AF_INET, [[octets componentsJoinedByString:@"."] UTF8String], range->address) == 1)
+    {
+        range->family = AF_INET;
+        range->prefixLength = 32;
+        return YES;
+    }
+
+    return NO;
+}
+
+static BOOL CURLRangeContainsAddress(const CURLAddressRange *range, int family, const unsigned char *address)
+{
+    if (range->family != family) return NO;
+
+    unsigned int wholeBytes = range->prefixLength / 8;
+    if (memcmp(range->address, address, wholeBytes) != 0) return NO;
+
+    unsigned int remainingBits = range->prefixLength % 8;
+    if (remainingBits)
+    {
+        unsigned char mask = (unsigned char)(0xFF << (8 - remainingBits));
+        if ((range->address[wholeBytes] & mask) != (address[wholeBytes] & mask)) return NO;
+    }
+
+    return YES;
+}
+
+- (void)addException:(NSString *)exception;
+{
+    exception = [[exception stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]] lowercaseString];
+    if (![exception length]) return;
+
+    if ([exception isEqualToString:@"*"])
+    {
+        _excludesAllHosts = YES;
+        return;
+    }
+
+    if ([exception isEqualToString:@"<local>"])
+    {
+        _excludesSimpleHostnames = YES;
+        return;
+    }
+
+
+    // Addresses and ranges
+    CURLAddressRange range;
+    NSRange slash = [exception rangeOfString:@"/"];
+    NSString *address = (slash.location == NSNotFound ? exception : [exception substringToIndex:slash.location]);
+
+    if (CURLParseAddress(address, &range))
+    {
+        if (slash.location != NSNotFound)
+        {
+            // Anything but plain decimal digits is ignored, rather than read as /0 and so matching everything
+            NSString *mask = [exception substringFromIndex:NSMaxRange(slash)];
+            if (![mask length] || [mask length] > 3) return;
+            if ([mask rangeOfCharacterFromSet:[[NSCharacterSet decimalDigitCharacterSet] invertedSet]].location != NSNotFound) return;
+
+            NSInteger prefix = [mask integerValue];
+            if (prefix > range.prefixLength) return;
+            range.prefixLength = (unsigned int)prefix;
+        }
+
+        [_excludedRanges appendBytes:&range length:sizeof(range)];
+        return;
+    }
+
+
+    // Domains. "example.com", ".example.com" and "*.example.com" all mean the same thing
+    if ([exception hasPrefix:@"*."])
+    {
+        exception = [exception substringFromIndex:2];
+    }
+    else if ([exception hasPrefix:@"."])
+    {
+        exception = [exception substringFromIndex:1];
+    }
+
+    NSRange colon = [exception rangeOfString:@":"];
+    if (colon.location != NSNotFound) exception = [exception substringToIndex:colon.location];   // ports aren't considered
+
+    if ([exception length]) [_excludedDomains addObject:exception];
+}
+
+- (void)addExceptionsFromList:(NSString *)list;
+{
+    for (NSString *anException in [list componentsSeparatedByString:@","])
+    {
+        [self addException:anException];
+    }
+}
+
+- (BOOL)excludesHost:(NSString *)host;
+{
+    if (_excludesAllHosts) return YES;
+
+    // IP literals are only checked against the ranges. NSURL leaves IPv6 hosts without their brackets
+    CURLAddressRange address;
+    const char *chars = [host UTF8String];
+    if (inet_pton(AF_INET, chars, address.address) == 1)
+    {
+        address.family = AF_INET;
+    }
+    else if (inet_pton(AF_INET6, chars, address.address) == 1)
+    {
+        address.family = AF_INET6;
+    }
+    else
+    {
+        address.family = AF_UNSPEC;
+    }
+
+    if (address.family != AF_UNSPEC)
+    {
+        const CURLAddressRange *ranges = [_excludedRanges bytes];
+        NSUInteger count = [_excludedRanges length] / sizeof(CURLAddressRange);
+        for (NSUInteger i = 0; i < count; i++)
+        {
+            if (CURLRangeContainsAddress(&ranges[i], address.family, address.address)) return YES;
+        }
+
+        return NO;
+    }
+
+    NSRange dot = [host rangeOfString:@"."];
+    if (dot.location == NSNotFound && _excludesSimpleHostnames) return YES;
+
+    // Try the host, and then each parent domain in turn
+    NSString *domain = host;
+    while (domain)
+    {
+        if ([_excludedDomains containsObject:domain]) return YES;
+
+        dot = [domain rangeOfString:@"."];
+        domain = (dot.location == NSNotFound ? nil : [domain substringFromIndex:NSMaxRange(dot)]);
+    }
+
+    return NO;
+}
+
+@end
+
+
+#pragma mark -
+
+
+@implementation CURLEnvironmentProxyResolver
+
+// There's deliberately no HTTP_PROXY. CGI puts a request's Proxy: header in it, letting whoever made the request
+// choose the proxy (the "httpoxy" problem), so curl ignores it too
+static const char *const kEnvironmentNames[] =
+{
+    "http_proxy",
+    "https_proxy",
+    "HTTPS_PROXY",
+    "no_proxy",
+    "NO_PROXY",
+};
+
+#define ENVIRONMENT_COUNT (sizeof(kEnvironmentNames) / sizeof(kEnvironmentNames[0]))
+
+- (void)dealloc
+{
+    for (NSUInteger i = 0; i < ENVIRONMENT_COUNT; i++)
+    {
+        free(_values[i]);
+    }
+
+    [super dealloc];
+}
+
+- (BOOL)configurationHasChanged;
+{
+    for (NSUInteger i = 0; i < ENVIRONMENT_COUNT; i++)
+    {
+        const char *value = getenv(kEnvironmentNames[i]);
+        if ((value == NULL) != (_values[i] == NULL)) return YES;
+        if (value && strcmp(value, _values[i]) != 0) return YES;
+    }
+
+    return NO;
+}
+
+- (NSString *)variableAtIndex:(NSUInteger)index uppercaseIndex:(NSUInteger)uppercaseIndex;
+{
+    // Lowercase takes precedence, as it does for curl itself
+    const char *value = _values[index];
+    if ((!value || !*value) && uppercaseIndex != NSNotFound) value = _values[uppercaseIndex];
+
+    return ((value && *value) ? [NSString stringWithUTF8String:value] : nil);
+}
+
+- (CURLProxyMatcher *)newMatcher;
+{
+    for (NSUInteger i = 0; i < ENVIRONMENT_COUNT; i++)
+    {
+        free(_values[i]);
+        const char *value = getenv(kEnvironmentNames[i]);
+        _values[i] = (value ? strdup(value) : NULL);
+    }
+
+    CURLProxyMatcher *result = [[CURLProxyMatcher alloc] initWithHTTPProxy:[self variableAtIndex:0 uppercaseIndex:NSNotFound]
+                                                                HTTPSProxy:[self variableAtIndex:1 uppercaseIndex:2]];
+    [result addExceptionsFromList:[self variableAtIndex:3 uppercaseIndex:4]];
+
+    return result;
+}
+
+@end
+
+
+#pragma mark -
+
+
+#if defined(__APPLE__)
+
+@implementation CURLSystemProxyResolver
+
+static void CURLSystemProxiesChanged(SCDynamicStoreRef store, CFArrayRef changedKeys, void *info)
+{
+    CURLSystemProxyResolver *resolver = info;
+    OSAtomicCompareAndSwap32Barrier(0, 1, &resolver->_changed);
+}
+
+- (id)init
+{
+    if (self = [super init])
+    {
+        SCDynamicStoreContext context = { 0, self, NULL, NULL, NULL };
+        _store = SCDynamicStoreCreate(NULL, CFSTR("CURLHandle"), CURLSystemProxiesChanged, &context);
+        if (!_store)
+        {
+            NSLog(@"Didn't get SCDynamicStoreRef");
+        }
+        else
+        {
+            // Watch for changes, rather than asking for the settings afresh for every request
+            CFStringRef key = SCDynamicStoreKeyCreateProxies(NULL);
+            CFArrayRef keys = CFArrayCreate(NULL, (const void **)&key, 1, &kCFTypeArrayCallBacks);
+
+            _queue = dispatch_queue_create("com.karelia.CURLProxyResolver", NULL);
+            if (!SCDynamicStoreSetNotificationKeys(_store, keys, NULL) || !SCDynamicStoreSetDispatchQueue(_store, _queue))
+            {
+                // Can't spot changes, so read them every time, as CURLTransfer used to
+                _changed = -1;
+            }
+
+            CFRelease(keys);
+            CFRelease(key);
+        }
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_store)
+    {
+        SCDynamicStoreSetDispatchQueue(_store, NULL);
+        CFRelease(_store);
+    }
+    if (_queue) dispatch_release(_queue);
+
+    [super dealloc];
+}
+
+- (BOOL)configurationHasChanged;
+{
+    if (_changed < 0) return YES;
+    return OSAtomicCompareAndSwap32Barrier(1, 0, &_changed);
+}
+
+static NSString *CURLProxyString(NSDictionary *proxies, CFStringRef enableKey, CFStringRef hostKey, CFStringRef portKey)
+{
+    if (![[proxies objectForKey:(NSString *)enableKey] boolValue]) return nil;
+
+    NSString *host = [proxies objectForKey:(NSString *)hostKey];
+    NSNumber *port = [proxies objectForKey:(NSString *)portKey];
+    if (!host || !port) return nil;
+
+    // An IPv6 literal needs brackets, or its last group would be read as the port
+    if ([host rangeOfString:@":"].location != NSNotFound && ![host hasPrefix:@"["])
+    {
+        return [NSString stringWithFormat:@"[%@]:%@", host, port];
+    }
+
+    return [NSString stringWithFormat:@"%@:%@", host, port];
+}
+
+- (CURLProxyMatcher *)newMatcher;
+{
+    NSDictionary *proxies = (NSDictionary *)(_store ? SCDynamicStoreCopyProxies(_store) : NULL);
+
+    CURLProxyMatcher *result = [[CURLProxyMatcher alloc] initWithHTTPProxy:CURLProxyString(proxies, kSCPropNetProxiesHTTPEnable, kSCPropNetProxiesHTTPProxy, kSCPropNetProxiesHTTPPort)
+                                                                HTTPSProxy:CURLProxyString(proxies, kSCPropNetProxiesHTTPSEnable, kSCPropNetProxiesHTTPSProxy, kSCPropNetProxiesHTTPSPort)];
+
+    for (NSString *anException in [proxies objectForKey:(NSString *)kSCPropNetProxiesExceptionsList])
+    {
+        [result addException:anException];
+    }
+
+    [result setExcludesSimpleHostnames:[[proxies objectForKey:(NSString *)kSCPropNetProxiesExcludeSimpleHostnames] boolValue]];
+
+    [proxies release];
+    return result;
+}
+
+@end
+
+#endif
@@ -8,6 +8,31 @@
 #import <Foundation/Foundation.h>
 #import <curl/curl.h>
 
+@class CURLSocketOptions;
+
+
+/**
+ When an HTTP upload should send "Expect: 100-continue" and wait for the server's go-ahead before the body.
+ */
+typedef NS_ENUM(NSInteger, CURLExpectContinuePolicy) {
+    CURLExpectContinuePolicyDefault = 0,    // for a request, defer to the multi; for a multi, leave it to libcurl (PUTs, and POSTs over 1KB)
+    CURLExpectContinuePolicyNever,
+    CURLExpectContinuePolicyAlways,
+    CURLExpectContinuePolicyThreshold,      // bodies of at least the threshold, or of unknown length
+    CURLExpectContinuePolicyAdaptive,       // as for threshold, except to servers which have been seen to ignore it
+};
+
+/**
+ Which IP versions a transfer may connect over.
+ */
+typedef NS_ENUM(NSInteger, CURLAddressFamilyPreference) {
+    CURLAddressFamilyPreferenceDefault = 0,     // for a request, defer to the multi; for a multi, the same as any
+    CURLAddressFamilyPreferenceAny,             // libcurl races IPv6 against IPv4 ("happy eyeballs")
+    CURLAddressFamilyPreferenceIPv4,            // CURL_IPRESOLVE_V4 only
+    CURLAddressFamilyPreferenceIPv6,            // CURL_IPRESOLVE_V6 only
+    CURLAddressFamilyPreferenceRemembered,      // as for any, until a connection succeeds; then straight to whichever family worked for that server
+};
+
 @interface NSURLRequest (CURLOptionsFTP)
 
 // CURLUSESSL_NONE, CURLUSESSL_TRY, CURLUSESSL_CONTROL, or CURLUSESSL_ALL
@@ -38,6 +63,40 @@
  */
 @property(nonatomic, readonly) NSURL *curl_SSHKnownHostsFileURL;
 
+// Asks libcurl to find out the remote file's modification date (CURLOPT_FILETIME), which is then reported
+// by CURLTransferMetrics. Costs an extra MDTM command for FTP. Default is NO
+@property(nonatomic, readonly) BOOL curl_wantsRemoteModificationDate;
+
+// How much data -HTTPBodyStream will supply, if known ahead of time. Passed on to libcurl so it can send an
+// exact Content-Length. Default is nil, for unknown. Ignored when using -HTTPBody
+@property(nonatomic, readonly) NSNumber *curl_uploadLength;
+
+// Overrides the multi's expectContinuePolicy and expectContinueThreshold for this request. A threshold of 0 means
+// use the multi's
+@property(nonatomic, readonly) CURLExpectContinuePolicy curl_expectContinuePolicy;
+@property(nonatomic, readonly) unsigned long long curl_expectContinueThreshold;
+
+// TCP tuning for this request's connections, in place of the multi's socketOptions. Default is nil, for the multi's.
+// Connections reused from an earlier transfer keep whatever they were created with
+@property(nonatomic, readonly) CURLSocketOptions *curl_socketOptions;
+
+// Override the multi's addressFamilyPreference and happyEyeballsDelay for this request. A delay of 0 means use
+// the multi's
+@property(nonatomic, readonly) CURLAddressFamilyPreference curl_addressFamilyPreference;
+@property(nonatomic, readonly) NSTimeInterval curl_happyEyeballsDelay;
+
+// Override the multi's DNSServers and resolveTimeout for this request. Default is nil and 0, for the multi's.
+// Lookups are still cached by the multi, whichever servers answered them
+@property(nonatomic, readonly) NSArray *curl_DNSServers;
+@property(nonatomic, readonly) NSTimeInterval curl_resolveTimeout;
+
+// libcurl's buffer sizes in bytes (CURLOPT_BUFFERSIZE and CURLOPT_UPLOAD_BUFFERSIZE). For SFTP these decide how
+// many requests libssh2 keeps in flight, so larger buffers are what lift throughput over long round trips; pair
+// them with CURLSocketOptions sized for the link. Default is 0, for libcurl's own 16KB. Before libcurl 7.53.0 the
+// receive buffer can't exceed 16KB, and the upload buffer needs 7.62.0
+@property(nonatomic, readonly) NSUInteger curl_receiveBufferSize;
+@property(nonatomic, readonly) NSUInteger curl_uploadBufferSize;
+
 @end
 
 @interface NSMutableURLRequest (CURLOptionsFTP)
@@ -55,9 +114,34 @@
 
 - (void)curl_setSSHKnownHostsFileURL:(NSURL *)url;
 
-@end
+- (void)curl_setWantsRemoteModificationDate:(BOOL)wants;
+
+- (void)curl_setUploadLength:(NSNumber *)length;
+
+- (void)curl_setExpectContinuePolicy:(CURLExpectContinuePolicy)policy;
+- (void)curl_setExpectContinueThreshold:(unsigned long long)threshold;
 
+- (void)curl_setSocketOptions:(CURLSocketOptions *)options;
 
+- (void)curl_setAddressFamilyPreference:(CURLAddressFamilyPreference)preference;
+- (void)curl_setHappyEyeballsDelay:(NSTimeInterval)delay;
 
+- (void)curl_setDNSServers:(NSArray *)servers;
+- (void)curl_setResolveTimeout:(NSTimeInterval)timeout;
+
+- (void)curl_setReceiveBufferSize:(NSUInteger)size;
+- (void)curl_setUploadBufferSize:(NSUInteger)size;
+
+@end
 
 
+@interface NSURL (CURLOrigin)
+
+/**
+ A normalised "scheme://host:port" string, suitable for keying per-server state.
+ 
+ Scheme and host are lowercased, and the port is always included, falling back to the scheme's default.
+ */
+@property(nonatomic, readonly) NSString *curl_originString;
+
+@end
@@ -7,6 +7,7 @@
 
 #import "CURLRequest.h"
 #import "CURLProtocol.h"
+#import "CURLSocketOptions.h"
 
 @implementation NSURLRequest (CURLOptionsFTP)
 
@@ -47,6 +48,52 @@
 
 - (NSURL *)curl_SSHKnownHostsFileURL; { return [NSURLProtocol propertyForKey:@"curl_SSHKnownHostsFileURL" inRequest:self]; }
 
+- (BOOL)curl_wantsRemoteModificationDate;
+{
+    return [[NSURLProtocol propertyForKey:@"curl_wantsRemoteModificationDate" inRequest:self] boolValue];
+}
+
+- (NSNumber *)curl_uploadLength; { return [NSURLProtocol propertyForKey:@"curl_uploadLength" inRequest:self]; }
+
+- (CURLExpectContinuePolicy)curl_expectContinuePolicy;
+{
+    return [[NSURLProtocol propertyForKey:@"curl_expectContinuePolicy" inRequest:self] integerValue];
+}
+
+- (unsigned long long)curl_expectContinueThreshold;
+{
+    return [[NSURLProtocol propertyForKey:@"curl_expectContinueThreshold" inRequest:self] unsignedLongLongValue];
+}
+
+- (CURLSocketOptions *)curl_socketOptions; { return [NSURLProtocol propertyForKey:@"curl_socketOptions" inRequest:self]; }
+
+- (CURLAddressFamilyPreference)curl_addressFamilyPreference;
+{
+    return [[NSURLProtocol propertyForKey:@"curl_addressFamilyPreference" inRequest:self] integerValue];
+}
+
+- (NSTimeInterval)curl_happyEyeballsDelay;
+{
+    return [[NSURLProtocol propertyForKey:@"curl_happyEyeballsDelay" inRequest:self] doubleValue];
+}
+
+- (NSArray *)curl_DNSServers; { return [NSURLProtocol propertyForKey:@"curl_DNSServers" inRequest:self]; }
+
+- (NSTimeInterval)curl_resolveTimeout;
+{
+    return [[NSURLProtocol propertyForKey:@"curl_resolveTimeout" inRequest:self] doubleValue];
+}
+
+- (NSUInteger)curl_receiveBufferSize;
+{
+    return [[NSURLProtocol propertyForKey:@"curl_receiveBufferSize" inRequest:self] unsignedIntegerValue];
+}
+
+- (NSUInteger)curl_uploadBufferSize;
+{
+    return [[NSURLProtocol propertyForKey:@"curl_uploadBufferSize" inRequest:self] unsignedIntegerValue];
+}
+
 @end
 
 @implementation NSMutableURLRequest (CURLOptionsFTP)
@@ -121,5 +168,106 @@
     }
 }
 
+- (void)curl_setWantsRemoteModificationDate:(BOOL)wants;
+{
+    [NSURLProtocol setProperty:@(wants) forKey:@"curl_wantsRemoteModificationDate" inRequest:self];
+}
+
+- (void)curl_setUploadLength:(NSNumber *)length;
+{
+    if (length)
+    {
+        [NSURLProtocol setProperty:length forKey:@"curl_uploadLength" inRequest:self];
+    }
+    else
+    {
+        [NSURLProtocol removePropertyForKey:@"curl_uploadLength" inRequest:self];
+    }
+}
+
+- (void)curl_setExpectContinuePolicy:(CURLExpectContinuePolicy)policy;
+{
+    [NSURLProtocol setProperty:[NSNumber numberWithInteger:policy] forKey:@"curl_expectContinuePolicy" inRequest:self];
+}
+
+- (void)curl_setExpectContinueThreshold:(unsigned long long)threshold;
+{
+    [NSURLProtocol setProperty:[NSNumber numberWithUnsignedLongLong:threshold] forKey:@"curl_expectContinueThreshold" inRequest:self];
+}
+
+- (void)curl_setSocketOptions:(CURLSocketOptions *)options;
+{
+    if (options)
+    {
+        options = [options copy];
+        [NSURLProtocol setProperty:options forKey:@"curl_socketOptions" inRequest:self];
+        [options release];
+    }
+    else
+    {
+        [NSURLProtocol removePropertyForKey:@"curl_socketOptions" inRequest:self];
+    }
+}
+
+- (void)curl_setAddressFamilyPreference:(CURLAddressFamilyPreference)preference;
+{
+    [NSURLProtocol setProperty:[NSNumber numberWithInteger:preference] forKey:@"curl_addressFamilyPreference" inRequest:self];
+}
+
+- (void)curl_setHappyEyeballsDelay:(NSTimeInterval)delay;
+{
+    [NSURLProtocol setProperty:[NSNumber numberWithDouble:delay] forKey:@"curl_happyEyeballsDelay" inRequest:self];
+}
+
+- (void)curl_setDNSServers:(NSArray *)servers;
+{
+    if (servers)
+    {
+        servers = [servers copy];
+        [NSURLProtocol setProperty:servers forKey:@"curl_DNSServers" inRequest:self];
+        [servers release];
+    }
+    else
+    {
+        [NSURLProtocol removePropertyForKey:@"curl_DNSServers" inRequest:self];
+    }
+}
+
+- (void)curl_setResolveTimeout:(NSTimeInterval)timeout;
+{
+    [NSURLProtocol setProperty:[NSNumber numberWithDouble:timeout] forKey:@"curl_resolveTimeout" inRequest:self];
+}
+
+- (void)curl_setReceiveBufferSize:(NSUInteger)size;
+{
+    [NSURLProtocol setProperty:[NSNumber numberWithUnsignedInteger:size] forKey:@"curl_receiveBufferSize" inRequest:self];
+}
+
+- (void)curl_setUploadBufferSize:(NSUInteger)size;
+{
+    [NSURLProtocol setProperty:[NSNumber numberWithUnsignedInteger:size] forKey:@"curl_uploadBufferSize" inRequest:self];
+}
+
 @end
 
+
+@implementation NSURL (CURLOrigin)
+
+- (NSString *)curl_originString;
+{
+    NSString *scheme = [[self scheme] lowercaseString];
+    NSNumber *port = [self port];
+    if (!port)
+    {
+        if ([scheme isEqualToString:@"http"]) port = @80;
+        else if ([scheme isEqualToString:@"https"]) port = @443;
+        else if ([scheme isEqualToString:@"ftp"]) port = @21;
+        else if ([scheme isEqualToString:@"ftps"]) port = @990;
+        else if ([scheme isEqualToString:@"sftp"] || [scheme isEqualToString:@"scp"]) port = @22;
+        else port = @0;
+    }
+    
+    return [NSString stringWithFormat:@"%@://%@:%@", scheme, [[self host] lowercaseString], port];
+}
+
+@end
@@ -17,6 +17,9 @@
 // For HTTP URLs, returns an NSHTTPURLResponse. For others, a CURLResponse
 + (NSURLResponse *)responseWithURL:(NSURL *)url statusCode:(NSInteger)statusCode headerString:(NSString *)header;
 
+// An NSHTTPURLResponse, even on systems where it can't be created directly
++ (NSHTTPURLResponse *)HTTPResponseWithURL:(NSURL *)url statusCode:(NSInteger)statusCode HTTPVersion:(NSString *)version headerFields:(NSDictionary *)fields;
+
 @property(readonly) NSInteger statusCode;
 @property(readonly) NSString *headerString;
 
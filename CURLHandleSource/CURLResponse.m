@@ -24,13 +24,7 @@
     NSString *scheme = url.scheme;
     if ([scheme caseInsensitiveCompare:@"http"] == NSOrderedSame || [scheme caseInsensitiveCompare:@"https"] == NSOrderedSame)
     {
-        Class responseClass = ([NSHTTPURLResponse instancesRespondToSelector:@selector(initWithURL:statusCode:HTTPVersion:headerFields:)] ? [NSHTTPURLResponse class] : [CURLResponse class]);
-        
-        return [[[responseClass alloc] initWithURL:url
-                                        statusCode:statusCode
-                                       HTTPVersion:[header headerHTTPVersion]
-                                      headerFields:[header allHTTPHeaderFields]]
-                autorelease];
+        return [self HTTPResponseWithURL:url statusCode:statusCode HTTPVersion:[header headerHTTPVersion] headerFields:[header allHTTPHeaderFields]];
     }
     else
     {
@@ -41,6 +35,17 @@
     }
 }
 
++ (NSHTTPURLResponse *)HTTPResponseWithURL:(NSURL *)url statusCode:(NSInteger)statusCode HTTPVersion:(NSString *)version headerFields:(NSDictionary *)fields;
+{
+    Class responseClass = ([NSHTTPURLResponse instancesRespondToSelector:@selector(initWithURL:statusCode:HTTPVersion:headerFields:)] ? [NSHTTPURLResponse class] : [CURLHTTPResponse class]);
+
+    return [[[responseClass alloc] initWithURL:url
+                                    statusCode:statusCode
+                                   HTTPVersion:version
+                                  headerFields:fields]
+            autorelease];
+}
+
 - (void)dealloc
 {
     [_header release];
@@ -0,0 +1,178 @@
+//
+//  CURLResponseCache.h
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+
+@class CURLCachedResponse;
+
+/**
+ An on-disk cache of HTTP responses, for use by CURLProtocol.
+
+ Bodies are kept as individual files in the cache directory. Everything else about each response (status,
+ headers, the request headers it varies on, when it was stored and last used) lives in a single index file,
+ which is loaded once and written back shortly after changes, or on -synchronize.
+
+ Entries are keyed by URL, plus the values of whichever request headers the response named in its Vary
+ header. When the cache grows past either limit, the least recently used entries are evicted.
+
+ All methods are thread safe.
+ */
+
+@interface CURLResponseCache : NSObject
+{
+  @private
+    NSURL               *_directoryURL;
+    dispatch_queue_t    _queue;
+
+    unsigned long long  _maximumDiskSize;
+    NSUInteger          _maximumEntryCount;
+
+    // Only accessed on _queue
+    NSMutableDictionary *_entries;          // key -> entry dictionary
+    NSMutableDictionary *_varyHeaders;      // URL -> sorted, lowercased request header names
+    unsigned long long  _currentDiskSize;
+    BOOL                _indexWriteScheduled;
+
+    NSUInteger          _lookupCount;
+    NSUInteger          _hitCount;
+    NSUInteger          _revalidatedCount;
+    NSUInteger          _missCount;
+}
+
+/**
+ Opens the cache in a given directory, creating it if needed, and loads any existing index.
+
+ The cache keeps its index and a subdirectory of response bodies there, and leaves anything else in the
+ directory alone.
+ */
+- (id)initWithDirectoryURL:(NSURL *)directoryURL __attribute((nonnull(1)));
+
+@property (readonly, copy) NSURL *directoryURL;
+
+/**
+ Default is 50MB. Responses bigger than a tenth of this aren't stored.
+ */
+@property (assign) unsigned long long maximumDiskSize;
+
+/**
+ Default is 1000.
+ */
+@property (assign) NSUInteger maximumEntryCount;
+
+@property (readonly) unsigned long long currentDiskSize;
+@property (readonly) NSUInteger entryCount;
+
+
+#pragma mark Lookup & Storage
+
+/**
+ @return The entry matching `request`, whether fresh or not, or `nil`. Also marks the entry as recently used.
+ */
+- (CURLCachedResponse *)cachedResponseForRequest:(NSURLRequest *)request;
+
+/**
+ @return Whether a response is worth storing at all. `response` should be an NSHTTPURLResponse.
+ */
+- (BOOL)shouldStoreResponse:(NSURLResponse *)response forRequest:(NSURLRequest *)request;
+
+/**
+ Where to write a response body before handing it to -storeResponse:bodyFileURL:forRequest:. Each call
+ returns a new location inside the cache directory.
+ */
+- (NSURL *)temporaryBodyFileURL;
+
+/**
+ Adds a response to the cache, replacing any existing entry for the same request.
+
+ @param bodyFileURL The complete body, already on disk. The cache takes ownership of the file, moving it
+ into place or deleting it.
+ */
+- (void)storeResponse:(NSHTTPURLResponse *)response bodyFileURL:(NSURL *)bodyFileURL forRequest:(NSURLRequest *)request;
+
+/**
+ Refreshes a stale entry after the server answered a conditional request with 304 Not Modified.
+
+ @return The cached response, with its headers updated from `response`.
+ */
+- (NSHTTPURLResponse *)updateCachedResponse:(CURLCachedResponse *)cachedResponse withNotModifiedResponse:(NSHTTPURLResponse *)response;
+
+- (void)removeCachedResponseForRequest:(NSURLRequest *)request;
+- (void)removeAllCachedResponses;
+
+/**
+ Writes the index to disk now, rather than waiting.
+ */
+- (void)synchronize;
+
+
+#pragma mark Statistics
+
+/**
+ How many times -cachedResponseForRequest: has been called.
+ */
+@property (readonly) NSUInteger lookupCount;
+
+/**
+ Lookups which found a fresh entry.
+ */
+@property (readonly) NSUInteger hitCount;
+
+/**
+ Stale entries which the server confirmed were still good.
+ */
+@property (readonly) NSUInteger revalidatedCount;
+
+/**
+ Lookups which found nothing.
+ */
+@property (readonly) NSUInteger missCount;
+
+/**
+ The proportion of lookups answered from the cache, whether directly or after revalidation. 0 if there
+ have been no lookups.
+ */
+@property (readonly) double hitRate;
+
+- (void)resetStatistics;
+
+@end
+
+
+/**
+ A snapshot of one entry in the cache.
+ */
+
+@interface CURLCachedResponse : NSObject
+{
+  @private
+    NSString            *_key;
+    NSHTTPURLResponse   *_response;
+    NSURL               *_bodyFileURL;
+    BOOL                _fresh;
+}
+
+@property (readonly, retain) NSHTTPURLResponse *response;
+
+/**
+ The body's file. Read it promptly; the entry could be evicted later on.
+ */
+@property (readonly, copy) NSURL *bodyFileURL;
+
+/**
+ Whether the entry can be used without checking with the server, as of the lookup.
+ */
+@property (readonly, getter=isFresh) BOOL fresh;
+
+/**
+ The response's ETag and Last-Modified headers, for building a conditional request.
+ */
+@property (readonly) NSString *entityTag;
+@property (readonly) NSString *lastModified;
+
+@end
@@ -0,0 +1,704 @@
+//
+//  CURLResponseCache.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLResponseCache.h"
+
+#import "CURLResponse.h"
+
+#include <sys/stat.h>
+#include <time.h>
+#include <xlocale.h>
+
+
+static NSString * const kIndexFilename = @"index.plist";
+static NSString * const kBodiesDirectoryName = @"CURLResponseCacheBodies";
+static NSString * const kTemporaryPrefix = @"tmp-";
+
+// Index keys
+static NSString * const kEntriesKey = @"entries";
+static NSString * const kVaryKey = @"vary";
+static NSString * const kKeyKey = @"key";
+static NSString * const kURLKey = @"URL";
+static NSString * const kFileKey = @"file";
+static NSString * const kSizeKey = @"size";
+static NSString * const kStatusKey = @"status";
+static NSString * const kHeadersKey = @"headers";
+static NSString * const kStoredKey = @"stored";
+static NSString * const kAccessedKey = @"accessed";
+static NSString * const kAgeKey = @"age";
+
+#define INDEX_WRITE_DELAY 2.0   // seconds
+
+
+@interface CURLCachedResponse ()
+- (id)initWithKey:(NSString *)key response:(NSHTTPURLResponse *)response bodyFileURL:(NSURL *)bodyURL fresh:(BOOL)fresh;
+@property (readonly, copy) NSString *key;
+@end
+
+
+#pragma mark - Header Parsing
+
+static NSString *CURLHeaderValue(NSDictionary *headers, NSString *name)
+{
+    NSString *result = [headers objectForKey:name];
+    if (result) return result;
+
+    for (NSString *aKey in headers)
+    {
+        if ([aKey caseInsensitiveCompare:name] == NSOrderedSame) return [headers objectForKey:aKey];
+    }
+    return nil;
+}
+
+// Directive names are lowercased. Those without a value map to NSNull
+static NSDictionary *CURLCacheControlDirectives(NSString *header)
+{
+    if (!header) return nil;
+
+    NSMutableDictionary *result = [NSMutableDictionary dictionary];
+    NSCharacterSet *whitespace = [NSCharacterSet whitespaceCharacterSet];
+
+    for (NSString *aDirective in [header componentsSeparatedByString:@","])
+    {
+        NSRange equals = [aDirective rangeOfString:@"="];
+        NSString *name = (equals.location == NSNotFound ? aDirective : [aDirective substringToIndex:equals.location]);
+        name = [[name stringByTrimmingCharactersInSet:whitespace] lowercaseString];
+        if (![name length]) continue;
+
+        id value = [NSNull null];
+        if (equals.location != NSNotFound)
+        {
+            value = [[aDirective substringFromIndex:NSMaxRange(equals)] stringByTrimmingCharactersInSet:whitespace];
+            value = [value stringByTrimmingCharactersInSet:[NSCharacterSet characterSetWithCharactersInString:@"\""]];
+        }
+        [result setObject:value forKey:name];
+    }
+
+    return result;
+}
+
+// RFC 1123, RFC 850 and asctime formats, as HTTP allows
+static NSDate *CURLDateFromHTTPDate(NSString *string)
+{
+    const char *cString = [string UTF8String];
+    if (!cString) return nil;
+
+    static const char *formats[] = { "%a, %d %b %Y %H:%M:%S GMT", "%A, %d-%b-%y %H:%M:%S GMT", "%a %b %e %H:%M:%S %Y" };
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+    {
+        struct tm parsed;
+        memset(&parsed, 0, sizeof(parsed));
+
+        const char *end = strptime_l(cString, formats[i], &parsed, NULL);
+        if (end && *end == '\0')
+        {
+            return [NSDate dateWithTimeIntervalSince1970:timegm(&parsed)];
+        }
+    }
+
+    return nil;
+}
+
+// How long a response stays fresh after it was generated
+static NSTimeInterval CURLFreshnessLifetime(NSDictionary *headers, NSDate *stored)
+{
+    NSDictionary *cacheControl = CURLCacheControlDirectives(CURLHeaderValue(headers, @"Cache-Control"));
+    if ([cacheControl objectForKey:@"no-cache"]) return 0.0;
+
+    NSString *maxAge = [cacheControl objectForKey:@"max-age"];
+    if ([maxAge isKindOfClass:[NSString class]]) return MAX([maxAge doubleValue], 0.0);
+
+    NSDate *date = CURLDateFromHTTPDate(CURLHeaderValue(headers, @"Date"));
+    if (!date) date = stored;
+
+    NSString *expiresHeader = CURLHeaderValue(headers, @"Expires");
+    if (expiresHeader)
+    {
+        // Invalid dates, such as "0", mean already expired
+        NSDate *expires = CURLDateFromHTTPDate(expiresHeader);
+        return (expires ? MAX([expires timeIntervalSinceDate:date], 0.0) : 0.0);
+    }
+
+    // Heuristic: a tenth of the time since the last change, up to a day
+    NSDate *lastModified = CURLDateFromHTTPDate(CURLHeaderValue(headers, @"Last-Modified"));
+    if (lastModified)
+    {
+        return MIN(MAX([date timeIntervalSinceDate:lastModified] / 10.0, 0.0), 24.0 * 60.0 * 60.0);
+    }
+
+    return 0.0;
+}
+
+static NSString *CURLCacheURLString(NSURL *url)
+{
+    NSString *result = [url absoluteString];
+    NSRange fragment = [result rangeOfString:@"#"];
+    if (fragment.location != NSNotFound) result = [result substringToIndex:fragment.location];
+    return result;
+}
+
+
+#pragma mark -
+
+@implementation CURLResponseCache
+
+@synthesize directoryURL = _directoryURL;
+
+#pragma mark Lifecycle
+
+- (id)initWithDirectoryURL:(NSURL *)directoryURL;
+{
+    NSParameterAssert([directoryURL isFileURL]);
+
+    if (self = [self init])
+    {
+        _directoryURL = [directoryURL copy];
+        _queue = dispatch_queue_create("com.karelia.CURLResponseCache", NULL);
+
+        _maximumDiskSize = 50 * 1024 * 1024;
+        _maximumEntryCount = 1000;
+
+        _entries = [[NSMutableDictionary alloc] init];
+        _varyHeaders = [[NSMutableDictionary alloc] init];
+
+        [[NSFileManager defaultManager] createDirectoryAtURL:[self bodiesDirectoryURL] withIntermediateDirectories:YES attributes:nil error:NULL];
+        [self loadIndex];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_directoryURL release];
+    if (_queue) dispatch_release(_queue);
+    [_entries release];
+    [_varyHeaders release];
+
+    [super dealloc];
+}
+
+#pragma mark Index
+
+- (NSURL *)indexURL;
+{
+    return [_directoryURL URLByAppendingPathComponent:kIndexFilename];
+}
+
+/*  Bodies get a directory to themselves, so anything else the client keeps alongside the cache is left alone
+ */
+- (NSURL *)bodiesDirectoryURL;
+{
+    return [_directoryURL URLByAppendingPathComponent:kBodiesDirectoryName isDirectory:YES];
+}
+
+- (NSURL *)URLForFile:(NSString *)filename;
+{
+    return [[self bodiesDirectoryURL] URLByAppendingPathComponent:filename isDirectory:NO];
+}
+
+- (void)loadIndex;
+{
+    NSData *data = [NSData dataWithContentsOfURL:[self indexURL]];
+    NSDictionary *index = (data ? [NSPropertyListSerialization propertyListWithData:data options:0 format:NULL error:NULL] : nil);
+
+    if ([index isKindOfClass:[NSDictionary class]])
+    {
+        // Trust the index for everything except which bodies are actually still there
+        for (NSDictionary *anEntry in [index objectForKey:kEntriesKey])
+        {
+            NSString *key = [anEntry objectForKey:kKeyKey];
+            NSString *file = [anEntry objectForKey:kFileKey];
+            if (!key || !file) continue;
+
+            struct stat info;
+            if (stat([[[self URLForFile:file] path] fileSystemRepresentation], &info) != 0) continue;
+
+            NSMutableDictionary *entry = [anEntry mutableCopy];
+            [entry setObject:[NSNumber numberWithUnsignedLongLong:info.st_size] forKey:kSizeKey];
+            [_entries setObject:entry forKey:key];
+            [entry release];
+
+            _currentDiskSize += info.st_size;
+        }
+
+        NSDictionary *vary = [index objectForKey:kVaryKey];
+        if ([vary isKindOfClass:[NSDictionary class]]) [_varyHeaders setDictionary:vary];
+    }
+
+    // Clear out bodies the index doesn't know about, such as from a crash mid-download
+    NSMutableSet *files = [NSMutableSet setWithCapacity:[_entries count]];
+    for (NSDictionary *anEntry in [_entries objectEnumerator])
+    {
+        [files addObject:[anEntry objectForKey:kFileKey]];
+    }
+
+    for (NSString *aFile in [[NSFileManager defaultManager] contentsOfDirectoryAtPath:[[self bodiesDirectoryURL] path] error:NULL])
+    {
+        if (![files containsObject:aFile])
+        {
+            [[NSFileManager defaultManager] removeItemAtURL:[self URLForFile:aFile] error:NULL];
+        }
+    }
+}
+
+- (void)writeIndex;
+{
+    _indexWriteScheduled = NO;
+
+    NSMutableArray *entries = [[NSMutableArray alloc] initWithCapacity:[_entries count]];
+    for (NSString *aKey in _entries)
+    {
+        NSMutableDictionary *entry = [_entries objectForKey:aKey];
+        [entry setObject:aKey forKey:kKeyKey];
+        [entries addObject:entry];
+    }
+
+    NSDictionary *index = [NSDictionary dictionaryWithObjectsAndKeys:entries, kEntriesKey, _varyHeaders, kVaryKey, nil];
+    [entries release];
+
+    NSError *error;
+    NSData *data = [NSPropertyListSerialization dataWithPropertyList:index format:NSPropertyListBinaryFormat_v1_0 options:0 error:&error];
+    if (!data || ![data writeToURL:[self indexURL] options:NSDataWritingAtomic error:&error])
+    {
+        NSLog(@"Failed to write response cache index: %@", error);
+    }
+}
+
+/*  Changes are batched up into a single write, shortly afterwards
+ */
+- (void)scheduleIndexWrite;
+{
+    if (_indexWriteScheduled) return;
+    _indexWriteScheduled = YES;
+
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(INDEX_WRITE_DELAY * NSEC_PER_SEC)), _queue, ^{
+        if (_indexWriteScheduled) [self writeIndex];
+    });
+}
+
+- (void)synchronize;
+{
+    dispatch_sync(_queue, ^{
+        [self writeIndex];
+    });
+}
+
+#pragma mark Limits
+
+- (unsigned long long)maximumDiskSize;
+{
+    __block unsigned long long result;
+    dispatch_sync(_queue, ^{ result = _maximumDiskSize; });
+    return result;
+}
+
+- (void)setMaximumDiskSize:(unsigned long long)size;
+{
+    dispatch_sync(_queue, ^{
+        _maximumDiskSize = size;
+        [self evictIfNeeded];
+    });
+}
+
+- (NSUInteger)maximumEntryCount;
+{
+    __block NSUInteger result;
+    dispatch_sync(_queue, ^{ result = _maximumEntryCount; });
+    return result;
+}
+
+- (void)setMaximumEntryCount:(NSUInteger)count;
+{
+    dispatch_sync(_queue, ^{
+        _maximumEntryCount = count;
+        [self evictIfNeeded];
+    });
+}
+
+- (unsigned long long)currentDiskSize;
+{
+    __block unsigned long long result;
+    dispatch_sync(_queue, ^{ result = _currentDiskSize; });
+    return result;
+}
+
+- (NSUInteger)entryCount;
+{
+    __block NSUInteger result;
+    dispatch_sync(_queue, ^{ result = [_entries count]; });
+    return result;
+}
+
+- (void)removeEntryForKey:(NSString *)key;
+{
+    NSDictionary *entry = [_entries objectForKey:key];
+    if (!entry) return;
+
+    [[NSFileManager defaultManager] removeItemAtURL:[self URLForFile:[entry objectForKey:kFileKey]] error:NULL];
+    _currentDiskSize -= [[entry objectForKey:kSizeKey] unsignedLongLongValue];
+    [_entries removeObjectForKey:key];
+
+    [self scheduleIndexWrite];
+}
+
+/*  Least recently used go first
+ */
+- (void)evictIfNeeded;
+{
+    if (_currentDiskSize <= _maximumDiskSize && [_entries count] <= _maximumEntryCount) return;
+
+    NSArray *keys = [_entries keysSortedByValueUsingComparator:^NSComparisonResult(id entry1, id entry2) {
+        return [[entry1 objectForKey:kAccessedKey] compare:[entry2 objectForKey:kAccessedKey]];
+    }];
+
+    for (NSString *aKey in keys)
+    {
+        if (_currentDiskSize <= _maximumDiskSize && [_entries count] <= _maximumEntryCount) break;
+        [self removeEntryForKey:aKey];
+    }
+}
+
+#pragma mark Keys
+
+- (NSString *)keyForRequest:(NSURLRequest *)request varyHeaders:(NSArray *)names;
+{
+    NSString *url = CURLCacheURLString([request URL]);
+    if (![names count]) return url;
+
+    NSMutableString *result = [[url mutableCopy] autorelease];
+    for (NSString *aName in names)
+    {
+        NSString *value = [request valueForHTTPHeaderField:aName];
+        [result appendFormat:@"\n%@:%@", aName, (value ? value : @"")];
+    }
+    return result;
+}
+
+// nil for "Vary: *", which can never be matched
+static NSArray *CURLVaryHeaderNames(NSHTTPURLResponse *response)
+{
+    NSString *vary = CURLHeaderValue([response allHeaderFields], @"Vary");
+    if (!vary) return [NSArray array];
+
+    NSMutableSet *result = [NSMutableSet set];
+    for (NSString *aName in [vary componentsSeparatedByString:@","])
+    {
+        aName = [[aName stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]] lowercaseString];
+        if ([aName isEqualToString:@"*"]) return nil;
+        if ([aName length]) [result addObject:aName];
+    }
+
+    return [[result allObjects] sortedArrayUsingSelector:@selector(compare:)];
+}
+
+#pragma mark Lookup & Storage
+
+- (NSHTTPURLResponse *)responseForEntry:(NSDictionary *)entry;
+{
+    return [CURLResponse HTTPResponseWithURL:[NSURL URLWithString:[entry objectForKey:kURLKey]]
+                                  statusCode:[[entry objectForKey:kStatusKey] integerValue]
+                                 HTTPVersion:@"HTTP/1.1"
+                                headerFields:[entry objectForKey:kHeadersKey]];
+}
+
+- (CURLCachedResponse *)cachedResponseForRequest:(NSURLRequest *)request;
+{
+    __block CURLCachedResponse *result = nil;
+
+    dispatch_sync(_queue, ^{
+        _lookupCount++;
+
+        NSString *key = [self keyForRequest:request varyHeaders:[_varyHeaders objectForKey:CURLCacheURLString([request URL])]];
+        NSMutableDictionary *entry = [_entries objectForKey:key];
+        if (!entry)
+        {
+            _missCount++;
+            return;
+        }
+
+        NSDate *now = [NSDate date];
+        [entry setObject:now forKey:kAccessedKey];
+        [self scheduleIndexWrite];
+
+        NSDictionary *headers = [entry objectForKey:kHeadersKey];
+        NSDate *stored = [entry objectForKey:kStoredKey];
+        NSTimeInterval age = [[entry objectForKey:kAgeKey] doubleValue] + MAX([now timeIntervalSinceDate:stored], 0.0);
+        BOOL fresh = (age < CURLFreshnessLifetime(headers, stored));
+        if (fresh) _hitCount++;
+
+        result = [[CURLCachedResponse alloc] initWithKey:key
+                                                response:[self responseForEntry:entry]
+                                             bodyFileURL:[self URLForFile:[entry objectForKey:kFileKey]]
+                                                   fresh:fresh];
+    });
+
+    return [result autorelease];
+}
+
+- (BOOL)shouldStoreResponse:(NSURLResponse *)response forRequest:(NSURLRequest *)request;
+{
+    if (![response isKindOfClass:[NSHTTPURLResponse class]]) return NO;
+    NSHTTPURLResponse *httpResponse = (NSHTTPURLResponse *)response;
+
+    NSString *method = [request HTTPMethod];
+    if (method && ![method isEqualToString:@"GET"]) return NO;
+
+    NSInteger status = [httpResponse statusCode];
+    if (status != 200 && status != 203 && status != 300 && status != 301) return NO;
+
+    // Anything redirected temporarily belongs to a different URL
+    if (![CURLCacheURLString([response URL]) isEqualToString:CURLCacheURLString([request URL])]) return NO;
+
+    NSDictionary *headers = [httpResponse allHeaderFields];
+    NSDictionary *responseDirectives = CURLCacheControlDirectives(CURLHeaderValue(headers, @"Cache-Control"));
+    NSDictionary *requestDirectives = CURLCacheControlDirectives([request valueForHTTPHeaderField:@"Cache-Control"]);
+    if ([responseDirectives objectForKey:@"no-store"] || [requestDirectives objectForKey:@"no-store"]) return NO;
+
+    if (!CURLVaryHeaderNames(httpResponse)) return NO;
+
+    if ([request valueForHTTPHeaderField:@"Authorization"] &&
+        ![responseDirectives objectForKey:@"public"] &&
+        ![responseDirectives objectForKey:@"must-revalidate"] &&
+        ![responseDirectives objectForKey:@"s-maxage"])
+    {
+        return NO;
+    }
+
+    // Only worth keeping if it can be served without asking, or revalidated cheaply
+    if (CURLFreshnessLifetime(headers, [NSDate date]) <= 0.0 &&
+        !CURLHeaderValue(headers, @"ETag") &&
+        !CURLHeaderValue(headers, @"Last-Modified"))
+    {
+        return NO;
+    }
+
+    return YES;
+}
+
+- (NSURL *)temporaryBodyFileURL;
+{
+    NSString *filename = [kTemporaryPrefix stringByAppendingString:[[NSProcessInfo processInfo] globallyUniqueString]];
+    return [self URLForFile:filename];
+}
+
+- (void)storeResponse:(NSHTTPURLResponse *)response bodyFileURL:(NSURL *)bodyFileURL forRequest:(NSURLRequest *)request;
+{
+    if (![self shouldStoreResponse:response forRequest:request])
+    {
+        [[NSFileManager defaultManager] removeItemAtURL:bodyFileURL error:NULL];
+        return;
+    }
+
+    dispatch_sync(_queue, ^{
+
+        struct stat info;
+        if (stat([[bodyFileURL path] fileSystemRepresentation], &info) != 0) return;
+
+        if ((unsigned long long)info.st_size > _maximumDiskSize / 10)
+        {
+            [[NSFileManager defaultManager] removeItemAtURL:bodyFileURL error:NULL];
+            return;
+        }
+
+        NSString *file = [[NSProcessInfo processInfo] globallyUniqueString];
+        if (![[NSFileManager defaultManager] moveItemAtURL:bodyFileURL toURL:[self URLForFile:file] error:NULL])
+        {
+            [[NSFileManager defaultManager] removeItemAtURL:bodyFileURL error:NULL];
+            return;
+        }
+
+        NSString *url = CURLCacheURLString([request URL]);
+        NSArray *vary = CURLVaryHeaderNames(response);
+        if ([vary count])
+        {
+            [_varyHeaders setObject:vary forKey:url];
+        }
+        else
+        {
+            [_varyHeaders removeObjectForKey:url];
+        }
+
+        NSString *key = [self keyForRequest:request varyHeaders:vary];
+        [self removeEntryForKey:key];
+
+        NSDate *now = [NSDate date];
+        NSDictionary *headers = [response allHeaderFields];
+        NSMutableDictionary *entry = [[NSMutableDictionary alloc] initWithObjectsAndKeys:
+                                      [[response URL] absoluteString], kURLKey,
+                                      file, kFileKey,
+                                      [NSNumber numberWithUnsignedLongLong:info.st_size], kSizeKey,
+                                      [NSNumber numberWithInteger:[response statusCode]], kStatusKey,
+                                      (headers ? headers : [NSDictionary dictionary]), kHeadersKey,
+                                      now, kStoredKey,
+                                      now, kAccessedKey,
+                                      [NSNumber numberWithDouble:MAX([CURLHeaderValue(headers, @"Age") doubleValue], 0.0)], kAgeKey,
+                                      nil];
+        [_entries setObject:entry forKey:key];
+        [entry release];
+
+        _currentDiskSize += info.st_size;
+        [self evictIfNeeded];
+        [self scheduleIndexWrite];
+    });
+}
+
+- (NSHTTPURLResponse *)updateCachedResponse:(CURLCachedResponse *)cachedResponse withNotModifiedResponse:(NSHTTPURLResponse *)response;
+{
+    // A 304 describes the stored body, so mustn't override headers about this (empty) message's framing
+    static NSSet *framingHeaders;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        framingHeaders = [[NSSet alloc] initWithObjects:@"content-length", @"content-encoding", @"transfer-encoding", @"content-range", nil];
+    });
+
+    NSMutableDictionary *headers = [[[[cachedResponse response] allHeaderFields] mutableCopy] autorelease];
+    NSDictionary *newHeaders = [response allHeaderFields];
+
+    for (NSString *aName in newHeaders)
+    {
+        if ([framingHeaders containsObject:[aName lowercaseString]]) continue;
+
+        for (NSString *anExistingName in [headers allKeys])
+        {
+            if ([anExistingName caseInsensitiveCompare:aName] == NSOrderedSame) [headers removeObjectForKey:anExistingName];
+        }
+        [headers setObject:[newHeaders objectForKey:aName] forKey:aName];
+    }
+
+    dispatch_sync(_queue, ^{
+        _revalidatedCount++;
+
+        NSMutableDictionary *entry = [_entries objectForKey:[cachedResponse key]];
+        if (entry)
+        {
+            NSDate *now = [NSDate date];
+            [entry setObject:headers forKey:kHeadersKey];
+            [entry setObject:now forKey:kStoredKey];
+            [entry setObject:now forKey:kAccessedKey];
+            [entry setObject:[NSNumber numberWithDouble:MAX([CURLHeaderValue(newHeaders, @"Age") doubleValue], 0.0)] forKey:kAgeKey];
+            [self scheduleIndexWrite];
+        }
+    });
+
+    return [CURLResponse HTTPResponseWithURL:[[cachedResponse response] URL]
+                                  statusCode:[[cachedResponse response] statusCode]
+                                 HTTPVersion:@"HTTP/1.1"
+                                headerFields:headers];
+}
+
+- (void)removeCachedResponseForRequest:(NSURLRequest *)request;
+{
+    dispatch_sync(_queue, ^{
+        NSString *key = [self keyForRequest:request varyHeaders:[_varyHeaders objectForKey:CURLCacheURLString([request URL])]];
+        [self removeEntryForKey:key];
+    });
+}
+
+- (void)removeAllCachedResponses;
+{
+    dispatch_sync(_queue, ^{
+        for (NSString *aKey in [_entries allKeys])
+        {
+            [self removeEntryForKey:aKey];
+        }
+        [_varyHeaders removeAllObjects];
+        [self writeIndex];
+    });
+}
+
+#pragma mark Statistics
+
+- (NSUInteger)lookupCount;
+{
+    __block NSUInteger result;
+    dispatch_sync(_queue, ^{ result = _lookupCount; });
+    return result;
+}
+
+- (NSUInteger)hitCount;
+{
+    __block NSUInteger result;
+    dispatch_sync(_queue, ^{ result = _hitCount; });
+    return result;
+}
+
+- (NSUInteger)revalidatedCount;
+{
+    __block NSUInteger result;
+    dispatch_sync(_queue, ^{ result = _revalidatedCount; });
+    return result;
+}
+
+- (NSUInteger)missCount;
+{
+    __block NSUInteger result;
+    dispatch_sync(_queue, ^{ result = _missCount; });
+    return result;
+}
+
+- (double)hitRate;
+{
+    __block double result = 0.0;
+    dispatch_sync(_queue, ^{
+        if (_lookupCount) result = (double)(_hitCount + _revalidatedCount) / (double)_lookupCount;
+    });
+    return result;
+}
+
+- (void)resetStatistics;
+{
+    dispatch_sync(_queue, ^{
+        _lookupCount = _hitCount = _revalidatedCount = _missCount = 0;
+    });
+}
+
+@end
+
+
+#pragma mark -
+
+@implementation CURLCachedResponse
+
+- (id)initWithKey:(NSString *)key response:(NSHTTPURLResponse *)response bodyFileURL:(NSURL *)bodyURL fresh:(BOOL)fresh;
+{
+    if (self = [self init])
+    {
+        _key = [key copy];
+        _response = [response retain];
+        _bodyFileURL = [bodyURL copy];
+        _fresh = fresh;
+    }
+    return self;
+}
+
+- (void)dealloc
+{
+    [_key release];
+    [_response release];
+    [_bodyFileURL release];
+
+    [super dealloc];
+}
+
+@synthesize key = _key;
+@synthesize response = _response;
+@synthesize bodyFileURL = _bodyFileURL;
+@synthesize fresh = _fresh;
+
+- (NSString *)entityTag;
+{
+    return CURLHeaderValue([_response allHeaderFields], @"ETag");
+}
+
+- (NSString *)lastModified;
+{
+    return CURLHeaderValue([_response allHeaderFields], @"Last-Modified");
+}
+
+@end
@@ -0,0 +1,135 @@
+//
+//  CURLResumableDownload.h
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLTransfer.h"
+
+
+@protocol CURLResumableDownloadDelegate;
+
+/**
+ Downloads a file to disk such that an interrupted download can pick up where it left off, even in a later run
+ of the app.
+
+ As data arrives, a checkpoint is periodically saved next to the destination file: how many bytes have been
+ written (and synced to disk), the file's total length, and whatever validators the server offers (ETag or
+ Last-Modified for HTTP; size and modification date for FTP and SFTP). Starting a download whose destination
+ has a matching checkpoint resumes from the checkpointed offset.
+
+ If the file has changed on the server in the meantime, the partial data is thrown away and the download
+ restarts cleanly from the beginning. For HTTP that's detected in the same request, using If-Range. For FTP
+ and SFTP, a quick request for the size and modification date is made first.
+
+ Failed attempts are also resumed automatically, up to `maximumAttempts`. If the download still fails, the
+ checkpoint is left in place for next time. It's removed once the download completes.
+ */
+
+@interface CURLResumableDownload : NSObject <CURLTransferDelegate>
+{
+  @private
+    NSURLRequest                        *_request;
+    NSURL                               *_destinationURL;
+    NSURLCredential                     *_credential;
+    id <CURLResumableDownloadDelegate>  _delegate;
+    NSOperationQueue                    *_delegateQueue;
+    NSOperationQueue                    *_workQueue;
+
+    NSUInteger          _maximumAttempts;
+    unsigned long long  _checkpointInterval;
+
+    // Only accessed on _workQueue
+    int                 _fileDescriptor;
+    CURLTransfer        *_transfer;
+    BOOL                _probing;
+    BOOL                _restartRequested;
+    NSURLResponse       *_lastResponse;
+    NSMutableDictionary *_checkpoint;
+    unsigned long long  _offset;
+    unsigned long long  _checkpointedOffset;
+    unsigned long long  _transferOffset;    // where the current transfer started
+    NSUInteger          _attempts;
+    BOOL                _started;
+    BOOL                _finished;
+}
+
+/**
+ Where the checkpoint for a given destination is kept.
+ */
++ (NSURL *)checkpointURLForDestinationURL:(NSURL *)fileURL;
+
+/**
+ @param request The request to download. Any Range header is replaced.
+ @param fileURL Where to write the file. If there's a checkpoint for it, and it matches, the download resumes.
+ @param credential Credential to use if needed. May be `nil`.
+ @param delegate Retained until the download completes or is cancelled.
+ @param queue The queue to deliver delegate messages on. If `nil`, a serial queue is created.
+ */
+- (id)initWithRequest:(NSURLRequest *)request
+       destinationURL:(NSURL *)fileURL
+           credential:(NSURLCredential *)credential
+             delegate:(id <CURLResumableDownloadDelegate>)delegate
+        delegateQueue:(NSOperationQueue *)queue __attribute((nonnull(1,2)));
+
+@property (readonly, copy) NSURLRequest *request;
+@property (readonly, copy) NSURL *destinationURL;
+@property (readonly, strong) id <CURLResumableDownloadDelegate> delegate;
+
+/**
+ How many transfers to try, each resuming from where the last got to, before giving up. Default is 3.
+ Must be set before calling -start.
+ */
+@property (assign) NSUInteger maximumAttempts;
+
+/**
+ How much data to write between checkpoints. Default is 4MB. Must be set before calling -start.
+ */
+@property (assign) unsigned long long checkpointInterval;
+
+/**
+ Starts downloading. Only call this once.
+ */
+- (void)start;
+
+/**
+ Stops as quickly as possible, saving a checkpoint first. Reports NSURLErrorCancelled to the delegate.
+ */
+- (void)cancel;
+
+@end
+
+
+#pragma mark - Delegate
+
+@protocol CURLResumableDownloadDelegate <NSObject>
+
+/**
+ Sent as the last message related to the download.
+
+ @param download The download.
+ @param error `nil` if the whole file was written successfully.
+ */
+- (void)resumableDownload:(CURLResumableDownload *)download didCompleteWithError:(NSError *)error;
+
+@optional
+
+/**
+ Sent each time data starts flowing from a given point in the file. That's 0 for a fresh download, or
+ a restart because the file changed on the server.
+ */
+- (void)resumableDownload:(CURLResumableDownload *)download willWriteFromOffset:(unsigned long long)offset;
+
+/**
+ Sent as data is written to disk.
+
+ @param download The download.
+ @param length How many bytes were just written.
+ @param totalBytesWritten How much of the file is now on disk, including anything from before resuming.
+ @param totalBytesExpected The length of the file, or NSURLResponseUnknownLength if not known.
+ */
+- (void)resumableDownload:(CURLResumableDownload *)download didWriteDataOfLength:(NSUInteger)length totalBytesWritten:(unsigned long long)totalBytesWritten totalBytesExpected:(long long)totalBytesExpected;
+
+@end
@@ -0,0 +1,531 @@
+//
+//  CURLResumableDownload.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLResumableDownload.h"
+
+#import "CURLRequest.h"
+#import "CURLTransferMetrics.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+// Checkpoint keys
+static NSString * const kURLKey = @"URL";
+static NSString * const kOffsetKey = @"offset";
+static NSString * const kLengthKey = @"length";
+static NSString * const kETagKey = @"ETag";
+static NSString * const kLastModifiedKey = @"Last-Modified";
+static NSString * const kModificationDateKey = @"modificationDate";
+
+
+@implementation CURLResumableDownload
+
+@synthesize request = _request;
+@synthesize destinationURL = _destinationURL;
+@synthesize delegate = _delegate;
+@synthesize maximumAttempts = _maximumAttempts;
+@synthesize checkpointInterval = _checkpointInterval;
+
++ (NSURL *)checkpointURLForDestinationURL:(NSURL *)fileURL;
+{
+    return [fileURL URLByAppendingPathExtension:@"curlcheckpoint"];
+}
+
+#pragma mark Lifecycle
+
+- (id)initWithRequest:(NSURLRequest *)request destinationURL:(NSURL *)fileURL credential:(NSURLCredential *)credential delegate:(id <CURLResumableDownloadDelegate>)delegate delegateQueue:(NSOperationQueue *)queue;
+{
+    NSParameterAssert(request);
+    NSParameterAssert([fileURL isFileURL]);
+
+    if (self = [self init])
+    {
+        _request = [request copy];
+        _destinationURL = [fileURL copy];
+        _credential = [credential retain];
+        _delegate = [delegate retain];
+
+        if (queue)
+        {
+            _delegateQueue = [queue retain];
+        }
+        else
+        {
+            _delegateQueue = [[NSOperationQueue alloc] init];
+            _delegateQueue.maxConcurrentOperationCount = 1;
+        }
+
+        _workQueue = [[NSOperationQueue alloc] init];
+        _workQueue.maxConcurrentOperationCount = 1;
+
+        _maximumAttempts = 3;
+        _checkpointInterval = 4 * 1024 * 1024;
+        _fileDescriptor = -1;
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_fileDescriptor >= 0) close(_fileDescriptor);
+
+    [_request release];
+    [_destinationURL release];
+    [_credential release];
+    [_delegate release];
+    [_delegateQueue release];
+    [_workQueue release];
+    [_transfer release];
+    [_lastResponse release];
+    [_checkpoint release];
+
+    [super dealloc];
+}
+
+#pragma mark Control
+
+- (void)start;
+{
+    [_workQueue addOperationWithBlock:^{
+
+        NSAssert(!_started, @"CURLResumableDownload can only be started once");
+        _started = YES;
+        if (_finished) return;  // cancelled already
+
+        _fileDescriptor = open([[_destinationURL path] fileSystemRepresentation], O_RDWR | O_CREAT, 0644);
+        if (_fileDescriptor < 0)
+        {
+            [self finishWithError:[self fileError]];
+            return;
+        }
+
+        // Only trust a checkpoint for the same URL, and which the file on disk can back up
+        NSDictionary *saved = [NSDictionary dictionaryWithContentsOfURL:[[self class] checkpointURLForDestinationURL:_destinationURL]];
+        struct stat info;
+        if ([[saved objectForKey:kURLKey] isEqualToString:[[_request URL] absoluteString]] &&
+            fstat(_fileDescriptor, &info) == 0 &&
+            [[saved objectForKey:kOffsetKey] unsignedLongLongValue] <= (unsigned long long)info.st_size)
+        {
+            _checkpoint = [saved mutableCopy];
+            _offset = [[saved objectForKey:kOffsetKey] unsignedLongLongValue];
+            CURLHandleLog(@"resuming download of %@ from %llu", [_request URL], _offset);
+        }
+        else
+        {
+            _checkpoint = [[NSMutableDictionary alloc] initWithObjectsAndKeys:[[_request URL] absoluteString], kURLKey, nil];
+        }
+
+        // Anything written after the last checkpoint might not have made it to disk intact
+        if (ftruncate(_fileDescriptor, (off_t)_offset) != 0)
+        {
+            [self finishWithError:[self fileError]];
+            return;
+        }
+        _checkpointedOffset = _offset;
+
+        [self startTransfer];
+    }];
+}
+
+- (void)cancel;
+{
+    [_workQueue addOperationWithBlock:^{
+        if (!_finished)
+        {
+            [self saveCheckpoint];
+            [self finishWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+        }
+    }];
+}
+
+#pragma mark Transfers
+
+- (BOOL)isHTTP;
+{
+    NSString *scheme = [[_request URL] scheme];
+    return ([scheme caseInsensitiveCompare:@"http"] == NSOrderedSame || [scheme caseInsensitiveCompare:@"https"] == NSOrderedSame);
+}
+
+- (long long)expectedLength;
+{
+    NSNumber *length = [_checkpoint objectForKey:kLengthKey];
+    return (length ? [length longLongValue] : NSURLResponseUnknownLength);
+}
+
+- (void)startTransfer;
+{
+    NSMutableURLRequest *request = [_request mutableCopy];
+    [request setValue:nil forHTTPHeaderField:@"Range"];
+
+    // FTP and SFTP have no equivalent of If-Range, so check for changes before resuming
+    _probing = (_offset > 0 && ![self isHTTP]);
+    if (![self isHTTP]) [request curl_setWantsRemoteModificationDate:YES];
+
+    if (_probing)
+    {
+        [request setHTTPMethod:@"HEAD"];
+    }
+    else
+    {
+        _attempts++;
+
+        if (_offset > 0)
+        {
+            [request setValue:[NSString stringWithFormat:@"bytes=%llu-", _offset] forHTTPHeaderField:@"Range"];
+
+            NSString *validator = [_checkpoint objectForKey:kETagKey];
+            if (!validator) validator = [_checkpoint objectForKey:kLastModifiedKey];
+            if (validator) [request setValue:validator forHTTPHeaderField:@"If-Range"];
+        }
+
+        [self notifyWillWriteFromOffset:_offset];
+    }
+
+    _transferOffset = _offset;
+    [_lastResponse release]; _lastResponse = nil;
+
+    [_transfer release];
+    _transfer = [[CURLTransfer alloc] initWithRequest:request credential:_credential delegate:self delegateQueue:_workQueue];
+
+    [request release];
+}
+
+/*  The server's copy has changed, so what we have is useless
+ */
+- (BOOL)discardPartialData;
+{
+    CURLHandleLog(@"remote file has changed; restarting download of %@", [_request URL]);
+
+    _offset = _transferOffset = _checkpointedOffset = 0;
+
+    [_checkpoint removeObjectForKey:kLengthKey];
+    [_checkpoint removeObjectForKey:kETagKey];
+    [_checkpoint removeObjectForKey:kLastModifiedKey];
+    [_checkpoint removeObjectForKey:kModificationDateKey];
+
+    if (ftruncate(_fileDescriptor, 0) != 0)
+    {
+        [self finishWithError:[self fileError]];
+        return NO;
+    }
+
+    [self saveCheckpoint];
+    return YES;
+}
+
+- (void)saveCheckpoint;
+{
+    if (_fileDescriptor < 0) return;
+
+    // Data first, so the checkpoint never claims more than is really there
+    fsync(_fileDescriptor);
+
+    [_checkpoint setObject:[NSNumber numberWithUnsignedLongLong:_offset] forKey:kOffsetKey];
+    [_checkpoint writeToURL:[[self class] checkpointURLForDestinationURL:_destinationURL] atomically:YES];
+    _checkpointedOffset = _offset;
+}
+
+- (void)finishWithError:(NSError *)error;
+{
+    _finished = YES;
+    [_transfer cancel];
+
+    if (_fileDescriptor >= 0)
+    {
+        if (close(_fileDescriptor) != 0 && !error) error = [self fileError];
+        _fileDescriptor = -1;
+    }
+
+    if (!error)
+    {
+        [[NSFileManager defaultManager] removeItemAtURL:[[self class] checkpointURLForDestinationURL:_destinationURL] error:NULL];
+    }
+
+    CURLHandleLog(@"resumable download finished at %llu with error %@", _offset, error);
+
+    [_delegateQueue addOperationWithBlock:^{
+        [_delegate resumableDownload:self didCompleteWithError:error];
+        [_delegate release]; _delegate = nil;
+    }];
+}
+
+- (NSError *)fileError;
+{
+    NSDictionary *userInfo = [NSDictionary dictionaryWithObject:[_destinationURL path] forKey:NSFilePathErrorKey];
+    return [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:userInfo];
+}
+
+- (void)notifyWillWriteFromOffset:(unsigned long long)offset;
+{
+    if ([_delegate respondsToSelector:@selector(resumableDownload:willWriteFromOffset:)])
+    {
+        [_delegateQueue addOperationWithBlock:^{
+            [_delegate resumableDownload:self willWriteFromOffset:offset];
+        }];
+    }
+}
+
+#pragma mark Validation
+
+// "bytes 100-999/1000" gives a start of 100 and total of 1000. -1 for anything missing
+static void CURLParseContentRange(NSHTTPURLResponse *response, long long *start, long long *total)
+{
+    *start = *total = -1;
+
+    NSString *range = [[response allHeaderFields] objectForKey:@"Content-Range"];
+    if (!range) return;
+
+    NSScanner *scanner = [NSScanner scannerWithString:range];
+    [scanner scanString:@"bytes" intoString:NULL];
+    if (![scanner scanLongLong:start]) *start = -1;
+
+    NSRange slash = [range rangeOfString:@"/" options:NSBackwardsSearch];
+    if (slash.location != NSNotFound)
+    {
+        scanner = [NSScanner scannerWithString:[range substringFromIndex:NSMaxRange(slash)]];
+        if (![scanner scanLongLong:total] || ![scanner isAtEnd]) *total = -1;
+    }
+}
+
+- (void)recordValidatorsFromResponse:(NSHTTPURLResponse *)response length:(long long)length;
+{
+    NSDictionary *headers = [response allHeaderFields];
+
+    // Weak ETags aren't allowed in If-Range
+    NSString *eTag = [headers objectForKey:@"ETag"];
+    if (eTag && ![eTag hasPrefix:@"W/"])
+    {
+        [_checkpoint setObject:eTag forKey:kETagKey];
+    }
+    else
+    {
+        [_checkpoint removeObjectForKey:kETagKey];
+    }
+
+    NSString *lastModified = [headers objectForKey:@"Last-Modified"];
+    if (lastModified)
+    {
+        [_checkpoint setObject:lastModified forKey:kLastModifiedKey];
+    }
+    else
+    {
+        [_checkpoint removeObjectForKey:kLastModifiedKey];
+    }
+
+    if (length >= 0)
+    {
+        [_checkpoint setObject:[NSNumber numberWithLongLong:length] forKey:kLengthKey];
+    }
+    else
+    {
+        [_checkpoint removeObjectForKey:kLengthKey];
+    }
+}
+
+/*  For FTP and SFTP, compares the size and modification date against those checkpointed
+ */
+- (BOOL)remoteFileHasChanged:(CURLTransferMetrics *)metrics length:(long long)length;
+{
+    long long expected = [self expectedLength];
+    if (length >= 0)
+    {
+        if (expected >= 0 && length != expected) return YES;
+        if ((unsigned long long)length < _offset) return YES;
+    }
+
+    NSDate *date = [metrics remoteModificationDate];
+    NSDate *expectedDate = [_checkpoint objectForKey:kModificationDateKey];
+    if (date && expectedDate && ![date isEqualToDate:expectedDate]) return YES;
+
+    return NO;
+}
+
+- (void)recordRemoteFileFromMetrics:(CURLTransferMetrics *)metrics length:(long long)length;
+{
+    if (length >= 0) [_checkpoint setObject:[NSNumber numberWithLongLong:length] forKey:kLengthKey];
+
+    NSDate *date = [metrics remoteModificationDate];
+    if (date) [_checkpoint setObject:date forKey:kModificationDateKey];
+}
+
+#pragma mark CURLTransferDelegate
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveResponse:(NSURLResponse *)response;
+{
+    if (transfer != _transfer || _finished) return;
+
+    [_lastResponse release]; _lastResponse = [response retain];
+    if (_probing || ![response isKindOfClass:[NSHTTPURLResponse class]]) return;
+
+    NSHTTPURLResponse *httpResponse = (NSHTTPURLResponse *)response;
+    NSInteger status = [httpResponse statusCode];
+
+    if (status == 206)
+    {
+        long long start, total;
+        CURLParseContentRange(httpResponse, &start, &total);
+
+        long long expected = [self expectedLength];
+        if (start != (long long)_offset || (expected >= 0 && total >= 0 && total != expected))
+        {
+            // Not the continuation we asked for. Start over with a fresh request
+            _restartRequested = YES;
+            [transfer cancel];
+            return;
+        }
+
+        [self recordValidatorsFromResponse:httpResponse length:total];
+    }
+    else if (status >= 200 && status < 300)
+    {
+        // The whole file is on its way. If we asked to resume, the file has changed (or ranges aren't
+        // supported), so start over from this response
+        if (_offset > 0)
+        {
+            if (![self discardPartialData]) return;
+            [self notifyWillWriteFromOffset:0];
+        }
+
+        [self recordValidatorsFromResponse:httpResponse length:[response expectedContentLength]];
+    }
+}
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveData:(NSData *)data;
+{
+    if (transfer != _transfer || _finished || _probing || _restartRequested) return;
+
+    const char *bytes = [data bytes];
+    size_t length = [data length];
+    while (length > 0)
+    {
+        ssize_t written = pwrite(_fileDescriptor, bytes, length, (off_t)_offset);
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+
+            [self finishWithError:[self fileError]];
+            return;
+        }
+
+        bytes += written;
+        length -= written;
+        _offset += written;
+    }
+
+    if (_offset - _checkpointedOffset >= _checkpointInterval)
+    {
+        [self saveCheckpoint];
+    }
+
+    if ([_delegate respondsToSelector:@selector(resumableDownload:didWriteDataOfLength:totalBytesWritten:totalBytesExpected:)])
+    {
+        NSUInteger written = [data length];
+        unsigned long long total = _offset;
+        long long expected = [self expectedLength];
+
+        [_delegateQueue addOperationWithBlock:^{
+            [_delegate resumableDownload:self didWriteDataOfLength:written totalBytesWritten:total totalBytesExpected:expected];
+        }];
+    }
+}
+
+- (void)transfer:(CURLTransfer *)transfer didCompleteWithError:(NSError *)error;
+{
+    if (transfer != _transfer) return;
+
+    CURLTransferMetrics *metrics = [[transfer.metrics retain] autorelease];
+    [_transfer release]; _transfer = nil;
+
+    if (_finished) return;
+
+
+    // FTP and SFTP report the length of what's being sent, which when resuming is just the remainder
+    long long length = (metrics.contentLength >= 0 ? (long long)_transferOffset + metrics.contentLength : NSURLResponseUnknownLength);
+
+    if (_probing)
+    {
+        _probing = NO;
+
+        if (!error)
+        {
+            if ([self remoteFileHasChanged:metrics length:metrics.contentLength])
+            {
+                if (![self discardPartialData]) return;
+            }
+
+            [self recordRemoteFileFromMetrics:metrics length:metrics.contentLength];
+
+            if ([self expectedLength] >= 0 && _offset == (unsigned long long)[self expectedLength])
+            {
+                [self finishWithError:nil];     // nothing left to fetch
+            }
+            else
+            {
+                [self startTransfer];
+            }
+            return;
+        }
+
+        _attempts++;    // a failed probe counts against the download too
+    }
+    else if (_restartRequested)
+    {
+        _restartRequested = NO;
+        _attempts--;    // not the transfer's fault
+
+        if ([self discardPartialData]) [self startTransfer];
+        return;
+    }
+    else if (![self isHTTP])
+    {
+        [self recordRemoteFileFromMetrics:metrics length:length];
+    }
+
+
+    if (!error)
+    {
+        [self finishWithError:nil];
+        return;
+    }
+
+    if ([[error domain] isEqualToString:NSURLErrorDomain] && [error code] == NSURLErrorCancelled)
+    {
+        [self saveCheckpoint];
+        [self finishWithError:error];
+        return;
+    }
+
+    // A resume the server can't satisfy means we have the whole file already, or it's shrunk
+    if (_offset > 0 && [_lastResponse isKindOfClass:[NSHTTPURLResponse class]] && [(NSHTTPURLResponse *)_lastResponse statusCode] == 416)
+    {
+        if ([self expectedLength] == (long long)_offset)
+        {
+            [self finishWithError:nil];
+            return;
+        }
+
+        if (![self discardPartialData]) return;
+    }
+
+    [self saveCheckpoint];
+
+    if (_attempts < _maximumAttempts)
+    {
+        CURLHandleLog(@"resuming from %llu after %@", _offset, error);
+        [self startTransfer];
+    }
+    else
+    {
+        [self finishWithError:error];
+    }
+}
+
+@end
@@ -0,0 +1,140 @@
+//
+//  CURLSegmentedDownload.h
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLTransfer.h"
+
+
+@protocol CURLSegmentedDownloadDelegate;
+
+/**
+ Downloads one large file over several connections at once, straight to disk.
+
+ The first request asks for just the first segment. If the server answers with a 206 and the full length
+ in its Content-Range header, the file is preallocated and further range requests are issued in parallel.
+ Segment sizes follow the throughput observed so far, aiming for each to take a few seconds; once the
+ whole file has been handed out, idle connections take over the back half of the largest segment still
+ running. Each segment is written with `pwrite` at its own offset.
+
+ A failed segment is retried from wherever it had got to, without disturbing the others. Later requests
+ carry an If-Range validator (a strong ETag, or Last-Modified), so a file that changes on the server
+ fails the download rather than mixing versions.
+
+ Servers that don't support ranges, and schemes other than http and https, fall back to a single stream.
+ */
+
+@interface CURLSegmentedDownload : NSObject <CURLTransferDelegate>
+{
+  @private
+    NSURLRequest                        *_request;
+    NSURL                               *_destinationURL;
+    NSURLCredential                     *_credential;
+    id <CURLSegmentedDownloadDelegate>  _delegate;
+    NSOperationQueue                    *_delegateQueue;
+    NSOperationQueue                    *_workQueue;
+
+    NSUInteger          _maximumConnections;
+    unsigned long long  _minimumSegmentLength;
+    unsigned long long  _maximumSegmentLength;
+    NSUInteger          _maximumAttemptsPerSegment;
+
+    // Only accessed on _workQueue
+    int                 _fileDescriptor;
+    NSURLResponse       *_response;
+    NSString            *_validator;
+    BOOL                _segmented;
+    unsigned long long  _length;            // ULLONG_MAX until known
+    unsigned long long  _nextOffset;        // first byte not yet handed out to a segment
+    NSMutableArray      *_activeSegments;
+    NSMutableArray      *_retrySegments;
+    unsigned long long  _bytesWritten;
+    double              _segmentSpeed;      // bytes per second, per connection, smoothed
+    BOOL                _started;
+    BOOL                _finished;
+}
+
+/**
+ @param request The request to download. Any Range header is replaced.
+ @param fileURL Where to write the file. Anything already there is replaced. On failure, the partial file is left behind.
+ @param credential Credential to use if needed. May be `nil`.
+ @param delegate Retained until the download completes or is cancelled.
+ @param queue The queue to deliver delegate messages on. If `nil`, a serial queue is created.
+ */
+- (id)initWithRequest:(NSURLRequest *)request
+       destinationURL:(NSURL *)fileURL
+           credential:(NSURLCredential *)credential
+             delegate:(id <CURLSegmentedDownloadDelegate>)delegate
+        delegateQueue:(NSOperationQueue *)queue __attribute((nonnull(1,2)));
+
+@property (readonly, copy) NSURLRequest *request;
+@property (readonly, copy) NSURL *destinationURL;
+@property (readonly, strong) id <CURLSegmentedDownloadDelegate> delegate;
+
+/**
+ The most connections to use at once; 0 is treated as 1. Default is 4. Must be set before calling -start.
+ */
+@property (assign) NSUInteger maximumConnections;
+
+/**
+ Segments are never smaller than this, other than at the very end of the file. It's also the size of the
+ first request, and files smaller than twice this aren't split. Default is 1MB. Must be set before calling -start.
+ */
+@property (assign) unsigned long long minimumSegmentLength;
+
+/**
+ Default is 64MB. Must be set before calling -start.
+ */
+@property (assign) unsigned long long maximumSegmentLength;
+
+/**
+ How many times each segment is tried before the whole download fails. Default is 3. Must be set before calling -start.
+ */
+@property (assign) NSUInteger maximumAttemptsPerSegment;
+
+/**
+ Starts downloading. Only call this once.
+ */
+- (void)start;
+
+/**
+ Stops as quickly as possible, reporting NSURLErrorCancelled to the delegate.
+ */
+- (void)cancel;
+
+@end
+
+
+#pragma mark - Delegate
+
+@protocol CURLSegmentedDownloadDelegate <NSObject>
+
+/**
+ Sent as the last message related to the download.
+
+ @param download The download.
+ @param error `nil` if the whole file was written successfully.
+ */
+- (void)segmentedDownload:(CURLSegmentedDownload *)download didCompleteWithError:(NSError *)error;
+
+@optional
+
+/**
+ Sent once, with the response to the first request. For a segmented download, that's a 206 response.
+ */
+- (void)segmentedDownload:(CURLSegmentedDownload *)download didReceiveResponse:(NSURLResponse *)response;
+
+/**
+ Sent as data is written to disk.
+
+ @param download The download.
+ @param length How many bytes were just written.
+ @param totalBytesWritten The number written so far, across all connections.
+ @param totalBytesExpected The length of the file, or NSURLResponseUnknownLength if the server didn't say.
+ */
+- (void)segmentedDownload:(CURLSegmentedDownload *)download didWriteDataOfLength:(NSUInteger)length totalBytesWritten:(unsigned long long)totalBytesWritten totalBytesExpected:(long long)totalBytesExpected;
+
+@end
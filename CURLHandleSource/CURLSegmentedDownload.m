@@ -0,0 +1,591 @@
+//
+//  CURLSegmentedDownload.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLSegmentedDownload.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+
+#define TARGET_SEGMENT_DURATION 3.0     // seconds; segment sizes aim for this given the speed seen so far
+#define MINIMUM_TIMED_DURATION 0.1      // segments quicker than this don't say much about speed
+
+
+/*  A byte range of the file, and the transfer (if any) currently fetching it
+ */
+@interface CURLDownloadSegment : NSObject
+{
+  @public
+    unsigned long long  _offset;        // next byte to write
+    unsigned long long  _end;           // exclusive. ULLONG_MAX if running to the end of an unknown length
+    unsigned long long  _requestedEnd;  // what the transfer asked for; beyond _end if another segment has taken over the tail
+    NSUInteger          _attempts;
+    CURLTransfer        *_transfer;
+    BOOL                _failed;        // transfer was cancelled because of an unusable response
+
+    CFAbsoluteTime      _startTime;
+    unsigned long long  _startOffset;
+}
+@end
+
+@implementation CURLDownloadSegment
+
+- (void)dealloc
+{
+    [_transfer release];
+    [super dealloc];
+}
+
+@end
+
+
+#pragma mark -
+
+
+@implementation CURLSegmentedDownload
+
+@synthesize request = _request;
+@synthesize destinationURL = _destinationURL;
+@synthesize delegate = _delegate;
+@synthesize maximumConnections = _maximumConnections;
+@synthesize minimumSegmentLength = _minimumSegmentLength;
+@synthesize maximumSegmentLength = _maximumSegmentLength;
+@synthesize maximumAttemptsPerSegment = _maximumAttemptsPerSegment;
+
+#pragma mark Lifecycle
+
+- (id)initWithRequest:(NSURLRequest *)request destinationURL:(NSURL *)fileURL credential:(NSURLCredential *)credential delegate:(id <CURLSegmentedDownloadDelegate>)delegate delegateQueue:(NSOperationQueue *)queue;
+{
+    NSParameterAssert(request);
+    NSParameterAssert([fileURL isFileURL]);
+
+    if (self = [self init])
+    {
+        _request = [request copy];
+        _destinationURL = [fileURL copy];
+        _credential = [credential retain];
+        _delegate = [delegate retain];
+
+        if (queue)
+        {
+            _delegateQueue = [queue retain];
+        }
+        else
+        {
+            _delegateQueue = [[NSOperationQueue alloc] init];
+            _delegateQueue.maxConcurrentOperationCount = 1;
+        }
+
+        // Transfers report to us here, which keeps disk writes off both the multi's queue and the client's
+        _workQueue = [[NSOperationQueue alloc] init];
+        _workQueue.maxConcurrentOperationCount = 1;
+
+        _maximumConnections = 4;
+        _minimumSegmentLength = 1024 * 1024;
+        _maximumSegmentLength = 64 * 1024 * 1024;
+        _maximumAttemptsPerSegment = 3;
+
+        _fileDescriptor = -1;
+        _length = ULLONG_MAX;
+        _activeSegments = [[NSMutableArray alloc] init];
+        _retrySegments = [[NSMutableArray alloc] init];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    if (_fileDescriptor >= 0) close(_fileDescriptor);
+
+    [_request release];
+    [_destinationURL release];
+    [_credential release];
+    [_delegate release];
+    [_delegateQueue release];
+    [_workQueue release];
+    [_response release];
+    [_validator release];
+    [_activeSegments release];
+    [_retrySegments release];
+
+    [super dealloc];
+}
+
+#pragma mark Control
+
+- (void)start;
+{
+    [_workQueue addOperationWithBlock:^{
+
+        NSAssert(!_started, @"CURLSegmentedDownload can only be started once");
+        _started = YES;
+        if (_finished) return;  // cancelled already
+
+        _fileDescriptor = open([[_destinationURL path] fileSystemRepresentation], O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (_fileDescriptor < 0)
+        {
+            [self finishWithError:[self fileError]];
+            return;
+        }
+
+        // Start with one segment to learn the length, and whether ranges are supported at all
+        CURLDownloadSegment *segment = [[CURLDownloadSegment alloc] init];
+        segment->_end = ([self supportsRanges] ? _minimumSegmentLength : ULLONG_MAX);
+        [self startSegment:segment];
+        [segment release];
+    }];
+}
+
+- (void)cancel;
+{
+    [_workQueue addOperationWithBlock:^{
+        if (!_finished)
+        {
+            [self finishWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+        }
+    }];
+}
+
+#pragma mark Segments
+
+- (BOOL)supportsRanges;
+{
+    NSString *scheme = [[_request URL] scheme];
+    return ([scheme caseInsensitiveCompare:@"http"] == NSOrderedSame || [scheme caseInsensitiveCompare:@"https"] == NSOrderedSame);
+}
+
+- (void)startSegment:(CURLDownloadSegment *)segment;
+{
+    NSMutableURLRequest *request = [_request mutableCopy];
+
+    if (segment->_offset > 0 || segment->_end != ULLONG_MAX)
+    {
+        NSString *range = (segment->_end == ULLONG_MAX ?
+                           [NSString stringWithFormat:@"bytes=%llu-", segment->_offset] :
+                           [NSString stringWithFormat:@"bytes=%llu-%llu", segment->_offset, segment->_end - 1]);
+        [request setValue:range forHTTPHeaderField:@"Range"];
+
+        if (_validator) [request setValue:_validator forHTTPHeaderField:@"If-Range"];
+    }
+
+    segment->_requestedEnd = segment->_end;
+    segment->_attempts++;
+    segment->_failed = NO;
+    segment->_startTime = CFAbsoluteTimeGetCurrent();
+    segment->_startOffset = segment->_offset;
+    [_activeSegments addObject:segment];
+
+    CURLHandleLog(@"starting segment %@", [request valueForHTTPHeaderField:@"Range"]);
+
+    // Any setup failure is reported back asynchronously on _workQueue, by which time the segment is ready for it
+    [segment->_transfer release];
+    segment->_transfer = [[CURLTransfer alloc] initWithRequest:request credential:_credential delegate:self delegateQueue:_workQueue];
+
+    [request release];
+}
+
+- (CURLDownloadSegment *)segmentForTransfer:(CURLTransfer *)transfer;
+{
+    for (CURLDownloadSegment *aSegment in _activeSegments)
+    {
+        if (aSegment->_transfer == transfer) return aSegment;
+    }
+
+    return nil;
+}
+
+- (unsigned long long)nextSegmentLength;
+{
+    unsigned long long result = _minimumSegmentLength;
+    if (_segmentSpeed > 0.0) result = _segmentSpeed * TARGET_SEGMENT_DURATION;
+
+    // No more than a fair share of what's left, so connections tend to finish together
+    unsigned long long fairShare = (_length - _nextOffset) / MAX(_maximumConnections, 1U);
+    result = MIN(result, fairShare);
+
+    return MIN(MAX(result, _minimumSegmentLength), _maximumSegmentLength);
+}
+
+/*  Once everything's been handed out, idle connections take over the back half of the largest segment
+ *  still in progress.
+ */
+- (CURLDownloadSegment *)newSegmentFromLargestRemainder;
+{
+    CURLDownloadSegment *largest = nil;
+    for (CURLDownloadSegment *aSegment in _activeSegments)
+    {
+        if (!largest || (aSegment->_end - aSegment->_offset) > (largest->_end - largest->_offset))
+        {
+            largest = aSegment;
+        }
+    }
+
+    if (!largest) return nil;
+
+    unsigned long long remaining = largest->_end - largest->_offset;
+    if (remaining < 2 * _minimumSegmentLength) return nil;
+
+    CURLDownloadSegment *result = [[CURLDownloadSegment alloc] init];
+    result->_offset = largest->_offset + remaining / 2;
+    result->_end = largest->_end;
+    largest->_end = result->_offset;
+
+    return result;
+}
+
+- (void)startSegmentsIfNeeded;
+{
+    if (_finished) return;
+
+    // Until the first response, only the probe runs
+    if (!_response)
+    {
+        if (![_activeSegments count] && [_retrySegments count])
+        {
+            CURLDownloadSegment *segment = [[_retrySegments objectAtIndex:0] retain];
+            [_retrySegments removeObjectAtIndex:0];
+            [self startSegment:segment];
+            [segment release];
+        }
+        return;
+    }
+
+    while ([_activeSegments count] < MAX(_maximumConnections, 1U))
+    {
+        CURLDownloadSegment *segment = nil;
+
+        if ([_retrySegments count])
+        {
+            segment = [[_retrySegments objectAtIndex:0] retain];
+            [_retrySegments removeObjectAtIndex:0];
+        }
+        else if (!_segmented)
+        {
+            break;
+        }
+        else if (_nextOffset < _length)
+        {
+            segment = [[CURLDownloadSegment alloc] init];
+            segment->_offset = _nextOffset;
+            segment->_end = MIN(_nextOffset + [self nextSegmentLength], _length);
+            _nextOffset = segment->_end;
+        }
+        else
+        {
+            segment = [self newSegmentFromLargestRemainder];
+            if (!segment) break;
+        }
+
+        [self startSegment:segment];
+        [segment release];
+    }
+}
+
+- (void)finishIfDone;
+{
+    if (_finished || !_response) return;
+    if ([_activeSegments count] || [_retrySegments count]) return;
+    if (_segmented && _nextOffset < _length) return;
+
+    [self finishWithError:nil];
+}
+
+- (void)finishWithError:(NSError *)error;
+{
+    _finished = YES;
+
+    // Remaining transfers report back once cancelled; they're ignored from here on
+    for (CURLDownloadSegment *aSegment in _activeSegments)
+    {
+        [aSegment->_transfer cancel];
+    }
+    [_retrySegments removeAllObjects];
+
+    if (_fileDescriptor >= 0)
+    {
+        if (close(_fileDescriptor) != 0 && !error) error = [self fileError];
+        _fileDescriptor = -1;
+    }
+
+    CURLHandleLog(@"segmented download finished with %llu bytes, error %@", _bytesWritten, error);
+
+    [_delegateQueue addOperationWithBlock:^{
+        [_delegate segmentedDownload:self didCompleteWithError:error];
+        [_delegate release]; _delegate = nil;
+    }];
+}
+
+#pragma mark Files
+
+- (NSError *)fileError;
+{
+    NSDictionary *userInfo = [NSDictionary dictionaryWithObject:[_destinationURL path] forKey:NSFilePathErrorKey];
+    return [NSError errorWithDomain:NSPOSIXErrorDomain code:errno userInfo:userInfo];
+}
+
+- (BOOL)preallocateLength:(unsigned long long)length;
+{
+#if defined(F_PREALLOCATE)
+    // Best effort; contiguous if possible
+    fstore_t store = { F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, (off_t)length, 0 };
+    if (fcntl(_fileDescriptor, F_PREALLOCATE, &store) == -1)
+    {
+        store.fst_flags = F_ALLOCATEALL;
+        fcntl(_fileDescriptor, F_PREALLOCATE, &store);
+    }
+#endif
+
+    return (ftruncate(_fileDescriptor, (off_t)length) == 0);
+}
+
+- (BOOL)writeBytes:(const void *)bytes length:(size_t)length offset:(unsigned long long)offset;
+{
+    while (length > 0)
+    {
+        ssize_t written = pwrite(_fileDescriptor, bytes, length, (off_t)offset);
+        if (written < 0)
+        {
+            if (errno == EINTR) continue;
+            return NO;
+        }
+
+        bytes = (const char *)bytes + written;
+        length -= written;
+        offset += written;
+    }
+
+    return YES;
+}
+
+#pragma mark Responses
+
+- (NSError *)errorForResponse:(NSURLResponse *)response description:(NSString *)description;
+{
+    NSMutableDictionary *userInfo = [NSMutableDictionary dictionaryWithObjectsAndKeys:
+                                     [_request URL], NSURLErrorFailingURLErrorKey,
+                                     [[_request URL] absoluteString], NSURLErrorFailingURLStringErrorKey,
+                                     description, NSLocalizedDescriptionKey,
+                                     nil];
+
+    if ([response isKindOfClass:[NSHTTPURLResponse class]])
+    {
+        [userInfo setObject:[NSNumber numberWithInteger:[(NSHTTPURLResponse *)response statusCode]] forKey:@(CURLINFO_RESPONSE_CODE)];
+    }
+
+    return [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorBadServerResponse userInfo:userInfo];
+}
+
+//  Total length from a Content-Range header, e.g. "bytes 0-1023/4096", or "bytes */4096" for a 416.
+//  ULLONG_MAX if missing or unknown.
+static unsigned long long CURLContentRangeTotal(NSHTTPURLResponse *response)
+{
+    NSString *range = [[response allHeaderFields] objectForKey:@"Content-Range"];
+    NSRange slash = (range ? [range rangeOfString:@"/" options:NSBackwardsSearch] : NSMakeRange(NSNotFound, 0));
+    if (slash.location == NSNotFound) return ULLONG_MAX;
+
+    NSScanner *scanner = [NSScanner scannerWithString:[range substringFromIndex:NSMaxRange(slash)]];
+    long long result;
+    return ([scanner scanLongLong:&result] && [scanner isAtEnd] && result >= 0 ? (unsigned long long)result : ULLONG_MAX);
+}
+
+- (void)handleFirstResponse:(NSURLResponse *)response segment:(CURLDownloadSegment *)segment;
+{
+    _response = [response retain];
+
+    if ([response isKindOfClass:[NSHTTPURLResponse class]])
+    {
+        NSHTTPURLResponse *httpResponse = (NSHTTPURLResponse *)response;
+        NSInteger status = [httpResponse statusCode];
+
+        if (status == 206)
+        {
+            _length = CURLContentRangeTotal(httpResponse);
+            if (_length == ULLONG_MAX)
+            {
+                [self finishWithError:[self errorForResponse:response description:@"The server didn't report the length of the file"]];
+                return;
+            }
+
+            _segmented = (_length >= 2 * _minimumSegmentLength);
+            segment->_end = MIN(segment->_end, _length);
+            _nextOffset = segment->_end;
+
+            // Weak ETags aren't allowed in If-Range
+            NSDictionary *headers = [httpResponse allHeaderFields];
+            NSString *validator = [headers objectForKey:@"ETag"];
+            if (!validator || [validator hasPrefix:@"W/"]) validator = [headers objectForKey:@"Last-Modified"];
+            _validator = [validator copy];
+
+            if (![self preallocateLength:_length])
+            {
+                [self finishWithError:[self fileError]];
+                return;
+            }
+        }
+        else if (status == 416 && CURLContentRangeTotal(httpResponse) == 0)
+        {
+            // Empty file
+            _length = 0;
+            segment->_end = 0;
+        }
+        else if (status >= 200 && status < 300)
+        {
+            // No range support; the whole file is on its way as one stream
+            if ([response expectedContentLength] >= 0) _length = [response expectedContentLength];
+            segment->_end = ULLONG_MAX;
+        }
+        else
+        {
+            [self finishWithError:[self errorForResponse:response description:[NSHTTPURLResponse localizedStringForStatusCode:status]]];
+            return;
+        }
+    }
+    else
+    {
+        if ([response expectedContentLength] >= 0) _length = [response expectedContentLength];
+    }
+
+    if ([_delegate respondsToSelector:@selector(segmentedDownload:didReceiveResponse:)])
+    {
+        [_delegateQueue addOperationWithBlock:^{
+            [_delegate segmentedDownload:self didReceiveResponse:response];
+        }];
+    }
+
+    [self startSegmentsIfNeeded];
+}
+
+#pragma mark CURLTransferDelegate
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveResponse:(NSURLResponse *)response;
+{
+    CURLDownloadSegment *segment = [self segmentForTransfer:transfer];
+    if (!segment || _finished) return;
+
+    if (!_response)
+    {
+        [self handleFirstResponse:response segment:segment];
+        return;
+    }
+
+    if (![response isKindOfClass:[NSHTTPURLResponse class]]) return;    // other schemes just stream
+
+    NSHTTPURLResponse *httpResponse = (NSHTTPURLResponse *)response;
+    NSInteger status = [httpResponse statusCode];
+
+    if (segment->_offset > 0 || segment->_end != ULLONG_MAX)
+    {
+        if (status == 206 && CURLContentRangeTotal(httpResponse) == _length) return;
+
+        if (status == 206 || (status == 200 && _validator))
+        {
+            // The length has changed, or If-Range was ignored because the file has changed
+            [self finishWithError:[self errorForResponse:response description:@"The file changed on the server during download"]];
+            return;
+        }
+    }
+    else if (status >= 200 && status < 300)
+    {
+        return;
+    }
+
+    // Can't use this response; retry if allowed
+    segment->_failed = YES;
+    [transfer cancel];
+}
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveData:(NSData *)data;
+{
+    CURLDownloadSegment *segment = [self segmentForTransfer:transfer];
+    if (!segment || segment->_failed || _finished) return;
+
+    // Another segment may have taken over the tail of this one
+    unsigned long long length = [data length];
+    if (segment->_end != ULLONG_MAX) length = MIN(length, segment->_end - segment->_offset);
+
+    if (length && ![self writeBytes:[data bytes] length:(size_t)length offset:segment->_offset])
+    {
+        [self finishWithError:[self fileError]];
+        return;
+    }
+
+    segment->_offset += length;
+    _bytesWritten += length;
+
+    if (segment->_offset >= segment->_end && segment->_requestedEnd > segment->_end)
+    {
+        [transfer cancel];
+    }
+
+    if (length && [_delegate respondsToSelector:@selector(segmentedDownload:didWriteDataOfLength:totalBytesWritten:totalBytesExpected:)])
+    {
+        unsigned long long total = _bytesWritten;
+        long long expected = (_length == ULLONG_MAX ? NSURLResponseUnknownLength : (long long)_length);
+
+        [_delegateQueue addOperationWithBlock:^{
+            [_delegate segmentedDownload:self didWriteDataOfLength:(NSUInteger)length totalBytesWritten:total totalBytesExpected:expected];
+        }];
+    }
+}
+
+- (void)transfer:(CURLTransfer *)transfer didCompleteWithError:(NSError *)error;
+{
+    CURLDownloadSegment *segment = [[self segmentForTransfer:transfer] retain];
+    if (!segment) return;
+
+    [_activeSegments removeObject:segment];
+    [segment->_transfer release]; segment->_transfer = nil;
+
+    if (_finished)
+    {
+        [segment release];
+        return;
+    }
+
+
+    // Feed the speed into sizing of later segments
+    CFAbsoluteTime elapsed = CFAbsoluteTimeGetCurrent() - segment->_startTime;
+    if (elapsed >= MINIMUM_TIMED_DURATION)
+    {
+        double speed = (segment->_offset - segment->_startOffset) / elapsed;
+        _segmentSpeed = (_segmentSpeed > 0.0 ? 0.7 * _segmentSpeed + 0.3 * speed : speed);
+    }
+
+
+    BOOL complete = (segment->_end == ULLONG_MAX ? (!error && _response) : (segment->_offset >= segment->_end));
+    if (!complete)
+    {
+        if (!error) error = [self errorForResponse:_response description:@"The server sent less data than requested"];
+
+        // Range requests can pick up where they left off; anything else has to be starting from scratch
+        BOOL canResume = (segment->_end != ULLONG_MAX || segment->_offset == 0);
+        if (canResume && segment->_attempts < _maximumAttemptsPerSegment)
+        {
+            CURLHandleLog(@"retrying segment at %llu after %@", segment->_offset, error);
+            [_retrySegments addObject:segment];
+        }
+        else
+        {
+            [self finishWithError:error];
+            [segment release];
+            return;
+        }
+    }
+    else if (segment->_end == ULLONG_MAX && _length == ULLONG_MAX)
+    {
+        _length = _bytesWritten;
+    }
+
+    [segment release];
+
+    [self startSegmentsIfNeeded];
+    [self finishIfDone];
+}
+
+@end
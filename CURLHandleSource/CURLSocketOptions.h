@@ -0,0 +1,89 @@
+//
+//  CURLSocketOptions.h
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+
+/**
+ A TCP tuning profile, applied to each connection as libcurl creates it.
+
+ Set one on a CURLMultiHandle to cover all of its transfers, or on an individual request with
+ -curl_setSocketOptions:, which takes precedence. Every setting defaults to 0 (or `NO`), meaning the
+ system's own default is left alone, so a profile only changes what it mentions.
+
+ Options the platform doesn't support (e.g. quickAck outside Linux) are silently skipped. Tuning is best
+ effort: if the kernel refuses a setting, the transfer carries on regardless.
+ */
+
+@interface CURLSocketOptions : NSObject <NSCopying, NSCoding>
+{
+  @private
+    BOOL            _noDelay;
+    NSTimeInterval  _keepAliveIdleTime;
+    NSTimeInterval  _keepAliveInterval;
+    NSUInteger      _keepAliveCount;
+    NSUInteger      _sendBufferSize;
+    NSUInteger      _receiveBufferSize;
+    BOOL            _quickAck;
+    NSUInteger      _typeOfService;
+}
+
+/**
+ Large buffers and keepalive, for long transfers over high bandwidth-delay links.
+ */
++ (CURLSocketOptions *)bulkTransferOptions;
+
+/**
+ Nagle disabled, immediate ACKs and a low-delay TOS, for small request/response traffic.
+ */
++ (CURLSocketOptions *)lowLatencyOptions;
+
+/**
+ Send and receive buffers big enough to keep a link of the given bandwidth full over the given round trip
+ (the bandwidth-delay product), and never smaller than 64KB. With SFTP, which has to wait on the server's
+ acknowledgements, TCP windows any smaller cap throughput at buffer size / round trip time.
+
+ @param bytesPerSecond The link's bandwidth.
+ @param roundTripTime e.g. from a transfer's connectTime.
+ */
++ (CURLSocketOptions *)optionsForBandwidth:(double)bytesPerSecond roundTripTime:(NSTimeInterval)roundTripTime;
+
+/**
+ TCP_NODELAY. `NO` leaves libcurl's choice alone, rather than re-enabling Nagle's algorithm.
+ */
+@property (assign) BOOL noDelay;
+
+/**
+ Setting any of these turns on SO_KEEPALIVE.
+ */
+@property (assign) NSTimeInterval keepAliveIdleTime;    // TCP_KEEPALIVE on OS X, TCP_KEEPIDLE elsewhere
+@property (assign) NSTimeInterval keepAliveInterval;    // TCP_KEEPINTVL
+@property (assign) NSUInteger keepAliveCount;           // TCP_KEEPCNT
+
+@property (assign) NSUInteger sendBufferSize;           // SO_SNDBUF, in bytes
+@property (assign) NSUInteger receiveBufferSize;        // SO_RCVBUF, in bytes
+
+/**
+ TCP_QUICKACK. Linux only.
+ */
+@property (assign) BOOL quickAck;
+
+/**
+ IP_TOS, or IPV6_TCLASS for IPv6 connections. Includes the DSCP, e.g. 0xB8 for expedited forwarding.
+ */
+@property (assign) NSUInteger typeOfService;
+
+/**
+ Applies every setting to `socket`, carrying on past any the kernel refuses.
+
+ @param error Set to the first failure, in NSPOSIXErrorDomain.
+ @return `NO` if any setting failed.
+ */
+- (BOOL)applyToSocket:(int)socket error:(NSError **)error;
+
+@end
@@ -0,0 +1,197 @@
+//
+//  CURLSocketOptions.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLSocketOptions.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+
+@implementation CURLSocketOptions
+
+@synthesize noDelay = _noDelay;
+@synthesize keepAliveIdleTime = _keepAliveIdleTime;
+@synthesize keepAliveInterval = _keepAliveInterval;
+@synthesize keepAliveCount = _keepAliveCount;
+@synthesize sendBufferSize = _sendBufferSize;
+@synthesize receiveBufferSize = _receiveBufferSize;
+@synthesize quickAck = _quickAck;
+@synthesize typeOfService = _typeOfService;
+
++ (CURLSocketOptions *)bulkTransferOptions;
+{
+    CURLSocketOptions *result = [[[self alloc] init] autorelease];
+    result.sendBufferSize = 4 * 1024 * 1024;
+    result.receiveBufferSize = 4 * 1024 * 1024;
+    result.keepAliveIdleTime = 60.0;
+    result.keepAliveInterval = 15.0;
+    result.keepAliveCount = 4;
+    result.typeOfService = 0x08;    // IPTOS_THROUGHPUT
+    return result;
+}
+
++ (CURLSocketOptions *)lowLatencyOptions;
+{
+    CURLSocketOptions *result = [[[self alloc] init] autorelease];
+    result.noDelay = YES;
+    result.quickAck = YES;
+    result.typeOfService = 0x10;    // IPTOS_LOWDELAY
+    return result;
+}
+
++ (CURLSocketOptions *)optionsForBandwidth:(double)bytesPerSecond roundTripTime:(NSTimeInterval)roundTripTime;
+{
+    double product = bytesPerSecond * roundTripTime;
+    NSUInteger size = (NSUInteger)MAX(product, 64.0 * 1024.0);
+
+    CURLSocketOptions *result = [[[self alloc] init] autorelease];
+    result.sendBufferSize = size;
+    result.receiveBufferSize = size;
+    return result;
+}
+
+#pragma mark NSCopying
+
+- (id)copyWithZone:(NSZone *)zone;
+{
+    CURLSocketOptions *result = [[[self class] allocWithZone:zone] init];
+    result->_noDelay = _noDelay;
+    result->_keepAliveIdleTime = _keepAliveIdleTime;
+    result->_keepAliveInterval = _keepAliveInterval;
+    result->_keepAliveCount = _keepAliveCount;
+    result->_sendBufferSize = _sendBufferSize;
+    result->_receiveBufferSize = _receiveBufferSize;
+    result->_quickAck = _quickAck;
+    result->_typeOfService = _typeOfService;
+    return result;
+}
+
+#pragma mark NSCoding
+
+// Requests carrying options may be archived, e.g. by NSURLCache
+
+- (id)initWithCoder:(NSCoder *)aDecoder;
+{
+    if (self = [self init])
+    {
+        _noDelay = [aDecoder decodeBoolForKey:@"noDelay"];
+        _keepAliveIdleTime = [aDecoder decodeDoubleForKey:@"keepAliveIdleTime"];
+        _keepAliveInterval = [aDecoder decodeDoubleForKey:@"keepAliveInterval"];
+        _keepAliveCount = [aDecoder decodeIntegerForKey:@"keepAliveCount"];
+        _sendBufferSize = [aDecoder decodeIntegerForKey:@"sendBufferSize"];
+        _receiveBufferSize = [aDecoder decodeIntegerForKey:@"receiveBufferSize"];
+        _quickAck = [aDecoder decodeBoolForKey:@"quickAck"];
+        _typeOfService = [aDecoder decodeIntegerForKey:@"typeOfService"];
+    }
+    return self;
+}
+
+- (void)encodeWithCoder:(NSCoder *)aCoder;
+{
+    [aCoder encodeBool:_noDelay forKey:@"noDelay"];
+    [aCoder encodeDouble:_keepAliveIdleTime forKey:@"keepAliveIdleTime"];
+    [aCoder encodeDouble:_keepAliveInterval forKey:@"keepAliveInterval"];
+    [aCoder encodeInteger:_keepAliveCount forKey:@"keepAliveCount"];
+    [aCoder encodeInteger:_sendBufferSize forKey:@"sendBufferSize"];
+    [aCoder encodeInteger:_receiveBufferSize forKey:@"receiveBufferSize"];
+    [aCoder encodeBool:_quickAck forKey:@"quickAck"];
+    [aCoder encodeInteger:_typeOfService forKey:@"typeOfService"];
+}
+
+#pragma mark Applying
+
+static BOOL CURLSetSocketOption(int socket, int level, int name, int value, NSString *description, NSError **firstError)
+{
+    if (setsockopt(socket, level, name, &value, sizeof(value)) == 0) return YES;
+
+    if (firstError && !*firstError)
+    {
+        *firstError = [NSError errorWithDomain:NSPOSIXErrorDomain
+                                          code:errno
+                                      userInfo:[NSDictionary dictionaryWithObject:[NSString stringWithFormat:@"Unable to set %@", description]
+                                                                           forKey:NSLocalizedDescriptionKey]];
+    }
+    return NO;
+}
+
+- (BOOL)applyToSocket:(int)socket error:(NSError **)error;
+{
+    NSError *firstError = nil;
+    BOOL result = YES;
+
+    if (_noDelay)
+    {
+        result &= CURLSetSocketOption(socket, IPPROTO_TCP, TCP_NODELAY, 1, @"TCP_NODELAY", &firstError);
+    }
+
+    if (_keepAliveIdleTime > 0.0 || _keepAliveInterval > 0.0 || _keepAliveCount)
+    {
+        result &= CURLSetSocketOption(socket, SOL_SOCKET, SO_KEEPALIVE, 1, @"SO_KEEPALIVE", &firstError);
+
+        if (_keepAliveIdleTime > 0.0)
+        {
+#if defined(TCP_KEEPIDLE)
+            result &= CURLSetSocketOption(socket, IPPROTO_TCP, TCP_KEEPIDLE, MAX((int)_keepAliveIdleTime, 1), @"TCP_KEEPIDLE", &firstError);
+#elif defined(TCP_KEEPALIVE)
+            result &= CURLSetSocketOption(socket, IPPROTO_TCP, TCP_KEEPALIVE, MAX((int)_keepAliveIdleTime, 1), @"TCP_KEEPALIVE", &firstError);
+#endif
+        }
+#ifdef TCP_KEEPINTVL
+        if (_keepAliveInterval > 0.0)
+        {
+            result &= CURLSetSocketOption(socket, IPPROTO_TCP, TCP_KEEPINTVL, MAX((int)_keepAliveInterval, 1), @"TCP_KEEPINTVL", &firstError);
+        }
+#endif
+#ifdef TCP_KEEPCNT
+        if (_keepAliveCount)
+        {
+            result &= CURLSetSocketOption(socket, IPPROTO_TCP, TCP_KEEPCNT, (int)_keepAliveCount, @"TCP_KEEPCNT", &firstError);
+        }
+#endif
+    }
+
+    // Buffer sizes only affect the window scale negotiated if set before connecting, which the sockopt callback is
+    if (_sendBufferSize)
+    {
+        result &= CURLSetSocketOption(socket, SOL_SOCKET, SO_SNDBUF, (int)MIN(_sendBufferSize, (NSUInteger)INT_MAX), @"SO_SNDBUF", &firstError);
+    }
+    if (_receiveBufferSize)
+    {
+        result &= CURLSetSocketOption(socket, SOL_SOCKET, SO_RCVBUF, (int)MIN(_receiveBufferSize, (NSUInteger)INT_MAX), @"SO_RCVBUF", &firstError);
+    }
+
+#ifdef TCP_QUICKACK
+    if (_quickAck)
+    {
+        result &= CURLSetSocketOption(socket, IPPROTO_TCP, TCP_QUICKACK, 1, @"TCP_QUICKACK", &firstError);
+    }
+#endif
+
+    if (_typeOfService)
+    {
+        // Even before it's bound or connected, a socket reports its family through getsockname()
+        struct sockaddr_storage address;
+        socklen_t length = sizeof(address);
+        memset(&address, 0, sizeof(address));
+
+        if (getsockname(socket, (struct sockaddr *)&address, &length) == 0 && address.ss_family == AF_INET6)
+        {
+            result &= CURLSetSocketOption(socket, IPPROTO_IPV6, IPV6_TCLASS, (int)_typeOfService, @"IPV6_TCLASS", &firstError);
+        }
+        else
+        {
+            result &= CURLSetSocketOption(socket, IPPROTO_IP, IP_TOS, (int)_typeOfService, @"IP_TOS", &firstError);
+        }
+    }
+
+    if (!result && error) *error = firstError;
+    return result;
+}
+
+@end
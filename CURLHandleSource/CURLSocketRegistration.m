@@ -8,6 +8,7 @@
 
 #import "CURLSocketRegistration.h"
 #import "CURLMultiHandle.h"
+#import "CURLTransfer+MultiSupport.h"
 
 #import <curl/curl.h>
 
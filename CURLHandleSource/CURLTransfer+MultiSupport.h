@@ -6,6 +6,7 @@
 //  Copyright (c) 2013 Karelia Software. All rights reserved.
 
 #import "CURLTransfer.h"
+#import "CURLMultiHandle.h"
 
 
 /**
@@ -17,6 +18,43 @@
 
 /** @name Internal Methods */
 
+/**
+ Creates a transfer that is set up, but not yet handed to the multi.
+ 
+ Start it (generally along with a bunch of others) using `-[CURLMultiHandle beginTransfers:]`.
+ 
+ There is no delegate queue; delegate messages are sent directly on the multi's queue, so the 
+ delegate must be quick about handling them. If setup fails, the transfer completes (and the delegate
+ is told so) before this method returns.
+ 
+ @warning Not intended for general use.
+ 
+ @return A new CURLTransfer object.
+ */
+
+- (id)initWithRequest:(NSURLRequest *)request credential:(NSURLCredential *)credential delegate:(id <CURLTransferDelegate>)delegate multi:(CURLMultiHandle *)multi __attribute((nonnull(1,4)));
+
+/**
+ If `YES`, body data isn't sent to the delegate as each read from the network comes in. Instead it's gathered up
+ over each pass the multi makes through libcurl, and delivered as one larger chunk at the end of it (or sooner,
+ should a lot build up). Only takes effect for transfers without a delegate queue, so suits delegates which can
+ deal with the data straight away on the multi's queue. Default is `NO`.
+
+ Set before beginning the transfer.
+
+ @warning Not intended for general use.
+ */
+
+@property (assign) BOOL coalescesReceivedData;
+
+/**
+ Sends any coalesced body data to the delegate.
+
+ @warning Not intended for general use. Called by <CURLMulti> on its queue.
+ */
+
+- (void)deliverCoalescedData;
+
 /**
  The CURL handle managed by this object.
 
@@ -63,3 +101,92 @@
 
 @end
 
+
+/**
+ What's been learnt about how an FTP server handles passive mode data connections.
+ */
+typedef NS_OPTIONS(NSUInteger, CURLFTPPassiveModeTraits) {
+    CURLFTPPassiveModeEPSVWorks             = 1 << 0,   // answered EPSV with 229, and the data connection opened
+    CURLFTPPassiveModeEPSVFails             = 1 << 1,   // refused EPSV, didn't answer it, or its data connection couldn't be opened
+    CURLFTPPassiveModeSkipPASVAddress       = 1 << 2,   // PASV replies give an address which can't be reached (e.g. behind NAT)
+    CURLFTPPassiveModeDataConnectionWorks   = 1 << 3,   // a data connection has been opened as described
+};
+
+/**
+ Private API used by CURLTransfer and CURLSocketRegistration.
+ Not exported in the framework.
+ */
+
+@interface CURLMultiHandle(TransferSupport)
+
+/**
+ * Has the transfer's coalesced body data delivered once the current pass over libcurl is done.
+ *
+ * @warning Used internally by <CURLTransfer>. ONLY call this on the receiver's queue
+ */
+
+- (void)noteTransferHasCoalescedData:(CURLTransfer*)transfer __attribute((nonnull));
+
+/**
+ * Gets libcurl going again on a transfer which has just been unpaused with curl_easy_pause(), as it won't
+ * necessarily notice by itself.
+ *
+ * @warning Used internally by <CURLTransfer>. ONLY call this on the receiver's queue
+ */
+
+- (void)noteTransferWasUnpaused:(CURLTransfer*)transfer __attribute((nonnull));
+
+/**
+ Update the dispatch source for a given socket and type.
+ 
+ @warning The routine is used internally by <CURLMulti> / <CURLSocket>, and shouldn't be called from your code.
+
+ @param source The current dispatch source for the given type
+ @param type Is this the source for reading or writing?
+ @param socket The raw system socket that the dispatch source should be monitoring.
+ @param registration The <CURLSocketRegistration> object that owns the source.
+ @param required Is the source required? If not, an existing source will be cancelled. If required and the source parameter is nil, and new one will be created.
+ @return The new/updated dispatch source.
+*/
+
+- (dispatch_source_t)updateSource:(dispatch_source_t)source type:(dispatch_source_type_t)type socket:(int)socket registration:(CURLSocketRegistration *)registration required:(BOOL)required;
+
+/**
+ For the remembered preference. Records the family (AF_INET or AF_INET6) a server was last reached over.
+ Pass AF_UNSPEC to forget it, so the next transfer tries both again.
+
+ @warning Used internally by <CURLTransfer>.
+ */
+- (void)noteOrigin:(NSString *)origin connectedUsingAddressFamily:(int)family;
+
+/**
+ @return AF_INET or AF_INET6 if a server has been reached before, otherwise AF_UNSPEC.
+ */
+- (int)addressFamilyForOrigin:(NSString *)origin;
+
+/**
+ For the adaptive policy. Records whether a server answered an "Expect: 100-continue" with a 100 response.
+
+ @warning Used internally by <CURLTransfer>.
+ */
+- (void)noteOrigin:(NSString *)origin answersExpectContinue:(BOOL)answers;
+
+/**
+ @return `NO` if a server has been seen to ignore "Expect: 100-continue", so there's no point waiting for it.
+ */
+- (BOOL)originAnswersExpectContinue:(NSString *)origin;
+
+/**
+ Records what's been learnt about a server's passive mode, replacing anything noted before. Pass 0 to forget it.
+
+ @warning Used internally by <CURLTransfer>.
+ */
+- (void)noteOrigin:(NSString *)origin FTPPassiveModeTraits:(CURLFTPPassiveModeTraits)traits;
+
+/**
+ @return What's known about a server's passive mode, or 0 if it hasn't been reached yet.
+ */
+- (CURLFTPPassiveModeTraits)FTPPassiveModeTraitsForOrigin:(NSString *)origin;
+
+@end
+
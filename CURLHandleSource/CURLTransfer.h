@@ -19,6 +19,8 @@
 
 
 @class CURLMultiHandle;
+@class CURLTransferMetrics;
+@class CURLSocketOptions;
 
 @protocol CURLTransferDelegate;
 
@@ -45,13 +47,34 @@ typedef NS_ENUM(NSInteger, CURLTransferState) {
     NSOperationQueue        *_delegateQueue;
     CURLTransferState         _state;
     NSError                 *_error;
+    CURLTransferMetrics     *_metrics;
     
 	char                    _errorBuffer[CURL_ERROR_SIZE];	/*" Buffer to hold string generated by CURL; this is then converted to an NSString. "*/
     BOOL                    _executing;                     // debugging
 	NSMutableData           *_headerBuffer;                 /*" The buffer that is filled with data from the header as the download progresses; it's appended to one line at a time. "*/
     NSMutableArray          *_lists;                        // Lists we need to hold on to until the handle goes away.
-	NSDictionary            *_proxies;                      /*" Dictionary of proxy information; it's released when the transfer is deallocated since it's needed for the transfer."*/
     NSInputStream           *_uploadStream;
+    BOOL                    _chunkedUpload;                 // HTTP body of unknown length, sent as it becomes available
+    dispatch_source_t       _uploadResumeTimer;             // polls a paused upload's stream. Only accessed on the multi's queue
+    NSString                *_expectHeader;                 // constant string overriding libcurl's Expect: handling, or nil
+    BOOL                    _expectContinueLearning;        // asked for a 100 Continue under the adaptive policy
+    BOOL                    _receivedContinue;
+    CURLSocketOptions       *_socketOptions;                // the request's, or the multi's, captured during setup
+    BOOL                    _addressFamilyLearning;         // under the remembered preference
+    BOOL                    _addressFamilyPinned;           // restricted to the family remembered for the server
+    BOOL                    _FTPPassiveModeLearning;        // FTP transfer on a multi which adapts its passive mode
+    NSUInteger              _FTPPassiveModeExchange;        // which passive mode commands were sent, and how they were answered
+    NSString                *_PASVAddress;                  // as given by a 227 reply
+    NSTimeInterval          _EPSVProbeTimeout;              // how long to wait for a reply to EPSV, or 0 to leave it to libcurl
+    dispatch_source_t       _EPSVProbeTimer;                // runs while that reply is awaited. Only accessed on the multi's queue
+    BOOL                    _coalescesReceivedData;
+    NSMutableData           *_coalescedData;                // body data waiting for the multi's pass to end
+
+    // Host key checks waiting on the delegate. Only accessed on the multi's queue
+    BOOL                    _hostKeyDeferred;
+    BOOL                    _hostKeyCheckFailed;
+    BOOL                    _hostKeyDecided;
+    enum curl_khstat        _hostKeyDecision;
 }
 
 //  Loading respects as many of NSURLRequest's built-in features as possible, including:
@@ -60,6 +83,11 @@ typedef NS_ENUM(NSInteger, CURLTransferState) {
 //    * Similarly, @"PUT" turns on the CURLOPT_UPLOAD option (again handy for FTP uploads)
 //  
 //    * Supply -HTTPBody or -HTTPBodyStream to switch Curl into uploading mode, regardless of protocol
+//      (an HTTP POST sends it as the POST body instead; see also -curl_uploadLength for streams)
+//
+//    * Over HTTP, a -HTTPBodyStream of unknown length is sent chunked. When run by a multi, the transfer waits
+//      for the stream to have bytes available rather than blocking in -read:maxLength:, so the stream can be
+//      fed gradually (e.g. the input half of a bound pair). Other protocols read the stream as before
 //  
 //    * Custom Range: HTTP headers are specially handled to set the CURLOPT_RANGE option, regardless of protocol in use
 //      (you should still construct the header as though it were HTTP, e.g. bytes=500-999)
@@ -95,6 +123,12 @@ typedef NS_ENUM(NSInteger, CURLTransferState) {
  */
 @property (readonly, copy) NSError *error;
 
+/*
+ * Timings and connection details, captured as the transfer completes.
+ * Available from -transfer:didCompleteWithError: onwards; nil before then.
+ */
+@property (readonly, strong) CURLTransferMetrics *metrics;
+
 /**
  CURLINFO_FTP_ENTRY_PATH. Only suitable once transfer has finished.
  
@@ -189,6 +223,13 @@ typedef NS_ENUM(NSInteger, CURLTransferState) {
  If not implemented, only matching keys are accepted; all else is rejected
  I've found that CURLKHSTAT_FINE_ADD_TO_FILE only bothers appending to the file if not already present
 
+ Decisions are remembered for the life of the process, keyed by host, known hosts file and key, so
+ repeat connections don't ask again. Returning CURLKHSTAT_DEFER is never remembered.
+
+ When running on a multi, this is sent asynchronously like any other delegate message. Only the transfer
+ in question waits for the answer; it then reconnects from scratch. The key structures are copies, valid
+ just for the duration of the call.
+
  @param transfer The transfer that's found the fingerprint
  @param foundKey The fingerprint.
  @param knownkey The known fingerprint for the host.
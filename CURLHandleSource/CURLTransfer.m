@@ -12,13 +12,15 @@
 
 #import "CURLList.h"
 #import "CURLMultiHandle.h"
+#import "CURLProxyResolver.h"
 #import "CURLRequest.h"
 #import "CURLResponse.h"
+#import "CURLSocketOptions.h"
+#import "CURLTransferError.h"
+#import "CURLTransferMetrics.h"
 
 #import "CK2SSHCredential.h"
 
-#include <SystemConfiguration/SystemConfiguration.h>
-
 #pragma mark - Constants
 
 NSString * const CURLcodeErrorDomain = @"se.haxx.curl.libcurl.CURLcode";
@@ -45,12 +47,29 @@ NSString *const kInfoNames[] =
 #define __IPHONE_5_0 (__IPHONE_OS_VERSION_MAX_ALLOWED + 1)
 #endif
 
+// Flags for _FTPPassiveModeExchange
+enum {
+    CURLFTPExchangeSentEPSV     = 1 << 0,
+    CURLFTPExchangeSentPASV     = 1 << 1,
+    CURLFTPExchangeEPSVAccepted = 1 << 2,
+    CURLFTPExchangeEPSVRefused  = 1 << 3,
+    CURLFTPExchangePASVAccepted = 1 << 4,
+};
+
+// Coalesced body data is handed over early once there's this much of it
+#define kMaximumCoalescedDataLength (256 * 1024)
+
 #pragma mark - Globals
 
 BOOL				sAllowsProxy = YES;		// by default, allow proxy to be used./
-SCDynamicStoreRef	sSCDSRef = NULL;
 NSString			*sProxyUserIDAndPassword = nil;
 
+// Easy handles finished with by a multi, already reset, kept for the next transfer to save creating a fresh one.
+// Only accessed while synchronized on CURLTransfer
+#define kMaximumRecycledHandles 16
+static CURL         *sRecycledHandles[kMaximumRecycledHandles];
+static NSUInteger   sRecycledHandleCount = 0;
+
 #pragma mark - Callback Prototypes
 
 int curlSocketOptFunction(CURLTransfer *self, curl_socket_t curlfd, curlsocktype purpose);
@@ -71,6 +90,14 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 
 - (size_t) curlReceiveDataFrom:(void *)inPtr size:(size_t)inSize number:(size_t)inNumber isHeader:(BOOL)header;
 - (size_t) curlSendDataTo:(void *)inPtr size:(size_t)inSize number:(size_t)inNumber;
+- (void)resumeAfterHostKeyDecisionIfReady;
+- (BOOL)uploadStreamIsReadable;
+- (void)waitForUploadData;
+- (void)stopWaitingForUploadData;
+- (void)startEPSVProbeTimer;
+- (void)stopEPSVProbeTimer;
+- (void)tuneSocket:(curl_socket_t)socket;
+- (void)observeFTPExchange:(const char *)info length:(size_t)length type:(curl_infotype)type;
 
 @property (strong, nonatomic) NSMutableArray* lists;
 @property (strong, nonatomic, readonly) CURLMultiHandle* multi;
@@ -83,8 +110,10 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 @synthesize originalRequest = _request;
 @synthesize state = _state;
 @synthesize error = _error;
+@synthesize metrics = _metrics;
 @synthesize lists = _lists;
 @synthesize multi = _multi;
+@synthesize coalescesReceivedData = _coalescesReceivedData;
 
 
 /*"	CURLTransfer is a wrapper around a CURL.
@@ -123,13 +152,6 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 	{
 		NSLog(@"Didn't curl_global_init, result = %d",rc);
 	}
-	
-	// Now initialize System Config. I have no idea why this signature; it's just what was in tester app
-	sSCDSRef = SCDynamicStoreCreate(NULL,CFSTR("XxXx"),NULL, NULL);
-	if ( sSCDSRef == NULL )
-	{
-		NSLog(@"Didn't get SCDynamicStoreRef");
-	}
 }
 
 /*"	Set a proxy user id and password, used by all CURLTransfer. This should be done before any transfers are made."*/
@@ -199,10 +221,12 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
         // Turn automatic redirects off by default, so can properly report them to delegate
         curl_easy_setopt([self curlHandle], CURLOPT_FOLLOWLOCATION, NO);
                 
+        // Set before setup, so that the multi's defaults can apply
+        _multi = [multi retain];
+
         CURLcode code = [self setupRequest:request credential:credential];
         if (code == CURLE_OK)
         {
-            _multi = [multi retain];
             [multi beginTransfer:self];
         }
         else
@@ -214,6 +238,27 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
     return self;
 }
 
+- (id)initWithRequest:(NSURLRequest *)request credential:(NSURLCredential *)credential delegate:(id <CURLTransferDelegate>)delegate multi:(CURLMultiHandle *)multi;
+{
+    NSParameterAssert(multi);
+    
+    if (self = [self init])
+    {
+        // No delegate queue, so messages go straight out on the multi's queue
+        _delegate = [delegate retain];
+        
+        _multi = [multi retain];    // caller is responsible for beginning us
+
+        CURLcode code = [self setupRequest:request credential:credential];
+        if (code != CURLE_OK)
+        {
+            [self completeWithCode:code];
+        }
+    }
+    
+    return self;
+}
+
 
 - (void) dealloc
 {
@@ -225,9 +270,12 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
     [_delegateQueue release];
     [_request release];
     [_error release];
+    [_metrics release];
 	[_headerBuffer release];
-	[_proxies release];
     [_uploadStream release];
+    [_socketOptions release];
+    [_PASVAddress release];
+    [_coalescedData release];
 
     CURLHandleLogDetail(@"dealloced");
     
@@ -242,7 +290,8 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 {
 	if ((self = [super init]) != nil)
 	{
-		_handle = curl_easy_init();
+		_handle = [CURLTransfer dequeueRecycledHandle];
+		if (!_handle) _handle = curl_easy_init();
 		if (_handle)
 		{
             _errorBuffer[0] = 0;	// initialize the error buffer to empty
@@ -323,47 +372,13 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 {
     CURLcode code = CURLE_OK;
 
-    NSString *proxyHost = nil;
-    NSNumber *proxyPort = nil;
-    NSString *scheme = [[[request URL] scheme] lowercaseString];
-
-    // Allocate and keep the proxy dictionary
-    if (nil == _proxies)
+    // The resolver caches its settings and decisions, so this is cheap to do for every request
+    NSString *proxy = [[CURLProxyResolver sharedResolver] proxyForURL:[request URL]];
+    if (proxy)
     {
-        _proxies = (NSDictionary *) SCDynamicStoreCopyProxies(sSCDSRef);
-    }
+        CURLHandleLog(@"Using proxy %@", proxy);
 
-
-    if (_proxies
-        && [scheme isEqualToString:@"http"]
-        && [[_proxies objectForKey:(NSString *)kSCPropNetProxiesHTTPEnable] boolValue] )
-    {
-        proxyHost = (NSString *) [_proxies objectForKey:(NSString *)kSCPropNetProxiesHTTPProxy];
-        proxyPort = (NSNumber *)[_proxies objectForKey:(NSString *)kSCPropNetProxiesHTTPPort];
-    }
-    if (_proxies
-        && [scheme isEqualToString:@"https"]
-        && [[_proxies objectForKey:(NSString *)kSCPropNetProxiesHTTPSEnable] boolValue] )
-    {
-        proxyHost = (NSString *) [_proxies objectForKey:(NSString *)kSCPropNetProxiesHTTPSProxy];
-        proxyPort = (NSNumber *)[_proxies objectForKey:(NSString *)kSCPropNetProxiesHTTPSPort];
-    }
-
-    /*	Disable FTP proxy for now as it seems to be messing up for at least one Karelia customer
-    if (_proxies
-        && [scheme isEqualToString:@"ftp"]
-        && [[_proxies objectForKey:(NSString *)kSCPropNetProxiesFTPEnable] boolValue] )
-    {
-        proxyHost = (NSString *) [_proxies objectForKey:(NSString *)kSCPropNetProxiesFTPProxy];
-        proxyPort = (NSNumber *)[_proxies objectForKey:(NSString *)kSCPropNetProxiesFTPPort];
-    }*/
-
-    if (proxyHost && proxyPort)
-    {
-	    NSLog(@"CURLTransfer: Using proxy %@:%@", proxyHost, proxyPort);
-	    
-        RETURN_IF_FAILED([self setOption:CURLOPT_PROXY string:proxyHost]);
-        RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_PROXYPORT, [proxyPort longValue]));
+        RETURN_IF_FAILED([self setOption:CURLOPT_PROXY string:proxy]);
 
         // Now, provide a user/password if one is globally set.
         if (nil != sProxyUserIDAndPassword)
@@ -442,6 +457,17 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
         }
     }
 
+    if (_expectHeader && ![request valueForHTTPHeaderField:@"Expect"])
+    {
+        [headers addObject:_expectHeader];
+    }
+
+    // Make chunking explicit, unless the client has its own ideas about framing the body
+    if (_chunkedUpload && ![request valueForHTTPHeaderField:@"Transfer-Encoding"] && ![request valueForHTTPHeaderField:@"Content-Length"])
+    {
+        [headers addObject:@"Transfer-Encoding: chunked"];
+    }
+
     RETURN_IF_FAILED([self setOption:CURLOPT_HTTPHEADER withContentsOfArray:headers]);
 
     return code;
@@ -452,30 +478,409 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
     CURLcode code = CURLE_OK;
     
     // Set the upload data
+    curl_off_t length = -1;
     NSData *uploadData = [request HTTPBody];
     if (uploadData)
     {
         _uploadStream = [[NSInputStream alloc] initWithData:uploadData];
-        RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_INFILESIZE, [uploadData length]));
+        length = [uploadData length];
     }
     else
     {
         _uploadStream = [[request HTTPBodyStream] retain];
+
+        NSNumber *knownLength = [request curl_uploadLength];
+        if (knownLength) length = [knownLength longLongValue];
     }
 
-    if (_uploadStream)
+    // CURLOPT_UPLOAD would turn an HTTP POST into a PUT, so POST bodies are fed through the read
+    // callback instead. An unknown length there means a chunked request
+    NSString *scheme = [[request URL] scheme];
+    BOOL isHTTP = ([scheme caseInsensitiveCompare:@"http"] == NSOrderedSame || [scheme caseInsensitiveCompare:@"https"] == NSOrderedSame);
+    _chunkedUpload = (isHTTP && _uploadStream && length < 0);
+
+    _expectHeader = nil;
+    _expectContinueLearning = _receivedContinue = NO;
+    if (isHTTP && _uploadStream) [self setupExpectContinueForRequest:request uploadLength:length];
+
+    if (isHTTP && [[request HTTPMethod] isEqualToString:@"POST"])
+    {
+        [_uploadStream open];
+        RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_POSTFIELDSIZE_LARGE, (_uploadStream ? length : (curl_off_t)0)));
+    }
+    else if (_uploadStream)
     {
         [_uploadStream open];
         RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_UPLOAD, 1L));
+        if (length >= 0) RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_INFILESIZE_LARGE, length));
     }
-    else
+
+    return code;
+}
+
+- (CURLMultiHandle *)multiForDefaults;
+{
+    // Synchronous transfers have no multi of their own
+    return (self.multi ? self.multi : [CURLMultiHandle sharedInstance]);
+}
+
+/*  Decides whether to send "Expect: 100-continue", leaving the header itself to -setupHeadersForRequest:
+ */
+- (void)setupExpectContinueForRequest:(NSURLRequest *)request uploadLength:(curl_off_t)length;
+{
+    CURLMultiHandle *multi = [self multiForDefaults];
+
+    CURLExpectContinuePolicy policy = [request curl_expectContinuePolicy];
+    if (policy == CURLExpectContinuePolicyDefault) policy = multi.expectContinuePolicy;
+
+    unsigned long long threshold = [request curl_expectContinueThreshold];
+    if (!threshold) threshold = multi.expectContinueThreshold;
+
+    BOOL expect;
+    switch (policy)
+    {
+        case CURLExpectContinuePolicyNever:
+            expect = NO;
+            break;
+
+        case CURLExpectContinuePolicyAlways:
+            expect = YES;
+            break;
+
+        case CURLExpectContinuePolicyThreshold:
+        case CURLExpectContinuePolicyAdaptive:
+            expect = (length < 0 || (unsigned long long)length >= threshold);
+            if (expect && policy == CURLExpectContinuePolicyAdaptive)
+            {
+                expect = _expectContinueLearning = [multi originAnswersExpectContinue:[[request URL] curl_originString]];
+            }
+            break;
+
+        default:
+            return; // libcurl's own behaviour
+    }
+
+    // An empty Expect: header stops libcurl adding its own
+    _expectHeader = (expect ? @"Expect: 100-continue" : @"Expect:");
+}
+
+/*  A server which accepted the body without ever sending 100 Continue made libcurl wait out its timeout, so
+ *  isn't worth asking again. One which rejected the request early has answered promptly enough
+ */
+- (void)learnExpectContinueOutcome;
+{
+    long code;
+    if (curl_easy_getinfo(_handle, CURLINFO_RESPONSE_CODE, &code) != CURLE_OK || code == 0) return;
+    if (!_receivedContinue && code >= 400) return;
+
+    [[self multiForDefaults] noteOrigin:[[_request URL] curl_originString] answersExpectContinue:_receivedContinue];
+}
+
+- (CURLcode)setupResolverForRequest:(NSURLRequest *)request;
+{
+    CURLcode code = CURLE_OK;
+    CURLMultiHandle *multi = [self multiForDefaults];
+
+    if (multi.requiresAsynchronousResolver && ![CURLMultiHandle asynchronousResolver]) return CURLE_NOT_BUILT_IN;
+
+    NSArray *servers = [request curl_DNSServers];
+    if (!servers) servers = multi.DNSServers;
+    if ([servers count])
+    {
+        RETURN_IF_FAILED([self setOption:CURLOPT_DNS_SERVERS string:[servers componentsJoinedByString:@","]]);
+    }
+
+    RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_DNS_CACHE_TIMEOUT, (long)multi.DNSCacheTimeout));
+
+    NSTimeInterval timeout = [request curl_resolveTimeout];
+    if (timeout <= 0.0) timeout = multi.resolveTimeout;
+    if (timeout > 0.0)
+    {
+        RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_CONNECTTIMEOUT_MS, (long)(timeout * 1000.0)));
+    }
+
+    return code;
+}
+
+- (CURLcode)setupAddressFamilyForRequest:(NSURLRequest *)request;
+{
+    CURLcode code = CURLE_OK;
+    CURLMultiHandle *multi = [self multiForDefaults];
+
+    CURLAddressFamilyPreference preference = [request curl_addressFamilyPreference];
+    if (preference == CURLAddressFamilyPreferenceDefault) preference = multi.addressFamilyPreference;
+
+    _addressFamilyLearning = (preference == CURLAddressFamilyPreferenceRemembered);
+    _addressFamilyPinned = NO;
+
+    long resolve = CURL_IPRESOLVE_WHATEVER;
+    switch (preference)
+    {
+        case CURLAddressFamilyPreferenceIPv4:
+            resolve = CURL_IPRESOLVE_V4;
+            break;
+
+        case CURLAddressFamilyPreferenceIPv6:
+            resolve = CURL_IPRESOLVE_V6;
+            break;
+
+        case CURLAddressFamilyPreferenceRemembered:
+        {
+            int family = [multi addressFamilyForOrigin:[[request URL] curl_originString]];
+            if (family == AF_INET) resolve = CURL_IPRESOLVE_V4;
+            else if (family == AF_INET6) resolve = CURL_IPRESOLVE_V6;
+            _addressFamilyPinned = (family != AF_UNSPEC);
+            break;
+        }
+
+        default:
+            break;
+    }
+    RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_IPRESOLVE, resolve));
+
+    NSTimeInterval delay = [request curl_happyEyeballsDelay];
+    if (delay <= 0.0) delay = multi.happyEyeballsDelay;
+    if (delay > 0.0)
+    {
+#if LIBCURL_VERSION_NUM >= 0x073b00
+        RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_HAPPY_EYEBALLS_TIMEOUT_MS, (long)(delay * 1000.0)));
+#else
+        CURLHandleLog(@"Ignoring happy eyeballs delay; libcurl is too old to support it");
+#endif
+    }
+
+    return code;
+}
+
+- (CURLcode)setupBufferSizesForRequest:(NSURLRequest *)request;
+{
+    CURLcode code = CURLE_OK;
+
+    // Before 7.53.0, libcurl caps the receive buffer at CURL_MAX_WRITE_SIZE
+    NSUInteger receive = [request curl_receiveBufferSize];
+    if (receive)
     {
-        RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_UPLOAD, 0));
+#if LIBCURL_VERSION_NUM < 0x073500
+        receive = MIN(receive, (NSUInteger)CURL_MAX_WRITE_SIZE);
+#endif
+        RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_BUFFERSIZE, (long)receive));
+    }
+
+    // For SFTP, the upload buffer is how much libssh2 gets to pipeline per write
+    NSUInteger upload = [request curl_uploadBufferSize];
+    if (upload)
+    {
+#if LIBCURL_VERSION_NUM >= 0x073e00
+        RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_UPLOAD_BUFFERSIZE, (long)upload));
+#else
+        CURLHandleLog(@"Ignoring upload buffer size; libcurl is too old to support it");
+#endif
     }
 
     return code;
 }
 
+- (CURLcode)setupFTPPassiveModeForRequest:(NSURLRequest *)request;
+{
+    CURLcode code = CURLE_OK;
+    CURLMultiHandle *multi = [self multiForDefaults];
+
+    NSString *scheme = [[request URL] scheme];
+    BOOL isFTP = ([scheme caseInsensitiveCompare:@"ftp"] == NSOrderedSame || [scheme caseInsensitiveCompare:@"ftps"] == NSOrderedSame);
+
+    _FTPPassiveModeLearning = (isFTP && multi.adaptsFTPPassiveMode);
+    _FTPPassiveModeExchange = 0;
+    _EPSVProbeTimeout = 0;
+    [_PASVAddress release]; _PASVAddress = nil;
+
+    // I've found that some servers claim to support EPSV but take a very long time to respond to it, if at all,
+    // often causing the overall connection to fail. So EPSV is only used for servers which have been seen to
+    // handle it, or to find out. While finding out, -observeFTPExchange: times the reply, and should it not come,
+    // the transfer is started over with PASV instead. That needs the multi's queue, so synchronous transfers
+    // leave the finding out to others, and stick to PASV until EPSV is known to work.
+    // Note IPv6 connections will ignore this and use EPSV anyway
+    long useEPSV = 0;
+    if (_FTPPassiveModeLearning)
+    {
+        CURLFTPPassiveModeTraits traits = [multi FTPPassiveModeTraitsForOrigin:[[request URL] curl_originString]];
+
+        if (traits & CURLFTPPassiveModeSkipPASVAddress)
+        {
+            RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_FTP_SKIP_PASV_IP, 1L));
+        }
+
+        if (traits & CURLFTPPassiveModeEPSVWorks)
+        {
+            useEPSV = 1;
+        }
+        else if (!(traits & CURLFTPPassiveModeEPSVFails) && self.multi)
+        {
+            useEPSV = 1;
+            _EPSVProbeTimeout = multi.FTPPassiveModeProbeTimeout;
+        }
+    }
+    RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_FTP_USE_EPSV, useEPSV));
+
+    return code;
+}
+
+/*  Watches the control connection for EPSV/PASV and their replies. libcurl itself falls back to PASV when EPSV is
+ *  refused, so the transfer goes ahead either way; this just records what happened for next time
+ */
+- (void)observeFTPExchange:(const char *)info length:(size_t)length type:(curl_infotype)type;
+{
+    if (!_FTPPassiveModeLearning || length < 4) return;
+
+    if (type == CURLINFO_HEADER_OUT)
+    {
+        if (strncasecmp(info, "EPSV", 4) == 0)
+        {
+            _FTPPassiveModeExchange |= CURLFTPExchangeSentEPSV;
+            if (_EPSVProbeTimeout > 0.0) [self startEPSVProbeTimer];
+        }
+        else if (strncasecmp(info, "PASV", 4) == 0)
+        {
+            _FTPPassiveModeExchange |= CURLFTPExchangeSentPASV;
+        }
+        return;
+    }
+
+    // Replies may come several lines at a time; only the last line of each ("nnn " rather than "nnn-") counts
+    const char *end = info + length;
+    for (const char *line = info; line + 4 <= end; )
+    {
+        const char *next = memchr(line, '\n', end - line);
+        next = (next ? next + 1 : end);
+
+        if (line[3] == ' ')
+        {
+            BOOL awaitingEPSV = ((_FTPPassiveModeExchange & CURLFTPExchangeSentEPSV) &&
+                                 !(_FTPPassiveModeExchange & (CURLFTPExchangeEPSVAccepted | CURLFTPExchangeEPSVRefused)));
+            BOOL awaitingPASV = ((_FTPPassiveModeExchange & CURLFTPExchangeSentPASV) &&
+                                 !(_FTPPassiveModeExchange & CURLFTPExchangePASVAccepted));
+
+            if (awaitingEPSV)
+            {
+                _FTPPassiveModeExchange |= (strncmp(line, "229", 3) == 0 ? CURLFTPExchangeEPSVAccepted : CURLFTPExchangeEPSVRefused);
+                [self stopEPSVProbeTimer];
+            }
+            else if (awaitingPASV && strncmp(line, "227", 3) == 0)
+            {
+                _FTPPassiveModeExchange |= CURLFTPExchangePASVAccepted;
+
+                // "227 Entering Passive Mode (h1,h2,h3,h4,p1,p2)", although the brackets are optional
+                char reply[256];
+                size_t replyLength = MIN((size_t)(next - line), sizeof(reply) - 1);
+                memcpy(reply, line, replyLength);
+                reply[replyLength] = '\0';
+
+                for (const char *digits = reply + 4; *digits; ++digits)
+                {
+                    unsigned int h1, h2, h3, h4, p1, p2;
+                    if (isdigit(*digits) && sscanf(digits, "%u,%u,%u,%u,%u,%u", &h1, &h2, &h3, &h4, &p1, &p2) == 6)
+                    {
+                        [_PASVAddress release];
+                        _PASVAddress = [[NSString alloc] initWithFormat:@"%u.%u.%u.%u", h1, h2, h3, h4];
+                        break;
+                    }
+                }
+            }
+        }
+
+        line = next;
+    }
+}
+
+/*  What a transfer's passive mode exchange says about the server. A data connection failing after a 229 counts
+ *  against EPSV; after a 227 naming an address other than the server's own, it counts against trusting that
+ *  address -- unless data connections have worked before, in which case it's more likely a passing network problem.
+ *  Only failures before any of the body has moved count; after that, the data connection evidently opened
+ */
+- (void)learnFTPPassiveModeOutcome;
+{
+    NSUInteger exchange = _FTPPassiveModeExchange;
+    if (!(exchange & (CURLFTPExchangeSentEPSV | CURLFTPExchangeSentPASV))) return;  // e.g. only quote commands
+
+    CURLMultiHandle *multi = [self multiForDefaults];
+    NSString *origin = [[_request URL] curl_originString];
+    CURLFTPPassiveModeTraits traits = [multi FTPPassiveModeTraitsForOrigin:origin];
+    CURLFTPPassiveModeTraits learnt = traits;
+
+    NSInteger errorCode = ([[_error domain] isEqualToString:NSURLErrorDomain] ? [_error code] : 0);
+    BOOL bodyMoved = ([_metrics bytesReceived] > 0 || [_metrics bytesSent] > 0);
+    BOOL dataConnectionFailed = (!bodyMoved &&
+                                 (errorCode == NSURLErrorCannotConnectToHost ||
+                                  errorCode == NSURLErrorCannotFindHost ||
+                                  errorCode == NSURLErrorTimedOut));  // connecting to somewhere which swallows packets
+    BOOL dataConnectionsHaveWorked = ((traits & CURLFTPPassiveModeDataConnectionWorks) != 0);
+
+    if ((exchange & CURLFTPExchangeEPSVRefused) ||
+        ((exchange & CURLFTPExchangeSentEPSV) && !(exchange & CURLFTPExchangeEPSVAccepted) && _error))  // never answered
+    {
+        learnt = (learnt & ~CURLFTPPassiveModeEPSVWorks) | CURLFTPPassiveModeEPSVFails;
+    }
+    else if (exchange & CURLFTPExchangeEPSVAccepted)
+    {
+        if (!_error)
+        {
+            learnt = (learnt & ~CURLFTPPassiveModeEPSVFails) | CURLFTPPassiveModeEPSVWorks;
+        }
+        else if (dataConnectionFailed && !dataConnectionsHaveWorked)
+        {
+            learnt = (learnt & ~CURLFTPPassiveModeEPSVWorks) | CURLFTPPassiveModeEPSVFails;
+        }
+    }
+
+    if (exchange & CURLFTPExchangePASVAccepted)
+    {
+        if (dataConnectionFailed && _PASVAddress && !dataConnectionsHaveWorked &&
+            ![_PASVAddress isEqualToString:[_metrics remoteAddress]])
+        {
+            learnt |= CURLFTPPassiveModeSkipPASVAddress;
+        }
+    }
+
+    if (!_error && (exchange & (CURLFTPExchangeEPSVAccepted | CURLFTPExchangePASVAccepted)))
+    {
+        learnt |= CURLFTPPassiveModeDataConnectionWorks;
+    }
+
+    if (learnt != traits)
+    {
+        CURLHandleLog(@"learnt passive mode traits %lx for %@", (unsigned long)learnt, origin);
+        [multi noteOrigin:origin FTPPassiveModeTraits:learnt];
+    }
+}
+
+/*  Remembers the family which reached the server. If a transfer confined to the remembered family couldn't
+ *  connect at all, the network has probably changed, so the memory is dropped and both get tried next time
+ */
+- (void)learnAddressFamilyOutcome;
+{
+    NSString *origin = [[_request URL] curl_originString];
+    NSString *address = [_metrics remoteAddress];
+
+    if (address && ([_metrics connectTime] > 0.0 || [_metrics isConnectionReused]))
+    {
+        int family = ([address rangeOfString:@":"].location != NSNotFound ? AF_INET6 : AF_INET);
+        [[self multiForDefaults] noteOrigin:origin connectedUsingAddressFamily:family];
+    }
+    else if (_addressFamilyPinned && _error)
+    {
+        [[self multiForDefaults] noteOrigin:origin connectedUsingAddressFamily:AF_UNSPEC];
+    }
+}
+
+- (void)tuneSocket:(curl_socket_t)socket;
+{
+    // Tuning is only ever an optimisation, so failures aren't worth abandoning the connection for
+    NSError *error;
+    if (_socketOptions && ![_socketOptions applyToSocket:socket error:&error])
+    {
+        CURLHandleLog(@"Unable to apply socket options: %@", error);
+    }
+}
+
 - (CURLcode)setupMethodForRequest:(NSURLRequest *)request
 {
     CURLcode code = CURLE_OK;
@@ -531,10 +936,20 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
     RETURN_IF_FAILED([self setOption:CURLOPT_NEW_FILE_PERMS number:[request curl_newFilePermissions]]);
     RETURN_IF_FAILED([self setOption:CURLOPT_NEW_DIRECTORY_PERMS number:[request curl_newDirectoryPermissions]]);
     RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_USE_SSL, (long)[request curl_desiredSSLLevel]));
+    RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_FILETIME, (long)[request curl_wantsRemoteModificationDate]));
     //RETURN_IF_FAILED(curl_easy_setopt(_curl, CURLOPT_CERTINFO, 1L);    // isn't supported by Darwin-SSL backend yet
     RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_SSL_VERIFYPEER, (long)[request curl_shouldVerifySSLCertificate]));
     RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_SSL_VERIFYHOST, (long)(request.curl_shouldVerifySSLHost ? 2 : 0)));
-    RETURN_IF_FAILED(curl_easy_setopt(_handle, CURLOPT_FTP_USE_EPSV, 0));     // Disable EPSV for FTP transfers. I've found that some servers claim to support EPSV but take a very long time to respond to it, if at all, often causing the overall connection to fail. Note IPv6 connections will ignore this and use EPSV anyway
+
+    RETURN_IF_FAILED([self setupFTPPassiveModeForRequest:request]);
+    RETURN_IF_FAILED([self setupResolverForRequest:request]);
+    RETURN_IF_FAILED([self setupAddressFamilyForRequest:request]);
+    RETURN_IF_FAILED([self setupBufferSizesForRequest:request]);
+
+    // socket tuning, which is applied as each new connection is made
+    CURLSocketOptions *socketOptions = [request curl_socketOptions];
+    if (!socketOptions) socketOptions = [[self multiForDefaults] socketOptions];
+    [_socketOptions release]; _socketOptions = [socketOptions retain];
 
     // functions
     RETURN_IF_FAILED([self setOption:CURLOPT_SOCKOPTFUNCTION data:CURLOPT_SOCKOPTDATA function:curlSocketOptFunction]);
@@ -555,8 +970,8 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
     }
 
     RETURN_IF_FAILED([self setupMethodForRequest:request]);
-    RETURN_IF_FAILED([self setupHeadersForRequest:request]);
     RETURN_IF_FAILED([self setupUploadForRequest:request]);
+    RETURN_IF_FAILED([self setupHeadersForRequest:request]);
     RETURN_IF_FAILED([self setOption:CURLOPT_PREQUOTE withContentsOfArray:[request curl_preTransferCommands]]);
     RETURN_IF_FAILED([self setOption:CURLOPT_POSTQUOTE withContentsOfArray:[request curl_postTransferCommands]]);
 
@@ -585,11 +1000,13 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
         
         if (cleanupHandleToo)
         {
-            curl_easy_cleanup(_handle);
+            [CURLTransfer recycleHandle:_handle];
             _handle = NULL;
         }
     }
     
+    [self stopWaitingForUploadData];
+    [self stopEPSVProbeTimer];
     if (_uploadStream)
     {
         [_uploadStream close];
@@ -602,6 +1019,35 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
     _executing = NO;
 }
 
+#pragma mark Handle Reuse
+
+/*  Creating an easy handle allocates and initialises a fair amount of state inside libcurl, which adds up for
+ *  short requests. A reset handle is as good as new, and keeps its TLS session cache to speed up the next
+ *  connection to the same server.
+ */
++ (CURL *)dequeueRecycledHandle;
+{
+    @synchronized([CURLTransfer class])
+    {
+        if (!sRecycledHandleCount) return NULL;
+        return sRecycledHandles[--sRecycledHandleCount];
+    }
+}
+
++ (void)recycleHandle:(CURL *)handle;
+{
+    @synchronized([CURLTransfer class])
+    {
+        if (sRecycledHandleCount < kMaximumRecycledHandles)
+        {
+            sRecycledHandles[sRecycledHandleCount++] = handle;
+            return;
+        }
+    }
+
+    curl_easy_cleanup(handle);
+}
+
 #pragma mark - Completion
 
 - (void)cancel;
@@ -617,10 +1063,11 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
         //
         // We use the CURLMulti's queue to synchronize access to this ivar, and
         // deliberately make the usage synchronous so that self.state is correct upon
-        // returning from this method. Deadlock *shouldn't* be possible since client
-        // code should always run on _delegateQueue rather than CURLMulti's.
+        // returning from this method. Delegates without a queue of their own (e.g. CURLProtocol)
+        // are messaged on the multi's queue, and may well cancel from there; that's done inline
+        // as a dispatch_sync would deadlock.
         dispatch_queue_t queue = multi.queue;
-        dispatch_sync(queue, ^{
+        void (^markCanceling)(void) = ^{
             
             if (_state < CURLTransferStateCanceling)
             {
@@ -638,7 +1085,16 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
                     });
                 });
             }
-        });
+        };
+        
+        if ([multi isCurrentQueue])
+        {
+            markCanceling();
+        }
+        else
+        {
+            dispatch_sync(queue, markCanceling);
+        }
     }
     else    // synchronous usage
     {
@@ -650,6 +1106,17 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 {
     CURLHandleLog(@"completed with %@ code %d", isMultiCode ? @"multi" : @"easy", code);
     
+    if (_hostKeyDeferred && code == CURLE_PEER_FAILED_VERIFICATION)
+    {
+        // Not a real failure; just the delegate still deciding about the host key
+        _hostKeyCheckFailed = YES;
+        [self resumeAfterHostKeyDecisionIfReady];
+        return;
+    }
+    
+    // Anything else means libcurl has given up for its own reasons; a late answer has nothing to resume
+    _hostKeyDeferred = _hostKeyCheckFailed = _hostKeyDecided = NO;
+    
     NSError *error = nil;
     if (code != CURLE_OK)
     {
@@ -662,10 +1129,21 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 
 - (void)completeWithError:(NSError *)error;
 {
-    _error = [error copy];
+    [_error release]; _error = [error copy];
     _state = CURLTransferStateCompleted;
     
+    // Must be read before cleanup resets the handle
+    if (_handle)
+    {
+        if (_expectContinueLearning && (!error || _receivedContinue)) [self learnExpectContinueOutcome];
+
+        [_metrics release]; _metrics = [[CURLTransferMetrics metricsWithHandle:_handle] retain];
+        if (_addressFamilyLearning) [self learnAddressFamilyOutcome];
+        if (_FTPPassiveModeLearning) [self learnFTPPassiveModeOutcome];
+    }
+    
     [self notifyDelegateOfResponseIfNeeded];
+    [self deliverCoalescedData];
     
     if (!error)
     {
@@ -730,99 +1208,101 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 
 - (NSError*)errorForURL:(NSURL*)url code:(CURLcode)code
 {
-    NSMutableDictionary *userInfo = [[NSMutableDictionary alloc] initWithObjectsAndKeys:
-                                     url, NSURLErrorFailingURLErrorKey,
-                                     [url absoluteString], NSURLErrorFailingURLStringErrorKey,
-                                     [NSString stringWithUTF8String:_errorBuffer], NSLocalizedDescriptionKey,
-                                     [NSString stringWithUTF8String:curl_easy_strerror(code)], NSLocalizedFailureReasonErrorKey,
-                                     nil];
-    
+    // Just capture the raw details; CURLTransferError builds its userInfo on demand
     long responseCode;
-    if (curl_easy_getinfo(_handle, CURLINFO_RESPONSE_CODE, &responseCode) == CURLE_OK && responseCode)
-    {
-        [userInfo setObject:[NSNumber numberWithLong:responseCode] forKey:@(CURLINFO_RESPONSE_CODE)];
-    }
-    
-    long osErrorNumber = 0;
-    if (curl_easy_getinfo(_handle, CURLINFO_OS_ERRNO, &osErrorNumber) == CURLE_OK && osErrorNumber)
-    {
-        [userInfo setObject:[NSError errorWithDomain:NSPOSIXErrorDomain code:osErrorNumber userInfo:nil]
-                     forKey:NSUnderlyingErrorKey];
-    }
+    if (curl_easy_getinfo(_handle, CURLINFO_RESPONSE_CODE, &responseCode) != CURLE_OK) responseCode = 0;
     
-    NSError* result = [NSError errorWithDomain:CURLcodeErrorDomain code:code userInfo:userInfo];
-    [userInfo release];
+    long osErrorNumber;
+    if (curl_easy_getinfo(_handle, CURLINFO_OS_ERRNO, &osErrorNumber) != CURLE_OK) osErrorNumber = 0;
     
     
     // Try to generate a Cocoa-friendly error on top of the raw libCurl one
+    NSString *domain = CURLcodeErrorDomain;
+    NSInteger errorCode = code;
+    
     switch (code)
     {
         case CURLE_UNSUPPORTED_PROTOCOL:
-            result = [self errorWithDomain:NSURLErrorDomain code:NSURLErrorUnsupportedURL underlyingError:result];
+            domain = NSURLErrorDomain;
+            errorCode = NSURLErrorUnsupportedURL;
             break;
             
         case CURLE_URL_MALFORMAT:
-            result = [self errorWithDomain:NSURLErrorDomain code:NSURLErrorBadURL underlyingError:result];
+            domain = NSURLErrorDomain;
+            errorCode = NSURLErrorBadURL;
             break;
             
         case CURLE_COULDNT_RESOLVE_HOST:
         case CURLE_FTP_CANT_GET_HOST:
-            result = [self errorWithDomain:NSURLErrorDomain code:NSURLErrorCannotFindHost underlyingError:result];
+            domain = NSURLErrorDomain;
+            errorCode = NSURLErrorCannotFindHost;
             break;
             
         case CURLE_COULDNT_CONNECT:
-            result = [self errorWithDomain:NSURLErrorDomain code:NSURLErrorCannotConnectToHost underlyingError:result];
+            domain = NSURLErrorDomain;
+            errorCode = NSURLErrorCannotConnectToHost;
             break;
             
         case CURLE_WRITE_ERROR:
-            result = [self errorWithDomain:NSURLErrorDomain code:NSURLErrorCannotWriteToFile underlyingError:result];
+            domain = NSURLErrorDomain;
+            errorCode = NSURLErrorCannotWriteToFile;
             break;
             
             //case CURLE_FTP_ACCEPT_TIMEOUT:    seems to have been added in a newer version of Curl than ours
         case CURLE_OPERATION_TIMEDOUT:
-            result = [self errorWithDomain:NSURLErrorDomain code:NSURLErrorTimedOut underlyingError:result];
+            domain = NSURLErrorDomain;
+            errorCode = NSURLErrorTimedOut;
             break;
             
         case CURLE_SSL_CONNECT_ERROR:
-            result = [self errorWithDomain:NSURLErrorDomain code:NSURLErrorSecureConnectionFailed underlyingError:result];
+            domain = NSURLErrorDomain;
+            errorCode = NSURLErrorSecureConnectionFailed;
             break;
             
         case CURLE_TOO_MANY_REDIRECTS:
-            result = [self errorWithDomain:NSURLErrorDomain code:NSURLErrorHTTPTooManyRedirects underlyingError:result];
+            domain = NSURLErrorDomain;
+            errorCode = NSURLErrorHTTPTooManyRedirects;
             break;
             
         case CURLE_BAD_CONTENT_ENCODING:
-            result = [self errorWithDomain:NSCocoaErrorDomain code:NSFileWriteInapplicableStringEncodingError underlyingError:result];
+            domain = NSCocoaErrorDomain;
+            errorCode = NSFileWriteInapplicableStringEncodingError;
             break;
             
 #if MAC_OS_X_VERSION_10_5 <= MAC_OS_X_VERSION_MAX_ALLOWED || __IPHONE_2_0 <= __IPHONE_OS_VERSION_MAX_ALLOWED
         case CURLE_FILESIZE_EXCEEDED:
-            result = [self errorWithDomain:NSURLErrorDomain code:NSURLErrorDataLengthExceedsMaximum underlyingError:result];
+            domain = NSURLErrorDomain;
+            errorCode = NSURLErrorDataLengthExceedsMaximum;
             break;
 #endif
             
 #if MAC_OS_X_VERSION_10_7 <= MAC_OS_X_VERSION_MAX_ALLOWED
         case CURLE_SEND_FAIL_REWIND:
-            result = [self errorWithDomain:NSURLErrorDomain code:NSURLErrorRequestBodyStreamExhausted underlyingError:result];
+            domain = NSURLErrorDomain;
+            errorCode = NSURLErrorRequestBodyStreamExhausted;
             break;
 #endif
             
         case CURLE_LOGIN_DENIED:
-            result = [self errorWithDomain:NSURLErrorDomain code:NSURLErrorUserAuthenticationRequired underlyingError:result];
+            domain = NSURLErrorDomain;
+            errorCode = NSURLErrorUserAuthenticationRequired;
             break;
             
         case CURLE_REMOTE_DISK_FULL:
-            result = [self errorWithDomain:NSCocoaErrorDomain code:NSFileWriteOutOfSpaceError underlyingError:result];
+            domain = NSCocoaErrorDomain;
+            errorCode = NSFileWriteOutOfSpaceError;
             break;
             
 #if MAC_OS_X_VERSION_10_7 <= MAC_OS_X_VERSION_MAX_ALLOWED || __IPHONE_5_0 <= __IPHONE_OS_VERSION_MAX_ALLOWED
         case CURLE_REMOTE_FILE_EXISTS:
-            result = [self errorWithDomain:NSCocoaErrorDomain code:NSFileWriteFileExistsError underlyingError:result];
+            domain = NSCocoaErrorDomain;
+            errorCode = NSFileWriteFileExistsError;
             break;
 #endif
             
         case CURLE_REMOTE_FILE_NOT_FOUND:
-            result = [self errorWithDomain:NSURLErrorDomain code:NSURLErrorResourceUnavailable underlyingError:result];
+            domain = NSURLErrorDomain;
+            errorCode = NSURLErrorResourceUnavailable;
             break;
             
         case CURLE_SSL_CACERT:
@@ -846,17 +1326,13 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
             break;
     }
     
-    return result;
-}
-
-- (NSError *)errorWithDomain:(NSString *)domain code:(NSInteger)code underlyingError:(NSError *)underlyingError;
-{
-    NSMutableDictionary *userInfo = [[NSMutableDictionary alloc] initWithDictionary:[underlyingError userInfo]];
-    [userInfo setObject:underlyingError forKey:NSUnderlyingErrorKey];
-    
-    NSError *result = [NSError errorWithDomain:domain code:code userInfo:userInfo];
-    [userInfo release];
-    return result;
+    return [[[CURLTransferError alloc] initWithDomain:domain
+                                                 code:errorCode
+                                                  URL:url
+                                             curlCode:code
+                                         responseCode:responseCode
+                                        osErrorNumber:osErrorNumber
+                                          errorBuffer:_errorBuffer] autorelease];
 }
 
 #pragma mark - Multi Support
@@ -917,6 +1393,19 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
     }
 }
 
+- (void)deliverCoalescedData;
+{
+    if (!_coalescedData) return;
+
+    // Hand over the buffer itself; the next read starts a new one
+    NSData *data = [_coalescedData autorelease];
+    _coalescedData = nil;
+
+    [self tryToPerformSelectorOnDelegate:@selector(transfer:didReceiveData:) usingBlock:^{
+        [self.delegate transfer:self didReceiveData:data];
+    }];
+}
+
 - (void)notifyDelegateOfResponseIfNeeded;
 {
     // If a response has been buffered, send that off
@@ -967,10 +1456,20 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 
 	if (self.state < CURLTransferStateCanceling || self.multi)
 	{
-        NSData *data = [NSData dataWithBytes:inPtr length:written];
-
 		if (header)
 		{
+            NSData *data = [NSData dataWithBytes:inPtr length:written];
+
+            // Spot the status line of an interim "HTTP/1.1 100 Continue"
+            if (_expectContinueLearning && written > 12 && memcmp(inPtr, "HTTP/", 5) == 0)
+            {
+                const char *space = memchr(inPtr, ' ', written);
+                if (space && (space + 4) <= ((const char *)inPtr + written) && strncmp(space + 1, "100", 3) == 0)
+                {
+                    _receivedContinue = YES;
+                }
+            }
+
             // Delegate might not care about the response
             if ([self.delegate respondsToSelector:@selector(transfer:didReceiveResponse:)])
             {
@@ -982,10 +1481,26 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
             // Once the body starts arriving, we know we have the full header, so can report that
             [self notifyDelegateOfResponseIfNeeded];
 
-            // Report regular body data
-            [self tryToPerformSelectorOnDelegate:@selector(transfer:didReceiveData:) usingBlock:^{
-                [self.delegate transfer:self didReceiveData:data];
-            }];
+            if (_coalescesReceivedData && !_delegateQueue && self.multi)
+            {
+                // Save up for the end of the multi's pass, rather than a message per read
+                if (!_coalescedData)
+                {
+                    _coalescedData = [[NSMutableData alloc] initWithCapacity:MAX(written, CURL_MAX_WRITE_SIZE * 4)];
+                    [self.multi noteTransferHasCoalescedData:self];
+                }
+                [_coalescedData appendBytes:inPtr length:written];
+
+                if ([_coalescedData length] >= kMaximumCoalescedDataLength) [self deliverCoalescedData];
+            }
+            else
+            {
+                // Report regular body data
+                NSData *data = [NSData dataWithBytes:inPtr length:written];
+                [self tryToPerformSelectorOnDelegate:@selector(transfer:didReceiveData:) usingBlock:^{
+                    [self.delegate transfer:self didReceiveData:data];
+                }];
+            }
 		}
 	}
     else
@@ -1003,6 +1518,13 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 
     if (self.state < CURLTransferStateCanceling || self.multi)
     {
+        // Rather than block the multi waiting for a chunked body to be produced, pause until there's more
+        if (_chunkedUpload && self.multi && ![self uploadStreamIsReadable])
+        {
+            [self waitForUploadData];
+            return CURL_READFUNC_PAUSE;
+        }
+
         result = [_uploadStream read:inPtr maxLength:inSize * inNumber];
         if (result < 0)
         {
@@ -1037,21 +1559,265 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
     return result;
 }
 
+#pragma mark Chunked Uploads
+
+// A producer which is keeping up usually has more data almost straight away, so the stream is checked again
+// quickly at first. One which has gone quiet is checked less and less often, so an idle upload costs little
+#define UPLOAD_POLL_INTERVAL (10 * NSEC_PER_MSEC)
+#define UPLOAD_POLL_MAXIMUM_INTERVAL (250 * NSEC_PER_MSEC)
+
+/*  Whether reading won't block: there's data, or the stream has finished one way or another
+ */
+- (BOOL)uploadStreamIsReadable;
+{
+    NSStreamStatus status = [_uploadStream streamStatus];
+    return (status == NSStreamStatusAtEnd || status == NSStreamStatusClosed || status == NSStreamStatusError || [_uploadStream hasBytesAvailable]);
+}
+
+/*  NSInputStream can only report availability on a run loop, which the multi's queue doesn't have, so poll
+ *  the stream while paused. Runs on the multi's queue
+ */
+- (void)waitForUploadData;
+{
+    if (_uploadResumeTimer) return;
+
+    __block uint64_t interval = UPLOAD_POLL_INTERVAL;
+    _uploadResumeTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, self.multi.queue);
+    dispatch_source_set_timer(_uploadResumeTimer, dispatch_time(DISPATCH_TIME_NOW, interval), DISPATCH_TIME_FOREVER, interval / 2);
+
+    dispatch_source_set_event_handler(_uploadResumeTimer, ^{
+        if (self.state >= CURLTransferStateCanceling)
+        {
+            [self stopWaitingForUploadData];
+        }
+        else if ([self uploadStreamIsReadable])
+        {
+            [self stopWaitingForUploadData];
+            CURLHandleLog(@"resuming chunked upload");
+            curl_easy_pause(_handle, CURLPAUSE_CONT);
+            [self.multi noteTransferWasUnpaused:self];
+        }
+        else
+        {
+            interval = MIN(interval * 2, UPLOAD_POLL_MAXIMUM_INTERVAL);
+            dispatch_source_set_timer(_uploadResumeTimer, dispatch_time(DISPATCH_TIME_NOW, interval), DISPATCH_TIME_FOREVER, interval / 2);
+        }
+    });
+
+    dispatch_resume(_uploadResumeTimer);
+}
+
+- (void)stopWaitingForUploadData;
+{
+    if (!_uploadResumeTimer) return;
+
+    dispatch_source_cancel(_uploadResumeTimer);
+    dispatch_release(_uploadResumeTimer);
+    _uploadResumeTimer = NULL;
+}
+
+#pragma mark EPSV Probes
+
+/*  Gives a server whose EPSV support is unknown so long to answer it. Runs on the multi's queue, from libcurl's
+ *  debug callback, so libcurl's own options are left alone while it's working
+ */
+- (void)startEPSVProbeTimer;
+{
+    if (_EPSVProbeTimer) return;
+
+    _EPSVProbeTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, self.multi.queue);
+    dispatch_source_set_timer(_EPSVProbeTimer, dispatch_time(DISPATCH_TIME_NOW, (int64_t)(_EPSVProbeTimeout * NSEC_PER_SEC)), DISPATCH_TIME_FOREVER, NSEC_PER_SEC / 10);
+
+    dispatch_source_set_event_handler(_EPSVProbeTimer, ^{
+        [self stopEPSVProbeTimer];
+        if (self.state >= CURLTransferStateCanceling) return;
+
+        // Nothing has been downloaded or uploaded yet, so the transfer can quietly go again without EPSV
+        CURLHandleLog(@"EPSV went unanswered; starting over with PASV");
+        CURLMultiHandle *multi = self.multi;
+        [multi suspendTransfer:self];   // gives up on the stuck connection
+
+        NSString *origin = [[_request URL] curl_originString];
+        CURLFTPPassiveModeTraits traits = [multi FTPPassiveModeTraitsForOrigin:origin];
+        [multi noteOrigin:origin FTPPassiveModeTraits:(traits & ~CURLFTPPassiveModeEPSVWorks) | CURLFTPPassiveModeEPSVFails];
+
+        _FTPPassiveModeExchange = 0;
+        _EPSVProbeTimeout = 0.0;
+        [_PASVAddress release]; _PASVAddress = nil;
+        [_headerBuffer setLength:0];
+
+        CURLcode code = curl_easy_setopt(_handle, CURLOPT_FTP_USE_EPSV, 0L);
+        if (code == CURLE_OK)
+        {
+            [multi beginTransfer:self];
+        }
+        else
+        {
+            [self completeWithCode:code];
+        }
+    });
+
+    dispatch_resume(_EPSVProbeTimer);
+}
+
+- (void)stopEPSVProbeTimer;
+{
+    if (!_EPSVProbeTimer) return;
+
+    dispatch_source_cancel(_EPSVProbeTimer);
+    dispatch_release(_EPSVProbeTimer);
+    _EPSVProbeTimer = NULL;
+}
+
+#pragma mark Host Keys
+
+static NSMutableDictionary *sHostKeyDecisions = nil;
+
+/*  Identifies a host key decision. The known hosts file and match are included since the same key can
+ *  deserve a different answer against a different file.
+ */
+- (NSData *)hostKeyDecisionKeyForFingerprint:(const struct curl_khkey *)key match:(enum curl_khmatch)match;
+{
+    NSURL *url = [_request URL];
+    NSString *prefix = [NSString stringWithFormat:@"%@ %@ %d %d ",
+                        [url curl_originString],
+                        [[_request curl_SSHKnownHostsFileURL] path],
+                        key->keytype,
+                        match];
+
+    NSMutableData *result = [[[prefix dataUsingEncoding:NSUTF8StringEncoding] mutableCopy] autorelease];
+    [result appendBytes:key->key length:(key->len ? key->len : strlen(key->key))];
+    return result;
+}
+
++ (BOOL)getHostKeyDecision:(enum curl_khstat *)decision forKey:(NSData *)key;
+{
+    @synchronized([CURLTransfer class])
+    {
+        NSNumber *cached = [sHostKeyDecisions objectForKey:key];
+        if (!cached) return NO;
+
+        *decision = [cached intValue];
+
+        // Adding to the file only needs doing the once
+        if (*decision == CURLKHSTAT_FINE_ADD_TO_FILE)
+        {
+            [sHostKeyDecisions setObject:[NSNumber numberWithInt:CURLKHSTAT_FINE] forKey:key];
+        }
+
+        return YES;
+    }
+}
+
++ (void)setHostKeyDecision:(enum curl_khstat)decision forKey:(NSData *)key;
+{
+    if (decision == CURLKHSTAT_DEFER) return;
+
+    @synchronized([CURLTransfer class])
+    {
+        if (!sHostKeyDecisions) sHostKeyDecisions = [[NSMutableDictionary alloc] init];
+        [sHostKeyDecisions setObject:[NSNumber numberWithInt:decision] forKey:key];
+    }
+}
+
+/*  Copies a key handed to us by libcurl, so it can outlive the callback
+ */
+static NSData *CURLCopyHostKeyData(const struct curl_khkey *key)
+{
+    if (!key) return nil;
+    
+    // Keys without a length are NUL-terminated base64; keep the terminator
+    size_t length = (key->len ? key->len : strlen(key->key) + 1);
+    return [NSData dataWithBytes:key->key length:length];
+}
+
 - (enum curl_khstat)didFindHostFingerprint:(const struct curl_khkey *)foundKey knownFingerprint:(const struct curl_khkey *)knownkey match:(enum curl_khmatch)match;
 {
-    __block enum curl_khstat result;
+    NSData *decisionKey = [self hostKeyDecisionKeyForFingerprint:foundKey match:match];
+
+    enum curl_khstat result;
+    if ([CURLTransfer getHostKeyDecision:&result forKey:decisionKey]) return result;
     
-    if ([self tryToPerformSelectorOnDelegate:@selector(transfer:didFindHostFingerprint:knownFingerprint:match:) usingBlock:^{
-        
-        result = [self.delegate transfer:self didFindHostFingerprint:foundKey knownFingerprint:knownkey match:match];
-    }])
+    if (![self.delegate respondsToSelector:@selector(transfer:didFindHostFingerprint:knownFingerprint:match:)])
+    {
+        return (match == CURLKHMATCH_OK ? CURLKHSTAT_FINE : CURLKHSTAT_REJECT);
+    }
+    
+    CURLMultiHandle *multi = self.multi;
+    if (!multi || !_delegateQueue)
     {
-        [_delegateQueue waitUntilAllOperationsAreFinished]; // ideally ought to wait till just the op finishes
+        // Synchronous, or delegate is called directly on the multi's queue anyway
+        result = [self.delegate transfer:self didFindHostFingerprint:foundKey knownFingerprint:knownkey match:match];
+        [CURLTransfer setHostKeyDecision:result forKey:decisionKey];
         return result;
     }
+    
+    
+    // Ask the delegate without holding up the multi. libcurl will fail this attempt once we return
+    // CURLKHSTAT_DEFER; -completeWithCode: spots that and waits for the answer before going again
+    NSData *foundData = CURLCopyHostKeyData(foundKey);
+    NSData *knownData = CURLCopyHostKeyData(knownkey);
+    enum curl_khtype foundType = foundKey->keytype;
+    enum curl_khtype knownType = (knownkey ? knownkey->keytype : CURLKHTYPE_UNKNOWN);
+    size_t foundLength = foundKey->len;
+    size_t knownLength = (knownkey ? knownkey->len : 0);
+    
+    _hostKeyDeferred = YES;
+    
+    // The delegate is held by the block, so it's still around to answer even if the transfer lets go of it
+    id <CURLTransferDelegate> delegate = self.delegate;
+    
+    [_delegateQueue addOperationWithBlock:^{
+        
+        // Nobody left to ask, so don't trust the key. Nor cache that, as it's not a real answer
+        enum curl_khstat decision = CURLKHSTAT_REJECT;
+        if (_state < CURLTransferStateCanceling && delegate)
+        {
+            struct curl_khkey found = { [foundData bytes], foundLength, foundType };
+            struct curl_khkey known = { [knownData bytes], knownLength, knownType };
+            
+            decision = [delegate transfer:self
+                   didFindHostFingerprint:&found
+                         knownFingerprint:(knownData ? &known : NULL)
+                                    match:match];
+            
+            [CURLTransfer setHostKeyDecision:decision forKey:decisionKey];
+        }
+        
+        dispatch_async(multi.queue, ^{
+            // The transfer may have finished some other way while the delegate was thinking
+            if (!_hostKeyDeferred) return;
+            
+            _hostKeyDecision = decision;
+            _hostKeyDecided = YES;
+            [self resumeAfterHostKeyDecisionIfReady];
+        });
+    }];
+    
+    return CURLKHSTAT_DEFER;
+}
+
+/*  Called on the multi's queue. Waits for both libcurl to have given up on the deferred attempt, and
+ *  for the delegate to have answered.
+ */
+- (void)resumeAfterHostKeyDecisionIfReady;
+{
+    if (!_hostKeyCheckFailed || !_hostKeyDecided) return;
+    
+    _hostKeyDeferred = _hostKeyCheckFailed = _hostKeyDecided = NO;
+    
+    // If cancelled in the meantime, -cancel takes care of completing
+    if (_state >= CURLTransferStateCanceling) return;
+    
+    if (_hostKeyDecision == CURLKHSTAT_FINE || _hostKeyDecision == CURLKHSTAT_FINE_ADD_TO_FILE)
+    {
+        // Go again from the top; the decision will come straight out of the cache this time
+        CURLHandleLog(@"host key accepted; reconnecting");
+        [self.multi beginTransfer:self];
+    }
     else
     {
-        return (match == CURLKHMATCH_OK ? CURLKHSTAT_FINE : CURLKHSTAT_REJECT);
+        [self completeWithCode:CURLE_PEER_FAILED_VERIFICATION];
     }
 }
 
@@ -1070,6 +1836,11 @@ static int curlKnownHostsFunction(CURL *easy,     /* easy handle */
 
 int curlDebugFunction(CURL *curl, curl_infotype infoType, char *info, size_t infoLength, CURLTransfer *self)
 {
+    if (infoType == CURLINFO_HEADER_IN || infoType == CURLINFO_HEADER_OUT)
+    {
+        [self observeFTPExchange:info length:infoLength type:infoType];
+    }
+
     BOOL delegateResponds = [self.delegate respondsToSelector:@selector(transfer:didReceiveDebugInformation:ofType:)];
     if (delegateResponds || LOG_DEBUG)
     {
@@ -1124,7 +1895,7 @@ int curlSocketOptFunction(CURLTransfer *self, curl_socket_t curlfd, curlsocktype
     if (purpose == CURLSOCKTYPE_IPCXN)
     {
         // FTP control connections should be kept alive. However, I'm fairly sure this is unlikely to have a real effect in practice since OS X's default time before it starts sending keep alive packets is 2 hours :(
-        // TODO: Looks like we could adopt CURLOPT_TCP_KEEPINTVL instead
+        // Supply socket options with a keepAliveIdleTime to shorten that
         if ([self.originalRequest.URL.scheme isEqualToString:@"ftp"])
         {
             int keepAlive = 1;
@@ -1137,6 +1908,8 @@ int curlSocketOptFunction(CURLTransfer *self, curl_socket_t curlfd, curlsocktype
                 return 1;
             }
         }
+
+        [self tuneSocket:curlfd];
     }
 
     return 0;
@@ -0,0 +1,182 @@
+//
+//  CURLTransferBatch.h
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLTransfer.h"
+
+
+@class CURLTransferBatchSummary;
+@protocol CURLTransferBatchDelegate;
+
+/**
+ Runs a whole bunch of requests, reporting back on each as it finishes, and then with an
+ overall summary once they're all done.
+
+ Rather than creating a CURLTransfer (and delegate queue) per request yourself, the batch adds
+ transfers to the multi in bulk, and gathers up completions on the multi's queue, so that the
+ delegate receives them in groups.
+
+ Bodies are buffered in memory, so this is aimed at large numbers of smallish requests.
+ */
+
+@interface CURLTransferBatch : NSObject <CURLTransferDelegate>
+{
+  @private
+    NSArray                         *_requests;
+    NSURLCredential                 *_credential;
+    CURLMultiHandle                 *_multi;
+    id <CURLTransferBatchDelegate>  _delegate;
+    NSOperationQueue                *_delegateQueue;
+
+    NSUInteger  _maximumConcurrentTransfers;
+    NSUInteger  _maximumConcurrentTransfersPerOrigin;
+
+    // Only accessed on the multi's queue
+    NSMutableIndexSet   *_pendingIndexes;
+    NSMapTable          *_activeItems;
+    NSCountedSet        *_activeOrigins;
+    NSMutableArray      *_finishedItems;
+    id                  _startingItem;
+    BOOL                _flushScheduled;
+    BOOL                _started;
+    BOOL                _cancelled;
+
+    NSUInteger          _succeededCount;
+    NSUInteger          _failedCount;
+    unsigned long long  _totalBytesReceived;
+    NSTimeInterval      *_latencies;
+    NSUInteger          _latencyCount;
+
+    CURLTransferBatchSummary    *_summary;
+}
+
+/**
+ @param requests The NSURLRequests to perform.
+ @param credential Credential to use for any of the requests that need one. May be `nil`.
+ @param delegate Retained until the batch completes or is cancelled, much like CURLTransfer.
+ @param queue The queue to deliver delegate messages on. If `nil`, a serial queue is created.
+ */
+- (id)initWithRequests:(NSArray *)requests
+            credential:(NSURLCredential *)credential
+              delegate:(id <CURLTransferBatchDelegate>)delegate
+         delegateQueue:(NSOperationQueue *)queue __attribute((nonnull(1)));
+
+@property (readonly, copy) NSArray *requests;
+@property (readonly, strong) id <CURLTransferBatchDelegate> delegate;
+
+/**
+ The most transfers to run at once. Default is 0, which means no limit.
+
+ Must be set before calling -start.
+ */
+@property (assign) NSUInteger maximumConcurrentTransfers;
+
+/**
+ The most transfers to run at once against any single origin (scheme, host and port). Default is 0, which means no limit.
+
+ Must be set before calling -start.
+ */
+@property (assign) NSUInteger maximumConcurrentTransfersPerOrigin;
+
+/**
+ Starts the requests running. Only call this once.
+ */
+- (void)start;
+
+/**
+ Stops everything as quickly as possible. Outstanding requests are reported with NSURLErrorCancelled, and then the summary is delivered as usual.
+ */
+- (void)cancel;
+
+/**
+ The summary, once the batch has completed. `nil` until then.
+ */
+@property (readonly, strong) CURLTransferBatchSummary *summary;
+
+@end
+
+
+#pragma mark - Results
+
+/**
+ The outcome of one request within a batch.
+ */
+
+@interface CURLTransferBatchItem : NSObject
+{
+  @private
+    NSUInteger      _index;
+    NSURLRequest    *_request;
+    NSURLResponse   *_response;
+    NSMutableData   *_data;
+    NSError         *_error;
+    NSTimeInterval  _totalTime;
+}
+
+@property (readonly) NSUInteger index;              // position in the batch's requests array
+@property (readonly, copy) NSURLRequest *request;
+@property (readonly, strong) NSURLResponse *response;
+@property (readonly, copy) NSData *data;
+@property (readonly, copy) NSError *error;          // nil if the request succeeded
+@property (readonly) NSTimeInterval totalTime;      // CURLINFO_TOTAL_TIME
+
+@end
+
+
+/**
+ Aggregate figures for a completed batch.
+ */
+
+@interface CURLTransferBatchSummary : NSObject
+{
+  @private
+    NSUInteger          _succeededCount;
+    NSUInteger          _failedCount;
+    unsigned long long  _totalBytesReceived;
+    NSTimeInterval      *_sortedLatencies;
+    NSUInteger          _latencyCount;
+}
+
+@property (readonly) NSUInteger succeededCount;
+@property (readonly) NSUInteger failedCount;        // includes cancelled requests
+@property (readonly) unsigned long long totalBytesReceived;
+
+@property (readonly) NSTimeInterval minimumLatency;
+@property (readonly) NSTimeInterval maximumLatency;
+@property (readonly) NSTimeInterval meanLatency;
+@property (readonly) NSTimeInterval medianLatency;
+
+/**
+ @param percentile Between 0 and 100.
+ @return The latency at that percentile (nearest-rank) of all requests which reached the network. 0 if there were none.
+ */
+- (NSTimeInterval)latencyAtPercentile:(double)percentile;
+
+@end
+
+
+#pragma mark - Delegate
+
+@protocol CURLTransferBatchDelegate <NSObject>
+
+/**
+ Called as requests finish. Completions are coalesced, so each call may report several items.
+
+ @param batch The batch.
+ @param items Array of CURLTransferBatchItem objects.
+ */
+- (void)transferBatch:(CURLTransferBatch *)batch didFinishItems:(NSArray *)items;
+
+/**
+ Sent as the last message related to the batch, once every request has been reported.
+
+ @param batch The batch.
+ @param summary The aggregate results.
+ */
+- (void)transferBatch:(CURLTransferBatch *)batch didCompleteWithSummary:(CURLTransferBatchSummary *)summary;
+
+@end
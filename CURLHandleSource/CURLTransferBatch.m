@@ -0,0 +1,430 @@
+//
+//  CURLTransferBatch.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLTransferBatch.h"
+
+#import "CURLTransferMetrics.h"
+#import "CURLTransfer+MultiSupport.h"
+
+#import "CURLMultiHandle.h"
+#import "CURLRequest.h"
+
+
+@interface CURLTransferBatchItem ()
+@property (readwrite) NSUInteger index;
+@property (readwrite, copy) NSURLRequest *request;
+@property (readwrite, strong) NSURLResponse *response;
+@property (readwrite, copy) NSError *error;
+@property (readwrite) NSTimeInterval totalTime;
+- (void)appendData:(NSData *)data;
+- (NSUInteger)length;
+@end
+
+
+@interface CURLTransferBatchSummary ()
+- (id)initWithSucceededCount:(NSUInteger)succeeded failedCount:(NSUInteger)failed totalBytesReceived:(unsigned long long)bytes latencies:(NSTimeInterval *)latencies count:(NSUInteger)count;
+@end
+
+
+@interface CURLTransferBatch ()
+@property (readwrite, strong) CURLTransferBatchSummary *summary;
+@end
+
+
+@implementation CURLTransferBatch
+
+@synthesize requests = _requests;
+@synthesize delegate = _delegate;
+@synthesize maximumConcurrentTransfers = _maximumConcurrentTransfers;
+@synthesize maximumConcurrentTransfersPerOrigin = _maximumConcurrentTransfersPerOrigin;
+@synthesize summary = _summary;
+
+#pragma mark Lifecycle
+
+- (id)initWithRequests:(NSArray *)requests credential:(NSURLCredential *)credential delegate:(id <CURLTransferBatchDelegate>)delegate delegateQueue:(NSOperationQueue *)queue;
+{
+    NSParameterAssert(requests);
+
+    if (self = [self init])
+    {
+        _requests = [requests copy];
+        _credential = [credential retain];
+        _delegate = [delegate retain];
+        _multi = [[CURLMultiHandle sharedInstance] retain];
+
+        if (queue)
+        {
+            _delegateQueue = [queue retain];
+        }
+        else
+        {
+            _delegateQueue = [[NSOperationQueue alloc] init];
+            _delegateQueue.maxConcurrentOperationCount = 1;
+        }
+
+        _pendingIndexes = [[NSMutableIndexSet alloc] initWithIndexesInRange:NSMakeRange(0, [_requests count])];
+        _activeItems = [[NSMapTable alloc] initWithKeyOptions:NSPointerFunctionsObjectPointerPersonality|NSPointerFunctionsStrongMemory
+                                                 valueOptions:NSPointerFunctionsStrongMemory
+                                                     capacity:0];
+        _activeOrigins = [[NSCountedSet alloc] init];
+        _finishedItems = [[NSMutableArray alloc] init];
+
+        _latencies = malloc(sizeof(NSTimeInterval) * MAX([_requests count], 1));
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    [_requests release];
+    [_credential release];
+    [_multi release];
+    [_delegate release];
+    [_delegateQueue release];
+    [_pendingIndexes release];
+    [_activeItems release];
+    [_activeOrigins release];
+    [_finishedItems release];
+    [_summary release];
+    free(_latencies);
+
+    [super dealloc];
+}
+
+#pragma mark Running
+
+- (void)start;
+{
+    dispatch_async(_multi.queue, ^{
+
+        NSAssert(!_started, @"CURLTransferBatch can only be started once");
+        _started = YES;
+        [self startPendingTransfers];
+
+        // Might be an empty batch, or every request fell at the first hurdle
+        [self scheduleFlush];
+    });
+}
+
+- (void)cancel;
+{
+    // All our bookkeeping is on the multi's queue, so cancel from there too. -[CURLTransfer cancel]
+    // would try to dispatch_sync back on to the queue, so we do its work directly
+    dispatch_async(_multi.queue, ^{
+
+        if (_cancelled) return;
+        _cancelled = YES;
+
+        NSError *error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil];
+
+        // Requests that never started can be reported straight off
+        [_pendingIndexes enumerateIndexesUsingBlock:^(NSUInteger idx, BOOL *stop) {
+            CURLTransferBatchItem *item = [[CURLTransferBatchItem alloc] init];
+            item.index = idx;
+            item.request = [_requests objectAtIndex:idx];
+            item.error = error;
+            [self recordFinishedItem:item];
+            [item release];
+        }];
+        [_pendingIndexes removeAllIndexes];
+
+        for (CURLTransfer *aTransfer in [[_activeItems keyEnumerator] allObjects])
+        {
+            [_multi suspendTransfer:aTransfer];
+            [aTransfer completeWithError:error];
+        }
+
+        [self scheduleFlush];
+    });
+}
+
+- (void)startPendingTransfers;
+{
+    if (_cancelled) return;
+
+    NSMutableArray *transfers = [[NSMutableArray alloc] init];
+    NSMutableIndexSet *started = [[NSMutableIndexSet alloc] init];
+
+    [_pendingIndexes enumerateIndexesUsingBlock:^(NSUInteger idx, BOOL *stop) {
+
+        if (_maximumConcurrentTransfers && [_activeItems count] >= _maximumConcurrentTransfers)
+        {
+            *stop = YES;
+            return;
+        }
+
+        NSURLRequest *request = [_requests objectAtIndex:idx];
+        NSString *origin = [[request URL] curl_originString];
+        if (_maximumConcurrentTransfersPerOrigin && [_activeOrigins countForObject:origin] >= _maximumConcurrentTransfersPerOrigin)
+        {
+            return; // leave it for later, but maybe other origins can run
+        }
+
+        [started addIndex:idx];
+
+        CURLTransferBatchItem *item = [[CURLTransferBatchItem alloc] init];
+        item.index = idx;
+        item.request = request;
+
+        // If setup fails, the transfer reports so before init returns
+        _startingItem = item;
+        CURLTransfer *transfer = [[CURLTransfer alloc] initWithRequest:request credential:_credential delegate:self multi:_multi];
+        _startingItem = nil;
+
+        if (!transfer)
+        {
+            item.error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorUnknown userInfo:nil];
+            [self recordFinishedItem:item];
+        }
+        else if (transfer.state != CURLTransferStateCompleted)
+        {
+            [_activeItems setObject:item forKey:transfer];
+            [_activeOrigins addObject:origin];
+            [transfers addObject:transfer];
+        }
+
+        [transfer release];
+        [item release];
+    }];
+
+    [_pendingIndexes removeIndexes:started];
+    [started release];
+
+    if ([transfers count]) [_multi beginTransfers:transfers];
+    [transfers release];
+}
+
+- (void)recordFinishedItem:(CURLTransferBatchItem *)item;
+{
+    if (item.error)
+    {
+        _failedCount++;
+    }
+    else
+    {
+        _succeededCount++;
+    }
+
+    _totalBytesReceived += [item length];
+
+    if (item.totalTime > 0.0)
+    {
+        _latencies[_latencyCount] = item.totalTime;
+        _latencyCount++;
+    }
+
+    [_finishedItems addObject:item];
+}
+
+/*  Completions pile up in _finishedItems while the multi processes messages. Once it's done a pass,
+ *  our flush gets its turn on the queue and delivers them all to the delegate in one go.
+ */
+- (void)scheduleFlush;
+{
+    if (_flushScheduled) return;
+    _flushScheduled = YES;
+
+    dispatch_async(_multi.queue, ^{
+
+        _flushScheduled = NO;
+        [self startPendingTransfers];
+
+        if ([_finishedItems count])
+        {
+            NSArray *items = [_finishedItems copy];
+            [_finishedItems removeAllObjects];
+
+            [_delegateQueue addOperationWithBlock:^{
+                [self.delegate transferBatch:self didFinishItems:items];
+            }];
+            [items release];
+        }
+
+        if ([_activeItems count] == 0 && [_pendingIndexes count] == 0 && !self.summary)
+        {
+            CURLTransferBatchSummary *summary = [[CURLTransferBatchSummary alloc] initWithSucceededCount:_succeededCount
+                                                                                             failedCount:_failedCount
+                                                                                      totalBytesReceived:_totalBytesReceived
+                                                                                               latencies:_latencies
+                                                                                                   count:_latencyCount];
+            _latencies = NULL; // summary owns them now
+            self.summary = summary;
+
+            [_delegateQueue addOperationWithBlock:^{
+                [self.delegate transferBatch:self didCompleteWithSummary:summary];
+
+                // Break the retain cycle, like CURLTransfer
+                [_delegate release]; _delegate = nil;
+            }];
+            [summary release];
+        }
+    });
+}
+
+#pragma mark CURLTransferDelegate
+
+// All of these arrive on the multi's queue
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveResponse:(NSURLResponse *)response;
+{
+    CURLTransferBatchItem *item = [_activeItems objectForKey:transfer];
+    item.response = response;
+}
+
+- (void)transfer:(CURLTransfer *)transfer didReceiveData:(NSData *)data;
+{
+    CURLTransferBatchItem *item = [_activeItems objectForKey:transfer];
+    [item appendData:data];
+}
+
+- (void)transfer:(CURLTransfer *)transfer didCompleteWithError:(NSError *)error;
+{
+    CURLTransferBatchItem *item = [[_activeItems objectForKey:transfer] retain];
+    if (item)
+    {
+        item.totalTime = transfer.metrics.totalTime;
+
+        [_activeItems removeObjectForKey:transfer];
+        [_activeOrigins removeObject:[[item.request URL] curl_originString]];
+    }
+    else
+    {
+        item = [_startingItem retain];  // failed during setup
+    }
+    NSAssert(item, @"completion for a transfer %@ that isn't part of the batch", transfer);
+
+    item.error = error;
+    [self recordFinishedItem:item];
+    [item release];
+
+    [self scheduleFlush];
+}
+
+@end
+
+
+#pragma mark -
+
+
+@implementation CURLTransferBatchItem
+
+@synthesize index = _index;
+@synthesize request = _request;
+@synthesize response = _response;
+@synthesize error = _error;
+@synthesize totalTime = _totalTime;
+
+- (void)dealloc
+{
+    [_request release];
+    [_response release];
+    [_data release];
+    [_error release];
+
+    [super dealloc];
+}
+
+- (NSData *)data; { return [[_data copy] autorelease]; }
+
+- (void)appendData:(NSData *)data;
+{
+    if (!_data)
+    {
+        long long expected = [_response expectedContentLength];
+        _data = [[NSMutableData alloc] initWithCapacity:(expected > 0 ? (NSUInteger)expected : [data length])];
+    }
+
+    [_data appendData:data];
+}
+
+- (NSUInteger)length; { return [_data length]; }
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %p %lu %@ %@>", [self class], self, (unsigned long)_index, [_request URL], (_error ? _error : @"OK")];
+}
+
+@end
+
+
+#pragma mark -
+
+
+static int CompareLatencies(const void *a, const void *b)
+{
+    NSTimeInterval first = *(const NSTimeInterval *)a;
+    NSTimeInterval second = *(const NSTimeInterval *)b;
+    return (first < second ? -1 : (first > second ? 1 : 0));
+}
+
+@implementation CURLTransferBatchSummary
+
+@synthesize succeededCount = _succeededCount;
+@synthesize failedCount = _failedCount;
+@synthesize totalBytesReceived = _totalBytesReceived;
+
+- (id)initWithSucceededCount:(NSUInteger)succeeded failedCount:(NSUInteger)failed totalBytesReceived:(unsigned long long)bytes latencies:(NSTimeInterval *)latencies count:(NSUInteger)count;
+{
+    if (self = [self init])
+    {
+        _succeededCount = succeeded;
+        _failedCount = failed;
+        _totalBytesReceived = bytes;
+
+        _sortedLatencies = latencies;
+        _latencyCount = count;
+        qsort(_sortedLatencies, _latencyCount, sizeof(NSTimeInterval), CompareLatencies);
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_sortedLatencies);
+    [super dealloc];
+}
+
+- (NSTimeInterval)minimumLatency; { return (_latencyCount ? _sortedLatencies[0] : 0.0); }
+- (NSTimeInterval)maximumLatency; { return (_latencyCount ? _sortedLatencies[_latencyCount - 1] : 0.0); }
+- (NSTimeInterval)medianLatency; { return [self latencyAtPercentile:50.0]; }
+
+- (NSTimeInterval)meanLatency;
+{
+    if (!_latencyCount) return 0.0;
+
+    NSTimeInterval total = 0.0;
+    for (NSUInteger i = 0; i < _latencyCount; i++)
+    {
+        total += _sortedLatencies[i];
+    }
+
+    return total / _latencyCount;
+}
+
+- (NSTimeInterval)latencyAtPercentile:(double)percentile;
+{
+    if (!_latencyCount) return 0.0;
+
+    NSUInteger rank = (NSUInteger)ceil((percentile / 100.0) * _latencyCount);
+    if (rank < 1) rank = 1;
+    if (rank > _latencyCount) rank = _latencyCount;
+
+    return _sortedLatencies[rank - 1];
+}
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"<%@ %p succeeded:%lu failed:%lu bytes:%llu latency min:%.3f median:%.3f p90:%.3f p99:%.3f max:%.3f>",
+            [self class], self,
+            (unsigned long)_succeededCount, (unsigned long)_failedCount, _totalBytesReceived,
+            self.minimumLatency, self.medianLatency, [self latencyAtPercentile:90.0], [self latencyAtPercentile:99.0], self.maximumLatency];
+}
+
+@end
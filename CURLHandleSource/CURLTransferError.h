@@ -0,0 +1,46 @@
+//
+//  CURLTransferError.h
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <curl/curl.h>
+
+/**
+ The errors CURLTransfer reports failures with.
+ 
+ Only the raw details are captured when the transfer fails: the CURLcode, response code, errno and the
+ contents of the error buffer. The userInfo dictionary, with its strings and underlying errors, is built
+ the first time it's asked for. That keeps things cheap when large numbers of requests fail together,
+ e.g. a dead server with thousands of queued requests.
+ 
+ When domain is not CURLcodeErrorDomain, the error is a Cocoa-friendly translation and the userInfo
+ includes the raw CURLcode error as NSUnderlyingErrorKey. Otherwise, any errno is supplied as an
+ underlying NSPOSIXErrorDomain error.
+ 
+ Archiving substitutes a plain NSError.
+ */
+
+@interface CURLTransferError : NSError
+{
+  @private
+    NSURL           *_URL;
+    CURLcode        _curlCode;
+    long            _responseCode;
+    long            _osErrorNumber;
+    char            *_errorBuffer;  // NULL if libcurl didn't write anything
+    NSDictionary    *_lazyUserInfo;
+}
+
+- (id)initWithDomain:(NSString *)domain
+                code:(NSInteger)code
+                 URL:(NSURL *)url
+            curlCode:(CURLcode)curlCode
+        responseCode:(long)responseCode
+       osErrorNumber:(long)osErrorNumber
+         errorBuffer:(const char *)errorBuffer __attribute((nonnull(1)));
+
+@end
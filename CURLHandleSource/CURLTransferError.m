@@ -0,0 +1,109 @@
+//
+//  CURLTransferError.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLTransferError.h"
+
+#import "CURLTransfer.h"
+
+
+@implementation CURLTransferError
+
+- (id)initWithDomain:(NSString *)domain
+                code:(NSInteger)code
+                 URL:(NSURL *)url
+            curlCode:(CURLcode)curlCode
+        responseCode:(long)responseCode
+       osErrorNumber:(long)osErrorNumber
+         errorBuffer:(const char *)errorBuffer;
+{
+    if (self = [super initWithDomain:domain code:code userInfo:nil])
+    {
+        _URL = [url retain];
+        _curlCode = curlCode;
+        _responseCode = responseCode;
+        _osErrorNumber = osErrorNumber;
+        
+        if (errorBuffer && *errorBuffer)
+        {
+            _errorBuffer = strdup(errorBuffer);
+        }
+    }
+    
+    return self;
+}
+
+- (void)dealloc
+{
+    [_URL release];
+    free(_errorBuffer);
+    [_lazyUserInfo release];
+    
+    [super dealloc];
+}
+
+- (NSDictionary *)userInfo
+{
+    @synchronized(self)
+    {
+        if (!_lazyUserInfo)
+        {
+            NSMutableDictionary *userInfo = [[NSMutableDictionary alloc] initWithCapacity:6];
+            
+            if (_URL)
+            {
+                [userInfo setObject:_URL forKey:NSURLErrorFailingURLErrorKey];
+                [userInfo setObject:[_URL absoluteString] forKey:NSURLErrorFailingURLStringErrorKey];
+            }
+            
+            // The buffer can carry a server's own words, which needn't be UTF-8. As for debug info, ISO Latin 2 is the fallback
+            NSString *description = nil;
+            if (_errorBuffer)
+            {
+                description = [NSString stringWithUTF8String:_errorBuffer];
+                if (!description) description = [NSString stringWithCString:_errorBuffer encoding:NSISOLatin2StringEncoding];
+            }
+            [userInfo setObject:(description ? description : @"") forKey:NSLocalizedDescriptionKey];
+            [userInfo setObject:[NSString stringWithUTF8String:curl_easy_strerror(_curlCode)] forKey:NSLocalizedFailureReasonErrorKey];
+            
+            if (_responseCode)
+            {
+                [userInfo setObject:[NSNumber numberWithLong:_responseCode] forKey:@(CURLINFO_RESPONSE_CODE)];
+            }
+            
+            if (![[self domain] isEqualToString:CURLcodeErrorDomain])
+            {
+                NSError *curlError = [[CURLTransferError alloc] initWithDomain:CURLcodeErrorDomain
+                                                                          code:_curlCode
+                                                                           URL:_URL
+                                                                      curlCode:_curlCode
+                                                                  responseCode:_responseCode
+                                                                 osErrorNumber:_osErrorNumber
+                                                                   errorBuffer:_errorBuffer];
+                
+                [userInfo setObject:curlError forKey:NSUnderlyingErrorKey];
+                [curlError release];
+            }
+            else if (_osErrorNumber)
+            {
+                [userInfo setObject:[NSError errorWithDomain:NSPOSIXErrorDomain code:_osErrorNumber userInfo:nil]
+                             forKey:NSUnderlyingErrorKey];
+            }
+            
+            _lazyUserInfo = userInfo;
+        }
+        
+        return _lazyUserInfo;
+    }
+}
+
+- (id)replacementObjectForCoder:(NSCoder *)aCoder
+{
+    return [NSError errorWithDomain:[self domain] code:[self code] userInfo:[self userInfo]];
+}
+
+@end
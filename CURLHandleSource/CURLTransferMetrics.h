@@ -0,0 +1,104 @@
+//
+//  CURLTransferMetrics.h
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <curl/curl.h>
+
+
+/**
+ Timing and connection details for a single transfer, as reported by libcurl.
+
+ CURLTransfer captures one of these as it completes, before sending `transfer:didCompleteWithError:`,
+ so it can be read from the transfer's `metrics` property at that point.
+
+ As with libcurl, each time is measured in seconds from the start of the transfer, so they accumulate:
+ nameLookupTime <= connectTime <= appConnectTime <= preTransferTime <= startTransferTime <= totalTime.
+ When redirects are followed, redirectTime is the time spent on them, and the others include it.
+ A phase which didn't happen (e.g. no TLS) reports 0.
+ */
+
+@interface CURLTransferMetrics : NSObject
+{
+  @private
+    NSTimeInterval  _nameLookupTime;
+    NSTimeInterval  _connectTime;
+    NSTimeInterval  _appConnectTime;
+    NSTimeInterval  _preTransferTime;
+    NSTimeInterval  _startTransferTime;
+    NSTimeInterval  _redirectTime;
+    NSTimeInterval  _totalTime;
+
+    double          _bytesSent;
+    double          _bytesReceived;
+    double          _uploadSpeed;
+    double          _downloadSpeed;
+    long long       _contentLength;
+    NSDate          *_remoteModificationDate;
+
+    long            _connectionCount;
+    long            _redirectCount;
+
+    NSString        *_remoteAddress;
+    long            _remotePort;
+    NSString        *_localAddress;
+    long            _localPort;
+}
+
+/**
+ Reads the figures for the most recent transfer on an easy handle.
+
+ @param handle The easy handle, which must not have been reset since the transfer.
+ @return A new metrics object.
+ */
++ (CURLTransferMetrics *)metricsWithHandle:(CURL *)handle __attribute((nonnull));
+
+/** @name Times */
+
+@property (readonly) NSTimeInterval nameLookupTime;     // CURLINFO_NAMELOOKUP_TIME, DNS resolution done
+@property (readonly) NSTimeInterval connectTime;        // CURLINFO_CONNECT_TIME, TCP connection established
+@property (readonly) NSTimeInterval appConnectTime;     // CURLINFO_APPCONNECT_TIME, TLS/SSH handshake done
+@property (readonly) NSTimeInterval preTransferTime;    // CURLINFO_PRETRANSFER_TIME, about to send the request
+@property (readonly) NSTimeInterval startTransferTime;  // CURLINFO_STARTTRANSFER_TIME, first byte of the response
+@property (readonly) NSTimeInterval redirectTime;       // CURLINFO_REDIRECT_TIME
+@property (readonly) NSTimeInterval totalTime;          // CURLINFO_TOTAL_TIME
+
+/** @name Volume */
+
+@property (readonly) double bytesSent;          // CURLINFO_SIZE_UPLOAD, body only
+@property (readonly) double bytesReceived;      // CURLINFO_SIZE_DOWNLOAD, body only
+@property (readonly) double uploadSpeed;        // bytes per second
+@property (readonly) double downloadSpeed;      // bytes per second
+
+/**
+ CURLINFO_CONTENT_LENGTH_DOWNLOAD, or NSURLResponseUnknownLength. When resuming, that's the length of the
+ remainder being downloaded, not the whole file. Unlike NSURLResponse, also filled in for FTP and SFTP.
+ */
+@property (readonly) long long contentLength;
+
+/**
+ CURLINFO_FILETIME. Only available if the request's `curl_wantsRemoteModificationDate` was set, and the server
+ was able to tell; `nil` otherwise.
+ */
+@property (readonly, copy) NSDate *remoteModificationDate;
+
+/** @name Connection */
+
+/**
+ YES if the transfer didn't need to open any connection of its own, i.e. it ran over one left in the pool.
+ */
+@property (readonly, getter=isConnectionReused) BOOL connectionReused;
+
+@property (readonly) long connectionCount;      // CURLINFO_NUM_CONNECTS, connections this transfer had to open
+@property (readonly) long redirectCount;        // CURLINFO_REDIRECT_COUNT
+
+@property (readonly, copy) NSString *remoteAddress;     // nil if never connected
+@property (readonly) long remotePort;
+@property (readonly, copy) NSString *localAddress;      // nil if never connected
+@property (readonly) long localPort;
+
+@end
@@ -0,0 +1,130 @@
+//
+//  CURLTransferMetrics.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLTransferMetrics.h"
+
+
+@implementation CURLTransferMetrics
+
+static double CURLGetDoubleInfo(CURL *handle, CURLINFO info)
+{
+    double result;
+    return (curl_easy_getinfo(handle, info, &result) == CURLE_OK ? result : 0.0);
+}
+
+static long CURLGetLongInfo(CURL *handle, CURLINFO info)
+{
+    long result;
+    return (curl_easy_getinfo(handle, info, &result) == CURLE_OK ? result : 0);
+}
+
+static NSString *CURLCopyAddressInfo(CURL *handle, CURLINFO info)
+{
+    char *address = NULL;
+    if (curl_easy_getinfo(handle, info, &address) != CURLE_OK || !address || !*address) return nil;
+    
+    return [[NSString alloc] initWithUTF8String:address];
+}
+
++ (CURLTransferMetrics *)metricsWithHandle:(CURL *)handle;
+{
+    CURLTransferMetrics *result = [[self alloc] init];
+    
+    result->_nameLookupTime = CURLGetDoubleInfo(handle, CURLINFO_NAMELOOKUP_TIME);
+    result->_connectTime = CURLGetDoubleInfo(handle, CURLINFO_CONNECT_TIME);
+    result->_appConnectTime = CURLGetDoubleInfo(handle, CURLINFO_APPCONNECT_TIME);
+    result->_preTransferTime = CURLGetDoubleInfo(handle, CURLINFO_PRETRANSFER_TIME);
+    result->_startTransferTime = CURLGetDoubleInfo(handle, CURLINFO_STARTTRANSFER_TIME);
+    result->_redirectTime = CURLGetDoubleInfo(handle, CURLINFO_REDIRECT_TIME);
+    result->_totalTime = CURLGetDoubleInfo(handle, CURLINFO_TOTAL_TIME);
+    
+    result->_bytesSent = CURLGetDoubleInfo(handle, CURLINFO_SIZE_UPLOAD);
+    result->_bytesReceived = CURLGetDoubleInfo(handle, CURLINFO_SIZE_DOWNLOAD);
+    result->_uploadSpeed = CURLGetDoubleInfo(handle, CURLINFO_SPEED_UPLOAD);
+    result->_downloadSpeed = CURLGetDoubleInfo(handle, CURLINFO_SPEED_DOWNLOAD);
+    
+    double contentLength;
+    if (curl_easy_getinfo(handle, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &contentLength) != CURLE_OK || contentLength < 0.0) contentLength = NSURLResponseUnknownLength;
+    result->_contentLength = (long long)contentLength;
+    
+    long fileTime;
+    if (curl_easy_getinfo(handle, CURLINFO_FILETIME, &fileTime) == CURLE_OK && fileTime >= 0)
+    {
+        result->_remoteModificationDate = [[NSDate alloc] initWithTimeIntervalSince1970:fileTime];
+    }
+    
+    result->_connectionCount = CURLGetLongInfo(handle, CURLINFO_NUM_CONNECTS);
+    result->_redirectCount = CURLGetLongInfo(handle, CURLINFO_REDIRECT_COUNT);
+    
+    result->_remoteAddress = CURLCopyAddressInfo(handle, CURLINFO_PRIMARY_IP);
+    result->_remotePort = CURLGetLongInfo(handle, CURLINFO_PRIMARY_PORT);
+    result->_localAddress = CURLCopyAddressInfo(handle, CURLINFO_LOCAL_IP);
+    result->_localPort = CURLGetLongInfo(handle, CURLINFO_LOCAL_PORT);
+    
+    return [result autorelease];
+}
+
+- (void)dealloc
+{
+    [_remoteAddress release];
+    [_localAddress release];
+    [_remoteModificationDate release];
+    
+    [super dealloc];
+}
+
+@synthesize nameLookupTime = _nameLookupTime;
+@synthesize connectTime = _connectTime;
+@synthesize appConnectTime = _appConnectTime;
+@synthesize preTransferTime = _preTransferTime;
+@synthesize startTransferTime = _startTransferTime;
+@synthesize redirectTime = _redirectTime;
+@synthesize totalTime = _totalTime;
+
+@synthesize bytesSent = _bytesSent;
+@synthesize bytesReceived = _bytesReceived;
+@synthesize uploadSpeed = _uploadSpeed;
+@synthesize downloadSpeed = _downloadSpeed;
+@synthesize contentLength = _contentLength;
+@synthesize remoteModificationDate = _remoteModificationDate;
+
+@synthesize connectionCount = _connectionCount;
+@synthesize redirectCount = _redirectCount;
+
+- (BOOL)isConnectionReused;
+{
+    // A transfer that never got as far as connecting doesn't count as reusing anything
+    return (_connectionCount == 0 && _remoteAddress != nil);
+}
+
+@synthesize remoteAddress = _remoteAddress;
+@synthesize remotePort = _remotePort;
+@synthesize localAddress = _localAddress;
+@synthesize localPort = _localPort;
+
+- (NSString *)description
+{
+    return [NSString stringWithFormat:@"%@ dns %.3fs connect %.3fs handshake %.3fs pretransfer %.3fs first byte %.3fs redirect %.3fs total %.3fs; sent %.0f received %.0f bytes; %@ %@:%ld -> %@:%ld",
+            [super description],
+            _nameLookupTime,
+            _connectTime,
+            _appConnectTime,
+            _preTransferTime,
+            _startTransferTime,
+            _redirectTime,
+            _totalTime,
+            _bytesSent,
+            _bytesReceived,
+            ([self isConnectionReused] ? @"reused" : @"new connection"),
+            _localAddress,
+            _localPort,
+            _remoteAddress,
+            _remotePort];
+}
+
+@end
@@ -13,6 +13,11 @@
 - (NSString *) formatForHTTPUsingEncoding:(NSStringEncoding)inEncoding;
 - (NSString *) formatForHTTPUsingEncoding:(NSStringEncoding)inEncoding ordering:(NSArray *)inOrdering;
 
+// application/x-www-form-urlencoded, ready for -setHTTPBody:. Keys and values are handled as above, but
+// encoded straight into one buffer: letters, digits and "*-._" pass through, spaces become "+", and all
+// other bytes are percent-escaped. Characters the encoding can't represent become "?"
+- (NSData *) dataFormattedForHTTPUsingEncoding:(NSStringEncoding)inEncoding ordering:(NSArray *)inOrdering;
+
 @end
 
 
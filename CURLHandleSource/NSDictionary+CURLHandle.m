@@ -7,6 +7,91 @@
 
 #import "NSDictionary+CURLHandle.h"
 
+
+/*"	Which bytes may appear as-is in a form body: 1 for yes, 2 for space (which becomes +), 0 for escaping.
+"*/
+
+static const unsigned char CURLFormCharacterClass[256] = {
+    ['*'] = 1, ['-'] = 1, ['.'] = 1, ['_'] = 1, [' '] = 2,
+    ['0'] = 1, ['1'] = 1, ['2'] = 1, ['3'] = 1, ['4'] = 1, ['5'] = 1, ['6'] = 1, ['7'] = 1, ['8'] = 1, ['9'] = 1,
+    ['A'] = 1, ['B'] = 1, ['C'] = 1, ['D'] = 1, ['E'] = 1, ['F'] = 1, ['G'] = 1, ['H'] = 1, ['I'] = 1, ['J'] = 1,
+    ['K'] = 1, ['L'] = 1, ['M'] = 1, ['N'] = 1, ['O'] = 1, ['P'] = 1, ['Q'] = 1, ['R'] = 1, ['S'] = 1, ['T'] = 1,
+    ['U'] = 1, ['V'] = 1, ['W'] = 1, ['X'] = 1, ['Y'] = 1, ['Z'] = 1,
+    ['a'] = 1, ['b'] = 1, ['c'] = 1, ['d'] = 1, ['e'] = 1, ['f'] = 1, ['g'] = 1, ['h'] = 1, ['i'] = 1, ['j'] = 1,
+    ['k'] = 1, ['l'] = 1, ['m'] = 1, ['n'] = 1, ['o'] = 1, ['p'] = 1, ['q'] = 1, ['r'] = 1, ['s'] = 1, ['t'] = 1,
+    ['u'] = 1, ['v'] = 1, ['w'] = 1, ['x'] = 1, ['y'] = 1, ['z'] = 1,
+};
+
+typedef struct {
+    NSMutableData   *data;
+    unsigned char   *bytes;     // [data mutableBytes], which is kept at full capacity
+    NSUInteger      length;     // how much of it is used
+    NSMutableData   *scratch;   // for strings whose bytes can't be accessed directly
+} CURLFormBuffer;
+
+static void CURLFormBufferReserve(CURLFormBuffer *buffer, NSUInteger extra)
+{
+    NSUInteger capacity = [buffer->data length];
+    if (buffer->length + extra <= capacity) return;
+
+    while (capacity < buffer->length + extra) capacity *= 2;
+    [buffer->data setLength:capacity];
+    buffer->bytes = [buffer->data mutableBytes];
+}
+
+static void CURLFormBufferAppendEscaped(CURLFormBuffer *buffer, NSString *string, CFStringEncoding encoding)
+{
+    static const char hex[] = "0123456789ABCDEF";
+
+    // Use the string's own storage if it's already in the right encoding, otherwise convert into scratch space
+    const unsigned char *bytes = (const unsigned char *)CFStringGetCStringPtr((CFStringRef)string, encoding);
+    CFIndex count;
+    if (bytes)
+    {
+        count = strlen((const char *)bytes);
+    }
+    else
+    {
+        CFRange range = CFRangeMake(0, CFStringGetLength((CFStringRef)string));
+        CFIndex maximum = CFStringGetMaximumSizeForEncoding(range.length, encoding);
+        if ((CFIndex)[buffer->scratch length] < maximum) [buffer->scratch setLength:maximum];
+
+        CFStringGetBytes((CFStringRef)string, range, encoding, '?', false, [buffer->scratch mutableBytes], maximum, &count);
+        bytes = [buffer->scratch bytes];
+    }
+
+    // Worst case, every byte is escaped
+    CURLFormBufferReserve(buffer, count * 3);
+    unsigned char *out = buffer->bytes + buffer->length;
+
+    for (CFIndex i = 0; i < count; i++)
+    {
+        unsigned char c = bytes[i];
+        switch (CURLFormCharacterClass[c])
+        {
+            case 1:
+                *out++ = c;
+                break;
+            case 2:
+                *out++ = '+';
+                break;
+            default:
+                *out++ = '%';
+                *out++ = hex[c >> 4];
+                *out++ = hex[c & 0x0F];
+        }
+    }
+
+    buffer->length = out - buffer->bytes;
+}
+
+static void CURLFormBufferAppendByte(CURLFormBuffer *buffer, unsigned char byte)
+{
+    CURLFormBufferReserve(buffer, 1);
+    buffer->bytes[buffer->length++] = byte;
+}
+
+
 @implementation NSDictionary ( CurlHTTPExtensions )
 
 /*"	This category adds methods for dealing with HTTP input and output to an #NSDictionary.
@@ -81,4 +166,36 @@
 	return s;	
 }
 
+- (NSData *) dataFormattedForHTTPUsingEncoding:(NSStringEncoding)inEncoding ordering:(NSArray *)inOrdering
+{
+	CFStringEncoding cfStrEnc = CFStringConvertNSStringEncodingToEncoding(inEncoding);
+
+    CURLFormBuffer buffer;
+    buffer.data = [NSMutableData dataWithLength:1024];
+    buffer.bytes = [buffer.data mutableBytes];
+    buffer.length = 0;
+    buffer.scratch = [NSMutableData data];
+
+	for (id key in (inOrdering ? inOrdering : [self allKeys]))
+	{
+        id keyObject = [self objectForKey:key];
+        if (!keyObject) continue;
+
+        NSString *keyString = ([key isKindOfClass:[NSString class]] ? key : [key description]);
+
+        id <NSFastEnumeration> values = ([keyObject respondsToSelector:@selector(objectEnumerator)] ? [keyObject objectEnumerator] : [NSArray arrayWithObject:keyObject]);
+        for (id aValue in values)
+        {
+            if (buffer.length) CURLFormBufferAppendByte(&buffer, '&');
+
+            CURLFormBufferAppendEscaped(&buffer, keyString, cfStrEnc);
+            CURLFormBufferAppendByte(&buffer, '=');
+            CURLFormBufferAppendEscaped(&buffer, ([aValue isKindOfClass:[NSString class]] ? aValue : [aValue description]), cfStrEnc);
+        }
+	}
+
+    [buffer.data setLength:buffer.length];
+	return buffer.data;
+}
+
 @end
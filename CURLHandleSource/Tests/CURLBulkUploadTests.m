@@ -0,0 +1,131 @@
+//
+//  CURLBulkUploadTests.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLBulkUpload.h"
+#import "CURLHandleBasedTest.h"
+
+
+@interface CURLBulkUploadTests : CURLHandleBasedTest <CURLBulkUploadDelegate>
+
+@property (strong, nonatomic) NSMutableArray* items;
+@property (strong, nonatomic) CURLBulkUploadSummary* summary;
+
+@end
+
+@implementation CURLBulkUploadTests
+
+- (void)dealloc
+{
+    [_items release];
+    [_summary release];
+
+    [super dealloc];
+}
+
+- (void)bulkUpload:(CURLBulkUpload *)upload didFinishItem:(CURLBulkUploadItem *)item
+{
+    if (!self.items)
+    {
+        self.items = [NSMutableArray array];
+    }
+
+    [self.items addObject:item];
+}
+
+- (void)bulkUpload:(CURLBulkUpload *)upload didCompleteWithSummary:(CURLBulkUploadSummary *)summary
+{
+    NSLog(@"test: bulk upload finished %@", summary);
+
+    self.summary = summary;
+    [self pause];
+}
+
+- (NSDictionary*)manifestForRoot:(NSURL*)root count:(NSUInteger)count
+{
+    NSMutableDictionary* manifest = [NSMutableDictionary dictionaryWithCapacity:count];
+    NSString* directory = NSTemporaryDirectory();
+    NSData* data = [NSData dataWithContentsOfURL:[self testFileURL]];
+
+    for (NSUInteger i = 0; i < count; ++i)
+    {
+        // Files of differing sizes, spread over a couple of directories
+        NSMutableData* contents = [NSMutableData data];
+        for (NSUInteger j = 0; j <= i; ++j)
+        {
+            [contents appendData:data];
+        }
+
+        NSString* name = [NSString stringWithFormat:@"BulkUpload%lu.txt", (unsigned long)i];
+        NSURL* localURL = [NSURL fileURLWithPath:[directory stringByAppendingPathComponent:name]];
+        [contents writeToURL:localURL atomically:YES];
+
+        NSString* remotePath = [NSString stringWithFormat:@"CURLHandleTests/Bulk/%@/%@", (i % 2 ? @"Odd" : @"Even"), name];
+        [manifest setObject:[root URLByAppendingPathComponent:remotePath] forKey:localURL];
+    }
+
+    return manifest;
+}
+
+#pragma mark - Tests
+
+- (void)testRetriesThenGivesUp
+{
+    // Nothing listens on port 1, so every attempt is refused
+    NSURL* root = [NSURL URLWithString:@"ftp://127.0.0.1:1/"];
+    NSDictionary* manifest = [self manifestForRoot:root count:3];
+
+    CURLBulkUpload* upload = [[CURLBulkUpload alloc] initWithManifest:manifest credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue]];
+    upload.maximumAttempts = 2;
+    [upload start];
+
+    [self runUntilPaused];
+
+    STAssertEquals([self.items count], [manifest count], @"every file should have been reported");
+    STAssertEquals(self.summary.failedCount, [manifest count], @"nothing should have got through");
+    STAssertEquals(self.summary.retryCount, [manifest count], @"each file should have been retried once");
+    for (CURLBulkUploadItem* item in self.items)
+    {
+        STAssertEquals(item.attemptCount, (NSUInteger)2, @"%@", item);
+        STAssertEquals([item.error code], (NSInteger)NSURLErrorCannotConnectToHost, @"%@", item);
+    }
+
+    [upload release];
+}
+
+- (void)testUpload
+{
+    NSURL* ftpRoot = [self ftpTestServer];
+    if (!ftpRoot || [self usingMockServer])
+    {
+        NSLog(@"Skipping bulk upload test as it needs a real FTP server");
+        return;
+    }
+
+    NSDictionary* manifest = [self manifestForRoot:ftpRoot count:12];
+
+    CURLBulkUpload* upload = [[CURLBulkUpload alloc] initWithManifest:manifest credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue]];
+    upload.maximumSessionsPerHost = 3;
+    [upload start];
+
+    [self runUntilPaused];
+
+    STAssertEquals(self.summary.succeededCount, [manifest count], @"unexpected failures in %@", self.items);
+    STAssertTrue(self.summary.sessionCount <= 3, @"should have stayed within the session limit");
+    STAssertTrue(self.summary.throughput > 0.0, @"should have a throughput");
+
+    unsigned long long expected = 0;
+    for (CURLBulkUploadItem* item in self.items)
+    {
+        expected += item.size;
+    }
+    STAssertEquals(self.summary.totalBytesSent, expected, @"should have sent every byte");
+
+    [upload release];
+}
+
+@end
@@ -0,0 +1,198 @@
+//
+//  CURLDirectoryListingTests.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLDirectoryListing.h"
+#import "CURLHandleBasedTest.h"
+
+
+@interface CURLDirectoryListingTests : CURLHandleBasedTest
+
+@end
+
+@implementation CURLDirectoryListingTests
+
+- (NSArray*)parseListing:(NSString*)listing format:(CURLDirectoryListingFormat)format chunkSize:(NSUInteger)chunkSize
+{
+    NSMutableArray* entries = [NSMutableArray array];
+    CURLDirectoryListingParser* parser = [[CURLDirectoryListingParser alloc] initWithFormat:format handler:^(NSArray *batch) {
+        [entries addObjectsFromArray:batch];
+    }];
+
+    // Feed it in small pieces, so lines get split between chunks
+    NSData* data = [listing dataUsingEncoding:NSUTF8StringEncoding];
+    for (NSUInteger offset = 0; offset < [data length]; offset += chunkSize)
+    {
+        NSUInteger length = MIN(chunkSize, [data length] - offset);
+        [parser appendBytes:(const char*)[data bytes] + offset length:length];
+    }
+    [parser finish];
+
+    STAssertEquals(parser.entryCount, [entries count], @"count should match what was delivered");
+    [parser release];
+
+    return entries;
+}
+
+- (NSDate*)dateWithString:(NSString*)string
+{
+    NSDateFormatter* formatter = [[[NSDateFormatter alloc] init] autorelease];
+    formatter.dateFormat = @"yyyy-MM-dd HH:mm:ss";
+    formatter.timeZone = [NSTimeZone timeZoneForSecondsFromGMT:0];
+    return [formatter dateFromString:string];
+}
+
+#pragma mark - Tests
+
+- (void)testUnixListing
+{
+    NSString* listing = @"total 12\r\n"
+    "drwxr-xr-x   2 owner group      4096 Mar  7  2011 .\r\n"
+    "drwxr-xr-x   2 owner group      4096 Mar  7  2011 ..\r\n"
+    "drwxr-xr-x   2 owner group      4096 Mar  7  2011 My Folder\r\n"
+    "-rw-r--r--   1 owner group  123456789 Mar  7  2011 café.txt\r\n"
+    "lrwxrwxrwx   1 owner           11 Jan  1  2012 link -> target/file\r\n"
+    "-rwsr-sr-T   1 owner group       99 Dec 31  2012 odd\r\n";
+
+    NSArray* entries = [self parseListing:listing format:CURLDirectoryListingFormatAutomatic chunkSize:7];
+    STAssertEquals([entries count], (NSUInteger)4, @"should skip the total and dot entries: %@", entries);
+
+    CURLDirectoryEntry* folder = [entries objectAtIndex:0];
+    STAssertEqualObjects(folder.name, @"My Folder", @"spaces should be kept");
+    STAssertEquals(folder.type, CURLDirectoryEntryTypeDirectory, @"wrong type");
+    STAssertEquals(folder.permissions, (unsigned short)0755, @"wrong permissions");
+
+    CURLDirectoryEntry* file = [entries objectAtIndex:1];
+    STAssertEqualObjects(file.name, @"café.txt", @"should be decoded as UTF-8");
+    STAssertEquals(file.size, 123456789ULL, @"wrong size");
+    STAssertEquals(file.format, CURLDirectoryListingFormatUnix, @"should say how it was parsed");
+    STAssertEqualObjects(file.modificationDate, [self dateWithString:@"2011-03-07 00:00:00"], @"wrong date");
+
+    CURLDirectoryEntry* link = [entries objectAtIndex:2];
+    STAssertEqualObjects(link.name, @"link", @"target should be split off");
+    STAssertEqualObjects(link.symbolicLinkTarget, @"target/file", @"wrong target");
+    STAssertEquals(link.type, CURLDirectoryEntryTypeSymbolicLink, @"wrong type");
+
+    CURLDirectoryEntry* odd = [entries objectAtIndex:3];
+    STAssertEquals(odd.permissions, (unsigned short)07754, @"setuid, setgid and sticky bits should be parsed");
+}
+
+- (void)testUnixDateWithoutYear
+{
+    CURLDirectoryEntry* entry = [CURLDirectoryListingParser entryWithLine:@"-rw-r--r-- 1 owner group 5 Jan  2 03:04 recent" format:CURLDirectoryListingFormatUnix];
+    STAssertNotNil(entry, @"should parse");
+
+    NSDate* date = entry.modificationDate;
+    STAssertTrue([date timeIntervalSinceNow] < 86400.0, @"should never be far in the future: %@", date);
+    STAssertTrue([date timeIntervalSinceNow] > -366.0 * 86400.0, @"should be within the last year: %@", date);
+}
+
+- (void)testMLSDListing
+{
+    NSString* listing = @"type=cdir;modify=20130307123456; /home\r\n"
+    "type=pdir;modify=20130307123456; /\r\n"
+    "type=file;size=1234;modify=20130307123456.789;UNIX.mode=0644; name with space\r\n"
+    "Type=dir;Modify=20120101000000; sub\r\n"
+    "type=OS.unix=slink:/elsewhere;modify=20120101000000; link\r\n";
+
+    NSArray* entries = [self parseListing:listing format:CURLDirectoryListingFormatAutomatic chunkSize:5];
+    STAssertEquals([entries count], (NSUInteger)3, @"should skip cdir and pdir: %@", entries);
+
+    CURLDirectoryEntry* file = [entries objectAtIndex:0];
+    STAssertEqualObjects(file.name, @"name with space", @"wrong name");
+    STAssertEquals(file.size, 1234ULL, @"wrong size");
+    STAssertEquals(file.permissions, (unsigned short)0644, @"wrong permissions");
+    STAssertEqualObjects(file.modificationDate, [self dateWithString:@"2013-03-07 12:34:56"], @"wrong date");
+    STAssertEquals(file.format, CURLDirectoryListingFormatMLSD, @"should say how it was parsed");
+
+    STAssertEquals([[entries objectAtIndex:1] type], CURLDirectoryEntryTypeDirectory, @"facts should be case-insensitive");
+    STAssertEquals([[entries objectAtIndex:2] type], CURLDirectoryEntryTypeSymbolicLink, @"wrong type");
+}
+
+- (void)testWindowsListing
+{
+    NSString* listing = @"03-07-13  12:34PM       <DIR>          Windows Folder\r\n"
+    "03-07-2013  00:05                 1234 file.txt\r\n"
+    "01-01-99  12:00AM                   55 old";     // no final newline
+
+    NSArray* entries = [self parseListing:listing format:CURLDirectoryListingFormatAutomatic chunkSize:3];
+    STAssertEquals([entries count], (NSUInteger)3, @"%@", entries);
+
+    CURLDirectoryEntry* folder = [entries objectAtIndex:0];
+    STAssertEqualObjects(folder.name, @"Windows Folder", @"wrong name");
+    STAssertEquals(folder.type, CURLDirectoryEntryTypeDirectory, @"wrong type");
+    STAssertEqualObjects(folder.modificationDate, [self dateWithString:@"2013-03-07 12:34:00"], @"wrong date");
+    STAssertEquals(folder.format, CURLDirectoryListingFormatWindows, @"should say how it was parsed");
+
+    CURLDirectoryEntry* file = [entries objectAtIndex:1];
+    STAssertEquals(file.size, 1234ULL, @"wrong size");
+
+    CURLDirectoryEntry* old = [entries objectAtIndex:2];
+    STAssertEqualObjects(old.modificationDate, [self dateWithString:@"1999-01-01 00:00:00"], @"midnight and two-digit years should be handled");
+}
+
+- (void)testOverlongLineIsSkipped
+{
+    __block NSUInteger count = 0;
+    CURLDirectoryListingParser* parser = [[CURLDirectoryListingParser alloc] initWithFormat:CURLDirectoryListingFormatUnix handler:^(NSArray *entries) {
+        count += [entries count];
+    }];
+
+    NSMutableData* garbage = [NSMutableData dataWithLength:100 * 1024];
+    memset([garbage mutableBytes], 'x', [garbage length]);
+    [parser appendData:garbage];
+    [parser appendData:[@"\n-rw-r--r-- 1 owner group 5 Jan  2  2013 after\n" dataUsingEncoding:NSUTF8StringEncoding]];
+    [parser finish];
+
+    STAssertEquals(count, (NSUInteger)1, @"the entry after the garbage should still be found");
+    STAssertEquals(parser.skippedLineCount, (NSUInteger)1, @"the garbage should count as one line");
+
+    [parser release];
+}
+
+- (void)testLargeListing
+{
+    // Entries are handed over as they're parsed, so this only ever holds one chunk of text at a time
+    __block NSUInteger count = 0;
+    __block unsigned long long totalSize = 0;
+    CURLDirectoryListingParser* parser = [[CURLDirectoryListingParser alloc] initWithFormat:CURLDirectoryListingFormatAutomatic handler:^(NSArray *entries) {
+        count += [entries count];
+        for (CURLDirectoryEntry* entry in entries)
+        {
+            totalSize += entry.size;
+        }
+    }];
+
+    NSUInteger lines = 1000000;
+    NSUInteger chunkSize = 16 * 1024;   // as libcurl delivers it
+    NSMutableData* chunk = [NSMutableData dataWithCapacity:chunkSize];
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    for (NSUInteger i = 0; i < lines; ++i)
+    {
+        char line[128];
+        int length = snprintf(line, sizeof(line), "-rw-r--r--   1 owner group %8lu Mar  7  2011 file%lu.txt\r\n", (unsigned long)i, (unsigned long)i);
+        if ([chunk length] + length > chunkSize)
+        {
+            [parser appendData:chunk];
+            [chunk setLength:0];
+        }
+        [chunk appendBytes:line length:length];
+    }
+    [parser appendData:chunk];
+    [parser finish];
+    CFAbsoluteTime elapsed = CFAbsoluteTimeGetCurrent() - start;
+
+    NSLog(@"Parsed %lu entries in %.2fs", (unsigned long)count, elapsed);
+
+    STAssertEquals(count, lines, @"every line should be an entry");
+    STAssertEquals(totalSize, (unsigned long long)lines * (lines - 1) / 2, @"sizes should add up");
+    STAssertEquals(parser.skippedLineCount, (NSUInteger)0, @"nothing should be skipped");
+
+    [parser release];
+}
+
+@end
@@ -0,0 +1,146 @@
+//
+//  CURLDirectorySyncTests.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLDirectorySync.h"
+#import "CURLHandleBasedTest.h"
+
+
+@interface CURLDirectorySyncTests : CURLHandleBasedTest <CURLDirectorySyncDelegate>
+
+@property (strong, nonatomic) NSMutableArray* actions;
+@property (strong, nonatomic) CURLDirectorySyncSummary* summary;
+
+@end
+
+@implementation CURLDirectorySyncTests
+
+- (void)dealloc
+{
+    [_actions release];
+    [_summary release];
+
+    [super dealloc];
+}
+
+- (void)directorySync:(CURLDirectorySync *)sync didFinishAction:(CURLDirectorySyncAction *)action
+{
+    if (!self.actions)
+    {
+        self.actions = [NSMutableArray array];
+    }
+
+    [self.actions addObject:action];
+}
+
+- (void)directorySync:(CURLDirectorySync *)sync didCompleteWithSummary:(CURLDirectorySyncSummary *)summary
+{
+    NSLog(@"test: directory sync finished %@", summary);
+
+    self.summary = summary;
+    [self pause];
+}
+
+- (NSURL*)makeLocalTree
+{
+    NSFileManager* fm = [NSFileManager defaultManager];
+    NSURL* root = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:@"CURLDirectorySyncTests"] isDirectory:YES];
+    [fm removeItemAtURL:root error:NULL];
+
+    NSData* data = [NSData dataWithContentsOfURL:[self testFileURL]];
+    for (NSString* directory in @[@"", @"A", @"A/Deeper", @"B"])
+    {
+        NSURL* directoryURL = [root URLByAppendingPathComponent:directory isDirectory:YES];
+        [fm createDirectoryAtURL:directoryURL withIntermediateDirectories:YES attributes:nil error:NULL];
+        for (NSUInteger i = 0; i < 3; ++i)
+        {
+            NSString* name = [NSString stringWithFormat:@"File%lu.txt", (unsigned long)i];
+            [data writeToURL:[directoryURL URLByAppendingPathComponent:name] atomically:YES];
+        }
+    }
+
+    return root;
+}
+
+- (CURLDirectorySyncSummary*)syncLocalURL:(NSURL*)localURL remoteURL:(NSURL*)remoteURL manifestURL:(NSURL*)manifestURL
+{
+    self.actions = nil;
+    self.summary = nil;
+
+    CURLDirectorySync* sync = [[CURLDirectorySync alloc] initWithLocalURL:localURL remoteURL:remoteURL credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue]];
+    sync.manifestURL = manifestURL;
+    [sync start];
+
+    [self runUntilPaused];
+    [sync release];
+
+    return self.summary;
+}
+
+#pragma mark - Tests
+
+- (void)testUnreachableServer
+{
+    NSURL* localURL = [self makeLocalTree];
+    NSURL* manifestURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:@"CURLDirectorySyncTests.plist"]];
+    [[NSFileManager defaultManager] removeItemAtURL:manifestURL error:NULL];
+
+    // Nothing listens on port 1, so the first thing tried fails and nothing else is attempted
+    CURLDirectorySyncSummary* summary = [self syncLocalURL:localURL remoteURL:[NSURL URLWithString:@"ftp://127.0.0.1:1/Sync/"] manifestURL:manifestURL];
+
+    STAssertEquals(summary.failedCount, (NSUInteger)1, @"%@", self.actions);
+    STAssertEquals(summary.uploadedFileCount, (NSUInteger)0, @"nothing should have been uploaded");
+    STAssertEquals([self.actions count], (NSUInteger)1, @"%@", self.actions);
+
+    CURLDirectorySyncAction* action = [self.actions lastObject];
+    STAssertEquals(action.type, CURLDirectorySyncActionTypeCreateDirectory, @"should start by making sure the remote directory exists");
+    STAssertEquals([action.error code], (NSInteger)NSURLErrorCannotConnectToHost, @"%@", action);
+
+    // A failed sync mustn't let the next one skip anything
+    summary = [self syncLocalURL:localURL remoteURL:[NSURL URLWithString:@"ftp://127.0.0.1:1/Sync/"] manifestURL:manifestURL];
+    STAssertEquals(summary.skippedDirectoryCount, (NSUInteger)0, @"nothing should have been recorded as synced");
+}
+
+- (void)testSync
+{
+    NSURL* ftpRoot = [self ftpTestServer];
+    if (!ftpRoot || [self usingMockServer])
+    {
+        NSLog(@"Skipping directory sync test as it needs a real FTP server");
+        return;
+    }
+
+    NSURL* localURL = [self makeLocalTree];
+    NSURL* remoteURL = [ftpRoot URLByAppendingPathComponent:@"CURLHandleTests/Sync/"];
+    NSURL* manifestURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:@"CURLDirectorySyncTests.plist"]];
+    [[NSFileManager defaultManager] removeItemAtURL:manifestURL error:NULL];
+
+    // Without a manifest, everything is compared (and perhaps uploaded)
+    CURLDirectorySyncSummary* summary = [self syncLocalURL:localURL remoteURL:remoteURL manifestURL:manifestURL];
+    STAssertEquals(summary.failedCount, (NSUInteger)0, @"unexpected failures in %@", self.actions);
+    STAssertEquals(summary.uploadedFileCount + summary.unchangedFileCount, (NSUInteger)12, @"every file should have been dealt with");
+
+    // Nothing's changed, so nothing needs listing
+    summary = [self syncLocalURL:localURL remoteURL:remoteURL manifestURL:manifestURL];
+    STAssertEquals(summary.failedCount, (NSUInteger)0, @"unexpected failures in %@", self.actions);
+    STAssertEquals(summary.listedDirectoryCount, (NSUInteger)0, @"should have trusted the manifest");
+    STAssertEquals(summary.skippedDirectoryCount, (NSUInteger)1, @"the whole tree should have been skipped");
+    STAssertEquals([self.actions count], (NSUInteger)0, @"%@", self.actions);
+
+    // Change one file; only its directory and those above it need listing
+    NSData* data = [@"changed" dataUsingEncoding:NSUTF8StringEncoding];
+    [data writeToURL:[localURL URLByAppendingPathComponent:@"A/Deeper/File1.txt"] atomically:YES];
+
+    summary = [self syncLocalURL:localURL remoteURL:remoteURL manifestURL:manifestURL];
+    STAssertEquals(summary.failedCount, (NSUInteger)0, @"unexpected failures in %@", self.actions);
+    STAssertEquals(summary.uploadedFileCount, (NSUInteger)1, @"only the changed file should have been sent");
+    STAssertEquals(summary.listedDirectoryCount, (NSUInteger)3, @"root, A and A/Deeper should have been listed");
+    STAssertEquals(summary.skippedDirectoryCount, (NSUInteger)1, @"B should have been skipped");
+    STAssertEquals(summary.unchangedFileCount, (NSUInteger)8, @"the other files listed should have been left alone");
+}
+
+@end
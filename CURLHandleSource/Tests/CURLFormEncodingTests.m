@@ -0,0 +1,107 @@
+//
+//  CURLFormEncodingTests.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 18/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "NSDictionary+CURLHandle.h"
+
+#import <SenTestingKit/SenTestingKit.h>
+
+
+@interface CURLFormEncodingTests : SenTestCase
+
+@end
+
+@implementation CURLFormEncodingTests
+
+- (NSString*)stringForForm:(NSDictionary*)form encoding:(NSStringEncoding)encoding ordering:(NSArray*)ordering
+{
+    NSData* data = [form dataFormattedForHTTPUsingEncoding:encoding ordering:ordering];
+    STAssertNotNil(data, @"should always get data back");
+
+    // The result is always plain ASCII, whatever the encoding
+    return [[[NSString alloc] initWithData:data encoding:NSASCIIStringEncoding] autorelease];
+}
+
+- (void)testOrdering
+{
+    NSDictionary* form = [NSDictionary dictionaryWithObjectsAndKeys:@"a b&c=d/é", @"key one", [NSArray arrayWithObjects:@"1", @"2", nil], @"list", @"left out", @"other", nil];
+
+    STAssertEqualObjects([self stringForForm:form encoding:NSUTF8StringEncoding ordering:[NSArray arrayWithObjects:@"key one", @"list", nil]],
+                         @"key+one=a+b%26c%3Dd%2F%C3%A9&list=1&list=2",
+                         @"keys should come in order, with those not in the ordering left out");
+
+    STAssertEqualObjects([self stringForForm:form encoding:NSUTF8StringEncoding ordering:[NSArray arrayWithObjects:@"list", @"missing", @"key one", nil]],
+                         @"list=1&list=2&key+one=a+b%26c%3Dd%2F%C3%A9",
+                         @"keys not in the dictionary should be skipped, without a stray &");
+}
+
+- (void)testNilOrdering
+{
+    NSDictionary* form = [NSDictionary dictionaryWithObjectsAndKeys:@"1", @"a", @"two words", @"b", [NSArray arrayWithObjects:@"x", @"y", nil], @"c", [NSNumber numberWithInt:42], @"d", nil];
+    NSString* result = [self stringForForm:form encoding:NSUTF8StringEncoding ordering:nil];
+
+    // Any order will do, so long as every pair is there once
+    NSArray* pairs = [result componentsSeparatedByString:@"&"];
+    STAssertEquals([pairs count], (NSUInteger)5, @"should have every value of every key: %@", result);
+    STAssertEqualObjects([NSSet setWithArray:pairs],
+                         ([NSSet setWithObjects:@"a=1", @"b=two+words", @"c=x", @"c=y", @"d=42", nil]),
+                         @"wrong pairs: %@", result);
+
+    NSRange x = [result rangeOfString:@"c=x"];
+    NSRange y = [result rangeOfString:@"c=y"];
+    STAssertTrue(x.location < y.location, @"a key's values should stay in order: %@", result);
+}
+
+- (void)testMultipleValues
+{
+    NSDictionary* form = [NSDictionary dictionaryWithObjectsAndKeys:
+                          [NSArray arrayWithObjects:@"one", @"two & three", [NSNumber numberWithInt:4], nil], @"list",
+                          [NSArray array], @"empty",
+                          @"value", @"single",
+                          nil];
+
+    STAssertEqualObjects([self stringForForm:form encoding:NSUTF8StringEncoding ordering:[NSArray arrayWithObjects:@"list", @"empty", @"single", nil]],
+                         @"list=one&list=two+%26+three&list=4&single=value",
+                         @"each value should get its own pair, and an empty list none at all");
+
+    STAssertEqualObjects([self stringForForm:form encoding:NSUTF8StringEncoding ordering:[NSArray arrayWithObjects:@"empty", @"single", nil]],
+                         @"single=value",
+                         @"an empty list first mustn't leave a stray &");
+}
+
+- (void)testEncodingWithUnrepresentableCharacters
+{
+    // Latin 1 has é as a single byte, but no €, which becomes an escaped "?"
+    NSDictionary* form = [NSDictionary dictionaryWithObject:@"café 5€" forKey:@"prix"];
+    STAssertEqualObjects([self stringForForm:form encoding:NSISOLatin1StringEncoding ordering:nil],
+                         @"prix=caf%E9+5%3F",
+                         @"wrong Latin 1 encoding");
+
+    // Likewise for keys, and for an encoding with even less in it
+    form = [NSDictionary dictionaryWithObject:@"naïve" forKey:@"résumé"];
+    STAssertEqualObjects([self stringForForm:form encoding:NSASCIIStringEncoding ordering:nil],
+                         @"r%3Fsum%3F=na%3Fve",
+                         @"wrong ASCII encoding");
+
+    // Pure ASCII takes the fast path, which should give the same answer
+    form = [NSDictionary dictionaryWithObject:@"plain*text-with.safe_bits~and more" forKey:@"ascii"];
+    STAssertEqualObjects([self stringForForm:form encoding:NSISOLatin1StringEncoding ordering:nil],
+                         @"ascii=plain*text-with.safe_bits%7Eand+more",
+                         @"wrong encoding of ASCII");
+}
+
+- (void)testEmptyDictionary
+{
+    NSData* data = [[NSDictionary dictionary] dataFormattedForHTTPUsingEncoding:NSUTF8StringEncoding ordering:nil];
+    STAssertNotNil(data, @"should get empty data, not nil");
+    STAssertEquals([data length], (NSUInteger)0, @"should be empty");
+
+    data = [[NSDictionary dictionary] dataFormattedForHTTPUsingEncoding:NSUTF8StringEncoding ordering:[NSArray arrayWithObject:@"missing"]];
+    STAssertEquals([data length], (NSUInteger)0, @"should be empty, even when asked for keys");
+}
+
+@end
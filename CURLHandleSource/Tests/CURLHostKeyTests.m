@@ -0,0 +1,206 @@
+//
+//  CURLHostKeyTests.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLMultiHandle.h"
+#import "CURLHandleBasedTest.h"
+#import "CURLTransfer+TestingSupport.h"
+#import "CURLTransfer+MultiSupport.h"
+
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+
+// Private methods, so tests can stand in for libcurl checking the host key
+@interface CURLTransfer (CURLHostKeyTests)
++ (BOOL)getHostKeyDecision:(enum curl_khstat *)decision forKey:(NSData *)key;
+- (NSData *)hostKeyDecisionKeyForFingerprint:(const struct curl_khkey *)key match:(enum curl_khmatch)match;
+- (enum curl_khstat)didFindHostFingerprint:(const struct curl_khkey *)foundKey knownFingerprint:(const struct curl_khkey *)knownkey match:(enum curl_khmatch)match;
+@end
+
+
+@interface CURLHostKeyTests : CURLHandleBasedTest
+{
+    int _listeningSocket;
+    dispatch_source_t _acceptSource;
+    NSMutableArray* _connections;
+}
+
+@property (assign, atomic) NSUInteger connectionCount;
+@property (assign, atomic) NSUInteger questionCount;
+@property (assign, atomic) enum curl_khstat answer;
+
+@end
+
+@implementation CURLHostKeyTests
+
+- (void)setUp
+{
+    [super setUp];
+
+    // A server which accepts connections, but never says anything, so libcurl sits waiting for the SSH banner
+    _listeningSocket = socket(AF_INET, SOCK_STREAM, 0);
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_len = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(_listeningSocket, (struct sockaddr *)&address, sizeof(address));
+    listen(_listeningSocket, 8);
+
+    _connections = [[NSMutableArray alloc] init];
+    _acceptSource = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, _listeningSocket, 0, dispatch_get_main_queue());
+    dispatch_source_set_event_handler(_acceptSource, ^{
+        int connection = accept(_listeningSocket, NULL, NULL);
+        if (connection >= 0)
+        {
+            [_connections addObject:[NSNumber numberWithInt:connection]];
+            self.connectionCount++;
+        }
+    });
+    dispatch_resume(_acceptSource);
+}
+
+- (void)tearDown
+{
+    dispatch_source_cancel(_acceptSource);
+    dispatch_release(_acceptSource); _acceptSource = NULL;
+
+    for (NSNumber* connection in _connections)
+    {
+        close([connection intValue]);
+    }
+    [_connections release]; _connections = nil;
+    close(_listeningSocket);
+
+    [super tearDown];
+}
+
+- (NSURL*)listeningURL
+{
+    struct sockaddr_in address;
+    socklen_t length = sizeof(address);
+    getsockname(_listeningSocket, (struct sockaddr *)&address, &length);
+
+    return [NSURL URLWithString:[NSString stringWithFormat:@"sftp://127.0.0.1:%d/file.txt", ntohs(address.sin_port)]];
+}
+
+- (enum curl_khstat)transfer:(CURLTransfer *)transfer didFindHostFingerprint:(const struct curl_khkey *)foundKey knownFingerprint:(const struct curl_khkey *)knownkey match:(enum curl_khmatch)match;
+{
+    self.questionCount++;
+    return self.answer;
+}
+
+- (BOOL)runUntilConnectionCount:(NSUInteger)count
+{
+    NSDate* limit = [NSDate dateWithTimeIntervalSinceNow:10.0];
+    while (self.connectionCount < count && [limit timeIntervalSinceNow] > 0)
+    {
+        [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.01]];
+    }
+
+    return (self.connectionCount >= count);
+}
+
+/**
+ Does what libcurl does when a host key check is deferred: asks, then fails the attempt with
+ CURLE_PEER_FAILED_VERIFICATION. A fresh random key each time keeps the process-wide cache out of it.
+ */
+
+- (NSData*)deferHostKeyCheckForTransfer:(CURLTransfer*)transfer multi:(CURLMultiHandle*)multi
+{
+    unsigned char bytes[32];
+    arc4random_buf(bytes, sizeof(bytes));
+    struct curl_khkey key = { (const char *)bytes, sizeof(bytes), CURLKHTYPE_RSA };
+
+    __block enum curl_khstat result;
+    __block NSData* decisionKey = nil;
+    dispatch_sync(multi.queue, ^{
+        decisionKey = [[transfer hostKeyDecisionKeyForFingerprint:&key match:CURLKHMATCH_MISSING] retain];
+        result = [transfer didFindHostFingerprint:&key knownFingerprint:NULL match:CURLKHMATCH_MISSING];
+    });
+    STAssertEquals(result, CURLKHSTAT_DEFER, @"should defer asking the delegate");
+
+    dispatch_async(multi.queue, ^{
+        [multi suspendTransfer:transfer];
+        [transfer completeWithCode:CURLE_PEER_FAILED_VERIFICATION];
+    });
+
+    return [decisionKey autorelease];
+}
+
+#pragma mark - Tests
+
+- (void)testDeferredHostKeyReconnects
+{
+    CURLMultiHandle* multi = [[CURLMultiHandle alloc] init];
+    NSOperationQueue* queue = [[NSOperationQueue alloc] init];
+    queue.maxConcurrentOperationCount = 1;
+
+    self.answer = CURLKHSTAT_FINE;
+    NSURLRequest* request = [NSURLRequest requestWithURL:[self listeningURL]];
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:request credential:nil delegate:self delegateQueue:queue multi:multi];
+    STAssertTrue([self runUntilConnectionCount:1], @"should have connected");
+
+    NSData* decisionKey = [self deferHostKeyCheckForTransfer:transfer multi:multi];
+
+    // Accepting the key should start the transfer over, rather than fail it
+    STAssertTrue([self runUntilConnectionCount:2], @"should have reconnected once the delegate accepted the key");
+    STAssertEquals(self.questionCount, (NSUInteger)1, @"delegate should have been asked once");
+    STAssertNil(self.error, @"shouldn't have failed: %@", self.error);
+
+    enum curl_khstat cached;
+    STAssertTrue([CURLTransfer getHostKeyDecision:&cached forKey:decisionKey], @"the answer should have been remembered");
+    STAssertEquals(cached, CURLKHSTAT_FINE, @"the answer should have been remembered");
+
+    [transfer cancel];
+    [self runUntilPaused];
+    STAssertEquals([self.error code], (NSInteger)NSURLErrorCancelled, @"should have been cancelled, not %@", self.error);
+
+    [transfer release];
+    [queue release];
+    [multi shutdown];
+    [multi release];
+}
+
+- (void)testCancelWhileHostKeyDeferred
+{
+    CURLMultiHandle* multi = [[CURLMultiHandle alloc] init];
+    NSOperationQueue* queue = [[NSOperationQueue alloc] init];
+    queue.maxConcurrentOperationCount = 1;
+
+    self.answer = CURLKHSTAT_FINE;
+    NSURLRequest* request = [NSURLRequest requestWithURL:[self listeningURL]];
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:request credential:nil delegate:self delegateQueue:queue multi:multi];
+    STAssertTrue([self runUntilConnectionCount:1], @"should have connected");
+
+    // Hold the question back until the transfer's been cancelled
+    [queue setSuspended:YES];
+    NSData* decisionKey = [self deferHostKeyCheckForTransfer:transfer multi:multi];
+    [transfer cancel];
+    [queue setSuspended:NO];
+
+    [self runUntilPaused];
+    STAssertEquals([self.error code], (NSInteger)NSURLErrorCancelled, @"should have been cancelled, not %@", self.error);
+    STAssertEquals(self.questionCount, (NSUInteger)0, @"there's nothing left to ask about");
+
+    enum curl_khstat cached;
+    STAssertFalse([CURLTransfer getHostKeyDecision:&cached forKey:decisionKey], @"cancelling isn't an answer, so mustn't be remembered");
+
+    // Give a late answer the chance to (wrongly) start things up again
+    [[NSRunLoop currentRunLoop] runUntilDate:[NSDate dateWithTimeIntervalSinceNow:0.5]];
+    STAssertEquals(self.connectionCount, (NSUInteger)1, @"shouldn't have reconnected");
+
+    [transfer release];
+    [queue release];
+    [multi shutdown];
+    [multi release];
+}
+
+@end
@@ -0,0 +1,115 @@
+//
+//  CURLMultipartFormDataTests.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLMultipartFormData.h"
+#import "CURLRequest.h"
+#import "CURLHandleBasedTest.h"
+
+
+@interface CURLMultipartFormDataTests : CURLHandleBasedTest
+
+@end
+
+@implementation CURLMultipartFormDataTests
+
+- (NSData*)readStream:(NSInputStream*)stream chunkSize:(NSUInteger)chunkSize
+{
+    NSMutableData* result = [NSMutableData data];
+    uint8_t buffer[chunkSize];
+
+    [stream open];
+    NSInteger read;
+    while ((read = [stream read:buffer maxLength:chunkSize]) > 0)
+    {
+        [result appendBytes:buffer length:read];
+    }
+    [stream close];
+
+    return (read < 0 ? nil : result);
+}
+
+- (void)testBodyLayout
+{
+    CURLMultipartFormData* form = [[CURLMultipartFormData alloc] init];
+    [form addValue:@"café" forName:@"drink"];
+    [form addData:[@"<p/>" dataUsingEncoding:NSUTF8StringEncoding] forName:@"say \"hi\"" filename:@"hi.html" contentType:@"text/html"];
+
+    NSError* error = nil;
+    STAssertTrue([form addFileAtURL:[self testFileURL] forName:@"notes" filename:nil contentType:nil error:&error], @"couldn't add file: %@", error);
+
+    NSInputStream* stream = [form newInputStream];
+    NSData* body = [self readStream:stream chunkSize:7];   // awkward size to cross part boundaries mid-read
+    [stream release];
+
+    STAssertEquals((unsigned long long)[body length], form.contentLength, @"Content-Length should be exact");
+
+    NSData* fileData = [NSData dataWithContentsOfURL:[self testFileURL]];
+    NSMutableData* expected = [NSMutableData data];
+    NSString* boundary = form.boundary;
+    [expected appendData:[[NSString stringWithFormat:@"--%@\r\nContent-Disposition: form-data; name=\"drink\"\r\n\r\ncafé\r\n", boundary] dataUsingEncoding:NSUTF8StringEncoding]];
+    [expected appendData:[[NSString stringWithFormat:@"--%@\r\nContent-Disposition: form-data; name=\"say %%22hi%%22\"; filename=\"hi.html\"\r\nContent-Type: text/html\r\n\r\n<p/>\r\n", boundary] dataUsingEncoding:NSUTF8StringEncoding]];
+    [expected appendData:[[NSString stringWithFormat:@"--%@\r\nContent-Disposition: form-data; name=\"notes\"; filename=\"%@\"\r\nContent-Type: application/octet-stream\r\n\r\n", boundary, [[self testFileURL] lastPathComponent]] dataUsingEncoding:NSUTF8StringEncoding]];
+    [expected appendData:fileData];
+    [expected appendData:[[NSString stringWithFormat:@"\r\n--%@--\r\n", boundary] dataUsingEncoding:NSUTF8StringEncoding]];
+
+    STAssertEqualObjects(body, expected, @"body didn't match");
+
+    [form release];
+}
+
+- (void)testStreamsAreIndependent
+{
+    CURLMultipartFormData* form = [[CURLMultipartFormData alloc] init];
+    [form addValue:@"value" forName:@"name"];
+
+    NSInputStream* first = [form newInputStream];
+    NSInputStream* second = [form newInputStream];
+    STAssertEqualObjects([self readStream:first chunkSize:1024], [self readStream:second chunkSize:3], @"each stream should produce the whole body");
+    [first release];
+    [second release];
+
+    [form release];
+}
+
+- (void)testShrunkFileFails
+{
+    NSString* path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSProcessInfo processInfo] globallyUniqueString]];
+    NSURL* url = [NSURL fileURLWithPath:path];
+    [[@"0123456789" dataUsingEncoding:NSUTF8StringEncoding] writeToURL:url atomically:NO];
+
+    CURLMultipartFormData* form = [[CURLMultipartFormData alloc] init];
+    STAssertTrue([form addFileAtURL:url forName:@"file" filename:nil contentType:nil error:NULL], @"couldn't add file");
+
+    [[@"01234" dataUsingEncoding:NSUTF8StringEncoding] writeToURL:url atomically:NO];
+
+    NSInputStream* stream = [form newInputStream];
+    STAssertNil([self readStream:stream chunkSize:1024], @"reading should fail rather than send a short body");
+    STAssertNotNil([stream streamError], @"should report an error");
+    [stream release];
+
+    [form release];
+    [[NSFileManager defaultManager] removeItemAtURL:url error:NULL];
+}
+
+- (void)testApplyToRequest
+{
+    CURLMultipartFormData* form = [[CURLMultipartFormData alloc] init];
+    [form addValue:@"value" forName:@"name"];
+
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/form"]];
+    [form applyToRequest:request];
+
+    STAssertEqualObjects([request HTTPMethod], @"POST", @"should POST");
+    STAssertEqualObjects([request valueForHTTPHeaderField:@"Content-Type"], form.contentType, @"wrong content type");
+    STAssertNotNil([request HTTPBodyStream], @"should have a body stream");
+    STAssertEquals([[request curl_uploadLength] unsignedLongLongValue], form.contentLength, @"length should be passed on");
+
+    [form release];
+}
+
+@end
@@ -8,21 +8,48 @@
 
 #import "CURLProtocol.h"
 #import "CURLRequest.h"
+#import "CURLResponseCache.h"
 
 #import "CURLHandleBasedTest.h"
+#import "KMSServer.h"
 
 @interface CURLProtocolTests : CURLHandleBasedTest<NSURLConnectionDelegate, NSURLConnectionDataDelegate>
 
 @property (assign, nonatomic) BOOL pauseOnResponse;
+@property (strong, nonatomic) NSURLCredential* challengeCredential;
+@property (assign, nonatomic) NSUInteger challengeCount;
+@property (assign, nonatomic) NSInteger previousFailureCount;
 
 @end
 
 @implementation CURLProtocolTests
 
+- (void)dealloc
+{
+    [_challengeCredential release];
+
+    [super dealloc];
+}
+
 - (void)setUp;
 {
     [super setUp];
     [NSURLProtocol registerClass:[CURLProtocol class]];
+
+    // So every test starts out having to ask
+    [CURLProtocol clearFTPCredentialCache];
+}
+
+- (void)tearDown
+{
+    CURLResponseCache* cache = [CURLProtocol responseCache];
+    if (cache)
+    {
+        [CURLProtocol setResponseCache:nil];
+        [[NSFileManager defaultManager] removeItemAtURL:cache.directoryURL error:NULL];
+    }
+
+    [super tearDown];
 }
 
 - (void)connection:(NSURLConnection *)connection didFailWithError:(NSError *)error
@@ -59,11 +86,58 @@
     [self pause];
 }
 
+- (void)connection:(NSURLConnection *)connection willSendRequestForAuthenticationChallenge:(NSURLAuthenticationChallenge *)challenge
+{
+    self.challengeCount++;
+    self.previousFailureCount = [challenge previousFailureCount];
+
+    NSURLCredential* credential = (self.challengeCredential ? self.challengeCredential : [challenge proposedCredential]);
+    if (credential)
+    {
+        [[challenge sender] useCredential:credential forAuthenticationChallenge:challenge];
+    }
+    else
+    {
+        [[challenge sender] continueWithoutCredentialForAuthenticationChallenge:challenge];
+    }
+}
+
 - (void)connection:(NSURLConnection *)connection didSendBodyData:(NSInteger)bytesWritten totalBytesWritten:(NSInteger)totalBytesWritten totalBytesExpectedToWrite:(NSInteger)totalBytesExpectedToWrite;
 {
     self.sending = YES;
 }
 
+- (void)loadURL:(NSURL*)url
+{
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:url];
+    request.shouldUseCurlHandle = YES;
+
+    self.buffer = nil;
+    self.error = nil;
+    NSURLConnection* connection = [NSURLConnection connectionWithRequest:request delegate:self];
+    STAssertNotNil(connection, @"failed to get connection for request %@", request);
+
+    [self runUntilPaused];
+}
+
+- (CURLResponseCache*)useResponseCacheWithServerData:(NSData*)data
+{
+    [self setupServerWithResponseFileNamed:@"http-cache"];
+    self.server.data = data;
+
+    NSString* name = [NSString stringWithFormat:@"CURLProtocolTests-%@", [[NSProcessInfo processInfo] globallyUniqueString]];
+    NSURL* directoryURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:name] isDirectory:YES];
+    CURLResponseCache* cache = [[[CURLResponseCache alloc] initWithDirectoryURL:directoryURL] autorelease];
+    [CURLProtocol setResponseCache:cache];
+
+    return cache;
+}
+
+- (NSURL*)serverURLForPath:(NSString*)path
+{
+    return [NSURL URLWithString:[NSString stringWithFormat:@"http://127.0.0.1:%ld/%@", (long)self.server.port, path]];
+}
+
 - (void)testHTTPDownload
 {
     NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[self testFileRemoteURL]];
@@ -147,4 +221,111 @@
     }
 }
 
+- (void)testFTPCredentialIsRemembered
+{
+    NSURL* ftpRoot = [self ftpTestServer];
+    if (!ftpRoot || [self usingMockServer] || ![ftpRoot user])
+    {
+        NSLog(@"Skipping FTP credential test as it needs a real FTP server with a user and password");
+        return;
+    }
+
+    // Supply the login through the challenge rather than the URL
+    self.challengeCredential = [NSURLCredential credentialWithUser:[ftpRoot user] password:[ftpRoot password] persistence:NSURLCredentialPersistenceForSession];
+    NSString* host = ([ftpRoot port] ? [NSString stringWithFormat:@"%@:%@", [ftpRoot host], [ftpRoot port]] : [ftpRoot host]);
+    NSString* path = [[@"/" stringByAppendingPathComponent:[ftpRoot path]] stringByAppendingPathComponent:@"CURLHandleTests/TestContent.txt"];
+    NSURL* url = [[[NSURL alloc] initWithScheme:[ftpRoot scheme] host:host path:path] autorelease];
+
+    for (NSUInteger i = 0; i < 3; ++i)
+    {
+        NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:url];
+        request.shouldUseCurlHandle = YES;
+
+        NSURLConnection* connection = [NSURLConnection connectionWithRequest:request delegate:self];
+        STAssertNotNil(connection, @"failed to get connection for request %@", request);
+
+        [self runUntilPaused];
+        [self checkDownloadedBufferWasCorrect];
+    }
+
+    STAssertEquals(self.challengeCount, (NSUInteger)1, @"only the first request should have needed to ask");
+}
+
+- (void)testFTPCredentialRejectedAsksAgain
+{
+    [self setupServerWithResponseFileNamed:@"ftp-login"];
+    self.server.data = [NSData dataWithContentsOfURL:[self testFileURL]];
+    NSURL* url = [NSURL URLWithString:[NSString stringWithFormat:@"ftp://127.0.0.1:%ld/CURLHandleTests/TestContent.txt", (long)self.server.port]];
+
+    self.challengeCredential = [NSURLCredential credentialWithUser:@"user" password:@"old" persistence:NSURLCredentialPersistenceForSession];
+    [self loadURL:url];
+    [self checkDownloadedBufferWasCorrect];
+    STAssertEquals(self.challengeCount, (NSUInteger)1, @"should have asked for a credential");
+
+    [self loadURL:url];
+    [self checkDownloadedBufferWasCorrect];
+    STAssertEquals(self.challengeCount, (NSUInteger)1, @"should have used the one that worked");
+
+    // The server closes the connection after each download, so the next request logs in afresh, and is refused
+    [self useResponseSet:@"password changed"];
+    self.challengeCredential = [NSURLCredential credentialWithUser:@"user" password:@"new" persistence:NSURLCredentialPersistenceForSession];
+    [self loadURL:url];
+    [self checkDownloadedBufferWasCorrect];
+    STAssertEquals(self.challengeCount, (NSUInteger)2, @"should have asked again once the old password was refused");
+    STAssertEquals(self.previousFailureCount, (NSInteger)1, @"the challenge should say the last credential failed");
+
+    [self loadURL:url];
+    [self checkDownloadedBufferWasCorrect];
+    STAssertEquals(self.challengeCount, (NSUInteger)2, @"should have remembered the new password");
+
+    // Forgetting means asking again
+    [CURLProtocol clearFTPCredentialCache];
+    [self loadURL:url];
+    [self checkDownloadedBufferWasCorrect];
+    STAssertEquals(self.challengeCount, (NSUInteger)3, @"should have asked again after the cache was cleared");
+}
+
+- (void)testResponseCacheFreshHit
+{
+    NSData* original = [@"original" dataUsingEncoding:NSUTF8StringEncoding];
+    CURLResponseCache* cache = [self useResponseCacheWithServerData:original];
+    NSURL* url = [self serverURLForPath:@"fresh"];
+
+    [self loadURL:url];
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEqualObjects(self.buffer, original, @"wrong body");
+    STAssertEquals(cache.entryCount, (NSUInteger)1, @"response should have been stored");
+
+    // Anything which does come over the network from now on is different
+    self.server.data = [@"changed" dataUsingEncoding:NSUTF8StringEncoding];
+
+    [self loadURL:url];
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEquals([(NSHTTPURLResponse*)self.response statusCode], (NSInteger)200, @"wrong status");
+    STAssertEqualObjects(self.buffer, original, @"should have been served from the cache, without asking the server");
+    STAssertEquals(cache.hitCount, (NSUInteger)1, @"wrong hit count");
+    STAssertEquals(cache.revalidatedCount, (NSUInteger)0, @"a fresh response shouldn't need revalidating");
+}
+
+- (void)testResponseCacheRevalidation
+{
+    NSData* original = [@"original" dataUsingEncoding:NSUTF8StringEncoding];
+    CURLResponseCache* cache = [self useResponseCacheWithServerData:original];
+    NSURL* url = [self serverURLForPath:@"stale"];
+
+    [self loadURL:url];
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEqualObjects(self.buffer, original, @"wrong body");
+    STAssertEquals(cache.entryCount, (NSUInteger)1, @"response should have been stored");
+
+    // The server answers If-None-Match: "v1" with a 304, so the stored body should be what's delivered
+    self.server.data = [@"changed" dataUsingEncoding:NSUTF8StringEncoding];
+
+    [self loadURL:url];
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEquals([(NSHTTPURLResponse*)self.response statusCode], (NSInteger)200, @"a 304 should be passed on as the stored response");
+    STAssertEqualObjects(self.buffer, original, @"should have been served from the cache once the server confirmed it");
+    STAssertEquals(cache.revalidatedCount, (NSUInteger)1, @"wrong revalidation count");
+}
+
 @end
@@ -0,0 +1,103 @@
+//
+//  CURLProxyResolverTests.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLProxyResolver.h"
+
+#import <SenTestingKit/SenTestingKit.h>
+
+
+@interface CURLProxyResolverTests : SenTestCase
+
+@end
+
+@implementation CURLProxyResolverTests
+
+- (void)setUp
+{
+    setenv("http_proxy", "http://proxy.example.com:3128", 1);
+    setenv("https_proxy", "http://secure-proxy.example.com:3129", 1);
+    setenv("no_proxy", "localhost, .internal.example.com, 10.0.0.0/8, fe80::/10, 192.168.1.5", 1);
+}
+
+- (void)tearDown
+{
+    unsetenv("http_proxy");
+    unsetenv("https_proxy");
+    unsetenv("no_proxy");
+}
+
+- (NSString*)proxyForString:(NSString*)string resolver:(CURLProxyResolver*)resolver
+{
+    return [resolver proxyForURL:[NSURL URLWithString:string]];
+}
+
+- (void)testEnvironment
+{
+    CURLProxyResolver* resolver = [CURLProxyResolver environmentResolver];
+
+    STAssertEqualObjects([self proxyForString:@"http://www.example.com/" resolver:resolver], @"http://proxy.example.com:3128", @"http should use http_proxy");
+    STAssertEqualObjects([self proxyForString:@"https://www.example.com/" resolver:resolver], @"http://secure-proxy.example.com:3129", @"https should use https_proxy");
+    STAssertNil([self proxyForString:@"ftp://www.example.com/" resolver:resolver], @"ftp is never proxied");
+}
+
+- (void)testExceptions
+{
+    CURLProxyResolver* resolver = [CURLProxyResolver environmentResolver];
+
+    STAssertNil([self proxyForString:@"http://localhost:8080/" resolver:resolver], @"exact host match");
+    STAssertNil([self proxyForString:@"http://internal.example.com/" resolver:resolver], @"domain match");
+    STAssertNil([self proxyForString:@"http://a.b.internal.example.com/" resolver:resolver], @"subdomain match");
+    STAssertNotNil([self proxyForString:@"http://notinternal.example.com/" resolver:resolver], @"suffix must be on a label boundary");
+    STAssertNil([self proxyForString:@"http://10.1.2.3/" resolver:resolver], @"IPv4 range");
+    STAssertNotNil([self proxyForString:@"http://11.1.2.3/" resolver:resolver], @"outside IPv4 range");
+    STAssertNil([self proxyForString:@"http://192.168.1.5/" resolver:resolver], @"single address");
+    STAssertNotNil([self proxyForString:@"http://192.168.1.6/" resolver:resolver], @"different address");
+    STAssertNil([self proxyForString:@"http://[fe80::1]/" resolver:resolver], @"IPv6 range");
+    STAssertNotNil([self proxyForString:@"http://[2001:db8::1]/" resolver:resolver], @"outside IPv6 range");
+}
+
+- (void)testMalformedRangesAreIgnored
+{
+    setenv("no_proxy", "10.0.0.0/abc, 10.0.0.0/, 10.0.0.0/33, 10.0.0.0/-1, 10.0.0.0/ 8, fe80::/129, fe80::/0x10, 172.16.0.0/12", 1);
+    CURLProxyResolver* resolver = [CURLProxyResolver environmentResolver];
+
+    STAssertNotNil([self proxyForString:@"http://10.1.2.3/" resolver:resolver], @"malformed masks shouldn't match anything");
+    STAssertNotNil([self proxyForString:@"http://8.8.8.8/" resolver:resolver], @"malformed masks mustn't be read as /0");
+    STAssertNotNil([self proxyForString:@"http://[fe80::1]/" resolver:resolver], @"malformed IPv6 masks shouldn't match anything");
+    STAssertNil([self proxyForString:@"http://172.20.1.1/" resolver:resolver], @"well-formed ranges alongside them should still work");
+}
+
+- (void)testEnvironmentChanges
+{
+    CURLProxyResolver* resolver = [CURLProxyResolver environmentResolver];
+    STAssertNotNil([self proxyForString:@"http://www.example.com/" resolver:resolver], @"should be proxied");
+
+    setenv("no_proxy", "*", 1);
+    STAssertNil([self proxyForString:@"http://www.example.com/" resolver:resolver], @"change to environment should be noticed");
+
+    unsetenv("no_proxy");
+    unsetenv("https_proxy");
+    setenv("HTTPS_PROXY", "http://other.example.com:8080", 1);
+    STAssertEqualObjects([self proxyForString:@"https://www.example.com/" resolver:resolver], @"http://other.example.com:8080", @"uppercase variables should be used too");
+    unsetenv("HTTPS_PROXY");
+}
+
+- (void)testUppercaseHTTPProxyIsIgnored
+{
+    // As set by CGI from a request's "Proxy:" header
+    unsetenv("http_proxy");
+    setenv("HTTP_PROXY", "http://attacker.example.com:8080", 1);
+
+    CURLProxyResolver* resolver = [CURLProxyResolver environmentResolver];
+    STAssertNil([self proxyForString:@"http://www.example.com/" resolver:resolver], @"HTTP_PROXY shouldn't be trusted");
+    STAssertEqualObjects([self proxyForString:@"https://www.example.com/" resolver:resolver], @"http://secure-proxy.example.com:3129", @"https_proxy should be unaffected");
+
+    unsetenv("HTTP_PROXY");
+}
+
+@end
@@ -0,0 +1,307 @@
+//
+//  CURLResolverTests.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLHandleBasedTest.h"
+#import "CURLMultiHandle.h"
+#import "CURLTransfer+TestingSupport.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+
+#pragma mark Stub DNS Server
+
+/*  Answers A queries over UDP on loopback. Names are answered according to their first label:
+ *
+ *      fail.…  NXDOMAIN
+ *      slow.…  never answered
+ *      …       127.0.0.1
+ *
+ *  AAAA queries get an empty answer, so lookups settle on IPv4.
+ *
+ *  c-ares only takes a port for its servers from 1.11 on, so the standard port is tried first, on a loopback
+ *  address that a local resolver won't be using. Failing that, it's any free port on 127.0.0.1.
+ */
+
+@interface CURLStubDNSServer : NSObject
+{
+    int                 _socket;
+    NSString            *_address;
+    unsigned short      _port;
+    dispatch_source_t   _source;
+    NSUInteger          _queryCount;
+}
+
+@property (readonly, copy) NSString *address;
+@property (readonly) unsigned short port;
+@property (readonly) NSUInteger queryCount;
+
+- (void)stop;
+
+@end
+
+@implementation CURLStubDNSServer
+
+@synthesize address = _address;
+@synthesize port = _port;
+@synthesize queryCount = _queryCount;
+
+- (BOOL)bindToAddress:(const char *)host port:(unsigned short)port
+{
+    struct sockaddr_in address = { 0 };
+    address.sin_len = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    inet_pton(AF_INET, host, &address.sin_addr);
+    socklen_t length = sizeof(address);
+
+    // Loopback addresses other than 127.0.0.1 need an alias on OS X, and port 53 can need root, so either may fail
+    if (bind(_socket, (struct sockaddr *)&address, length) != 0 ||
+        getsockname(_socket, (struct sockaddr *)&address, &length) != 0)
+    {
+        return NO;
+    }
+
+    _address = [[NSString alloc] initWithUTF8String:host];
+    _port = ntohs(address.sin_port);
+    return YES;
+}
+
+- (id)init
+{
+    if (self = [super init])
+    {
+        _socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+        if (_socket < 0 ||
+            !([self bindToAddress:"127.0.0.2" port:53] ||
+              [self bindToAddress:"127.0.0.1" port:53] ||
+              [self bindToAddress:"127.0.0.1" port:0]))
+        {
+            if (_socket >= 0) close(_socket);
+            [self release]; return nil;
+        }
+
+        _source = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, _socket, 0, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+        dispatch_source_set_event_handler(_source, ^{
+            [self answerQuery];
+        });
+        int fd = _socket;
+        dispatch_source_set_cancel_handler(_source, ^{
+            close(fd);
+        });
+        dispatch_resume(_source);
+    }
+    return self;
+}
+
+- (void)stop
+{
+    if (_source)
+    {
+        dispatch_source_cancel(_source);   // closes the socket once the source is done with it
+        dispatch_release(_source); _source = NULL;
+    }
+}
+
+- (void)dealloc
+{
+    [self stop];
+    [_address release];
+    [super dealloc];
+}
+
+- (void)answerQuery
+{
+    uint8_t query[512];
+    struct sockaddr_storage client;
+    socklen_t clientLength = sizeof(client);
+    ssize_t length = recvfrom(_socket, query, sizeof(query), 0, (struct sockaddr *)&client, &clientLength);
+    if (length < 12) return;
+
+    @synchronized(self) { _queryCount++; }
+
+    // Walk the question's name, remembering its first label
+    NSString *firstLabel = nil;
+    ssize_t offset = 12;
+    while (offset < length && query[offset])
+    {
+        if (!firstLabel) firstLabel = [[[NSString alloc] initWithBytes:query + offset + 1 length:query[offset] encoding:NSASCIIStringEncoding] autorelease];
+        offset += query[offset] + 1;
+    }
+    offset += 1;
+    if (offset + 4 > length) return;
+
+    uint16_t type = (query[offset] << 8) | query[offset + 1];
+    offset += 4;    // type and class
+
+    if ([firstLabel isEqualToString:@"slow"]) return;
+
+    NSMutableData *response = [NSMutableData dataWithBytes:query length:offset];
+    uint8_t *header = [response mutableBytes];
+    BOOL fail = [firstLabel isEqualToString:@"fail"];
+    BOOL answer = (!fail && type == 1);
+
+    header[2] = 0x81;                   // response, recursion desired
+    header[3] = (fail ? 0x83 : 0x80);   // recursion available, NXDOMAIN or no error
+    header[6] = 0; header[7] = (answer ? 1 : 0);
+    header[8] = header[9] = header[10] = header[11] = 0;
+
+    if (answer)
+    {
+        uint8_t record[] = {
+            0xC0, 0x0C,                 // pointer to the question's name
+            0x00, 0x01, 0x00, 0x01,     // A, IN
+            0x00, 0x00, 0x00, 0x3C,     // TTL
+            0x00, 0x04, 127, 0, 0, 1,
+        };
+        [response appendBytes:record length:sizeof(record)];
+    }
+
+    sendto(_socket, [response bytes], [response length], 0, (struct sockaddr *)&client, clientLength);
+}
+
+@end
+
+
+#pragma mark - Tests
+
+@interface CURLResolverTests : CURLHandleBasedTest
+{
+    CURLStubDNSServer   *_DNSServer;
+    NSString            *_DNSServerString;
+    CURLMultiHandle     *_multi;
+}
+
+@end
+
+@implementation CURLResolverTests
+
+- (BOOL)setUpStubResolver
+{
+    _DNSServer = [[CURLStubDNSServer alloc] init];
+    STAssertNotNil(_DNSServer, @"couldn't start stub DNS server");
+    if (!_DNSServer) return NO;
+
+    NSString* server = _DNSServer.address;
+    if (_DNSServer.port != 53)
+    {
+        curl_version_info_data* info = curl_version_info(CURLVERSION_NOW);
+        if (info->ares_num < 0x010b00)
+        {
+            NSLog(@"Skipping resolver test as port 53 wasn't free, and the bundled c-ares is too old (before 1.11) to query another port");
+            return NO;
+        }
+        server = [NSString stringWithFormat:@"%@:%u", server, _DNSServer.port];
+    }
+
+    _DNSServerString = [server copy];
+    _multi = [[CURLTransfer standaloneMultiForTestPurposes] retain];
+    _multi.DNSServers = [NSArray arrayWithObject:server];
+    _multi.requiresAsynchronousResolver = YES;
+    _multi.DNSCacheTimeout = 0.0;
+
+    return YES;
+}
+
+- (void)tearDown
+{
+    if (_multi)
+    {
+        [CURLTransfer cleanupStandaloneMulti:_multi];
+        [_multi release]; _multi = nil;
+    }
+    [_DNSServer stop];
+    [_DNSServer release]; _DNSServer = nil;
+    [_DNSServerString release]; _DNSServerString = nil;
+
+    [super tearDown];
+}
+
+- (NSError*)errorLoadingHost:(NSString *)host
+{
+    // Nothing listens on port 1, so a successful lookup ends with a refused connection
+    NSURL* url = [NSURL URLWithString:[NSString stringWithFormat:@"http://%@:1/", host]];
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:[NSURLRequest requestWithURL:url] credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue] multi:_multi];
+    [self runUntilPaused];
+    [transfer release];
+
+    NSError* result = [[self.error retain] autorelease];
+    self.error = nil;
+    return result;
+}
+
+- (void)testResolverIsAsynchronous
+{
+    STAssertNotNil([CURLMultiHandle asynchronousResolver], @"CURLHandle's libcurl is built with c-ares");
+}
+
+- (void)testLookupThroughStub
+{
+    if (![self setUpStubResolver]) return;
+
+    NSError* error = [self errorLoadingHost:@"ok.curlhandle.test"];
+    STAssertEquals([error code], (NSInteger)NSURLErrorCannotConnectToHost, @"should have resolved, then been refused; got %@", error);
+    STAssertTrue(_DNSServer.queryCount > 0, @"stub should have been asked");
+}
+
+- (void)testFailedLookup
+{
+    if (![self setUpStubResolver]) return;
+
+    NSError* error = [self errorLoadingHost:@"fail.curlhandle.test"];
+    STAssertEquals([error code], (NSInteger)NSURLErrorCannotFindHost, @"got %@", error);
+}
+
+- (void)testSlowLookupTimesOutWithoutBlocking
+{
+    if (![self setUpStubResolver]) return;
+    _multi.resolveTimeout = 1.0;
+
+    NSURL* url = [NSURL URLWithString:@"http://slow.curlhandle.test:1/"];
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:[NSURLRequest requestWithURL:url] credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue] multi:_multi];
+
+    // A blocking lookup would hold up the multi's queue for the whole timeout
+    [NSThread sleepForTimeInterval:0.2];
+    CFAbsoluteTime before = CFAbsoluteTimeGetCurrent();
+    dispatch_sync(_multi.queue, ^{ });
+    STAssertTrue(CFAbsoluteTimeGetCurrent() - before < 0.5, @"multi's queue was blocked during the lookup");
+
+    [self runUntilPaused];
+    NSTimeInterval elapsed = CFAbsoluteTimeGetCurrent() - start;
+    [transfer release];
+
+    STAssertEquals([self.error code], (NSInteger)NSURLErrorTimedOut, @"got %@", self.error);
+    STAssertTrue(elapsed < 3.0, @"took %.1fs to time out", elapsed);
+}
+
+- (void)testRequestChoosesServersAndTimeout
+{
+    if (![self setUpStubResolver]) return;
+
+    // Only the request knows about the stub
+    _multi.DNSServers = nil;
+
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"http://slow.curlhandle.test:1/"]];
+    [request curl_setDNSServers:[NSArray arrayWithObject:_DNSServerString]];
+    [request curl_setResolveTimeout:1.0];
+
+    CFAbsoluteTime start = CFAbsoluteTimeGetCurrent();
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:request credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue] multi:_multi];
+    [self runUntilPaused];
+    NSTimeInterval elapsed = CFAbsoluteTimeGetCurrent() - start;
+    [transfer release];
+
+    STAssertTrue(_DNSServer.queryCount > 0, @"stub should have been asked");
+    STAssertEquals([self.error code], (NSInteger)NSURLErrorTimedOut, @"got %@", self.error);
+    STAssertTrue(elapsed < 3.0, @"took %.1fs to time out", elapsed);
+}
+
+@end
@@ -0,0 +1,194 @@
+//
+//  CURLResponseCacheTests.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLResponseCache.h"
+#import "CURLHandleBasedTest.h"
+
+
+@interface CURLResponseCacheTests : CURLHandleBasedTest
+
+@property (strong, nonatomic) NSURL* directoryURL;
+@property (strong, nonatomic) CURLResponseCache* cache;
+
+@end
+
+@implementation CURLResponseCacheTests
+
+- (void)dealloc
+{
+    [_directoryURL release];
+    [_cache release];
+
+    [super dealloc];
+}
+
+- (void)setUp
+{
+    [super setUp];
+
+    NSString* name = [NSString stringWithFormat:@"CURLResponseCacheTests-%@", [[NSProcessInfo processInfo] globallyUniqueString]];
+    self.directoryURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:name] isDirectory:YES];
+    self.cache = [[[CURLResponseCache alloc] initWithDirectoryURL:self.directoryURL] autorelease];
+}
+
+- (void)tearDown
+{
+    self.cache = nil;
+    [[NSFileManager defaultManager] removeItemAtURL:self.directoryURL error:NULL];
+
+    [super tearDown];
+}
+
+- (NSURLRequest*)requestForPath:(NSString*)path
+{
+    NSURL* url = [NSURL URLWithString:[@"http://example.com/" stringByAppendingString:path]];
+    return [NSURLRequest requestWithURL:url];
+}
+
+- (void)storeBody:(NSString*)body forRequest:(NSURLRequest*)request headers:(NSDictionary*)headers
+{
+    NSHTTPURLResponse* response = [[[NSHTTPURLResponse alloc] initWithURL:[request URL] statusCode:200 HTTPVersion:@"HTTP/1.1" headerFields:headers] autorelease];
+    STAssertTrue([self.cache shouldStoreResponse:response forRequest:request], @"response should be cacheable");
+
+    NSURL* bodyURL = [self.cache temporaryBodyFileURL];
+    [[body dataUsingEncoding:NSUTF8StringEncoding] writeToURL:bodyURL atomically:NO];
+    [self.cache storeResponse:response bodyFileURL:bodyURL forRequest:request];
+}
+
+- (NSString*)bodyOfCachedResponse:(CURLCachedResponse*)cached
+{
+    NSData* data = [NSData dataWithContentsOfURL:[cached bodyFileURL]];
+    return [[[NSString alloc] initWithData:data encoding:NSUTF8StringEncoding] autorelease];
+}
+
+#pragma mark - Tests
+
+- (void)testFreshHit
+{
+    NSURLRequest* request = [self requestForPath:@"fresh"];
+    [self storeBody:@"hello" forRequest:request headers:[NSDictionary dictionaryWithObject:@"max-age=3600" forKey:@"Cache-Control"]];
+
+    CURLCachedResponse* cached = [self.cache cachedResponseForRequest:request];
+    STAssertNotNil(cached, @"should have been stored");
+    STAssertTrue([cached isFresh], @"should be fresh");
+    STAssertEquals([[cached response] statusCode], (NSInteger)200, @"wrong status");
+    STAssertEqualObjects([self bodyOfCachedResponse:cached], @"hello", @"wrong body");
+
+    STAssertNil([self.cache cachedResponseForRequest:[self requestForPath:@"other"]], @"shouldn't match another URL");
+
+    STAssertEquals(self.cache.lookupCount, (NSUInteger)2, @"wrong lookup count");
+    STAssertEquals(self.cache.hitCount, (NSUInteger)1, @"wrong hit count");
+    STAssertEquals(self.cache.missCount, (NSUInteger)1, @"wrong miss count");
+    STAssertEqualsWithAccuracy(self.cache.hitRate, 0.5, 0.001, @"wrong hit rate");
+}
+
+- (void)testRevalidation
+{
+    NSURLRequest* request = [self requestForPath:@"stale"];
+    NSDictionary* headers = [NSDictionary dictionaryWithObjectsAndKeys:@"no-cache", @"Cache-Control", @"\"v1\"", @"ETag", nil];
+    [self storeBody:@"stale" forRequest:request headers:headers];
+
+    CURLCachedResponse* cached = [self.cache cachedResponseForRequest:request];
+    STAssertFalse([cached isFresh], @"no-cache should always need revalidating");
+    STAssertEqualObjects([cached entityTag], @"\"v1\"", @"wrong validator");
+
+    NSDictionary* notModifiedHeaders = [NSDictionary dictionaryWithObjectsAndKeys:@"\"v1\"", @"ETag", @"0", @"Content-Length", @"yes", @"X-Refreshed", nil];
+    NSHTTPURLResponse* notModified = [[[NSHTTPURLResponse alloc] initWithURL:[request URL] statusCode:304 HTTPVersion:@"HTTP/1.1" headerFields:notModifiedHeaders] autorelease];
+    NSHTTPURLResponse* updated = [self.cache updateCachedResponse:cached withNotModifiedResponse:notModified];
+
+    STAssertEquals([updated statusCode], (NSInteger)200, @"should still look like the original response");
+    STAssertEqualObjects([[updated allHeaderFields] objectForKey:@"X-Refreshed"], @"yes", @"headers should be updated");
+    STAssertNil([[updated allHeaderFields] objectForKey:@"Content-Length"], @"framing headers shouldn't be copied from the 304");
+    STAssertEquals(self.cache.revalidatedCount, (NSUInteger)1, @"wrong revalidation count");
+}
+
+- (void)testVary
+{
+    NSMutableURLRequest* english = [[[self requestForPath:@"vary"] mutableCopy] autorelease];
+    [english setValue:@"en" forHTTPHeaderField:@"Accept-Language"];
+    NSMutableURLRequest* french = [[english mutableCopy] autorelease];
+    [french setValue:@"fr" forHTTPHeaderField:@"Accept-Language"];
+
+    NSDictionary* headers = [NSDictionary dictionaryWithObjectsAndKeys:@"max-age=3600", @"Cache-Control", @"Accept-Language", @"Vary", nil];
+    [self storeBody:@"hello" forRequest:english headers:headers];
+
+    STAssertNotNil([self.cache cachedResponseForRequest:english], @"should match the same header value");
+    STAssertNil([self.cache cachedResponseForRequest:french], @"shouldn't match a different header value");
+
+    [self storeBody:@"bonjour" forRequest:french headers:headers];
+    STAssertEqualObjects([self bodyOfCachedResponse:[self.cache cachedResponseForRequest:english]], @"hello", @"variants should be kept separately");
+    STAssertEqualObjects([self bodyOfCachedResponse:[self.cache cachedResponseForRequest:french]], @"bonjour", @"variants should be kept separately");
+}
+
+- (void)testUncacheableResponses
+{
+    NSURLRequest* request = [self requestForPath:@"nostore"];
+
+    NSHTTPURLResponse* noStore = [[[NSHTTPURLResponse alloc] initWithURL:[request URL] statusCode:200 HTTPVersion:@"HTTP/1.1" headerFields:[NSDictionary dictionaryWithObject:@"no-store" forKey:@"Cache-Control"]] autorelease];
+    STAssertFalse([self.cache shouldStoreResponse:noStore forRequest:request], @"no-store should be respected");
+
+    NSHTTPURLResponse* noValidators = [[[NSHTTPURLResponse alloc] initWithURL:[request URL] statusCode:200 HTTPVersion:@"HTTP/1.1" headerFields:[NSDictionary dictionary]] autorelease];
+    STAssertFalse([self.cache shouldStoreResponse:noValidators forRequest:request], @"nothing to gain from storing a response which can't be reused");
+
+    NSHTTPURLResponse* varyStar = [[[NSHTTPURLResponse alloc] initWithURL:[request URL] statusCode:200 HTTPVersion:@"HTTP/1.1" headerFields:[NSDictionary dictionaryWithObjectsAndKeys:@"max-age=60", @"Cache-Control", @"*", @"Vary", nil]] autorelease];
+    STAssertFalse([self.cache shouldStoreResponse:varyStar forRequest:request], @"Vary: * can never match");
+}
+
+- (void)testLeastRecentlyUsedEviction
+{
+    self.cache.maximumEntryCount = 2;
+    NSDictionary* headers = [NSDictionary dictionaryWithObject:@"max-age=3600" forKey:@"Cache-Control"];
+
+    [self storeBody:@"a" forRequest:[self requestForPath:@"a"] headers:headers];
+    [NSThread sleepForTimeInterval:0.01];
+    [self storeBody:@"b" forRequest:[self requestForPath:@"b"] headers:headers];
+    [NSThread sleepForTimeInterval:0.01];
+
+    // Using a makes b the oldest
+    [self.cache cachedResponseForRequest:[self requestForPath:@"a"]];
+    [NSThread sleepForTimeInterval:0.01];
+    [self storeBody:@"c" forRequest:[self requestForPath:@"c"] headers:headers];
+
+    STAssertEquals(self.cache.entryCount, (NSUInteger)2, @"should have evicted down to the limit");
+    STAssertNotNil([self.cache cachedResponseForRequest:[self requestForPath:@"a"]], @"recently used entry should survive");
+    STAssertNil([self.cache cachedResponseForRequest:[self requestForPath:@"b"]], @"least recently used entry should be evicted");
+    STAssertNotNil([self.cache cachedResponseForRequest:[self requestForPath:@"c"]], @"newest entry should survive");
+}
+
+- (void)testPersistence
+{
+    NSURLRequest* request = [self requestForPath:@"persist"];
+    [self storeBody:@"kept" forRequest:request headers:[NSDictionary dictionaryWithObject:@"max-age=3600" forKey:@"Cache-Control"]];
+    [self.cache synchronize];
+
+    CURLResponseCache* reopened = [[CURLResponseCache alloc] initWithDirectoryURL:self.directoryURL];
+    CURLCachedResponse* cached = [reopened cachedResponseForRequest:request];
+    STAssertNotNil(cached, @"entry should survive reopening");
+    STAssertEqualObjects([self bodyOfCachedResponse:cached], @"kept", @"wrong body");
+    STAssertEquals(reopened.currentDiskSize, (unsigned long long)4, @"size should be recovered from disk");
+    [reopened release];
+}
+
+- (void)testOnlyOwnFilesAreSwept
+{
+    NSData* data = [@"mine" dataUsingEncoding:NSUTF8StringEncoding];
+    NSURL* neighbourURL = [self.directoryURL URLByAppendingPathComponent:@"Neighbour.txt"];
+    [data writeToURL:neighbourURL atomically:NO];
+
+    // A body left over from a load which never finished
+    NSURL* leftoverURL = [self.cache temporaryBodyFileURL];
+    [data writeToURL:leftoverURL atomically:NO];
+    [self.cache synchronize];
+
+    CURLResponseCache* reopened = [[CURLResponseCache alloc] initWithDirectoryURL:self.directoryURL];
+    STAssertTrue([[NSFileManager defaultManager] fileExistsAtPath:[neighbourURL path]], @"files which aren't the cache's should be left alone");
+    STAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:[leftoverURL path]], @"bodies the index doesn't know about should be cleared out");
+    [reopened release];
+}
+
+@end
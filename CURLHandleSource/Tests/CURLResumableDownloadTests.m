@@ -0,0 +1,145 @@
+//
+//  CURLResumableDownloadTests.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLResumableDownload.h"
+#import "CURLHandleBasedTest.h"
+
+
+@interface CURLResumableDownloadTests : CURLHandleBasedTest <CURLResumableDownloadDelegate>
+
+@property (strong, nonatomic) NSURL* destinationURL;
+@property (assign, nonatomic) unsigned long long firstOffset;
+@property (assign, nonatomic) unsigned long long bytesWritten;
+
+@end
+
+@implementation CURLResumableDownloadTests
+
+- (void)dealloc
+{
+    [_destinationURL release];
+
+    [super dealloc];
+}
+
+- (void)setUp
+{
+    [super setUp];
+
+    NSString* name = [NSString stringWithFormat:@"CURLResumableDownloadTests-%@.txt", [[NSProcessInfo processInfo] globallyUniqueString]];
+    self.destinationURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:name]];
+    self.firstOffset = ULLONG_MAX;
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtURL:self.destinationURL error:NULL];
+    [[NSFileManager defaultManager] removeItemAtURL:[CURLResumableDownload checkpointURLForDestinationURL:self.destinationURL] error:NULL];
+    self.bytesWritten = 0;
+
+    [super tearDown];
+}
+
+- (void)resumableDownload:(CURLResumableDownload *)download willWriteFromOffset:(unsigned long long)offset
+{
+    if (self.firstOffset == ULLONG_MAX) self.firstOffset = offset;
+}
+
+- (void)resumableDownload:(CURLResumableDownload *)download didWriteDataOfLength:(NSUInteger)length totalBytesWritten:(unsigned long long)totalBytesWritten totalBytesExpected:(long long)totalBytesExpected
+{
+    self.bytesWritten = totalBytesWritten;
+}
+
+- (void)resumableDownload:(CURLResumableDownload *)download didCompleteWithError:(NSError *)error
+{
+    self.error = error;
+    [self pause];
+}
+
+- (void)writePartialFile:(NSData*)data checkpoint:(NSDictionary*)extra
+{
+    [data writeToURL:self.destinationURL atomically:YES];
+
+    NSMutableDictionary* checkpoint = [NSMutableDictionary dictionaryWithDictionary:extra];
+    [checkpoint setObject:[[self testFileRemoteURL] absoluteString] forKey:@"URL"];
+    [checkpoint setObject:[NSNumber numberWithUnsignedInteger:[data length]] forKey:@"offset"];
+    [checkpoint writeToURL:[CURLResumableDownload checkpointURLForDestinationURL:self.destinationURL] atomically:YES];
+}
+
+- (void)download
+{
+    NSURLRequest* request = [NSURLRequest requestWithURL:[self testFileRemoteURL]];
+    CURLResumableDownload* download = [[CURLResumableDownload alloc] initWithRequest:request destinationURL:self.destinationURL credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue]];
+    [download start];
+
+    [self runUntilPaused];
+
+    [download release];
+}
+
+- (void)checkDownloadedFile
+{
+    STAssertNil(self.error, @"got error %@", self.error);
+
+    NSData* expected = [NSData dataWithContentsOfURL:[self testFileURL]];
+    NSData* received = [NSData dataWithContentsOfURL:self.destinationURL];
+    STAssertEqualObjects(received, expected, @"downloaded file didn't match");
+    STAssertEquals(self.bytesWritten, (unsigned long long)[expected length], @"progress didn't add up");
+
+    BOOL checkpointExists = [[NSFileManager defaultManager] fileExistsAtPath:[[CURLResumableDownload checkpointURLForDestinationURL:self.destinationURL] path]];
+    STAssertFalse(checkpointExists, @"checkpoint should be removed once complete");
+}
+
+#pragma mark - Tests
+
+- (void)testFreshDownload
+{
+    [self download];
+
+    STAssertEquals(self.firstOffset, 0ULL, @"should have started at the beginning");
+    [self checkDownloadedFile];
+}
+
+- (void)testResumingFromCheckpoint
+{
+    NSData* expected = [NSData dataWithContentsOfURL:[self testFileURL]];
+    NSUInteger half = [expected length] / 2;
+    [self writePartialFile:[expected subdataWithRange:NSMakeRange(0, half)] checkpoint:nil];
+
+    [self download];
+
+    STAssertEquals(self.firstOffset, (unsigned long long)half, @"should have resumed from the checkpoint");
+    [self checkDownloadedFile];
+}
+
+- (void)testChangedFileRestarts
+{
+    // A validator the server won't match, so If-Range gets us the whole file again
+    NSData* garbage = [@"this isn't what's on the server" dataUsingEncoding:NSUTF8StringEncoding];
+    [self writePartialFile:garbage checkpoint:[NSDictionary dictionaryWithObject:@"\"no-such-etag\"" forKey:@"ETag"]];
+
+    [self download];
+
+    [self checkDownloadedFile];
+}
+
+- (void)testCheckpointForDifferentURLIsIgnored
+{
+    [self writePartialFile:[@"junk" dataUsingEncoding:NSUTF8StringEncoding] checkpoint:nil];
+
+    NSMutableDictionary* checkpoint = [NSMutableDictionary dictionaryWithContentsOfURL:[CURLResumableDownload checkpointURLForDestinationURL:self.destinationURL]];
+    [checkpoint setObject:@"http://example.com/other" forKey:@"URL"];
+    [checkpoint writeToURL:[CURLResumableDownload checkpointURLForDestinationURL:self.destinationURL] atomically:YES];
+
+    [self download];
+
+    STAssertEquals(self.firstOffset, 0ULL, @"should have started at the beginning");
+    [self checkDownloadedFile];
+}
+
+@end
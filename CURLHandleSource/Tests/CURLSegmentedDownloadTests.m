@@ -0,0 +1,135 @@
+//
+//  CURLSegmentedDownloadTests.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLSegmentedDownload.h"
+#import "CURLHandleBasedTest.h"
+
+
+@interface CURLSegmentedDownloadTests : CURLHandleBasedTest <CURLSegmentedDownloadDelegate>
+
+@property (strong, nonatomic) NSURL* destinationURL;
+@property (assign, nonatomic) unsigned long long bytesWritten;
+
+@end
+
+@implementation CURLSegmentedDownloadTests
+
+- (void)dealloc
+{
+    [_destinationURL release];
+
+    [super dealloc];
+}
+
+- (void)setUp
+{
+    [super setUp];
+
+    NSString* name = [NSString stringWithFormat:@"CURLSegmentedDownloadTests-%@.txt", [[NSProcessInfo processInfo] globallyUniqueString]];
+    self.destinationURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:name]];
+}
+
+- (void)tearDown
+{
+    [[NSFileManager defaultManager] removeItemAtURL:self.destinationURL error:NULL];
+    self.bytesWritten = 0;
+
+    [super tearDown];
+}
+
+- (void)segmentedDownload:(CURLSegmentedDownload *)download didReceiveResponse:(NSURLResponse *)response
+{
+    self.response = response;
+}
+
+- (void)segmentedDownload:(CURLSegmentedDownload *)download didWriteDataOfLength:(NSUInteger)length totalBytesWritten:(unsigned long long)totalBytesWritten totalBytesExpected:(long long)totalBytesExpected
+{
+    self.bytesWritten = totalBytesWritten;
+}
+
+- (void)segmentedDownload:(CURLSegmentedDownload *)download didCompleteWithError:(NSError *)error
+{
+    self.error = error;
+    [self pause];
+}
+
+- (void)checkDownloadedFile
+{
+    STAssertNil(self.error, @"got error %@", self.error);
+
+    NSData* expected = [NSData dataWithContentsOfURL:[self testFileURL]];
+    NSData* received = [NSData dataWithContentsOfURL:self.destinationURL];
+    STAssertEqualObjects(received, expected, @"downloaded file didn't match");
+    STAssertEquals(self.bytesWritten, (unsigned long long)[expected length], @"progress didn't add up");
+}
+
+#pragma mark - Tests
+
+- (void)testSegmentedDownload
+{
+    NSURLRequest* request = [NSURLRequest requestWithURL:[self testFileRemoteURL]];
+    CURLSegmentedDownload* download = [[CURLSegmentedDownload alloc] initWithRequest:request destinationURL:self.destinationURL credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue]];
+
+    // Tiny segments so that even the small test file gets split up
+    download.minimumSegmentLength = 8;
+    download.maximumConnections = 3;
+    [download start];
+
+    [self runUntilPaused];
+
+    STAssertEquals([(NSHTTPURLResponse*)self.response statusCode], (NSInteger)206, @"should have used range requests");
+    [self checkDownloadedFile];
+
+    [download release];
+}
+
+- (void)testZeroMaximumConnections
+{
+    NSURLRequest* request = [NSURLRequest requestWithURL:[self testFileRemoteURL]];
+    CURLSegmentedDownload* download = [[CURLSegmentedDownload alloc] initWithRequest:request destinationURL:self.destinationURL credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue]];
+
+    // Should carry on over a single connection, rather than never starting a segment after the probe
+    download.minimumSegmentLength = 8;
+    download.maximumConnections = 0;
+    [download start];
+
+    [self runUntilPaused];
+
+    [self checkDownloadedFile];
+
+    [download release];
+}
+
+- (void)testSmallFileIsNotSegmented
+{
+    NSURLRequest* request = [NSURLRequest requestWithURL:[self testFileRemoteURL]];
+    CURLSegmentedDownload* download = [[CURLSegmentedDownload alloc] initWithRequest:request destinationURL:self.destinationURL credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue]];
+    [download start];
+
+    [self runUntilPaused];
+
+    [self checkDownloadedFile];
+
+    [download release];
+}
+
+- (void)testCancelling
+{
+    NSURLRequest* request = [NSURLRequest requestWithURL:[self testFileRemoteURL]];
+    CURLSegmentedDownload* download = [[CURLSegmentedDownload alloc] initWithRequest:request destinationURL:self.destinationURL credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue]];
+    [download start];
+    [download cancel];
+
+    [self runUntilPaused];
+
+    STAssertEquals([self.error code], (NSInteger)NSURLErrorCancelled, @"should have been cancelled");
+
+    [download release];
+}
+
+@end
@@ -0,0 +1,104 @@
+//
+//  CURLSocketOptionsTests.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLSocketOptions.h"
+#import "CURLRequest.h"
+#import "CURLHandleBasedTest.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+
+@interface CURLSocketOptionsTests : CURLHandleBasedTest
+
+@end
+
+@implementation CURLSocketOptionsTests
+
+- (int)intOptionForSocket:(int)socket level:(int)level name:(int)name
+{
+    int value = 0;
+    socklen_t length = sizeof(value);
+    STAssertEquals(getsockopt(socket, level, name, &value, &length), 0, @"getsockopt failed: %d", errno);
+    return value;
+}
+
+- (void)testApplyToSocket
+{
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    STAssertTrue(fd >= 0, @"couldn't make a socket");
+
+    CURLSocketOptions* options = [[CURLSocketOptions alloc] init];
+    options.noDelay = YES;
+    options.keepAliveIdleTime = 30.0;
+    options.receiveBufferSize = 256 * 1024;
+
+    NSError* error = nil;
+    STAssertTrue([options applyToSocket:fd error:&error], @"failed with %@", error);
+
+    STAssertTrue([self intOptionForSocket:fd level:IPPROTO_TCP name:TCP_NODELAY] != 0, @"Nagle should be off");
+    STAssertTrue([self intOptionForSocket:fd level:SOL_SOCKET name:SO_KEEPALIVE] != 0, @"keepalive should be on");
+    STAssertTrue([self intOptionForSocket:fd level:SOL_SOCKET name:SO_RCVBUF] >= 256 * 1024, @"buffer should have grown");
+
+    [options release];
+    close(fd);
+}
+
+- (void)testTypeOfServiceForEachFamily
+{
+    CURLSocketOptions* options = [[CURLSocketOptions alloc] init];
+    options.typeOfService = 0x08;
+
+    // Not yet connected, as when libcurl hands the socket over
+    int fd = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    NSError* error = nil;
+    STAssertTrue([options applyToSocket:fd error:&error], @"failed with %@", error);
+    STAssertEquals([self intOptionForSocket:fd level:IPPROTO_IP name:IP_TOS], 0x08, @"should have set IP_TOS on an IPv4 socket");
+    close(fd);
+
+    fd = socket(AF_INET6, SOCK_STREAM, IPPROTO_TCP);
+    error = nil;
+    STAssertTrue([options applyToSocket:fd error:&error], @"failed with %@", error);
+    STAssertEquals([self intOptionForSocket:fd level:IPPROTO_IPV6 name:IPV6_TCLASS], 0x08, @"should have set IPV6_TCLASS on an IPv6 socket");
+    close(fd);
+
+    [options release];
+}
+
+- (void)testOptionsForBandwidth
+{
+    // 100Mbit/s over 80ms needs 1MB in flight
+    CURLSocketOptions* options = [CURLSocketOptions optionsForBandwidth:12.5 * 1000 * 1000 roundTripTime:0.08];
+    STAssertEquals(options.sendBufferSize, (NSUInteger)1000000, @"should cover the bandwidth-delay product");
+    STAssertEquals(options.receiveBufferSize, (NSUInteger)1000000, @"should cover the bandwidth-delay product");
+
+    options = [CURLSocketOptions optionsForBandwidth:1000.0 roundTripTime:0.001];
+    STAssertEquals(options.receiveBufferSize, (NSUInteger)(64 * 1024), @"shouldn't go below the floor");
+}
+
+- (void)testRequestProperty
+{
+    CURLSocketOptions* options = [CURLSocketOptions lowLatencyOptions];
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:@"http://example.com/"]];
+    [request curl_setSocketOptions:options];
+
+    CURLSocketOptions* stored = [request curl_socketOptions];
+    STAssertTrue(stored != options, @"should have been copied");
+    STAssertTrue(stored.noDelay, @"should survive copying");
+    STAssertEquals(stored.typeOfService, options.typeOfService, @"should survive copying");
+
+    // Archiving goes through NSCoding
+    CURLSocketOptions* unarchived = [NSKeyedUnarchiver unarchiveObjectWithData:[NSKeyedArchiver archivedDataWithRootObject:[CURLSocketOptions bulkTransferOptions]]];
+    STAssertEquals(unarchived.receiveBufferSize, [CURLSocketOptions bulkTransferOptions].receiveBufferSize, @"should survive archiving");
+
+    [request curl_setSocketOptions:nil];
+    STAssertNil([request curl_socketOptions], @"should have been removed");
+}
+
+@end
@@ -0,0 +1,118 @@
+//
+//  CURLTransferBatchTests.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLTransferBatch.h"
+#import "CURLHandleBasedTest.h"
+
+
+@interface CURLTransferBatchTests : CURLHandleBasedTest <CURLTransferBatchDelegate>
+
+@property (strong, nonatomic) NSMutableArray* items;
+@property (strong, nonatomic) CURLTransferBatchSummary* summary;
+
+@end
+
+@implementation CURLTransferBatchTests
+
+- (void)dealloc
+{
+    [_items release];
+    [_summary release];
+
+    [super dealloc];
+}
+
+- (void)transferBatch:(CURLTransferBatch *)batch didFinishItems:(NSArray *)items
+{
+    if (!self.items)
+    {
+        self.items = [NSMutableArray array];
+    }
+
+    [self.items addObjectsFromArray:items];
+}
+
+- (void)transferBatch:(CURLTransferBatch *)batch didCompleteWithSummary:(CURLTransferBatchSummary *)summary
+{
+    NSLog(@"test: batch finished %@", summary);
+
+    self.summary = summary;
+    [self pause];
+}
+
+- (NSArray*)requestsForRemoteTestFile:(NSUInteger)count
+{
+    NSMutableArray* requests = [NSMutableArray arrayWithCapacity:count];
+    for (NSUInteger i = 0; i < count; ++i)
+    {
+        [requests addObject:[NSURLRequest requestWithURL:[self testFileRemoteURL]]];
+    }
+
+    return requests;
+}
+
+#pragma mark - Tests
+
+- (void)testHTTPDownloads
+{
+    NSArray* requests = [self requestsForRemoteTestFile:10];
+    CURLTransferBatch* batch = [[CURLTransferBatch alloc] initWithRequests:requests credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue]];
+    batch.maximumConcurrentTransfersPerOrigin = 4;
+    [batch start];
+
+    [self runUntilPaused];
+
+    STAssertEquals([self.items count], [requests count], @"every request should have been reported");
+    STAssertEquals(self.summary.succeededCount, [requests count], @"unexpected failures in %@", self.items);
+    STAssertEquals(self.summary.failedCount, (NSUInteger)0, @"unexpected failures in %@", self.items);
+    STAssertTrue(self.summary.medianLatency > 0.0, @"should have latencies");
+    STAssertTrue(self.summary.maximumLatency >= [self.summary latencyAtPercentile:90.0], @"percentiles out of order");
+
+    NSString* testNotes = [NSString stringWithContentsOfURL:[self testFileURL] encoding:NSUTF8StringEncoding error:nil];
+    for (CURLTransferBatchItem* item in self.items)
+    {
+        NSString* received = [[NSString alloc] initWithData:item.data encoding:NSUTF8StringEncoding];
+        STAssertEqualObjects(received, testNotes, @"item %lu didn't match", (unsigned long)item.index);
+        [received release];
+    }
+
+    STAssertEquals(self.summary.totalBytesReceived, (unsigned long long)[requests count] * [[testNotes dataUsingEncoding:NSUTF8StringEncoding] length], @"byte count mismatch");
+
+    [batch release];
+}
+
+- (void)testEmptyBatch
+{
+    CURLTransferBatch* batch = [[CURLTransferBatch alloc] initWithRequests:@[] credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue]];
+    [batch start];
+
+    [self runUntilPaused];
+
+    STAssertNotNil(self.summary, @"should still get a summary");
+    STAssertEquals(self.summary.succeededCount + self.summary.failedCount, (NSUInteger)0, @"nothing to do");
+
+    [batch release];
+}
+
+- (void)testCancelling
+{
+    NSArray* requests = [self requestsForRemoteTestFile:20];
+    CURLTransferBatch* batch = [[CURLTransferBatch alloc] initWithRequests:requests credential:nil delegate:self delegateQueue:[NSOperationQueue mainQueue]];
+    batch.maximumConcurrentTransfers = 2;
+    [batch start];
+    [batch cancel];
+
+    [self runUntilPaused];
+
+    STAssertEquals([self.items count], [requests count], @"every request should have been reported");
+    STAssertTrue(self.summary.failedCount > 0, @"some requests should have been cancelled");
+
+    [batch release];
+}
+
+@end
@@ -0,0 +1,115 @@
+//
+//  CURLTransferErrorTests.m
+//  CURLHandle
+//
+//  Created by Mike Abdullah on 17/10/2026.
+//  Copyright (c) 2026 Karelia Software. All rights reserved.
+//
+
+#import "CURLTransferError.h"
+#import "CURLHandleBasedTest.h"
+
+
+@interface CURLTransferErrorTests : CURLHandleBasedTest
+
+@end
+
+@implementation CURLTransferErrorTests
+
+/**
+ Builds an error the way CURLTransfer did before userInfo was made lazy, to compare against.
+ */
+
+- (NSError*)eagerErrorWithDomain:(NSString*)domain code:(NSInteger)code URL:(NSURL*)url curlCode:(CURLcode)curlCode responseCode:(long)responseCode osErrorNumber:(long)osErrorNumber errorBuffer:(const char*)errorBuffer
+{
+    NSMutableDictionary* userInfo = [NSMutableDictionary dictionaryWithObjectsAndKeys:
+                                     url, NSURLErrorFailingURLErrorKey,
+                                     [url absoluteString], NSURLErrorFailingURLStringErrorKey,
+                                     [NSString stringWithUTF8String:errorBuffer], NSLocalizedDescriptionKey,
+                                     [NSString stringWithUTF8String:curl_easy_strerror(curlCode)], NSLocalizedFailureReasonErrorKey,
+                                     nil];
+
+    if (responseCode)
+    {
+        [userInfo setObject:[NSNumber numberWithLong:responseCode] forKey:@(CURLINFO_RESPONSE_CODE)];
+    }
+
+    if (osErrorNumber)
+    {
+        [userInfo setObject:[NSError errorWithDomain:NSPOSIXErrorDomain code:osErrorNumber userInfo:nil] forKey:NSUnderlyingErrorKey];
+    }
+
+    NSError* result = [NSError errorWithDomain:CURLcodeErrorDomain code:curlCode userInfo:userInfo];
+    if (![domain isEqualToString:CURLcodeErrorDomain])
+    {
+        NSMutableDictionary* translatedUserInfo = [NSMutableDictionary dictionaryWithDictionary:userInfo];
+        [translatedUserInfo setObject:result forKey:NSUnderlyingErrorKey];
+        result = [NSError errorWithDomain:domain code:code userInfo:translatedUserInfo];
+    }
+
+    return result;
+}
+
+- (void)checkError:(NSError*)error matchesError:(NSError*)expected
+{
+    STAssertEqualObjects([error domain], [expected domain], @"domains should match");
+    STAssertEquals([error code], [expected code], @"codes should match");
+
+    NSDictionary* userInfo = [error userInfo];
+    NSDictionary* expectedUserInfo = [expected userInfo];
+    STAssertEqualObjects([NSSet setWithArray:[userInfo allKeys]], [NSSet setWithArray:[expectedUserInfo allKeys]], @"should have the same keys");
+
+    for (id aKey in expectedUserInfo)
+    {
+        id value = [userInfo objectForKey:aKey];
+        id expectedValue = [expectedUserInfo objectForKey:aKey];
+        if ([expectedValue isKindOfClass:[NSError class]])
+        {
+            [self checkError:value matchesError:expectedValue];
+        }
+        else
+        {
+            STAssertEqualObjects(value, expectedValue, @"values for %@ should match", aKey);
+        }
+    }
+}
+
+#pragma mark - Tests
+
+- (void)testLazyUserInfoMatchesEager
+{
+    NSURL* url = [NSURL URLWithString:@"ftp://example.com/file.txt"];
+
+    // Translated into a Cocoa error, with the libcurl one underneath
+    CURLTransferError* error = [[CURLTransferError alloc] initWithDomain:NSURLErrorDomain code:NSURLErrorCannotConnectToHost URL:url curlCode:CURLE_COULDNT_CONNECT responseCode:421 osErrorNumber:ECONNREFUSED errorBuffer:"Failed connect to example.com:21; Connection refused"];
+    [self checkError:error matchesError:[self eagerErrorWithDomain:NSURLErrorDomain code:NSURLErrorCannotConnectToHost URL:url curlCode:CURLE_COULDNT_CONNECT responseCode:421 osErrorNumber:ECONNREFUSED errorBuffer:"Failed connect to example.com:21; Connection refused"]];
+    [error release];
+
+    // Left as a libcurl error, with errno underneath
+    error = [[CURLTransferError alloc] initWithDomain:CURLcodeErrorDomain code:CURLE_RECV_ERROR URL:url curlCode:CURLE_RECV_ERROR responseCode:0 osErrorNumber:ECONNRESET errorBuffer:"Recv failure: Connection reset by peer"];
+    [self checkError:error matchesError:[self eagerErrorWithDomain:CURLcodeErrorDomain code:CURLE_RECV_ERROR URL:url curlCode:CURLE_RECV_ERROR responseCode:0 osErrorNumber:ECONNRESET errorBuffer:"Recv failure: Connection reset by peer"]];
+    [error release];
+
+    // libcurl said nothing
+    error = [[CURLTransferError alloc] initWithDomain:CURLcodeErrorDomain code:CURLE_GOT_NOTHING URL:url curlCode:CURLE_GOT_NOTHING responseCode:0 osErrorNumber:0 errorBuffer:NULL];
+    [self checkError:error matchesError:[self eagerErrorWithDomain:CURLcodeErrorDomain code:CURLE_GOT_NOTHING URL:url curlCode:CURLE_GOT_NOTHING responseCode:0 osErrorNumber:0 errorBuffer:""]];
+    [error release];
+}
+
+- (void)testErrorBufferWhichIsNotUTF8
+{
+    NSURL* url = [NSURL URLWithString:@"ftp://example.com/file.txt"];
+
+    // A Hungarian server's reply, in ISO Latin 2
+    const char* buffer = "Sikertelen bel\xE9p\xE9s";
+    CURLTransferError* error = [[CURLTransferError alloc] initWithDomain:NSURLErrorDomain code:NSURLErrorUserAuthenticationRequired URL:url curlCode:CURLE_LOGIN_DENIED responseCode:530 osErrorNumber:0 errorBuffer:buffer];
+
+    NSDictionary* userInfo = nil;
+    STAssertNoThrow(userInfo = [error userInfo], @"building userInfo shouldn't throw");
+    STAssertEqualObjects([userInfo objectForKey:NSLocalizedDescriptionKey], [NSString stringWithCString:buffer encoding:NSISOLatin2StringEncoding], @"should have fallen back to ISO Latin 2");
+    STAssertNotNil([[userInfo objectForKey:NSUnderlyingErrorKey] userInfo], @"underlying error should cope too");
+
+    [error release];
+}
+
+@end
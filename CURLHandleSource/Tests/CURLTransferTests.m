@@ -8,9 +8,12 @@
 
 #import "CURLHandleBasedTest.h"
 #import "CURLTransfer+TestingSupport.h"
+#import "CURLTransfer+MultiSupport.h"
 #import "CURLMultiHandle.h"
 
 #import "CURLRequest.h"
+#import "CURLTransferMetrics.h"
+#import "KMSServer.h"
 
 #pragma mark - Globals
 
@@ -37,6 +40,7 @@ typedef enum
 
 @property (strong, nonatomic) CURLMultiHandle* multi;
 @property (assign, nonatomic) TestMode mode;
+@property (assign, atomic) NSUInteger receivedDataCount;
 
 @end
 
@@ -81,8 +85,16 @@ static TestMode gModeToUse;
     [super dealloc];
 }
 
+- (void)transfer:(CURLTransfer *)transfer didReceiveData:(NSData *)data
+{
+    self.receivedDataCount++;
+    [super transfer:transfer didReceiveData:data];
+}
+
 - (void)cleanup
 {
+    self.receivedDataCount = 0;
+
     switch (self.mode)
     {
         case TEST_WITH_OWN_MULTI:
@@ -258,6 +270,176 @@ static TestMode gModeToUse;
     }
 }
 
+- (void)testDownloadCoalesced
+{
+    if (self.mode != TEST_WITH_SHARED_MULTI) return;   // coalescing is done by the multi
+
+    // A local file is read by libcurl in one go, CURL_MAX_WRITE_SIZE at a time, so there's a known minimum number of reads
+    NSMutableData* contents = [NSMutableData dataWithLength:1024 * 1024];
+    arc4random_buf([contents mutableBytes], [contents length]);
+    NSURL* fileURL = [NSURL fileURLWithPath:[NSTemporaryDirectory() stringByAppendingPathComponent:@"CURLTransferTestsCoalesced"]];
+    [contents writeToURL:fileURL atomically:YES];
+    NSUInteger minimumReadCount = [contents length] / CURL_MAX_WRITE_SIZE;
+
+    // Delivered straight from the multi's queue, with reads gathered together
+    CURLMultiHandle* multi = [CURLMultiHandle sharedInstance];
+    NSURLRequest* request = [NSURLRequest requestWithURL:fileURL];
+    CURLTransfer* transfer = [[CURLTransfer alloc] initWithRequest:request credential:nil delegate:self multi:multi];
+    transfer.coalescesReceivedData = YES;
+    [multi beginTransfer:transfer];
+
+    [self runUntilPaused];
+
+    STAssertNil(self.error, @"got error %@", self.error);
+    STAssertEqualObjects(self.buffer, contents, @"no data should have been lost, or held back");
+    STAssertTrue(self.receivedDataCount > 0, @"should have been given some data");
+    STAssertTrue(self.receivedDataCount < minimumReadCount, @"%lu deliveries for at least %lu reads; should have been coalesced", (unsigned long)self.receivedDataCount, (unsigned long)minimumReadCount);
+
+    [transfer release];
+    [[NSFileManager defaultManager] removeItemAtURL:fileURL error:NULL];
+}
+
+- (void)testHTTPDownloadMetrics
+{
+    NSURLRequest* request = [NSURLRequest requestWithURL:[self testFileRemoteURL]];
+    CURLTransfer* transfer = [self newHandleWithRequest:request];
+    if (transfer)
+    {
+        if (self.mode != TEST_SYNCHRONOUS)
+        {
+            [self runUntilPaused];
+        }
+
+        CURLTransferMetrics* metrics = transfer.metrics;
+        NSLog(@"test: metrics %@", metrics);
+
+        STAssertNotNil(metrics, @"should have metrics once complete");
+        STAssertTrue(metrics.totalTime > 0.0, @"should have taken some time");
+        STAssertTrue(metrics.connectTime <= metrics.startTransferTime && metrics.startTransferTime <= metrics.totalTime, @"times should accumulate");
+        STAssertEquals((NSUInteger)metrics.bytesReceived, [self.buffer length], @"byte count mismatch");
+        STAssertNotNil(metrics.remoteAddress, @"should know who we talked to");
+
+        [transfer release];
+    }
+}
+
+
+/**
+ A body of unknown length, fed in gradually as something like a compressor would, so libcurl has to pause
+ the upload while it waits for more.
+ */
+
+- (NSInputStream*)newGraduallyWrittenStreamWithChunks:(NSArray*)chunks
+{
+    CFReadStreamRef readStream;
+    CFWriteStreamRef writeStream;
+    CFStreamCreateBoundPair(NULL, &readStream, &writeStream, 1024);
+    NSOutputStream* producer = [(NSOutputStream*)writeStream autorelease];
+
+    [producer open];
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        for (NSString* aChunk in chunks)
+        {
+            [NSThread sleepForTimeInterval:0.1];
+            NSData* data = [aChunk dataUsingEncoding:NSUTF8StringEncoding];
+            [producer write:[data bytes] maxLength:[data length]];
+        }
+        [producer close];
+    });
+
+    return (NSInputStream*)readStream;
+}
+
+/**
+ Undoes Transfer-Encoding: chunked, ignoring any extensions and trailers. Returns nil if it's malformed.
+ */
+
+- (NSData*)dataByDechunking:(NSData*)chunked
+{
+    NSMutableData* result = [NSMutableData data];
+    NSString* remaining = [[[NSString alloc] initWithData:chunked encoding:NSISOLatin1StringEncoding] autorelease];
+
+    while (YES)
+    {
+        NSRange lineEnd = [remaining rangeOfString:@"\r\n"];
+        if (lineEnd.location == NSNotFound) return nil;
+
+        unsigned length;
+        NSScanner* scanner = [NSScanner scannerWithString:[remaining substringToIndex:lineEnd.location]];
+        if (![scanner scanHexInt:&length]) return nil;
+        if (length == 0) return result;
+
+        NSUInteger start = NSMaxRange(lineEnd);
+        if (start + length + 2 > [remaining length]) return nil;
+        [result appendData:[[remaining substringWithRange:NSMakeRange(start, length)] dataUsingEncoding:NSISOLatin1StringEncoding]];
+        remaining = [remaining substringFromIndex:start + length + 2];
+    }
+}
+
+- (void)testHTTPChunkedUpload
+{
+    // Needs a server which echoes the request body back, e.g: defaults write otest CURLHandleHTTPEchoURL "https://httpbin.org/post"
+    NSString* echo = [[NSUserDefaults standardUserDefaults] objectForKey:@"CURLHandleHTTPEchoURL"];
+    if (!echo)
+    {
+        NSLog(@"Skipping chunked upload test as there's no echo server set up");
+        return;
+    }
+
+    NSArray* chunks = @[@"CURLHandle ", @"chunked ", @"upload ", @"test"];
+
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:echo]];
+    [request setHTTPMethod:@"POST"];
+    [request setHTTPBodyStream:[[self newGraduallyWrittenStreamWithChunks:chunks] autorelease]];
+
+    CURLTransfer* transfer = [self newHandleWithRequest:request];
+    if (transfer)
+    {
+        if (self.mode != TEST_SYNCHRONOUS)
+        {
+            [self runUntilPaused];
+        }
+
+        STAssertNil(self.error, @"got error %@", self.error);
+
+        NSString* received = [[[NSString alloc] initWithData:self.buffer encoding:NSUTF8StringEncoding] autorelease];
+        STAssertTrue([received rangeOfString:@"CURLHandle chunked upload test"].location != NSNotFound, @"body wasn't echoed back: %@", received);
+
+        [transfer release];
+    }
+}
+
+- (void)testHTTPChunkedUploadArrivesIntact
+{
+    // MockServer sends back the body exactly as it arrived, still chunked
+    [self setupServerWithResponseFileNamed:@"http-echo"];
+    NSURL* url = [NSURL URLWithString:[NSString stringWithFormat:@"http://127.0.0.1:%ld/echo", (long)self.server.port]];
+
+    NSArray* chunks = @[@"CURLHandle ", @"chunked ", @"upload ", @"test, ", @"with a longer chunk to finish it off"];
+    NSString* expected = [chunks componentsJoinedByString:@""];
+
+    NSMutableURLRequest* request = [NSMutableURLRequest requestWithURL:url];
+    [request setHTTPMethod:@"POST"];
+    [request setHTTPBodyStream:[[self newGraduallyWrittenStreamWithChunks:chunks] autorelease]];
+
+    CURLTransfer* transfer = [self newHandleWithRequest:request];
+    if (transfer)
+    {
+        if (self.mode != TEST_SYNCHRONOUS)
+        {
+            [self runUntilPaused];
+        }
+
+        STAssertNil(self.error, @"got error %@", self.error);
+        STAssertTrue([self.transcript rangeOfString:@"Transfer-Encoding: chunked"].location != NSNotFound, @"should have been sent chunked: %@", self.transcript);
+
+        NSData* body = [self dataByDechunking:self.buffer];
+        STAssertNotNil(body, @"chunked framing was broken: %@", self.buffer);
+        STAssertEqualObjects([[[NSString alloc] initWithData:body encoding:NSUTF8StringEncoding] autorelease], expected, @"body didn't arrive intact");
+
+        [transfer release];
+    }
+}
 
 - (void)testFTPDownload
 {